@@ -0,0 +1,52 @@
+/**
+ * @file    aes.h
+ * @brief   AES-128 encryption in software.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef AES_H_
+#define AES_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  AES AES
+ * @brief     AES-128 functions
+ */
+
+/**
+ * @addtogroup AES
+ * @{
+ */
+
+#define AES_BLOCK_SIZE  16  ///< Size of cipher block in bytes
+#define AES_KEY_SIZE    16  ///< Size of key in bytes
+
+/**
+ * @brief Expanded key.
+ */
+typedef struct {
+  uint32_t rk[44];  ///< Round keys (11 rounds of 4 words)
+} AES_Context;
+
+void  AES_SetKey  (AES_Context* ctx, const uint8_t* key);
+void  AES_Encrypt (const AES_Context* ctx, const uint8_t* in, uint8_t* out);
+void  AES_Ctr     (const AES_Context* ctx, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, uint32_t len);
+
+/**
+ * @}
+ */
+
+#endif /* AES_H_ */
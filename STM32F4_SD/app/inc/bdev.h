@@ -0,0 +1,177 @@
+/**
+ * @file    bdev.h
+ * @brief   Stackable block devices.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef BDEV_H_
+#define BDEV_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  BDEV BDEV
+ * @brief     Block device layers between file systems and drives.
+ */
+
+/**
+ * @addtogroup BDEV
+ * @{
+ */
+
+#define BDEV_SECTOR_SIZE  512 ///< Size of sector in bytes
+
+/*
+ * Operations of requests
+ */
+#define BDEV_READ     0 ///< Read sectors
+#define BDEV_WRITE    1 ///< Write sectors
+#define BDEV_FLUSH    2 ///< Write everything held by layers to the drive
+#define BDEV_TRIM     3 ///< Sectors are not used any more
+#define BDEV_OPS      4 ///< Number of operations
+
+/*
+ * Status of requests
+ */
+#define BDEV_OK       0 ///< Request finished
+#define BDEV_ERROR    1 ///< Request failed
+#define BDEV_PENDING  2 ///< Request is still running
+
+typedef struct BDEV_Request BDEV_Request;
+typedef struct BDEV_Device BDEV_Device;
+
+/**
+ * @brief Request to a block device.
+ */
+struct BDEV_Request {
+  uint8_t op;               ///< BDEV_READ, BDEV_WRITE, BDEV_FLUSH or BDEV_TRIM
+  volatile uint8_t status;  ///< BDEV_PENDING until finished
+  uint8_t* buf;             ///< Data of read or write
+  uint32_t sector;          ///< First sector (not used by flush)
+  uint32_t count;           ///< Number of sectors (not used by flush)
+  void (*done)(BDEV_Request* req); ///< Called when finished (may be 0)
+  void* ctx;                ///< For use by done
+};
+
+/**
+ * @brief Block device or layer.
+ * @details Layers are structures starting with this one, so a pointer
+ * to the layer can be used as a pointer to the device.
+ */
+struct BDEV_Device {
+  void (*submit)(BDEV_Device* dev, BDEV_Request* req); ///< Starts a request
+  void (*poll)(BDEV_Device* dev); ///< Moves running requests on (0 - poll lower device)
+  BDEV_Device* lower;       ///< Device below (0 - drive)
+};
+
+/**
+ * @brief Drive with functions of its driver (bottom of stack).
+ */
+typedef struct {
+  BDEV_Device dev;
+  uint8_t (*read)(uint8_t* buf, uint32_t sector, uint32_t count);  ///< Returns 0 if read
+  uint8_t (*write)(uint8_t* buf, uint32_t sector, uint32_t count); ///< Returns 0 if written
+} BDEV_Drive;
+
+/**
+ * @brief Statistics of requests passing a layer.
+ */
+typedef struct {
+  uint32_t requests[BDEV_OPS]; ///< Requests by operation
+  uint32_t sectors[BDEV_OPS];  ///< Sectors by operation
+  uint32_t errors;             ///< Failed requests
+  uint32_t errorSector;        ///< First sector of last failed request
+} BDEV_Counters;
+
+/**
+ * @brief Layer counting requests.
+ * @details Passes requests down unchanged, so it can be put above any
+ * layer. It keeps one request running below; the next one waits for
+ * it.
+ */
+typedef struct {
+  BDEV_Device dev;
+  BDEV_Counters counters;   ///< Statistics
+  BDEV_Request child;       ///< Request passed down
+  BDEV_Request* parent;     ///< Request counted (0 - none running)
+} BDEV_Stats;
+
+/**
+ * @brief Sector held by the cache.
+ */
+typedef struct {
+  uint32_t sector;          ///< Sector in the line
+  uint32_t used;            ///< Time of last use (for LRU)
+  uint8_t valid;            ///< Line holds a sector
+  uint8_t dirty;            ///< Sector was written only to the line
+} BDEV_CacheLine;
+
+/**
+ * @brief Write back cache of single sectors.
+ * @details Single sector requests, like these of FAT tables and
+ * directories, are served from the cache. Requests of more sectors go
+ * straight down, with the cached sectors updated. Written sectors reach
+ * the drive when evicted or flushed.
+ */
+typedef struct {
+  BDEV_Device dev;
+  BDEV_CacheLine* lines;    ///< Lines
+  uint8_t* data;            ///< Sectors of lines
+  uint8_t size;             ///< Number of lines
+  uint32_t clock;           ///< Counter of uses
+  uint32_t hits;            ///< Requests served from cache
+  uint32_t misses;          ///< Sectors read from drive
+  uint32_t writeBacks;      ///< Sectors written back
+} BDEV_Cache;
+
+/**
+ * @brief Layer merging consecutive writes.
+ * @details A write which continues the pending one is appended to it,
+ * so the drive gets one multiple sector write instead of many single
+ * ones. Pending sectors are written before any other write, and on
+ * flush. Reads see pending data.
+ */
+typedef struct {
+  BDEV_Device dev;
+  uint8_t* buf;             ///< Pending sectors
+  uint32_t size;            ///< Size of buf in sectors
+  uint32_t sector;          ///< First pending sector
+  uint32_t count;           ///< Number of pending sectors
+  uint32_t merged;          ///< Writes appended to pending ones
+} BDEV_Coalescer;
+
+void    BDEV_Submit       (BDEV_Device* dev, BDEV_Request* req);
+void    BDEV_Complete     (BDEV_Request* req, uint8_t status);
+void    BDEV_Poll         (BDEV_Device* dev);
+uint8_t BDEV_Wait         (BDEV_Device* dev, BDEV_Request* req);
+uint8_t BDEV_Read         (BDEV_Device* dev, uint8_t* buf, uint32_t sector, uint32_t count);
+uint8_t BDEV_Write        (BDEV_Device* dev, const uint8_t* buf, uint32_t sector, uint32_t count);
+uint8_t BDEV_Flush        (BDEV_Device* dev);
+uint8_t BDEV_Trim         (BDEV_Device* dev, uint32_t sector, uint32_t count);
+
+void    BDEV_InitDrive    (BDEV_Drive* drive,
+    uint8_t (*read)(uint8_t* buf, uint32_t sector, uint32_t count),
+    uint8_t (*write)(uint8_t* buf, uint32_t sector, uint32_t count));
+void    BDEV_InitStats    (BDEV_Stats* stats, BDEV_Device* lower);
+void    BDEV_GetCounters  (BDEV_Stats* stats, BDEV_Counters* counters);
+void    BDEV_InitCache    (BDEV_Cache* cache, BDEV_Device* lower,
+    BDEV_CacheLine* lines, uint8_t* data, uint8_t size);
+void    BDEV_InitCoalescer(BDEV_Coalescer* co, BDEV_Device* lower,
+    uint8_t* buf, uint32_t size);
+
+/**
+ * @}
+ */
+
+#endif /* BDEV_H_ */
@@ -0,0 +1,44 @@
+/**
+ * @file    boot.h
+ * @brief   Timing of boot phases.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef BOOT_H_
+#define BOOT_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  BOOT BOOT
+ * @brief     Boot profiling functions
+ */
+
+/**
+ * @addtogroup BOOT
+ * @{
+ */
+
+#define BOOT_MAX_MARKS    16        ///< Number of phases marked in main
+#define BOOT_RESET_CLOCK  16000000  ///< Core clock before SystemInit (HSI)
+
+void      BOOT_Mark     (const char* name);
+uint32_t  BOOT_GetTime  (void);
+void      BOOT_Report   (void);
+
+/**
+ * @}
+ */
+
+#endif /* BOOT_H_ */
@@ -34,6 +34,7 @@ void    COMM_Init(uint32_t baud);
 void    COMM_Putc(uint8_t c);
 uint8_t COMM_Getc(void);
 uint8_t COMM_GetFrame(uint8_t* buf, uint8_t* len);
+void    COMM_SendFrame(const uint8_t* buf, uint8_t len);
 
 /**
  * @}
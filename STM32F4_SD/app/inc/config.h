@@ -0,0 +1,45 @@
+/**
+ * @file    config.h
+ * @brief   Configuration store in internal flash.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  CONFIG CONFIG
+ * @brief     Configuration store functions
+ */
+
+/**
+ * @addtogroup CONFIG
+ * @{
+ */
+
+#define CONFIG_MAX_ID   64  ///< Number of configuration items (IDs 0 to CONFIG_MAX_ID-1)
+#define CONFIG_MAX_LEN  256 ///< Maximum length of item value
+
+uint8_t CONFIG_Init   (void);
+int     CONFIG_Read   (uint16_t id, void* data, int maxLen);
+uint8_t CONFIG_Write  (uint16_t id, const void* data, int len);
+uint8_t CONFIG_Delete (uint16_t id);
+
+/**
+ * @}
+ */
+
+#endif /* CONFIG_H_ */
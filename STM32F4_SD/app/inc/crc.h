@@ -0,0 +1,45 @@
+/**
+ * @file    crc.h
+ * @brief   CRC-32 of data blocks.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef CRC_H_
+#define CRC_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  CRC CRC
+ * @brief     CRC-32 functions
+ */
+
+/**
+ * @addtogroup CRC
+ * @{
+ */
+
+#define CRC_START 0xffffffff ///< CRC of no data
+
+void      CRC_Init      (uint32_t (*hwUpdate)(uint32_t crc,
+    const uint32_t* data, uint32_t words));
+uint32_t  CRC_Calc      (const void* data, uint32_t len);
+uint32_t  CRC_Update    (uint32_t crc, const void* data, uint32_t len);
+uint32_t  CRC_Software  (uint32_t crc, const void* data, uint32_t len);
+
+/**
+ * @}
+ */
+
+#endif /* CRC_H_ */
@@ -0,0 +1,103 @@
+/**
+ * @file    dsp.h
+ * @brief   Block processing pipeline for sampled signals.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef DSP_H_
+#define DSP_H_
+
+#include <inttypes.h>
+
+#ifdef DSP_USE_CMSIS
+  #define ARM_MATH_CM4
+  #include <arm_math.h>
+#endif
+
+/**
+ * @defgroup  DSP DSP
+ * @brief     Signal processing pipeline functions
+ */
+
+/**
+ * @addtogroup DSP
+ * @{
+ */
+
+#define DSP_MAX_STAGES    6   ///< Maximum number of stages in pipeline
+#define DSP_MAX_BLOCK     256 ///< Maximum number of input samples per block
+#define DSP_MAX_TAPS      64  ///< Maximum number of FIR taps
+#define DSP_MAX_SECTIONS  4   ///< Maximum number of biquad sections
+#define DSP_MAX_STATE     (DSP_MAX_TAPS + DSP_MAX_BLOCK) ///< Length of stage state
+
+/**
+ * @brief Kinds of pipeline stages.
+ */
+typedef enum {
+  DSP_FIR,      ///< FIR filter
+  DSP_BIQUAD,   ///< Cascade of biquad filters
+  DSP_DECIMATE, ///< FIR filter keeping every n-th sample
+  DSP_RMS,      ///< Root mean square of block (one value)
+  DSP_BANDS,    ///< Energies of equal frequency bands of block (FFT)
+} DSP_StageType;
+
+/**
+ * @brief Pipeline stage.
+ */
+typedef struct {
+  DSP_StageType type;     ///< Kind of stage
+  const float* coeffs;    ///< FIR taps or biquad coefficients
+  uint16_t count;         ///< Number of taps, sections or bands
+  uint16_t factor;        ///< Decimation factor
+  uint16_t inLen;         ///< Length of input block
+  uint16_t outLen;        ///< Length of output block
+  uint64_t cycles;        ///< Cycles spent in stage
+  float state[DSP_MAX_STATE]; ///< Filter history or FFT twiddles
+#ifdef DSP_USE_CMSIS
+  union {
+    arm_fir_instance_f32 fir;
+    arm_biquad_casd_df1_inst_f32 biquad;
+    arm_fir_decimate_instance_f32 decimate;
+    arm_rfft_fast_instance_f32 fft;
+  } cmsis;                ///< CMSIS-DSP kernel instance
+#endif
+} DSP_Stage;
+
+/**
+ * @brief Pipeline structure typedef.
+ */
+typedef struct {
+  DSP_Stage stage[DSP_MAX_STAGES];  ///< Stages in order of processing
+  uint8_t count;                    ///< Number of stages
+  uint16_t blockSize;               ///< Number of input samples per block
+  uint32_t blocks;                  ///< Number of processed blocks
+  float buf[2][DSP_MAX_BLOCK];      ///< Blocks between stages
+  float fft[2 * DSP_MAX_BLOCK];     ///< FFT work area
+} DSP_Pipeline;
+
+uint8_t   DSP_Init        (DSP_Pipeline* p, uint16_t blockSize);
+uint8_t   DSP_AddFir      (DSP_Pipeline* p, const float* coeffs, uint16_t taps);
+uint8_t   DSP_AddBiquad   (DSP_Pipeline* p, const float* coeffs, uint16_t sections);
+uint8_t   DSP_AddDecimate (DSP_Pipeline* p, const float* coeffs, uint16_t taps,
+    uint16_t factor);
+uint8_t   DSP_AddRms      (DSP_Pipeline* p);
+uint8_t   DSP_AddBands    (DSP_Pipeline* p, uint16_t bands);
+int       DSP_Process     (DSP_Pipeline* p, const int16_t* in, float* out);
+uint32_t  DSP_GetCycles   (DSP_Pipeline* p, uint8_t stage);
+
+/**
+ * @}
+ */
+
+#endif /* DSP_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file    efile.h
+ * @brief   Encrypted files.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef EFILE_H_
+#define EFILE_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  EFILE EFILE
+ * @brief     Encrypted file functions
+ */
+
+/**
+ * @addtogroup EFILE
+ * @{
+ */
+
+#define EFILE_SECTOR_SIZE 512       ///< Size of sector (unit of counter)
+#define EFILE_NONCE_SIZE  8         ///< Size of file nonce
+#define EFILE_MAGIC       0x4c494645 ///< "EFIL" - valid file header
+
+/**
+ * @brief Header in the first sector of an encrypted file.
+ */
+typedef struct {
+  uint32_t magic;                     ///< EFILE_MAGIC
+  uint8_t nonce[EFILE_NONCE_SIZE];    ///< Random nonce of file
+  uint32_t checksum;                  ///< CRC of preceding fields
+} EFILE_Header;
+
+/**
+ * @brief Opened encrypted file.
+ */
+typedef struct {
+  int file;                           ///< FAT file
+  uint8_t nonce[EFILE_NONCE_SIZE];    ///< Random nonce of file
+  int rdPtr;                          ///< Read pointer (in plaintext)
+  int wrPtr;                          ///< Write pointer (in plaintext)
+} EFILE_TypeDef;
+
+void    EFILE_Init      (const uint8_t* key,
+    void (*randomFunc)(uint8_t* buf, uint32_t len),
+    void (*startFunc)(const uint8_t* counter, const uint8_t* in, uint8_t* out,
+        uint32_t len),
+    void (*waitFunc)(void));
+uint8_t EFILE_Open      (EFILE_TypeDef* f, const char* filename);
+void    EFILE_Close     (EFILE_TypeDef* f);
+int     EFILE_Read      (EFILE_TypeDef* f, uint8_t* data, int count);
+int     EFILE_Write     (EFILE_TypeDef* f, const uint8_t* data, int count);
+void    EFILE_MoveRdPtr (EFILE_TypeDef* f, int ptr);
+void    EFILE_MoveWrPtr (EFILE_TypeDef* f, int ptr);
+int     EFILE_GetSize   (EFILE_TypeDef* f);
+
+/**
+ * @}
+ */
+
+#endif /* EFILE_H_ */
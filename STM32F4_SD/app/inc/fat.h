@@ -19,6 +19,7 @@
 #define FAT_H_
 
 #include <inttypes.h>
+#include <bdev.h>
 
 /**
  * @defgroup  FAT FAT
@@ -30,15 +31,76 @@
  * @{
  */
 
-int8_t FAT_Init(void (*phyInit)(void),
-    uint8_t (*phyReadSectors)(uint8_t* buf, uint32_t sector, uint32_t count),
-    uint8_t (*phyWriteSectors)(uint8_t* buf, uint32_t sector, uint32_t count));
+/**
+ * @brief Buffer description for vectored I/O.
+ */
+typedef struct {
+  uint8_t* buf; ///< Data buffer
+  int len;      ///< Number of bytes in buffer
+} FAT_IoVec;
+
+/**
+ * @brief Physical layer access statistics.
+ */
+typedef struct {
+  uint32_t phyReads;        ///< Number of read commands issued to the drive
+  uint32_t phyWrites;       ///< Number of write commands issued to the drive
+  uint32_t sectorsRead;     ///< Number of sectors read
+  uint32_t sectorsWritten;  ///< Number of sectors written
+  uint32_t bytesWritten;    ///< Number of data bytes written by the application
+  uint32_t dirWrites;       ///< Number of root directory entry updates
+  uint32_t mountTime;       ///< Time in ms spent in FAT_Init (including drive initialization)
+  uint32_t firstWriteTime;  ///< System time in ms of first write to the drive (time to first write after reset)
+  uint8_t snapshotUsed;     ///< Nonzero if volume was mounted from snapshot
+  uint32_t phyErrors;       ///< Number of reads and writes failed by the drive
+  uint32_t errorSector;     ///< First sector of last failed read or write
+} FAT_Stats;
+
+/**
+ * @brief Fragmentation of a file.
+ */
+typedef struct {
+  uint32_t fileSize;        ///< Size of file in bytes
+  uint32_t clusters;        ///< Number of clusters in chain
+  uint32_t fragments;       ///< Number of runs of consecutive clusters
+} FAT_Fragmentation;
+
+/**
+ * @brief Contiguity of free space.
+ */
+typedef struct {
+  uint32_t clusters;        ///< Number of data clusters in volume
+  uint32_t clusterSize;     ///< Size of cluster in bytes
+  uint32_t freeClusters;    ///< Number of free clusters
+  uint32_t freeRuns;        ///< Number of runs of consecutive free clusters
+  uint32_t largestFreeRun;  ///< Number of clusters in largest free run
+} FAT_FreeSpace;
+
+#define FAT_SNAPSHOT_SIZE 256 ///< Bytes of memory needed for mount snapshot
+
+int8_t FAT_Init(uint8_t (*phyInit)(void), BDEV_Device* dev);
+
+void FAT_SetSnapshot(void* store, void (*cardIdFunc)(uint8_t* id));
 
 int FAT_OpenFile(const char* filename);
+int FAT_CloseFile(int file);
+int FAT_SyncFile(int file);
 int FAT_ReadFile(int file, uint8_t* data, int count);
 int FAT_MoveRdPtr(int file, int newWrPtr);
 int FAT_MoveWrPtr(int file, int newWrPtr);
+int FAT_GetFileSize(int file);
 int FAT_WriteFile(int file, const uint8_t* data, int count);
+int FAT_ReadFileV(int file, const FAT_IoVec* iov, int iovcnt);
+int FAT_WriteFileV(int file, const FAT_IoVec* iov, int iovcnt);
+void FAT_SetSyncPolicy(uint32_t bytes, uint32_t ms);
+void FAT_Update(void);
+void FAT_GetStats(FAT_Stats* stats);
+int FAT_GetFragmentation(int file, FAT_Fragmentation* info);
+int8_t FAT_ReportContiguity(void (*fileFunc)(const char* filename,
+    const FAT_Fragmentation* info), FAT_FreeSpace* freeSpace);
+int8_t FAT_DefragFile(const char* filename);
+int8_t FAT_DefragStep(void);
+void FAT_ResetStats(void);
 
 /**
  * @}
@@ -49,8 +49,20 @@ typedef enum {
   KEY_NONE = 0xff
 } KEY_Id_Typedef;
 
-void KEYS_Init(void);
-uint8_t KEYS_Update(void);
+/**
+ * @brief Keyboard event types.
+ */
+typedef enum {
+  KEY_EVENT_PRESS,    ///< Key pressed (debounced)
+  KEY_EVENT_REPEAT,   ///< Key still held
+  KEY_EVENT_RELEASE,  ///< Key released (debounced)
+} KEY_Event_Typedef;
+
+void    KEYS_Init         (void);
+uint8_t KEYS_Update       (void);
+uint8_t KEYS_GetEvent     (uint8_t* id, KEY_Event_Typedef* event);
+void    KEYS_SetCallbacks (uint8_t id, void (*pressCb)(void),
+    void (*repeatCb)(void), void (*releaseCb)(void));
 
 /**
  * @}
@@ -0,0 +1,51 @@
+/**
+ * @file    kvs.h
+ * @brief   Key-value store in a preallocated file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef KVS_H_
+#define KVS_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  KVS KVS
+ * @brief     Key-value store functions
+ */
+
+/**
+ * @addtogroup KVS
+ * @{
+ */
+
+#define KVS_MAX_KEYS      128   ///< Maximum number of keys (size of RAM index)
+#define KVS_MAX_SEGMENTS  32    ///< Maximum number of segments in file
+#define KVS_SEGMENT_SIZE  8192  ///< Size of segment in bytes
+#define KVS_MAX_KEY       32    ///< Maximum length of key
+#define KVS_MAX_VALUE     (512 - 8 - 16 - KVS_MAX_KEY) ///< Maximum length of value
+
+uint8_t KVS_Open    (const char* filename);
+uint8_t KVS_Close   (void);
+uint8_t KVS_Sync    (void);
+int     KVS_Get     (const char* key, uint8_t* value, int maxLen);
+uint8_t KVS_Put     (const char* key, const uint8_t* value, int len);
+uint8_t KVS_Delete  (const char* key);
+void    KVS_Update  (void);
+
+/**
+ * @}
+ */
+
+#endif /* KVS_H_ */
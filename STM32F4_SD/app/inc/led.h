@@ -27,6 +27,8 @@
 #ifndef LED_H_
 #define LED_H_
 
+#include <inttypes.h>
+
 /**
  * @defgroup  LED LED
  * @brief     Light Emitting Diode control functions.
@@ -61,11 +63,25 @@ typedef enum {
   LED_UNUSED, //!< LED_UNUSED LED not initialized
   LED_OFF,    //!< LED_OFF    Turn off LED
   LED_ON,     //!< LED_ON     Turn on LED
+  LED_PATTERN,//!< LED_PATTERN LED plays a pattern
 } LED_State_TypeDef;
 
+/**
+ * @brief Patterns played by hardware.
+ */
+typedef enum {
+  LED_PATTERN_BLINK,      //!< LED_PATTERN_BLINK      1Hz blink
+  LED_PATTERN_BLINK_FAST, //!< LED_PATTERN_BLINK_FAST 5Hz blink
+  LED_PATTERN_BREATHE,    //!< LED_PATTERN_BREATHE    Slow fade in and out
+  LED_PATTERN_HEARTBEAT,  //!< LED_PATTERN_HEARTBEAT  Two short flashes
+  LED_PATTERN_COUNT,
+} LED_Pattern_TypeDef;
+
 void LED_Init         (LED_Number_TypeDef led);
 void LED_Toggle       (LED_Number_TypeDef led);
 void LED_ChangeState  (LED_Number_TypeDef led, LED_State_TypeDef state);
+void LED_StartPattern (LED_Number_TypeDef led, LED_Pattern_TypeDef pattern);
+void LED_ShowError    (LED_Number_TypeDef led, uint8_t code);
 
 /**
  * @}
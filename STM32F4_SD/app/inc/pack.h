@@ -0,0 +1,73 @@
+/**
+ * @file    pack.h
+ * @brief   Lossless compression of sample blocks.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef PACK_H_
+#define PACK_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  PACK PACK
+ * @brief     Sample block compression functions
+ */
+
+/**
+ * @addtogroup PACK
+ * @{
+ */
+
+#define PACK_MAGIC        0x4b50  ///< Marks a block header ("PK")
+#define PACK_MAX_SAMPLES  2048    ///< Maximum number of samples in block
+#define PACK_MAX_CHANNELS 16      ///< Maximum number of interleaved channels
+
+/**
+ * @brief Compression methods.
+ */
+typedef enum {
+  PACK_STORED,  ///< Samples stored as they are
+  PACK_DELTA1,  ///< Differences to previous sample, Rice coded
+  PACK_DELTA2,  ///< Differences to linear prediction, Rice coded
+} PACK_Method;
+
+/**
+ * @brief Header in front of every block.
+ *
+ * @details A block can be decompressed on its own, the header gives
+ * its length, so blocks written one after another can be walked.
+ */
+typedef struct {
+  uint16_t magic;     ///< PACK_MAGIC
+  uint8_t method;     ///< PACK_Method
+  uint8_t channels;   ///< Number of interleaved channels
+  uint16_t count;     ///< Number of samples
+  uint16_t length;    ///< Number of bytes following header
+  uint32_t checksum;  ///< CRC of samples
+} PACK_Header;
+
+/// Largest compressed size of block of count samples (header included)
+#define PACK_MAX_PACKED(count) (sizeof(PACK_Header) + 2 * (count))
+
+int PACK_Compress   (const int16_t* samples, uint16_t count, uint8_t channels,
+    uint8_t* out);
+int PACK_Decompress (const uint8_t* in, int len, int16_t* samples,
+    uint16_t maxCount);
+
+/**
+ * @}
+ */
+
+#endif /* PACK_H_ */
@@ -0,0 +1,98 @@
+/**
+ * @file    ringlog.h
+ * @brief   Circular log in a preallocated file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef RINGLOG_H_
+#define RINGLOG_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  RINGLOG RINGLOG
+ * @brief     Circular log functions
+ */
+
+/**
+ * @addtogroup RINGLOG
+ * @{
+ */
+
+#define RINGLOG_MAGIC         0x474f4c52 ///< Marks a valid header ("RLOG")
+#define RINGLOG_BLOCK_SIZE    512 ///< Size of block (one sector)
+#define RINGLOG_HEADER_BLOCKS 2   ///< Blocks at start of file holding the two header copies
+#define RINGLOG_BUFFER_BLOCKS 8   ///< Blocks collected in RAM before they are written
+#define RINGLOG_COMMIT_BLOCKS 64  ///< Blocks written between header updates
+
+/**
+ * @brief Header of the log.
+ *
+ * @details Two copies are kept in the first two blocks of the file and
+ * are written alternately, so a header torn by a power failure leaves
+ * the other one intact. The copy with the higher commit number is valid.
+ */
+typedef struct {
+  uint32_t magic;       ///< RINGLOG_MAGIC
+  uint32_t commit;      ///< Number of header updates
+  uint32_t blockCount;  ///< Number of data blocks in file
+  uint32_t nextSeq;     ///< Sequence number of next block to write
+  uint32_t oldestSeq;   ///< Sequence number of oldest block in log
+  uint32_t checksum;    ///< CRC of preceding fields
+} RINGLOG_Header;
+
+/**
+ * @brief Header at the start of every data block.
+ *
+ * @details Block with sequence number seq is stored at data block
+ * seq % blockCount. The block payload holds records, each preceded
+ * by its 16-bit length.
+ */
+typedef struct {
+  uint32_t seq;         ///< Sequence number of block
+  uint16_t used;        ///< Number of payload bytes used
+  uint16_t reserved;    ///< Always 0
+  uint32_t checksum;    ///< CRC of preceding fields and payload
+} RINGLOG_BlockHeader;
+
+#define RINGLOG_PAYLOAD (RINGLOG_BLOCK_SIZE - sizeof(RINGLOG_BlockHeader)) ///< Payload bytes in block
+#define RINGLOG_MAX_RECORD (RINGLOG_PAYLOAD - 2) ///< Maximum length of record
+
+/**
+ * @brief Log structure typedef.
+ */
+typedef struct {
+  int file;             ///< ID of opened file
+  uint32_t blockCount;  ///< Number of data blocks in file
+  uint32_t nextSeq;     ///< Sequence number of next block to write
+  uint32_t oldestSeq;   ///< Sequence number of oldest block in log
+  uint32_t commit;      ///< Number of header updates
+  uint32_t commitSeq;   ///< Value of nextSeq stored in last header
+  uint32_t commitOldest; ///< Value of oldestSeq stored in last header
+  uint32_t bufBlocks;   ///< Number of finished blocks in buffer
+  uint32_t bufUsed;     ///< Payload bytes used in current block
+  uint8_t buf[RINGLOG_BUFFER_BLOCKS * RINGLOG_BLOCK_SIZE]; ///< Blocks not yet written
+} RINGLOG_TypeDef;
+
+uint8_t RINGLOG_Open      (RINGLOG_TypeDef* log, const char* filename);
+uint8_t RINGLOG_Append    (RINGLOG_TypeDef* log, const uint8_t* data, uint16_t len);
+uint8_t RINGLOG_Flush     (RINGLOG_TypeDef* log);
+uint8_t RINGLOG_Close     (RINGLOG_TypeDef* log);
+int     RINGLOG_ReadBlock (RINGLOG_TypeDef* log, uint32_t seq, uint8_t* block);
+
+/**
+ * @}
+ */
+
+#endif /* RINGLOG_H_ */
@@ -3,6 +3,15 @@
  * @brief   SD card control functions.
  * @date    22 kwi 2014
  * @author  Michal Ksiezopolski
+ *
+ * @details The card is on the SPI bus (sdcard.c), or on the 4-bit SDIO
+ * bus (sdio_card.c) if SD_USE_SDIO is defined.
+ *
+ * SD_Init waits until the card has powered up. SD_StartInit and
+ * SD_PollInit do the same in steps, so other initialization can run
+ * meanwhile, SD_WaitInit finishes it. During power up ACMD41 is sent
+ * first every SD_INIT_INTERVAL_MIN ms, then less and less often (up
+ * to SD_INIT_INTERVAL_MAX ms), for at most SD_INIT_TIMEOUT ms.
  * 
  * @verbatim
  * Copyright (c) 2014 Michal Ksiezopolski.
@@ -18,7 +27,7 @@
 #ifndef SDCARD_H_
 #define SDCARD_H_
 
-#include <stm32f4xx.h>
+#include <inttypes.h>
 
 /**
  * @defgroup  SD_CARD SD CARD
@@ -30,11 +39,81 @@
  * @{
  */
 
-void    SD_Init         (void);
+#define SD_INIT_TIMEOUT       1000  ///< Time for card to power up [ms]
+#define SD_INIT_INTERVAL_MIN  1     ///< First time between ACMD41 [ms]
+#define SD_INIT_INTERVAL_MAX  32    ///< Longest time between ACMD41 [ms]
+
+/*
+ * Command selection policy (SD_SetCommandPolicy)
+ */
+#define SD_POLICY_SINGLE      0x01  ///< READ_SINGLE_BLOCK/WRITE_BLOCK for one sector
+#define SD_POLICY_CMD23       0x02  ///< SET_BLOCK_COUNT before multiple block transfers (if in SCR)
+#define SD_POLICY_PRE_ERASE   0x04  ///< SET_WR_BLK_ERASE_COUNT before multiple block writes
+#define SD_POLICY_DEFAULT     0x07  ///< Policy after reset
+
+#define SD_COMMANDS           64    ///< Number of command indexes
+
+/*
+ * Tiers of recovery after a transfer error, from the cheapest
+ */
+#define SD_TIER_RETRY         0     ///< Transfer repeated
+#define SD_TIER_RESYNC        1     ///< Dummy clocks with card deselected
+#define SD_TIER_STATUS        2     ///< STOP_TRANSMISSION and SEND_STATUS
+#define SD_TIER_SLOW          3     ///< SPI clock halved (for all later transfers)
+#define SD_TIER_REINIT        4     ///< Card initialized again
+#define SD_TIERS              5     ///< Number of tiers
+
+/**
+ * @brief Statistics of the last card initialization.
+ */
+typedef struct {
+  uint8_t cid[16];        ///< CID of the card (zeros if not read)
+  uint32_t powerUpTime;   ///< Time from SD_StartInit until card finished power up [ms]
+  uint32_t initTime;      ///< Time from SD_StartInit until card was ready or failed [ms]
+  uint16_t polls;         ///< Number of ACMD41 sent
+  uint8_t error;          ///< Nonzero if initialization failed
+} SD_InitStats;
+
+/**
+ * @brief Numbers of commands sent to the card.
+ */
+typedef struct {
+  uint32_t cmd[SD_COMMANDS];  ///< Commands by index
+  uint32_t acmd[SD_COMMANDS]; ///< Application specific commands by index
+  uint32_t busyBytes;         ///< Bytes clocked while card was busy (SPI only)
+  uint32_t crcErrors;         ///< Commands and blocks with wrong CRC
+} SD_CommandStats;
+
+/**
+ * @brief Errors of transfers and their recovery.
+ * @details Each tier is followed by repeating the transfer from the
+ * failed sector, which is included in its time.
+ */
+typedef struct {
+  uint32_t errors;              ///< Transfers which had an error
+  uint32_t attempts[SD_TIERS];  ///< Times each tier was tried
+  uint32_t recovered[SD_TIERS]; ///< Transfers finished after each tier
+  uint32_t time[SD_TIERS];      ///< Time spent in each tier [ms]
+  uint32_t failed;              ///< Transfers not recovered
+  uint32_t errorSector;         ///< Sector of last transfer not recovered
+} SD_RecoveryStats;
+
+uint8_t SD_Init         (void);
+void    SD_StartInit    (void);
+uint8_t SD_PollInit     (void);
+uint8_t SD_WaitInit     (void);
+void    SD_GetInitStats (SD_InitStats* stats);
 uint8_t SD_ReadBlock    (uint32_t block, uint8_t* buf);
 uint8_t SD_ReadSectors  (uint8_t* buf, uint32_t sector, uint32_t count);
 uint8_t SD_WriteSectors (uint8_t* buf, uint32_t sector, uint32_t count);
 uint64_t SD_ReadCapacity(void);
+void    SD_GetCID       (uint8_t* cid);
+void    SD_SetCommandPolicy (uint8_t policy);
+void    SD_GetCommandStats  (SD_CommandStats* stats);
+void    SD_ClearCommandStats(void);
+uint8_t SD_SetCrcMode       (uint8_t on);
+void    SD_GetRecoveryStats (SD_RecoveryStats* stats);
+void    SD_ClearRecoveryStats(void);
 
 /**
  * @}
@@ -0,0 +1,111 @@
+/**
+ * @file    tlog.h
+ * @brief   Time-indexed record file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef TLOG_H_
+#define TLOG_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  TLOG TLOG
+ * @brief     Time-indexed record file functions
+ */
+
+/**
+ * @addtogroup TLOG
+ * @{
+ */
+
+#define TLOG_BLOCK_MAGIC  0x4b4c4254 ///< Marks a data block ("TBLK")
+#define TLOG_INDEX_MAGIC  0x58444954 ///< Marks an index header ("TIDX")
+#define TLOG_BLOCK_SIZE   512 ///< Size of data block (one sector)
+#define TLOG_INDEX_BLOCKS 16  ///< Data blocks covered by one index entry
+
+/**
+ * @brief Header at the start of every data block.
+ *
+ * @details The payload holds records, each made of a 32-bit
+ * timestamp, a 16-bit length and the data. Timestamps never
+ * decrease, in a block and from block to block.
+ */
+typedef struct {
+  uint32_t magic;       ///< TLOG_BLOCK_MAGIC
+  uint32_t generation;  ///< Generation of the file (as in index header)
+  uint32_t block;       ///< Number of block in data file
+  uint32_t firstTime;   ///< Timestamp of first record
+  uint32_t lastTime;    ///< Timestamp of last record
+  uint16_t count;       ///< Number of records
+  uint16_t used;        ///< Number of payload bytes used
+  uint32_t checksum;    ///< CRC of preceding fields and payload
+} TLOG_BlockHeader;
+
+/**
+ * @brief Header in the first sector of the index file.
+ *
+ * @details The generation changes every time the files are emptied,
+ * so blocks left from earlier contents are never taken as valid.
+ */
+typedef struct {
+  uint32_t magic;          ///< TLOG_INDEX_MAGIC
+  uint32_t generation;     ///< Generation of the files
+  uint32_t blocksPerEntry; ///< Data blocks covered by one index entry
+  uint32_t blockCount;     ///< Data blocks written when header was updated
+  uint32_t checksum;       ///< CRC of preceding fields
+} TLOG_IndexHeader;
+
+/**
+ * @brief Index entry.
+ *
+ * @details Entries start in the second sector of the index file.
+ * Entry i describes data block i * blocksPerEntry.
+ */
+typedef struct {
+  uint32_t firstTime;   ///< Timestamp of first record in block
+  uint32_t block;       ///< Number of block in data file
+} TLOG_IndexEntry;
+
+#define TLOG_PAYLOAD (TLOG_BLOCK_SIZE - sizeof(TLOG_BlockHeader)) ///< Payload bytes in block
+#define TLOG_MAX_RECORD (TLOG_PAYLOAD - 6) ///< Maximum length of record data
+
+/**
+ * @brief Time-indexed record file structure typedef.
+ */
+typedef struct {
+  int dataFile;         ///< ID of opened data file
+  int indexFile;        ///< ID of opened index file
+  uint32_t generation;  ///< Generation of the files
+  uint32_t maxBlocks;   ///< Number of blocks data file can hold
+  uint32_t maxEntries;  ///< Number of entries index file can hold
+  uint32_t blockCount;  ///< Number of finished data blocks
+  uint32_t lastTime;    ///< Timestamp of last appended record
+  uint8_t block[TLOG_BLOCK_SIZE]; ///< Block being filled
+} TLOG_TypeDef;
+
+uint8_t TLOG_Open       (TLOG_TypeDef* log, const char* dataName, const char* indexName);
+uint8_t TLOG_Append     (TLOG_TypeDef* log, uint32_t time, const uint8_t* data, uint16_t len);
+uint8_t TLOG_Sync       (TLOG_TypeDef* log);
+uint8_t TLOG_Close      (TLOG_TypeDef* log);
+int     TLOG_FindBlock  (TLOG_TypeDef* log, uint32_t time);
+int     TLOG_ReadBlock  (TLOG_TypeDef* log, uint32_t block, uint8_t* buf);
+int     TLOG_Query      (TLOG_TypeDef* log, uint32_t from, uint32_t to,
+    void (*callback)(uint32_t time, const uint8_t* data, uint16_t len));
+
+/**
+ * @}
+ */
+
+#endif /* TLOG_H_ */
@@ -26,11 +26,67 @@
 #include <keys.h>
 #include <sdcard.h>
 #include <fat.h>
+#include <bdev.h>
+#include <diskio.h>
+#include <ff.h>
+#include <bkpsram.h>
+#include <config.h>
+#include <crc.h>
+#include <crc_hal.h>
+#include <dwt.h>
+#include <efile.h>
+#include <aes.h>
+#include <rng_hal.h>
+#include <boot.h>
+#include <flash_hal.h>
+#include <spi1.h>
+#include <uart2.h>
+#ifdef EFILE_USE_CRYP
+  #include <cryp_hal.h>
+#endif
 
 #define SYSTICK_FREQ 1000 ///< Frequency of the SysTick set at 1kHz.
 #define COMM_BAUD_RATE 115200UL ///< Baud rate for communication with PC
+#define BKPSRAM_FAT_SNAPSHOT 0 ///< Offset of FAT mount snapshot in backup SRAM
+#define BKPSRAM_FF_SNAPSHOT FAT_SNAPSHOT_SIZE ///< Offset of FatFs mount snapshot in backup SRAM
+#define CONFIG_BOOT_COUNT 0 ///< Configuration item counting program starts
+#define CONFIG_FILE_KEY 1 ///< Configuration item with key of encrypted files
+#define CONFIG_CARD_HISTORY 2 ///< Configuration item with power up times of the card
+#define SD_SLOW_POWER_UP 250 ///< Power up time [ms] of a card considered slow
+#define RAM_BENCH_PASSES 16 ///< Measurements of RAM benchmark
+#define CACHE_LINES 8 ///< Sectors in block device cache
+#define COALESCE_SECTORS 8 ///< Largest write merged by block device coalescer
 
-void softTimerCallback(void);
+/**
+ * @brief Power up times of the card, kept in configuration.
+ */
+typedef struct {
+  uint8_t cid[16];        ///< Card the times belong to
+  uint32_t inits;         ///< Number of initializations
+  uint32_t totalPowerUp;  ///< Sum of power up times [ms]
+  uint32_t maxPowerUp;    ///< Longest power up [ms]
+} CardHistory;
+
+/*
+ * Block device stack of the card used by both file systems:
+ * statistics -> cache -> coalescer -> card
+ */
+static BDEV_Drive sdDrive; ///< Card
+static BDEV_Coalescer sdCoalescer; ///< Merges writes of consecutive sectors
+static uint8_t coalescerBuf[COALESCE_SECTORS * BDEV_SECTOR_SIZE]; ///< Pending writes
+static BDEV_Cache sdCache; ///< Keeps FAT and directory sectors
+static BDEV_CacheLine cacheLines[CACHE_LINES]; ///< Lines of cache
+static uint8_t cacheData[CACHE_LINES * BDEV_SECTOR_SIZE]; ///< Sectors of cache
+static BDEV_Stats sdStats; ///< Counts requests of file systems
+
+void keyCallback(void);
+void printFragmentation(const char* filename, const FAT_Fragmentation* info);
+void crcBenchmark(uint32_t len);
+void encryptionBenchmark(void);
+void updateCardHistory(void);
+void ramBenchmark(void);
+void printCommandStats(void);
+void printBlockStats(void);
 
 #define DEBUG
 
@@ -45,14 +101,47 @@ void softTimerCallback(void);
 
 int main(void) {
 
+  // prefetch and caches hide flash wait states
+  FLASH_HAL_SetAccelerator(1, 1, 1);
+
   COMM_Init(COMM_BAUD_RATE); // initialize communication with PC
   println("Starting program"); // Print a string to terminal
+  BOOT_Mark("COMM_Init");
 
   TIMER_Init(SYSTICK_FREQ); // Initialize timer
+  BOOT_Mark("TIMER_Init");
 
-  // Add a soft timer with callback running every 1000ms
-  int8_t timerID = TIMER_AddSoftTimer(1000, softTimerCallback);
-  TIMER_StartSoftTimer(timerID); // start the timer
+  // the card powers up while the rest is initialized
+  SD_StartInit();
+  BOOT_Mark("SD_StartInit");
+
+  CRC_HAL_Init(); // records are checked with the CRC unit
+  CRC_Init(CRC_HAL_Update);
+
+  // configuration is in internal flash, so it is ready before the SD card
+  uint32_t bootCount = 0;
+  CONFIG_Init();
+  CONFIG_Read(CONFIG_BOOT_COUNT, &bootCount, sizeof(bootCount));
+  println("Configuration ready after %u ms", (unsigned int)TIMER_GetTime());
+  bootCount++;
+  CONFIG_Write(CONFIG_BOOT_COUNT, &bootCount, sizeof(bootCount));
+  println("Boot number %u", (unsigned int)bootCount);
+  BOOT_Mark("CONFIG_Init");
+
+  // key of encrypted files is made once and kept in configuration
+  uint8_t fileKey[AES_KEY_SIZE];
+  RNG_HAL_Init();
+  if (CONFIG_Read(CONFIG_FILE_KEY, fileKey, sizeof(fileKey)) != sizeof(fileKey)) {
+    RNG_HAL_Read(fileKey, sizeof(fileKey));
+    CONFIG_Write(CONFIG_FILE_KEY, fileKey, sizeof(fileKey));
+  }
+#ifdef EFILE_USE_CRYP
+  CRYP_HAL_Init(fileKey); // only STM32F415/417 have the CRYP unit
+  EFILE_Init(fileKey, RNG_HAL_Read, CRYP_HAL_Start, CRYP_HAL_Wait);
+#else
+  EFILE_Init(fileKey, RNG_HAL_Read, 0, 0);
+#endif
+  BOOT_Mark("EFILE_Init");
 
   LED_Init(LED0); // Add an LED
   LED_Init(LED1); // Add an LED
@@ -60,16 +149,42 @@ int main(void) {
   LED_Init(LED3); // Add an LED
   LED_Init(LED5); // Add nonexising LED for test
   LED_ChangeState(LED5, LED_ON);
+  LED_StartPattern(LED1, LED_PATTERN_BLINK); // played by hardware
+  LED_StartPattern(LED3, LED_PATTERN_BREATHE);
+  BOOT_Mark("LED_Init");
 
   KEYS_Init(); // Initialize matrix keyboard
+  KEYS_SetCallbacks(KEY0, keyCallback, keyCallback, 0); // LED2 follows KEY0
+  BOOT_Mark("KEYS_Init");
 
   uint8_t buf[255]; // buffer for receiving commands from PC
   uint8_t len;      // length of command
 
-  // test another way of measuring time delays
-  uint32_t softTimer = TIMER_GetTime(); // get start time for delay
+  BKPSRAM_Init(); // memory for data kept between resets
+  FAT_SetSnapshot(BKPSRAM_GetAddress(BKPSRAM_FAT_SNAPSHOT), SD_GetCID);
+#if _FS_SNAPSHOT
+  f_setsnapshot(BKPSRAM_GetAddress(BKPSRAM_FF_SNAPSHOT), SD_GetCID);
+#endif
+
+  BDEV_InitDrive(&sdDrive, SD_ReadSectors, SD_WriteSectors);
+  BDEV_InitCoalescer(&sdCoalescer, &sdDrive.dev, coalescerBuf, COALESCE_SECTORS);
+  BDEV_InitCache(&sdCache, &sdCoalescer.dev, cacheLines, cacheData, CACHE_LINES);
+  BDEV_InitStats(&sdStats, &sdCache.dev);
+  disk_attach(&sdStats.dev);
+
+  // waits for the rest of card power up
+  if (FAT_Init(SD_WaitInit, &sdStats.dev)) {
+    LED_ShowError(LED0, 1); // no card or no FAT volume
+  }
+  BOOT_Mark("FAT_Init");
+  updateCardHistory();
 
-  FAT_Init(SD_Init, SD_ReadSectors, SD_WriteSectors);
+  FAT_Stats fatStats;
+  FAT_GetStats(&fatStats);
+  println("FAT mounted in %u ms (snapshot %s), ready after %u ms",
+      (unsigned int)fatStats.mountTime,
+      fatStats.snapshotUsed ? "used" : "not used", (unsigned int)TIMER_GetTime());
+  BOOT_Report();
 
 //  int hello = FAT_OpenFile("HELLO   TXT");
 //  uint8_t data[100];
@@ -100,12 +215,6 @@ int main(void) {
 
   while (1) {
 
-    // test delay method
-    if (TIMER_DelayTimer(1000, softTimer)) {
-      LED_Toggle(LED3);
-      softTimer = TIMER_GetTime(); // get start time for delay
-    }
-
     // check for new frames from PC
     if (!COMM_GetFrame(buf, &len)) {
       println("Got frame of length %d: %s", (int)len, (char*)buf);
@@ -117,18 +226,302 @@ int main(void) {
       if (!strcmp((char*)buf, ":LED0 OFF")) {
         LED_ChangeState(LED0, LED_OFF);
       }
+      // contiguity report of the card
+      if (!strcmp((char*)buf, ":FRAG")) {
+        FAT_FreeSpace freeSpace;
+        if (FAT_ReportContiguity(printFragmentation, &freeSpace)) {
+          println("Card read error");
+        } else {
+          println("Free %u of %u clusters (%u bytes) in %u runs, largest run %u",
+              (unsigned int)freeSpace.freeClusters, (unsigned int)freeSpace.clusters,
+              (unsigned int)freeSpace.clusterSize, (unsigned int)freeSpace.freeRuns,
+              (unsigned int)freeSpace.largestFreeRun);
+        }
+      }
+      // move the most fragmented file in the background
+      if (!strcmp((char*)buf, ":DEFRAG")) {
+        FAT_DefragFile(0);
+      }
+      // compare CRC unit with table (fed by CPU and by DMA)
+      if (!strcmp((char*)buf, ":CRC")) {
+        crcBenchmark(64);
+        crcBenchmark(4096);
+      }
+      // compare plain and encrypted file writes
+      if (!strcmp((char*)buf, ":ENC")) {
+        encryptionBenchmark();
+      }
+      // durations of boot phases
+      if (!strcmp((char*)buf, ":BOOT")) {
+        BOOT_Report();
+      }
+      // compare code executed from flash and from RAM
+      if (!strcmp((char*)buf, ":RAM")) {
+        ramBenchmark();
+      }
+      // commands sent to the card since last report
+      if (!strcmp((char*)buf, ":SD")) {
+        printCommandStats();
+      }
+      // requests to the block device since last report
+      if (!strcmp((char*)buf, ":BDEV")) {
+        printBlockStats();
+      }
     }
 
     TIMER_SoftTimersUpdate(); // run timers
     KEYS_Update(); // run keyboard
+    FAT_Update(); // save pending file changes
+    FAT_DefragStep(); // defragment file if started
+  }
+}
+
+/**
+ * @brief Callback function called on press and repeat of KEY0
+ */
+void keyCallback(void) {
+
+  LED_Toggle(LED2); // Toggle LED
+
+}
+/**
+ * @brief Prints fragmentation of a file.
+ * @param filename Name of file
+ * @param info Fragmentation of file
+ */
+void printFragmentation(const char* filename, const FAT_Fragmentation* info) {
+
+  println("%s: %u bytes, %u clusters, %u fragments", filename,
+      (unsigned int)info->fileSize, (unsigned int)info->clusters,
+      (unsigned int)info->fragments);
+}
+/**
+ * @brief Prints cycles taken by the CRC table and the CRC unit.
+ * @param len Length of data in bytes (up to 4096)
+ */
+void crcBenchmark(uint32_t len) {
+
+  static uint32_t data[1024];
+
+  for (uint32_t i = 0; i < len / 4; i++) {
+    data[i] = i * 2654435761u;
+  }
+
+  DWT_Init();
+  uint32_t start = DWT_GetCycles();
+  uint32_t crcTable = CRC_Software(CRC_START, data, len);
+  uint32_t tableCycles = DWT_GetCycles() - start;
+
+  start = DWT_GetCycles();
+  uint32_t crcUnit = CRC_HAL_Update(CRC_START, data, len / 4);
+  uint32_t unitCycles = DWT_GetCycles() - start;
+
+  println("CRC of %u bytes: table %u cycles, unit %u cycles (%s)%s",
+      (unsigned int)len, (unsigned int)tableCycles, (unsigned int)unitCycles,
+      len / 4 < CRC_HAL_DMA_MIN ? "CPU" : "DMA",
+      crcTable == crcUnit ? "" : " MISMATCH");
+}
+/**
+ * @brief Prints write speed of a file without and with encryption.
+ * @details BENCH.DAT must exist on the card (at least 33 KB), its
+ * contents are overwritten.
+ */
+void encryptionBenchmark(void) {
+
+  static uint8_t data[4096];
+  EFILE_TypeDef f;
+  const int total = 32768;
+
+  if (EFILE_Open(&f, "BENCH   DAT") || EFILE_GetSize(&f) < total) {
+    println("BENCH.DAT missing or too small");
+    EFILE_Close(&f);
+    return;
   }
+  for (unsigned int i = 0; i < sizeof(data); i++) {
+    data[i] = i;
+  }
+
+  uint32_t start = TIMER_GetTime();
+  FAT_MoveWrPtr(f.file, EFILE_SECTOR_SIZE);
+  for (int pos = 0; pos < total; pos += sizeof(data)) {
+    FAT_WriteFile(f.file, data, sizeof(data));
+  }
+  uint32_t plainTime = TIMER_GetTime() - start;
+
+  start = TIMER_GetTime();
+  for (int pos = 0; pos < total; pos += sizeof(data)) {
+    EFILE_Write(&f, data, sizeof(data));
+  }
+  uint32_t encTime = TIMER_GetTime() - start;
+
+  EFILE_Close(&f);
+  println("%u bytes: plain %u ms, encrypted %u ms", (unsigned int)total,
+      (unsigned int)plainTime, (unsigned int)encTime);
+}
+/**
+ * @brief Adds power up time of the card to its history.
+ * @details The history starts again when another card is inserted.
+ * Slow cards are reported, so they can be replaced.
+ */
+void updateCardHistory(void) {
+
+  SD_InitStats stats;
+  CardHistory history;
+
+  SD_GetInitStats(&stats);
+  if (stats.error) {
+    println("Card failed after %u ms, %u ACMD41", (unsigned int)stats.initTime,
+        (unsigned int)stats.polls);
+    return;
+  }
+
+  if (CONFIG_Read(CONFIG_CARD_HISTORY, &history, sizeof(history)) !=
+      sizeof(history) || memcmp(history.cid, stats.cid, sizeof(stats.cid))) {
+    memset(&history, 0, sizeof(history));
+    memcpy(history.cid, stats.cid, sizeof(stats.cid));
+  }
+  history.inits++;
+  history.totalPowerUp += stats.powerUpTime;
+  if (stats.powerUpTime > history.maxPowerUp) {
+    history.maxPowerUp = stats.powerUpTime;
+  }
+  CONFIG_Write(CONFIG_CARD_HISTORY, &history, sizeof(history));
+
+  println("Card power up %u ms, %u ACMD41 (average %u ms, longest %u ms in %u starts)%s",
+      (unsigned int)stats.powerUpTime, (unsigned int)stats.polls,
+      (unsigned int)(history.totalPowerUp / history.inits),
+      (unsigned int)history.maxPowerUp, (unsigned int)history.inits,
+      history.maxPowerUp > SD_SLOW_POWER_UP ? " - SLOW CARD" : "");
+}
+/**
+ * @brief Prints cycles of the SPI byte loop and of interrupt entry
+ * executed from flash and from RAM.
+ * @details Minimum and maximum of RAM_BENCH_PASSES measurements show
+ * the jitter. The SPI runs at its highest clock with the card deselected,
+ * so the loop and not the bus limits the speed. The interrupt handler
+ * can't be copied, so it is compared between builds with and without
+ * RAMFUNC_IN_FLASH.
+ */
+void ramBenchmark(void) {
+
+  uint32_t min[5], max[5];
+  const char* names[5] = {"SPI RAM", "SPI flash", "SPI flash, no ART",
+      "IRQ entry", "IRQ entry, no ART"};
+
+  for (int i = 0; i < 5; i++) {
+    min[i] = UINT32_MAX;
+    max[i] = 0;
+  }
+
+  DWT_Init();
+  for (int pass = 0; pass < RAM_BENCH_PASSES; pass++) {
+    uint32_t cycles[5];
+
+    // card was initialized at a lower clock and gets no clock pulses
+    // while deselected
+#ifndef SD_USE_SDIO
+    static uint8_t data[512];
+    uint32_t start;
+    uint16_t div = SPI1_SetClockDivider(2);
+
+    start = DWT_GetCycles();
+    SPI1_ReadBuffer(data, sizeof(data));
+    cycles[0] = DWT_GetCycles() - start;
+
+    start = DWT_GetCycles();
+    SPI1_ReadBufferFlash(data, sizeof(data));
+    cycles[1] = DWT_GetCycles() - start;
+
+    FLASH_HAL_SetAccelerator(0, 0, 0);
+    start = DWT_GetCycles();
+    SPI1_ReadBufferFlash(data, sizeof(data));
+    cycles[2] = DWT_GetCycles() - start;
+    FLASH_HAL_SetAccelerator(1, 1, 1);
+
+    SPI1_SetClockDivider(div);
+#else
+    cycles[0] = cycles[1] = cycles[2] = 0; // SPI not used by the card
+#endif
+
+    cycles[3] = UART2_MeasureEntry();
+    FLASH_HAL_SetAccelerator(0, 0, 0);
+    cycles[4] = UART2_MeasureEntry();
+    FLASH_HAL_SetAccelerator(1, 1, 1);
+
+    for (int i = 0; i < 5; i++) {
+      if (cycles[i] < min[i]) {
+        min[i] = cycles[i];
+      }
+      if (cycles[i] > max[i]) {
+        max[i] = cycles[i];
+      }
+    }
+  }
+
+  for (int i = 0; i < 5; i++) {
+    println("%-18s min %6u, max %6u cycles", names[i],
+        (unsigned int)min[i], (unsigned int)max[i]);
+  }
+#ifdef RAMFUNC_IN_FLASH
+  println("IRQ handler in flash");
+#else
+  println("IRQ handler in RAM");
+#endif
 }
+/**
+ * @brief Prints commands sent to the card and recovery from errors since
+ * last call.
+ */
+void printCommandStats(void) {
+
+  static SD_CommandStats stats;
+  SD_RecoveryStats recovery;
 
+  SD_GetCommandStats(&stats);
+  SD_ClearCommandStats();
+
+  for (int i = 0; i < SD_COMMANDS; i++) {
+    if (stats.cmd[i]) {
+      println("CMD%-2d  %u", i, (unsigned int)stats.cmd[i]);
+    }
+  }
+  for (int i = 0; i < SD_COMMANDS; i++) {
+    if (stats.acmd[i]) {
+      println("ACMD%-2d %u", i, (unsigned int)stats.acmd[i]);
+    }
+  }
+  println("Busy bytes %u", (unsigned int)stats.busyBytes);
+  println("CRC errors %u", (unsigned int)stats.crcErrors);
+
+  SD_GetRecoveryStats(&recovery);
+  SD_ClearRecoveryStats();
+  println("Errors %u, not recovered %u (last at sector %u)",
+      (unsigned int)recovery.errors, (unsigned int)recovery.failed,
+      (unsigned int)recovery.errorSector);
+  for (int i = 0; i < SD_TIERS; i++) {
+    println("Tier %d: %u tried, %u recovered, %u ms", i,
+        (unsigned int)recovery.attempts[i], (unsigned int)recovery.recovered[i],
+        (unsigned int)recovery.time[i]);
+  }
+}
 /**
- * @brief Callback function called on every soft timer overflow
+ * @brief Prints requests of the file systems to the card and
+ * how the layers below served them.
  */
-void softTimerCallback(void) {
+void printBlockStats(void) {
 
-  LED_Toggle(LED1); // Toggle LED
+  static const char* const ops[BDEV_OPS] = {"Read", "Write", "Flush", "Trim"};
+  BDEV_Counters counters;
 
+  BDEV_GetCounters(&sdStats, &counters);
+  for (int i = 0; i < BDEV_OPS; i++) {
+    println("%-5s %u requests, %u sectors", ops[i],
+        (unsigned int)counters.requests[i], (unsigned int)counters.sectors[i]);
+  }
+  println("Errors %u (last at sector %u)", (unsigned int)counters.errors,
+      (unsigned int)counters.errorSector);
+  println("Cache %u hits, %u misses, %u written back",
+      (unsigned int)sdCache.hits, (unsigned int)sdCache.misses,
+      (unsigned int)sdCache.writeBacks);
+  println("Coalescer %u writes merged", (unsigned int)sdCoalescer.merged);
 }
@@ -0,0 +1,202 @@
+/**
+ * @file    aes.c
+ * @brief   AES-128 encryption in software.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Only encryption is needed, as files are encrypted in counter
+ * mode (decryption is the same operation). A table of 256 words,
+ * built from the S-box at the first AES_SetKey, combines SubBytes,
+ * ShiftRows and MixColumns of a column, the other three columns use
+ * the same table rotated.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <aes.h>
+
+/**
+ * @addtogroup AES
+ * @{
+ */
+
+#define AES_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n)))) ///< Rotate right
+
+/**
+ * @brief S-box
+ */
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16};
+
+static uint32_t te[256]; ///< Round table (0 before first AES_SetKey)
+
+static uint32_t AES_Load(const uint8_t* p);
+static void AES_Store(uint8_t* p, uint32_t w);
+
+/**
+ * @brief Expands a key.
+ * @param ctx Context
+ * @param key Key (AES_KEY_SIZE bytes)
+ */
+void AES_SetKey(AES_Context* ctx, const uint8_t* key) {
+
+  if (te[0] == 0) {
+    for (int i = 0; i < 256; i++) {
+      uint32_t s = sbox[i];
+      uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0)) & 0xff;
+      te[i] = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+    }
+  }
+
+  uint32_t* rk = ctx->rk;
+  uint8_t rcon = 1;
+
+  for (int i = 0; i < 4; i++) {
+    rk[i] = AES_Load(key + 4 * i);
+  }
+  for (int i = 4; i < 44; i++) {
+    uint32_t t = rk[i - 1];
+    if (i % 4 == 0) {
+      // RotWord, SubWord and round constant
+      t = ((uint32_t)sbox[(t >> 16) & 0xff] << 24) |
+          ((uint32_t)sbox[(t >> 8) & 0xff] << 16) |
+          ((uint32_t)sbox[t & 0xff] << 8) | sbox[t >> 24];
+      t ^= (uint32_t)rcon << 24;
+      rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+    }
+    rk[i] = rk[i - 4] ^ t;
+  }
+}
+/**
+ * @brief Encrypts a block.
+ * @param ctx Context
+ * @param in Plaintext (AES_BLOCK_SIZE bytes)
+ * @param out Ciphertext (may be the same as in)
+ */
+void AES_Encrypt(const AES_Context* ctx, const uint8_t* in, uint8_t* out) {
+
+  const uint32_t* rk = ctx->rk;
+  uint32_t s0 = AES_Load(in) ^ rk[0];
+  uint32_t s1 = AES_Load(in + 4) ^ rk[1];
+  uint32_t s2 = AES_Load(in + 8) ^ rk[2];
+  uint32_t s3 = AES_Load(in + 12) ^ rk[3];
+  uint32_t t0, t1, t2, t3;
+
+  for (int round = 1; round < 10; round++) {
+    rk += 4;
+    t0 = te[s0 >> 24] ^ AES_ROR(te[(s1 >> 16) & 0xff], 8) ^
+        AES_ROR(te[(s2 >> 8) & 0xff], 16) ^ AES_ROR(te[s3 & 0xff], 24) ^ rk[0];
+    t1 = te[s1 >> 24] ^ AES_ROR(te[(s2 >> 16) & 0xff], 8) ^
+        AES_ROR(te[(s3 >> 8) & 0xff], 16) ^ AES_ROR(te[s0 & 0xff], 24) ^ rk[1];
+    t2 = te[s2 >> 24] ^ AES_ROR(te[(s3 >> 16) & 0xff], 8) ^
+        AES_ROR(te[(s0 >> 8) & 0xff], 16) ^ AES_ROR(te[s1 & 0xff], 24) ^ rk[2];
+    t3 = te[s3 >> 24] ^ AES_ROR(te[(s0 >> 16) & 0xff], 8) ^
+        AES_ROR(te[(s1 >> 8) & 0xff], 16) ^ AES_ROR(te[s2 & 0xff], 24) ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  // last round without MixColumns
+  rk += 4;
+  t0 = ((uint32_t)sbox[s0 >> 24] << 24) | ((uint32_t)sbox[(s1 >> 16) & 0xff] << 16) |
+      ((uint32_t)sbox[(s2 >> 8) & 0xff] << 8) | sbox[s3 & 0xff];
+  t1 = ((uint32_t)sbox[s1 >> 24] << 24) | ((uint32_t)sbox[(s2 >> 16) & 0xff] << 16) |
+      ((uint32_t)sbox[(s3 >> 8) & 0xff] << 8) | sbox[s0 & 0xff];
+  t2 = ((uint32_t)sbox[s2 >> 24] << 24) | ((uint32_t)sbox[(s3 >> 16) & 0xff] << 16) |
+      ((uint32_t)sbox[(s0 >> 8) & 0xff] << 8) | sbox[s1 & 0xff];
+  t3 = ((uint32_t)sbox[s3 >> 24] << 24) | ((uint32_t)sbox[(s0 >> 16) & 0xff] << 16) |
+      ((uint32_t)sbox[(s1 >> 8) & 0xff] << 8) | sbox[s2 & 0xff];
+
+  AES_Store(out, t0 ^ rk[0]);
+  AES_Store(out + 4, t1 ^ rk[1]);
+  AES_Store(out + 8, t2 ^ rk[2]);
+  AES_Store(out + 12, t3 ^ rk[3]);
+}
+/**
+ * @brief Encrypts or decrypts data in counter mode.
+ * @details The last 32 bits of the counter block are incremented for
+ * every block (big endian, like the CRYP unit does).
+ * @param ctx Context
+ * @param counter Initial counter block (AES_BLOCK_SIZE bytes)
+ * @param in Input data
+ * @param out Output data (may be the same as in)
+ * @param len Length of data (last block may be partial)
+ */
+void AES_Ctr(const AES_Context* ctx, const uint8_t* counter,
+    const uint8_t* in, uint8_t* out, uint32_t len) {
+
+  uint8_t block[AES_BLOCK_SIZE];
+  uint8_t stream[AES_BLOCK_SIZE];
+
+  for (int i = 0; i < AES_BLOCK_SIZE; i++) {
+    block[i] = counter[i];
+  }
+
+  while (len) {
+
+    AES_Encrypt(ctx, block, stream);
+
+    uint32_t n = len < AES_BLOCK_SIZE ? len : AES_BLOCK_SIZE;
+    for (uint32_t i = 0; i < n; i++) {
+      out[i] = in[i] ^ stream[i];
+    }
+    in += n;
+    out += n;
+    len -= n;
+
+    AES_Store(block + 12, AES_Load(block + 12) + 1);
+  }
+}
+/**
+ * @brief Loads a big endian word.
+ */
+static uint32_t AES_Load(const uint8_t* p) {
+
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+      ((uint32_t)p[2] << 8) | p[3];
+}
+/**
+ * @brief Stores a big endian word.
+ */
+static void AES_Store(uint8_t* p, uint32_t w) {
+
+  p[0] = w >> 24;
+  p[1] = w >> 16;
+  p[2] = w >> 8;
+  p[3] = w;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,629 @@
+/**
+ * @file    bdev.c
+ * @brief   Stackable block devices.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details File systems read and write sectors through a stack of
+ * layers ending with the drive, e.g. statistics, cache, write
+ * coalescer and SD card. Each layer has the interface of the device
+ * below it, so layers can be added, removed and reordered without
+ * changing the file systems.
+ *
+ * Requests are asynchronous: BDEV_Submit starts a request and its done
+ * function is called when it finishes, which may be before BDEV_Submit
+ * returns. BDEV_Wait polls the stack until a request finishes, and
+ * BDEV_Read, BDEV_Write, BDEV_Flush and BDEV_Trim use it to run a
+ * request to the end. The drive functions and the cache and coalescer
+ * wait for requests they send down, so only layers like the statistics
+ * leave requests running.
+ *
+ * Writes may reach the drive in another order than they were made:
+ * the cache writes lines back when they are evicted or in order of
+ * sectors. A flush is the only barrier - everything written before
+ * it is on the drive before anything written after it. File systems
+ * flush between data and the metadata covering it, and between
+ * a journal and its commit record.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <bdev.h>
+#include <string.h>
+
+/**
+ * @addtogroup BDEV
+ * @{
+ */
+
+static uint8_t BDEV_Call(BDEV_Device* dev, uint8_t op, uint8_t* buf,
+    uint32_t sector, uint32_t count);
+static void BDEV_DriveSubmit(BDEV_Device* dev, BDEV_Request* req);
+static void BDEV_StatsSubmit(BDEV_Device* dev, BDEV_Request* req);
+static void BDEV_StatsDone(BDEV_Request* child);
+static void BDEV_CacheSubmit(BDEV_Device* dev, BDEV_Request* req);
+static uint8_t BDEV_CacheRead(BDEV_Cache* cache, uint8_t* buf, uint32_t sector);
+static uint8_t BDEV_CacheWrite(BDEV_Cache* cache, const uint8_t* buf, uint32_t sector);
+static int BDEV_CacheFind(BDEV_Cache* cache, uint32_t sector);
+static int BDEV_CacheVictim(BDEV_Cache* cache);
+static uint8_t BDEV_CacheWriteBack(BDEV_Cache* cache, int line);
+static uint8_t BDEV_CacheFlush(BDEV_Cache* cache);
+static void BDEV_CoalescerSubmit(BDEV_Device* dev, BDEV_Request* req);
+static uint8_t BDEV_CoalescerWrite(BDEV_Coalescer* co, uint8_t* buf,
+    uint32_t sector, uint32_t count);
+static uint8_t BDEV_CoalescerFlush(BDEV_Coalescer* co);
+
+/**
+ * @brief Starts a request.
+ * @param dev Device
+ * @param req Request (must be kept until it finishes)
+ */
+void BDEV_Submit(BDEV_Device* dev, BDEV_Request* req) {
+
+  req->status = BDEV_PENDING;
+  dev->submit(dev, req);
+}
+/**
+ * @brief Finishes a request.
+ * @details Called by devices.
+ * @param req Request
+ * @param status BDEV_OK or BDEV_ERROR
+ */
+void BDEV_Complete(BDEV_Request* req, uint8_t status) {
+
+  req->status = status;
+  if (req->done) {
+    req->done(req);
+  }
+}
+/**
+ * @brief Moves running requests on.
+ * @details Calls the poll function of the first layer which has one.
+ * @param dev Device
+ */
+void BDEV_Poll(BDEV_Device* dev) {
+
+  for (; dev; dev = dev->lower) {
+    if (dev->poll) {
+      dev->poll(dev);
+      return;
+    }
+  }
+}
+/**
+ * @brief Waits until a request finishes.
+ * @param dev Device which got the request
+ * @param req Request
+ * @retval BDEV_OK Request finished
+ * @retval BDEV_ERROR Request failed
+ */
+uint8_t BDEV_Wait(BDEV_Device* dev, BDEV_Request* req) {
+
+  while (req->status == BDEV_PENDING) {
+    BDEV_Poll(dev);
+  }
+  return req->status;
+}
+/**
+ * @brief Reads sectors.
+ * @param dev Device
+ * @param buf Buffer for data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors read
+ * @retval 1 Error occurred
+ */
+uint8_t BDEV_Read(BDEV_Device* dev, uint8_t* buf, uint32_t sector,
+    uint32_t count) {
+
+  return BDEV_Call(dev, BDEV_READ, buf, sector, count);
+}
+/**
+ * @brief Writes sectors.
+ * @details Layers may keep the data until BDEV_Flush and write it
+ * to the drive in any order.
+ * @param dev Device
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors written
+ * @retval 1 Error occurred
+ */
+uint8_t BDEV_Write(BDEV_Device* dev, const uint8_t* buf, uint32_t sector,
+    uint32_t count) {
+
+  return BDEV_Call(dev, BDEV_WRITE, (uint8_t*)buf, sector, count);
+}
+/**
+ * @brief Writes data kept by layers to the drive.
+ * @details Barrier between writes made before and after it.
+ * @param dev Device
+ * @retval 0 Data written
+ * @retval 1 Error occurred
+ */
+uint8_t BDEV_Flush(BDEV_Device* dev) {
+
+  return BDEV_Call(dev, BDEV_FLUSH, 0, 0, 0);
+}
+/**
+ * @brief Tells the device that sectors are not used any more.
+ * @details Layers drop data kept for these sectors.
+ * @param dev Device
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Request accepted
+ * @retval 1 Error occurred
+ */
+uint8_t BDEV_Trim(BDEV_Device* dev, uint32_t sector, uint32_t count) {
+
+  return BDEV_Call(dev, BDEV_TRIM, 0, sector, count);
+}
+/**
+ * @brief Initializes a drive using functions of its driver.
+ * @details The driver transfers sectors at once and doesn't erase, so
+ * flush and trim do nothing.
+ * @param drive Drive
+ * @param read Read sectors function
+ * @param write Write sectors function
+ */
+void BDEV_InitDrive(BDEV_Drive* drive,
+    uint8_t (*read)(uint8_t* buf, uint32_t sector, uint32_t count),
+    uint8_t (*write)(uint8_t* buf, uint32_t sector, uint32_t count)) {
+
+  memset(drive, 0, sizeof(*drive));
+  drive->dev.submit = BDEV_DriveSubmit;
+  drive->read = read;
+  drive->write = write;
+}
+/**
+ * @brief Initializes a statistics layer.
+ * @param stats Layer
+ * @param lower Device below
+ */
+void BDEV_InitStats(BDEV_Stats* stats, BDEV_Device* lower) {
+
+  memset(stats, 0, sizeof(*stats));
+  stats->dev.submit = BDEV_StatsSubmit;
+  stats->dev.lower = lower;
+}
+/**
+ * @brief Gets statistics of a layer and clears them.
+ * @param stats Layer
+ * @param counters Statistics (function writes this)
+ */
+void BDEV_GetCounters(BDEV_Stats* stats, BDEV_Counters* counters) {
+
+  *counters = stats->counters;
+  memset(&stats->counters, 0, sizeof(stats->counters));
+}
+/**
+ * @brief Initializes a cache layer.
+ * @param cache Layer
+ * @param lower Device below
+ * @param lines Lines (size elements)
+ * @param data Sectors of lines (size * BDEV_SECTOR_SIZE bytes)
+ * @param size Number of lines
+ */
+void BDEV_InitCache(BDEV_Cache* cache, BDEV_Device* lower,
+    BDEV_CacheLine* lines, uint8_t* data, uint8_t size) {
+
+  memset(cache, 0, sizeof(*cache));
+  memset(lines, 0, size * sizeof(*lines));
+  cache->dev.submit = BDEV_CacheSubmit;
+  cache->dev.lower = lower;
+  cache->lines = lines;
+  cache->data = data;
+  cache->size = size;
+}
+/**
+ * @brief Initializes a write coalescing layer.
+ * @param co Layer
+ * @param lower Device below
+ * @param buf Buffer for pending sectors (size * BDEV_SECTOR_SIZE bytes)
+ * @param size Largest number of pending sectors
+ */
+void BDEV_InitCoalescer(BDEV_Coalescer* co, BDEV_Device* lower,
+    uint8_t* buf, uint32_t size) {
+
+  memset(co, 0, sizeof(*co));
+  co->dev.submit = BDEV_CoalescerSubmit;
+  co->dev.lower = lower;
+  co->buf = buf;
+  co->size = size;
+}
+/**
+ * @brief Runs a request to the end.
+ * @param dev Device
+ * @param op Operation
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Request finished
+ * @retval 1 Request failed
+ */
+static uint8_t BDEV_Call(BDEV_Device* dev, uint8_t op, uint8_t* buf,
+    uint32_t sector, uint32_t count) {
+
+  BDEV_Request req;
+
+  req.op = op;
+  req.buf = buf;
+  req.sector = sector;
+  req.count = count;
+  req.done = 0;
+  req.ctx = 0;
+  BDEV_Submit(dev, &req);
+
+  return (BDEV_Wait(dev, &req) == BDEV_OK) ? 0 : 1;
+}
+/**
+ * @brief Passes a request to the driver.
+ * @param dev Drive
+ * @param req Request
+ */
+static void BDEV_DriveSubmit(BDEV_Device* dev, BDEV_Request* req) {
+
+  BDEV_Drive* drive = (BDEV_Drive*)dev;
+  uint8_t result = 0;
+
+  switch (req->op) {
+  case BDEV_READ:
+    result = drive->read(req->buf, req->sector, req->count);
+    break;
+  case BDEV_WRITE:
+    result = drive->write(req->buf, req->sector, req->count);
+    break;
+  default:
+    break;
+  }
+  BDEV_Complete(req, result ? BDEV_ERROR : BDEV_OK);
+}
+/**
+ * @brief Counts a request and passes it down.
+ * @param dev Statistics layer
+ * @param req Request
+ */
+static void BDEV_StatsSubmit(BDEV_Device* dev, BDEV_Request* req) {
+
+  BDEV_Stats* stats = (BDEV_Stats*)dev;
+
+  // one request at a time below
+  if (stats->parent) {
+    BDEV_Wait(dev->lower, &stats->child);
+  }
+
+  stats->counters.requests[req->op % BDEV_OPS]++;
+  if (req->op != BDEV_FLUSH) {
+    stats->counters.sectors[req->op % BDEV_OPS] += req->count;
+  }
+
+  stats->parent = req;
+  stats->child = *req;
+  stats->child.done = BDEV_StatsDone;
+  stats->child.ctx = stats;
+  BDEV_Submit(dev->lower, &stats->child);
+}
+/**
+ * @brief Counts result of a request and finishes it.
+ * @param child Request passed down
+ */
+static void BDEV_StatsDone(BDEV_Request* child) {
+
+  BDEV_Stats* stats = (BDEV_Stats*)child->ctx;
+  BDEV_Request* req = stats->parent;
+
+  stats->parent = 0;
+  if (child->status != BDEV_OK) {
+    stats->counters.errors++;
+    stats->counters.errorSector = child->sector;
+  }
+  BDEV_Complete(req, child->status);
+}
+/**
+ * @brief Serves a request with the cache.
+ * @param dev Cache layer
+ * @param req Request
+ */
+static void BDEV_CacheSubmit(BDEV_Device* dev, BDEV_Request* req) {
+
+  BDEV_Cache* cache = (BDEV_Cache*)dev;
+  uint8_t result = 0;
+  uint8_t* data;
+  int i;
+
+  switch (req->op) {
+  case BDEV_READ:
+    if (req->count == 1) {
+      result = BDEV_CacheRead(cache, req->buf, req->sector);
+      break;
+    }
+    result = BDEV_Call(dev->lower, BDEV_READ, req->buf, req->sector, req->count);
+    // sectors written only to the cache are newer
+    for (i = 0; !result && i < cache->size; i++) {
+      if (cache->lines[i].dirty && cache->lines[i].sector - req->sector < req->count) {
+        memcpy(req->buf + (cache->lines[i].sector - req->sector) * BDEV_SECTOR_SIZE,
+            cache->data + i * BDEV_SECTOR_SIZE, BDEV_SECTOR_SIZE);
+      }
+    }
+    break;
+  case BDEV_WRITE:
+    if (req->count == 1) {
+      result = BDEV_CacheWrite(cache, req->buf, req->sector);
+      break;
+    }
+    for (i = 0; i < cache->size; i++) {
+      if (cache->lines[i].valid && cache->lines[i].sector - req->sector < req->count) {
+        data = req->buf + (cache->lines[i].sector - req->sector) * BDEV_SECTOR_SIZE;
+        memcpy(cache->data + i * BDEV_SECTOR_SIZE, data, BDEV_SECTOR_SIZE);
+        cache->lines[i].dirty = 1; // until written below
+      }
+    }
+    result = BDEV_Call(dev->lower, BDEV_WRITE, req->buf, req->sector, req->count);
+    for (i = 0; !result && i < cache->size; i++) {
+      if (cache->lines[i].valid && cache->lines[i].sector - req->sector < req->count) {
+        cache->lines[i].dirty = 0;
+      }
+    }
+    break;
+  case BDEV_FLUSH:
+    result = BDEV_CacheFlush(cache);
+    result |= BDEV_Call(dev->lower, BDEV_FLUSH, 0, 0, 0);
+    break;
+  case BDEV_TRIM:
+    for (i = 0; i < cache->size; i++) {
+      if (cache->lines[i].sector - req->sector < req->count) {
+        cache->lines[i].valid = 0;
+        cache->lines[i].dirty = 0;
+      }
+    }
+    result = BDEV_Call(dev->lower, BDEV_TRIM, 0, req->sector, req->count);
+    break;
+  default:
+    result = 1;
+    break;
+  }
+  BDEV_Complete(req, result ? BDEV_ERROR : BDEV_OK);
+}
+/**
+ * @brief Reads a sector through the cache.
+ * @param cache Cache
+ * @param buf Buffer for data
+ * @param sector Sector
+ * @retval 0 Sector read
+ * @retval 1 Error occurred
+ */
+static uint8_t BDEV_CacheRead(BDEV_Cache* cache, uint8_t* buf, uint32_t sector) {
+
+  int i = BDEV_CacheFind(cache, sector);
+
+  if (i >= 0) {
+    cache->hits++;
+  } else {
+    i = BDEV_CacheVictim(cache);
+    if (BDEV_CacheWriteBack(cache, i)) {
+      return 1;
+    }
+    cache->lines[i].valid = 0;
+    if (BDEV_Call(cache->dev.lower, BDEV_READ, cache->data + i * BDEV_SECTOR_SIZE,
+        sector, 1)) {
+      return 1;
+    }
+    cache->misses++;
+    cache->lines[i].sector = sector;
+    cache->lines[i].valid = 1;
+  }
+  cache->lines[i].used = ++cache->clock;
+  memcpy(buf, cache->data + i * BDEV_SECTOR_SIZE, BDEV_SECTOR_SIZE);
+  return 0;
+}
+/**
+ * @brief Writes a sector to the cache.
+ * @param cache Cache
+ * @param buf Data
+ * @param sector Sector
+ * @retval 0 Sector written
+ * @retval 1 Error occurred (while writing back another sector)
+ */
+static uint8_t BDEV_CacheWrite(BDEV_Cache* cache, const uint8_t* buf, uint32_t sector) {
+
+  int i = BDEV_CacheFind(cache, sector);
+
+  if (i >= 0) {
+    cache->hits++;
+  } else {
+    i = BDEV_CacheVictim(cache);
+    if (BDEV_CacheWriteBack(cache, i)) {
+      return 1;
+    }
+    cache->lines[i].sector = sector;
+    cache->lines[i].valid = 1;
+  }
+  cache->lines[i].used = ++cache->clock;
+  cache->lines[i].dirty = 1;
+  memcpy(cache->data + i * BDEV_SECTOR_SIZE, buf, BDEV_SECTOR_SIZE);
+  return 0;
+}
+/**
+ * @brief Finds the line of a sector.
+ * @param cache Cache
+ * @param sector Sector
+ * @return Line or -1 if not in cache
+ */
+static int BDEV_CacheFind(BDEV_Cache* cache, uint32_t sector) {
+
+  for (int i = 0; i < cache->size; i++) {
+    if (cache->lines[i].valid && cache->lines[i].sector == sector) {
+      return i;
+    }
+  }
+  return -1;
+}
+/**
+ * @brief Chooses a line for a new sector.
+ * @param cache Cache
+ * @return Empty line or the least recently used one
+ */
+static int BDEV_CacheVictim(BDEV_Cache* cache) {
+
+  int victim = 0;
+
+  for (int i = 0; i < cache->size; i++) {
+    if (!cache->lines[i].valid) {
+      return i;
+    }
+    if (cache->lines[i].used < cache->lines[victim].used) {
+      victim = i;
+    }
+  }
+  return victim;
+}
+/**
+ * @brief Writes a line to the device below if it is dirty.
+ * @param cache Cache
+ * @param line Line
+ * @retval 0 Line is clean
+ * @retval 1 Error occurred
+ */
+static uint8_t BDEV_CacheWriteBack(BDEV_Cache* cache, int line) {
+
+  if (!cache->lines[line].dirty) {
+    return 0;
+  }
+  if (BDEV_Call(cache->dev.lower, BDEV_WRITE, cache->data + line * BDEV_SECTOR_SIZE,
+      cache->lines[line].sector, 1)) {
+    return 1;
+  }
+  cache->writeBacks++;
+  cache->lines[line].dirty = 0;
+  return 0;
+}
+/**
+ * @brief Writes back all dirty lines.
+ * @details Lines are written in order of sectors, so neighbouring
+ * sectors can be merged by a coalescer below.
+ * @param cache Cache
+ * @retval 0 All lines written
+ * @retval 1 Error occurred
+ */
+static uint8_t BDEV_CacheFlush(BDEV_Cache* cache) {
+
+  uint8_t result = 0;
+  int next;
+
+  do {
+    next = -1;
+    for (int i = 0; i < cache->size; i++) {
+      if (cache->lines[i].dirty && (next < 0 ||
+          cache->lines[i].sector < cache->lines[next].sector)) {
+        next = i;
+      }
+    }
+    if (next >= 0 && BDEV_CacheWriteBack(cache, next)) {
+      cache->lines[next].dirty = 0; // reported, not repeated forever
+      result = 1;
+    }
+  } while (next >= 0);
+
+  return result;
+}
+/**
+ * @brief Serves a request with the coalescer.
+ * @param dev Coalescer layer
+ * @param req Request
+ */
+static void BDEV_CoalescerSubmit(BDEV_Device* dev, BDEV_Request* req) {
+
+  BDEV_Coalescer* co = (BDEV_Coalescer*)dev;
+  uint8_t result = 0;
+  uint32_t first, last;
+
+  switch (req->op) {
+  case BDEV_READ:
+    result = BDEV_Call(dev->lower, BDEV_READ, req->buf, req->sector, req->count);
+    // pending sectors are newer
+    first = (req->sector > co->sector) ? req->sector : co->sector;
+    last = (req->sector + req->count < co->sector + co->count) ?
+        req->sector + req->count : co->sector + co->count;
+    if (!result && first < last) {
+      memcpy(req->buf + (first - req->sector) * BDEV_SECTOR_SIZE,
+          co->buf + (first - co->sector) * BDEV_SECTOR_SIZE,
+          (last - first) * BDEV_SECTOR_SIZE);
+    }
+    break;
+  case BDEV_WRITE:
+    result = BDEV_CoalescerWrite(co, req->buf, req->sector, req->count);
+    break;
+  case BDEV_FLUSH:
+    result = BDEV_CoalescerFlush(co);
+    result |= BDEV_Call(dev->lower, BDEV_FLUSH, 0, 0, 0);
+    break;
+  case BDEV_TRIM:
+    result = BDEV_CoalescerFlush(co);
+    result |= BDEV_Call(dev->lower, BDEV_TRIM, 0, req->sector, req->count);
+    break;
+  default:
+    result = 1;
+    break;
+  }
+  BDEV_Complete(req, result ? BDEV_ERROR : BDEV_OK);
+}
+/**
+ * @brief Appends a write to the pending one or starts a new one.
+ * @param co Coalescer
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors written or pending
+ * @retval 1 Error occurred
+ */
+static uint8_t BDEV_CoalescerWrite(BDEV_Coalescer* co, uint8_t* buf,
+    uint32_t sector, uint32_t count) {
+
+  if (co->count && sector == co->sector + co->count &&
+      co->count + count <= co->size) {
+    memcpy(co->buf + co->count * BDEV_SECTOR_SIZE, buf, count * BDEV_SECTOR_SIZE);
+    co->count += count;
+    co->merged++;
+    return 0;
+  }
+
+  // writes go to the drive in the order they came
+  if (BDEV_CoalescerFlush(co)) {
+    return 1;
+  }
+  if (count >= co->size) {
+    return BDEV_Call(co->dev.lower, BDEV_WRITE, buf, sector, count);
+  }
+  memcpy(co->buf, buf, count * BDEV_SECTOR_SIZE);
+  co->sector = sector;
+  co->count = count;
+  return 0;
+}
+/**
+ * @brief Writes pending sectors.
+ * @param co Coalescer
+ * @retval 0 Sectors written
+ * @retval 1 Error occurred (sectors are dropped)
+ */
+static uint8_t BDEV_CoalescerFlush(BDEV_Coalescer* co) {
+
+  uint32_t count = co->count;
+
+  if (count == 0) {
+    return 0;
+  }
+  co->count = 0;
+  return BDEV_Call(co->dev.lower, BDEV_WRITE, co->buf, co->sector, count);
+}
+
+/**
+ * @}
+ */
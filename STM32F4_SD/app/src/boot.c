@@ -0,0 +1,135 @@
+/**
+ * @file    boot.c
+ * @brief   Timing of boot phases.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details The startup code starts the cycle counter right after reset
+ * and saves it after clearing .bss, after copying .data and after
+ * SystemInit. main marks the end of each of its initialization phases
+ * with BOOT_Mark and prints the durations with BOOT_Report.
+ *
+ * Until SystemInit returns the core runs from HSI, later from the PLL,
+ * so cycles are converted to time with the clock of their phase.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <boot.h>
+#include <dwt.h>
+#include <stdio.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("BOOT--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup BOOT
+ * @{
+ */
+
+#define BOOT_STARTUP_MARKS 3 ///< Phases marked by the startup code
+
+/**
+ * @brief Cycle counter at end of startup phases (set in startup_cm.c)
+ */
+extern uint32_t boot_cycles[BOOT_STARTUP_MARKS];
+
+static const char* startupNames[BOOT_STARTUP_MARKS] = {
+    ".bss clear", ".data copy", "SystemInit"
+};
+
+static const char* names[BOOT_MAX_MARKS]; ///< Names of phases of main
+static uint32_t marks[BOOT_MAX_MARKS]; ///< Cycle counter at end of phases
+static uint8_t markCount; ///< Number of marked phases
+
+static uint32_t BOOT_Micros(uint32_t cycles);
+static void BOOT_PrintPhase(const char* name, uint32_t cycles,
+    uint32_t* prevTime);
+
+/**
+ * @brief Marks the end of a boot phase.
+ * @details Phases over BOOT_MAX_MARKS are not recorded.
+ * @param name Name of phase (must stay valid, e.g. a literal)
+ */
+void BOOT_Mark(const char* name) {
+
+  if (markCount < BOOT_MAX_MARKS) {
+    marks[markCount] = DWT_GetCycles();
+    names[markCount++] = name;
+  }
+}
+/**
+ * @brief Gets time since reset.
+ * @details Valid for about 25 s, until the cycle counter wraps.
+ * @return Time in us
+ */
+uint32_t BOOT_GetTime(void) {
+
+  return BOOT_Micros(DWT_GetCycles());
+}
+/**
+ * @brief Prints duration of every boot phase.
+ */
+void BOOT_Report(void) {
+
+  uint32_t prevTime = 0;
+
+  for (int i = 0; i < BOOT_STARTUP_MARKS; i++) {
+    BOOT_PrintPhase(startupNames[i], boot_cycles[i], &prevTime);
+  }
+  for (int i = 0; i < markCount; i++) {
+    BOOT_PrintPhase(names[i], marks[i], &prevTime);
+  }
+  println("Ready %u us after reset", (unsigned int)prevTime);
+}
+/**
+ * @brief Converts cycle counter to time since reset.
+ * @param cycles Cycle counter
+ * @return Time in us
+ */
+static uint32_t BOOT_Micros(uint32_t cycles) {
+
+  uint32_t clockSet = boot_cycles[BOOT_STARTUP_MARKS - 1];
+
+  if (cycles <= clockSet) {
+    return cycles / (BOOT_RESET_CLOCK / 1000000);
+  }
+  return clockSet / (BOOT_RESET_CLOCK / 1000000) +
+      (cycles - clockSet) / (DWT_GetFrequency() / 1000000);
+}
+/**
+ * @brief Prints a phase.
+ * @param name Name of phase
+ * @param cycles Cycle counter at end of phase
+ * @param prevTime End of previous phase in us (updated)
+ */
+static void BOOT_PrintPhase(const char* name, uint32_t cycles,
+    uint32_t* prevTime) {
+
+  uint32_t time = BOOT_Micros(cycles);
+
+  println("%-16s %7u us (at %u us)", name, (unsigned int)(time - *prevTime),
+      (unsigned int)time);
+  *prevTime = time;
+}
+
+/**
+ * @}
+ */
@@ -17,6 +17,7 @@
 
 #include <comm.h>
 #include <fifo.h>
+#include <crc.h>
 // HAL
 #include <uart2.h>
 #include <stdio.h>
@@ -40,6 +41,8 @@
 
 #define COMM_BUF_LEN     2048    ///< COMM buffer lengths
 #define COMM_TERMINATOR '\r'     ///< COMM frame terminator character
+#define COMM_CRC_MARK   '*'      ///< Marks the CRC suffix of a frame
+#define COMM_CRC_LEN    9        ///< Length of CRC suffix ("*XXXXXXXX")
 
 static uint8_t rxBuffer[COMM_BUF_LEN]; ///< Buffer for received data.
 static uint8_t txBuffer[COMM_BUF_LEN]; ///< Buffer for transmitted data.
@@ -51,6 +54,7 @@ static uint8_t gotFrame;  ///< Nonzero signals a new frame (number of received f
 
 uint8_t COMM_TxCallback(uint8_t* c);
 void    COMM_RxCallback(uint8_t c);
+static uint8_t COMM_CheckCrc(uint8_t* buf, uint8_t* len);
 
 /**
  * @brief Initialize communication terminal interface.
@@ -112,13 +116,36 @@ uint8_t COMM_Getc(void) {
 
   return c;
 }
+/**
+ * @brief Send a frame with a CRC suffix to USART2.
+ * @details The frame is followed by "*XXXXXXXX" (CRC of data in hex)
+ * and the terminator, so the receiver can check it.
+ * @param buf Frame data
+ * @param len Length of data
+ */
+void COMM_SendFrame(const uint8_t* buf, uint8_t len) {
+
+  char suffix[COMM_CRC_LEN + 2];
+
+  for (uint8_t i = 0; i < len; i++) {
+    COMM_Putc(buf[i]);
+  }
+  snprintf(suffix, sizeof(suffix), "%c%08lX%c", COMM_CRC_MARK,
+      (unsigned long)CRC_Calc(buf, len), COMM_TERMINATOR);
+  for (uint8_t i = 0; suffix[i]; i++) {
+    COMM_Putc(suffix[i]);
+  }
+}
 /**
  * @brief Get a complete frame from USART2 (nonblocking)
+ * @details A frame ending with "*XXXXXXXX" is checked against the CRC
+ * in the suffix and the suffix is removed. Frames without a suffix
+ * (typed by hand) are accepted as they are.
  * @param buf Buffer for data (data will be null terminated for easier string manipulation)
  * @param len Length not including terminator character
  * @retval 0 Received frame
  * @retval 1 No frame in buffer
- * @retval 2 Frame error
+ * @retval 2 Frame error (or wrong CRC)
  * TODO Add maximum length checking so as not to overflow
  */
 uint8_t COMM_GetFrame(uint8_t* buf, uint8_t* len) {
@@ -147,7 +174,7 @@ uint8_t COMM_GetFrame(uint8_t* buf, uint8_t* len) {
 
     }
     gotFrame--;
-    return 0;
+    return COMM_CheckCrc(buf, len);
 
   } else {
 
@@ -155,6 +182,43 @@ uint8_t COMM_GetFrame(uint8_t* buf, uint8_t* len) {
   }
 
 }
+/**
+ * @brief Checks and removes the CRC suffix of a frame.
+ * @param buf Frame (null terminated)
+ * @param len Length of frame, shortened if suffix is removed
+ * @retval 0 No suffix or correct CRC
+ * @retval 2 Wrong CRC
+ */
+static uint8_t COMM_CheckCrc(uint8_t* buf, uint8_t* len) {
+
+  if (*len < COMM_CRC_LEN || buf[*len - COMM_CRC_LEN] != COMM_CRC_MARK) {
+    return 0;
+  }
+
+  uint8_t dataLen = *len - COMM_CRC_LEN;
+  uint32_t crc = 0;
+
+  // exactly 8 hex digits, nothing else
+  for (uint8_t i = dataLen + 1; i < *len; i++) {
+    uint8_t c = buf[i];
+    if (c >= '0' && c <= '9') {
+      c -= '0';
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      c = (c | 0x20) - 'a' + 10;
+    } else {
+      return 0; // not a CRC, leave the frame as it is
+    }
+    crc = (crc << 4) | c;
+  }
+  if (crc != CRC_Calc(buf, dataLen)) {
+    *len = 0;
+    println("CRC error");
+    return 2;
+  }
+  *len = dataLen;
+  buf[dataLen] = 0;
+  return 0;
+}
 /**
  * @brief Callback for receiving data from PC.
  * @param c Data sent from lower layer software.
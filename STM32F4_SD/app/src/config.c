@@ -0,0 +1,327 @@
+/**
+ * @file    config.c
+ * @brief   Configuration store in internal flash.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <config.h>
+#include <flash_hal.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("CONFIG--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup CONFIG
+ * @{
+ */
+
+#define CONFIG_MAGIC        0x47464e43  ///< Marks a sector in use ("CNFG")
+#define CONFIG_ERASED       0xffffffff  ///< Value of erased flash word
+#define CONFIG_HEADER_SIZE  8           ///< Size of sector header (magic, sequence number)
+
+/*
+ * Every sector in use starts with a magic word and a sequence number.
+ * Records follow: a word with the ID (low half) and length (high half)
+ * of the value, the value padded to whole words and a checksum word.
+ * Words are programmed in this order, so a record cut short by a reset
+ * fails its checksum and is skipped. A value of length 0 marks a
+ * deleted item. The newest record of an ID holds its value.
+ *
+ * When the sector is full, the newest records are copied into the
+ * next sector, which then gets a higher sequence number. Sectors are
+ * used in turn, so they are erased equally often.
+ */
+
+static int8_t activeSector = -1;  ///< Sector holding records
+static uint32_t sectorSeq;        ///< Sequence number of active sector
+static uint32_t writePos;         ///< Offset of next record in active sector
+static uint32_t configIndex[CONFIG_MAX_ID]; ///< Offsets of newest records (0 - no value)
+static uint32_t recordBuf[(CONFIG_MAX_LEN + 8) / 4]; ///< Record being written
+
+static uint8_t CONFIG_Format(uint8_t sector, uint32_t seq);
+static uint8_t CONFIG_Rotate(void);
+static void CONFIG_Scan(void);
+static uint8_t CONFIG_IsBlank(uint8_t sector);
+static uint32_t CONFIG_RecordSize(uint32_t len);
+
+/**
+ * @brief Initializes the configuration store.
+ *
+ * @details Finds the sector with the highest sequence number and
+ * builds the index of newest records. No flash is written unless
+ * neither sector is in use.
+ *
+ * @retval 0 Store ready
+ * @retval 1 Error: flash erase or programming error
+ */
+uint8_t CONFIG_Init(void) {
+
+  activeSector = -1;
+
+  for (uint8_t i = 0; i < FLASH_HAL_SECTORS; i++) {
+    const uint32_t* words = FLASH_HAL_GetAddress(i);
+    if (words[0] != CONFIG_MAGIC || words[1] == CONFIG_ERASED) {
+      continue;
+    }
+    if (activeSector == -1 || (int32_t)(words[1] - sectorSeq) > 0) {
+      activeSector = i;
+      sectorSeq = words[1];
+    }
+  }
+
+  if (activeSector == -1) {
+    println("No sector in use, formatting");
+    memset(configIndex, 0, sizeof(configIndex));
+    return CONFIG_Format(0, 1);
+  }
+
+  CONFIG_Scan();
+  return 0;
+}
+/**
+ * @brief Reads the value of an item.
+ * @param id ID of item
+ * @param data Buffer for value
+ * @param maxLen Size of buffer (longer values are truncated)
+ * @return Length of value or -1 if item has no value
+ */
+int CONFIG_Read(uint16_t id, void* data, int maxLen) {
+
+  if (activeSector == -1 || id >= CONFIG_MAX_ID || configIndex[id] == 0) {
+    return -1;
+  }
+
+  const uint32_t* record = FLASH_HAL_GetAddress(activeSector) + configIndex[id] / 4;
+  int len = record[0] >> 16;
+
+  memcpy(data, record + 1, len < maxLen ? len : maxLen);
+  return len;
+}
+/**
+ * @brief Writes the value of an item.
+ *
+ * @details Writing the value the item already has costs no flash.
+ * If the sector is full, the store moves to the next sector, which
+ * has to be erased first - this stalls the CPU for about a second.
+ *
+ * @param id ID of item
+ * @param data Value
+ * @param len Length of value (0 deletes the item)
+ * @retval 0 Value written
+ * @retval 1 Error: bad arguments, store full or flash error
+ */
+uint8_t CONFIG_Write(uint16_t id, const void* data, int len) {
+
+  if (activeSector == -1 || id >= CONFIG_MAX_ID || len < 0 || len > CONFIG_MAX_LEN) {
+    return 1;
+  }
+
+  // unchanged value
+  if (configIndex[id] == 0 && len == 0) {
+    return 0;
+  }
+  if (configIndex[id] != 0) {
+    const uint32_t* record = FLASH_HAL_GetAddress(activeSector) + configIndex[id] / 4;
+    if ((int)(record[0] >> 16) == len && memcmp(record + 1, data, len) == 0) {
+      return 0;
+    }
+  }
+
+  uint32_t size = CONFIG_RecordSize(len);
+  if (writePos + size > FLASH_HAL_SECTOR_SIZE) {
+    if (CONFIG_Rotate()) {
+      return 1;
+    }
+    if (writePos + size > FLASH_HAL_SECTOR_SIZE) {
+      println("Store full");
+      return 1;
+    }
+  }
+
+  memset(recordBuf, 0, size);
+  recordBuf[0] = id | (len << 16);
+  memcpy(recordBuf + 1, data, len);
+  recordBuf[size / 4 - 1] = CRC_Calc(recordBuf, 4 + len);
+
+  uint32_t pos = writePos;
+  // space is used even if programming fails
+  writePos += size;
+  if (FLASH_HAL_Program(activeSector, pos, recordBuf, size / 4)) {
+    println("Programming error");
+    return 1;
+  }
+  configIndex[id] = len ? pos : 0;
+  return 0;
+}
+/**
+ * @brief Deletes the value of an item.
+ * @param id ID of item
+ * @retval 0 Value deleted
+ * @retval 1 Error: bad ID, store full or flash error
+ */
+uint8_t CONFIG_Delete(uint16_t id) {
+
+  return CONFIG_Write(id, 0, 0);
+}
+/**
+ * @brief Makes a sector the active sector, with no records.
+ * @param sector Sector number
+ * @param seq Sequence number of sector
+ * @retval 0 Sector ready
+ * @retval 1 Error: flash erase or programming error
+ */
+static uint8_t CONFIG_Format(uint8_t sector, uint32_t seq) {
+
+  if (!CONFIG_IsBlank(sector) && FLASH_HAL_Erase(sector)) {
+    println("Erase error");
+    return 1;
+  }
+
+  uint32_t magic = CONFIG_MAGIC;
+  // magic is programmed last, so a sector is not used before it is ready
+  if (FLASH_HAL_Program(sector, 4, &seq, 1) ||
+      FLASH_HAL_Program(sector, 0, &magic, 1)) {
+    println("Programming error");
+    return 1;
+  }
+
+  activeSector = sector;
+  sectorSeq = seq;
+  writePos = CONFIG_HEADER_SIZE;
+  return 0;
+}
+/**
+ * @brief Copies newest records to the next sector.
+ *
+ * @details The sector header is written after the records, so
+ * after a reset during copying the old sector is still used.
+ *
+ * @retval 0 Records copied
+ * @retval 1 Error: flash erase or programming error
+ */
+static uint8_t CONFIG_Rotate(void) {
+
+  uint8_t next = (activeSector + 1) % FLASH_HAL_SECTORS;
+  const uint32_t* words = FLASH_HAL_GetAddress(activeSector);
+  uint32_t pos = CONFIG_HEADER_SIZE;
+
+  println("Moving to sector %d", next);
+
+  if (!CONFIG_IsBlank(next) && FLASH_HAL_Erase(next)) {
+    println("Erase error");
+    return 1;
+  }
+
+  for (int id = 0; id < CONFIG_MAX_ID; id++) {
+    if (configIndex[id] == 0) {
+      continue;
+    }
+    const uint32_t* record = words + configIndex[id] / 4;
+    uint32_t size = CONFIG_RecordSize(record[0] >> 16);
+    if (FLASH_HAL_Program(next, pos, record, size / 4)) {
+      println("Programming error");
+      return 1;
+    }
+    pos += size;
+  }
+
+  uint32_t seq = sectorSeq + 1;
+  uint32_t magic = CONFIG_MAGIC;
+  if (FLASH_HAL_Program(next, 4, &seq, 1) ||
+      FLASH_HAL_Program(next, 0, &magic, 1)) {
+    println("Programming error");
+    return 1;
+  }
+
+  activeSector = next;
+  sectorSeq = seq;
+  CONFIG_Scan();
+  return 0;
+}
+/**
+ * @brief Builds the index of newest records in the active sector.
+ *
+ * @details A damaged record header ends the scan and marks the
+ * sector as full, so the next write moves to the other sector.
+ */
+static void CONFIG_Scan(void) {
+
+  const uint32_t* words = FLASH_HAL_GetAddress(activeSector);
+  uint32_t pos = CONFIG_HEADER_SIZE;
+
+  memset(configIndex, 0, sizeof(configIndex));
+
+  while (pos < FLASH_HAL_SECTOR_SIZE && words[pos / 4] != CONFIG_ERASED) {
+
+    uint32_t id = words[pos / 4] & 0xffff;
+    uint32_t len = words[pos / 4] >> 16;
+    uint32_t size = CONFIG_RecordSize(len);
+
+    if (id >= CONFIG_MAX_ID || len > CONFIG_MAX_LEN ||
+        pos + size > FLASH_HAL_SECTOR_SIZE) {
+      println("Damaged record at %u", (unsigned int)pos);
+      pos = FLASH_HAL_SECTOR_SIZE;
+      break;
+    }
+    // records cut short by a reset are skipped
+    if (words[(pos + size) / 4 - 1] ==
+        CRC_Calc(words + pos / 4, 4 + len)) {
+      configIndex[id] = len ? pos : 0;
+    }
+    pos += size;
+  }
+  writePos = pos;
+}
+/**
+ * @brief Checks if a sector is erased.
+ * @param sector Sector number
+ * @retval 1 Sector is erased
+ * @retval 0 Sector is not erased
+ */
+static uint8_t CONFIG_IsBlank(uint8_t sector) {
+
+  const uint32_t* words = FLASH_HAL_GetAddress(sector);
+
+  for (uint32_t i = 0; i < FLASH_HAL_SECTOR_SIZE / 4; i++) {
+    if (words[i] != CONFIG_ERASED) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/**
+ * @brief Calculates the size of a record.
+ * @param len Length of value
+ * @return Size of record in bytes
+ */
+static uint32_t CONFIG_RecordSize(uint32_t len) {
+
+  return 4 + ((len + 3) & ~3) + 4;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,469 @@
+/**
+ * @file    dsp.c
+ * @brief   Block processing pipeline for sampled signals.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Blocks of Q15 samples (as from the ADC) go through a chain
+ * of stages (filters, decimation, RMS, band energies) before they are
+ * logged, so only the reduced data is written to the card, e.g.:
+ *
+ *   n = DSP_Process(&pipeline, samples, out);
+ *   TLOG_Append(&log, time, (uint8_t*)out, n * sizeof(float));
+ *
+ * With DSP_USE_CMSIS defined (and the CMSIS-DSP library for Cortex-M4
+ * with FPU linked) the stages run the arm_math kernels, otherwise the
+ * portable kernels below, which give the same results and also build
+ * on the PC. Coefficients follow the CMSIS conventions: FIR taps in
+ * time reversed order, biquad sections as b0, b1, b2, a1, a2 with the
+ * feedback coefficients negated (y += a1 * y[n-1] + a2 * y[n-2]).
+ *
+ * The cycles of every stage are counted with the DWT cycle counter.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <dsp.h>
+#include <dwt.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("DSP--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup DSP
+ * @{
+ */
+
+#define DSP_MIN_FFT 32  ///< Shortest block for band energies
+
+static DSP_Stage* DSP_NewStage(DSP_Pipeline* p, DSP_StageType type);
+static void DSP_Fir(DSP_Stage* s, const float* in, float* out);
+static void DSP_Biquad(DSP_Stage* s, const float* in, float* out);
+static void DSP_Rms(DSP_Stage* s, const float* in, float* out);
+static void DSP_Bands(DSP_Stage* s, float* in, float* out, float* work);
+
+/**
+ * @brief Initializes an empty pipeline.
+ * @param p Pipeline
+ * @param blockSize Number of input samples per block
+ * @retval 0 Pipeline initialized
+ * @retval 1 Wrong block size
+ */
+uint8_t DSP_Init(DSP_Pipeline* p, uint16_t blockSize) {
+
+  if (blockSize == 0 || blockSize > DSP_MAX_BLOCK) {
+    println("Wrong block size %u", (unsigned int)blockSize);
+    return 1;
+  }
+
+  memset(p, 0, sizeof(DSP_Pipeline));
+  p->blockSize = blockSize;
+
+  DWT_Init();
+  return 0;
+}
+/**
+ * @brief Adds a FIR filter.
+ * @param p Pipeline
+ * @param coeffs Taps in time reversed order (must stay valid)
+ * @param taps Number of taps
+ * @retval 0 Stage added
+ * @retval 1 Error
+ */
+uint8_t DSP_AddFir(DSP_Pipeline* p, const float* coeffs, uint16_t taps) {
+
+  return DSP_AddDecimate(p, coeffs, taps, 1);
+}
+/**
+ * @brief Adds a cascade of biquad filters (direct form I).
+ * @param p Pipeline
+ * @param coeffs 5 coefficients per section (must stay valid)
+ * @param sections Number of sections
+ * @retval 0 Stage added
+ * @retval 1 Error
+ */
+uint8_t DSP_AddBiquad(DSP_Pipeline* p, const float* coeffs, uint16_t sections) {
+
+  if (sections == 0 || sections > DSP_MAX_SECTIONS) {
+    println("Wrong number of sections %u", (unsigned int)sections);
+    return 1;
+  }
+
+  DSP_Stage* s = DSP_NewStage(p, DSP_BIQUAD);
+  if (!s) {
+    return 1;
+  }
+  s->coeffs = coeffs;
+  s->count = sections;
+  s->outLen = s->inLen;
+
+#ifdef DSP_USE_CMSIS
+  arm_biquad_cascade_df1_init_f32(&s->cmsis.biquad, sections,
+      (float32_t*)coeffs, s->state);
+#endif
+  p->count++;
+  return 0;
+}
+/**
+ * @brief Adds a FIR filter keeping every factor-th output.
+ * @param p Pipeline
+ * @param coeffs Taps in time reversed order (must stay valid)
+ * @param taps Number of taps
+ * @param factor Decimation factor (must divide block length)
+ * @retval 0 Stage added
+ * @retval 1 Error
+ */
+uint8_t DSP_AddDecimate(DSP_Pipeline* p, const float* coeffs, uint16_t taps,
+    uint16_t factor) {
+
+  if (taps == 0 || taps > DSP_MAX_TAPS) {
+    println("Wrong number of taps %u", (unsigned int)taps);
+    return 1;
+  }
+
+  DSP_Stage* s = DSP_NewStage(p, factor == 1 ? DSP_FIR : DSP_DECIMATE);
+  if (!s) {
+    return 1;
+  }
+  if (factor == 0 || factor > 255 || s->inLen % factor) {
+    println("Wrong decimation factor %u", (unsigned int)factor);
+    return 1;
+  }
+  s->coeffs = coeffs;
+  s->count = taps;
+  s->factor = factor;
+  s->outLen = s->inLen / factor;
+
+#ifdef DSP_USE_CMSIS
+  if (factor == 1) {
+    arm_fir_init_f32(&s->cmsis.fir, taps, (float32_t*)coeffs,
+        s->state, s->inLen);
+  } else {
+    arm_fir_decimate_init_f32(&s->cmsis.decimate, taps, factor,
+        (float32_t*)coeffs, s->state, s->inLen);
+  }
+#endif
+  p->count++;
+  return 0;
+}
+/**
+ * @brief Adds root mean square of block.
+ * @param p Pipeline
+ * @retval 0 Stage added
+ * @retval 1 Error
+ */
+uint8_t DSP_AddRms(DSP_Pipeline* p) {
+
+  DSP_Stage* s = DSP_NewStage(p, DSP_RMS);
+  if (!s) {
+    return 1;
+  }
+  s->outLen = 1;
+
+  p->count++;
+  return 0;
+}
+/**
+ * @brief Adds energies of frequency bands.
+ * @details The spectrum of the block (without the Nyquist frequency)
+ * is split into equal bands. Energies are scaled so that their sum is
+ * the mean square of the block (a sine of amplitude A gives A^2 / 2).
+ * @param p Pipeline
+ * @param bands Number of bands (must divide half of block length)
+ * @retval 0 Stage added
+ * @retval 1 Error
+ */
+uint8_t DSP_AddBands(DSP_Pipeline* p, uint16_t bands) {
+
+  DSP_Stage* s = DSP_NewStage(p, DSP_BANDS);
+  if (!s) {
+    return 1;
+  }
+  uint16_t n = s->inLen;
+  if (n < DSP_MIN_FFT || (n & (n - 1))) {
+    println("Block length %u is not a power of 2", (unsigned int)n);
+    return 1;
+  }
+  if (bands == 0 || (n / 2) % bands) {
+    println("Wrong number of bands %u", (unsigned int)bands);
+    return 1;
+  }
+  s->count = bands;
+  s->outLen = bands;
+
+#ifdef DSP_USE_CMSIS
+  arm_rfft_fast_init_f32(&s->cmsis.fft, n);
+#else
+  // twiddle factors: cosines, then sines
+  for (uint16_t k = 0; k < n / 2; k++) {
+    s->state[k] = cosf(2 * M_PI * k / n);
+    s->state[n / 2 + k] = sinf(2 * M_PI * k / n);
+  }
+#endif
+  p->count++;
+  return 0;
+}
+/**
+ * @brief Processes a block of samples.
+ * @param p Pipeline
+ * @param in Input samples (blockSize, Q15)
+ * @param out Output of last stage
+ * @return Number of output values
+ */
+int DSP_Process(DSP_Pipeline* p, const int16_t* in, float* out) {
+
+  uint8_t cur = 0;
+  uint16_t len = p->blockSize;
+
+#ifdef DSP_USE_CMSIS
+  arm_q15_to_float((q15_t*)in, p->buf[cur], len);
+#else
+  for (uint16_t i = 0; i < len; i++) {
+    p->buf[cur][i] = in[i] / 32768.0f;
+  }
+#endif
+
+  for (uint8_t i = 0; i < p->count; i++) {
+
+    DSP_Stage* s = &p->stage[i];
+    float* src = p->buf[cur];
+    float* dst = p->buf[!cur];
+    uint32_t start = DWT_GetCycles();
+
+    switch (s->type) {
+    case DSP_FIR:
+    case DSP_DECIMATE:
+      DSP_Fir(s, src, dst);
+      break;
+    case DSP_BIQUAD:
+      DSP_Biquad(s, src, dst);
+      break;
+    case DSP_RMS:
+      DSP_Rms(s, src, dst);
+      break;
+    case DSP_BANDS:
+      DSP_Bands(s, src, dst, p->fft);
+      break;
+    }
+
+    s->cycles += DWT_GetCycles() - start;
+    cur = !cur;
+    len = s->outLen;
+  }
+
+  memcpy(out, p->buf[cur], len * sizeof(float));
+  p->blocks++;
+
+  return len;
+}
+/**
+ * @brief Gets cycles spent in a stage.
+ * @param p Pipeline
+ * @param stage Number of stage
+ * @return Average cycles per block
+ */
+uint32_t DSP_GetCycles(DSP_Pipeline* p, uint8_t stage) {
+
+  if (stage >= p->count || p->blocks == 0) {
+    return 0;
+  }
+  return p->stage[stage].cycles / p->blocks;
+}
+/**
+ * @brief Prepares the next stage of a pipeline.
+ * @details The stage is counted by the caller after checking its
+ * parameters.
+ * @param p Pipeline
+ * @param type Kind of stage
+ * @return Stage or null if pipeline is full
+ */
+static DSP_Stage* DSP_NewStage(DSP_Pipeline* p, DSP_StageType type) {
+
+  if (p->count == DSP_MAX_STAGES) {
+    println("Too many stages");
+    return 0;
+  }
+
+  DSP_Stage* s = &p->stage[p->count];
+  memset(s, 0, sizeof(DSP_Stage));
+  s->type = type;
+  s->inLen = p->count ? p->stage[p->count - 1].outLen : p->blockSize;
+
+  return s;
+}
+/**
+ * @brief FIR filter, keeping every factor-th output.
+ * @details The state holds taps - 1 previous samples followed by the
+ * current block, as in CMSIS.
+ * @param s Stage
+ * @param in Input block
+ * @param out Output block
+ */
+static void DSP_Fir(DSP_Stage* s, const float* in, float* out) {
+
+#ifdef DSP_USE_CMSIS
+  if (s->factor == 1) {
+    arm_fir_f32(&s->cmsis.fir, (float32_t*)in, out, s->inLen);
+  } else {
+    arm_fir_decimate_f32(&s->cmsis.decimate, (float32_t*)in, out, s->inLen);
+  }
+#else
+  uint16_t taps = s->count;
+  float* x = s->state;
+
+  memcpy(x + taps - 1, in, s->inLen * sizeof(float));
+
+  // output uses newest of every factor samples
+  for (uint16_t n = s->factor - 1; n < s->inLen; n += s->factor) {
+    float acc = 0;
+    for (uint16_t k = 0; k < taps; k++) {
+      acc += s->coeffs[k] * x[n + k];
+    }
+    *out++ = acc;
+  }
+
+  memmove(x, x + s->inLen, (taps - 1) * sizeof(float));
+#endif
+}
+/**
+ * @brief Cascade of biquad filters (direct form I).
+ * @details The state holds x[n-1], x[n-2], y[n-1], y[n-2] for every
+ * section, as in CMSIS.
+ * @param s Stage
+ * @param in Input block
+ * @param out Output block
+ */
+static void DSP_Biquad(DSP_Stage* s, const float* in, float* out) {
+
+#ifdef DSP_USE_CMSIS
+  arm_biquad_cascade_df1_f32(&s->cmsis.biquad, (float32_t*)in, out, s->inLen);
+#else
+  for (uint16_t i = 0; i < s->count; i++) {
+
+    const float* c = &s->coeffs[5 * i];
+    float* st = &s->state[4 * i];
+
+    for (uint16_t n = 0; n < s->inLen; n++) {
+      float x = in[n];
+      float y = c[0] * x + c[1] * st[0] + c[2] * st[1] +
+          c[3] * st[2] + c[4] * st[3];
+      st[1] = st[0];
+      st[0] = x;
+      st[3] = st[2];
+      st[2] = y;
+      out[n] = y;
+    }
+    in = out; // next section filters in place
+  }
+#endif
+}
+/**
+ * @brief Root mean square of block.
+ * @param s Stage
+ * @param in Input block
+ * @param out RMS
+ */
+static void DSP_Rms(DSP_Stage* s, const float* in, float* out) {
+
+#ifdef DSP_USE_CMSIS
+  arm_rms_f32((float32_t*)in, s->inLen, out);
+#else
+  float sum = 0;
+  for (uint16_t n = 0; n < s->inLen; n++) {
+    sum += in[n] * in[n];
+  }
+  *out = sqrtf(sum / s->inLen);
+#endif
+}
+/**
+ * @brief Energies of frequency bands.
+ * @param s Stage
+ * @param in Input block (destroyed)
+ * @param out Band energies
+ * @param work FFT work area (2 * block length)
+ */
+static void DSP_Bands(DSP_Stage* s, float* in, float* out, float* work) {
+
+  uint16_t n = s->inLen;
+  uint16_t width = n / 2 / s->count;
+  float scale = 2.0f / ((float)n * n);
+
+#ifdef DSP_USE_CMSIS
+  // output packed as X[0], X[n/2], then complex X[1] ... X[n/2-1]
+  arm_rfft_fast_f32(&s->cmsis.fft, in, work, 0);
+  float dc = work[0] * work[0] / 2;
+  work[0] = work[1] = 0;
+  arm_cmplx_mag_squared_f32(work, work, n / 2);
+  work[0] = dc;
+  float* power = work;
+#else
+  float* re = work;
+  float* im = work + n;
+
+  // bit reversed order
+  for (uint16_t i = 0, j = 0; i < n; i++) {
+    re[j] = in[i];
+    im[j] = 0;
+    uint16_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+  }
+  // radix-2 butterflies
+  for (uint16_t len = 2; len <= n; len <<= 1) {
+    uint16_t step = n / len;
+    for (uint16_t i = 0; i < n; i += len) {
+      for (uint16_t k = 0; k < len / 2; k++) {
+        float wr = s->state[k * step];
+        float wi = -s->state[n / 2 + k * step];
+        uint16_t a = i + k;
+        uint16_t b = a + len / 2;
+        float vr = re[b] * wr - im[b] * wi;
+        float vi = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - vr;
+        im[b] = im[a] - vi;
+        re[a] += vr;
+        im[a] += vi;
+      }
+    }
+  }
+  float* power = re;
+  for (uint16_t k = 0; k < n / 2; k++) {
+    power[k] = re[k] * re[k] + im[k] * im[k];
+  }
+  power[0] /= 2; // DC has no negative frequency
+#endif
+
+  for (uint16_t b = 0; b < s->count; b++) {
+    float sum = 0;
+    for (uint16_t k = 0; k < width; k++) {
+      sum += power[b * width + k];
+    }
+    out[b] = sum * scale;
+  }
+}
+
+/**
+ * @}
+ */
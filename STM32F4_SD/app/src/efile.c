@@ -0,0 +1,330 @@
+/**
+ * @file    efile.c
+ * @brief   Encrypted files.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Data of a file is encrypted with AES-128 in counter mode,
+ * so any byte can be read or written without touching its neighbours.
+ * The first sector of the file holds the header with a random nonce,
+ * data starts in the second sector. The counter block of every 16 bytes
+ * of data is made of the nonce, the number of the sector and the number
+ * of the block in the sector:
+ *
+ *   | nonce (8) | sector (4, big endian) | block (4, big endian) |
+ *
+ * Writes are split at sector boundaries. While a piece is written to
+ * the card, the next one is already encrypted by the CRYP unit (with
+ * DMA), so with the hardware encryption costs almost nothing. Without
+ * it the software AES is used, started and finished at once.
+ *
+ * Overwriting data reuses the key stream of its sector, so files
+ * should be written once (logs) or the old contents must not be
+ * secret. A file without a valid header gets a new nonce when opened.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <efile.h>
+#include <aes.h>
+#include <fat.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("EFILE--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup EFILE
+ * @{
+ */
+
+#define EFILE_BUF_WORDS ((EFILE_SECTOR_SIZE + 2 * AES_BLOCK_SIZE) / 4) ///< Size of buffer
+
+static AES_Context aes; ///< Key for software encryption
+static void (*randomCallback)(uint8_t* buf, uint32_t len);
+static void (*startCallback)(const uint8_t* counter, const uint8_t* in,
+    uint8_t* out, uint32_t len);
+static void (*waitCallback)(void);
+
+/**
+ * @brief Buffers for a piece of a sector (aligned for DMA)
+ * @details The piece starts at the offset of its first byte in a cipher
+ * block and the length is rounded up to whole blocks.
+ */
+static uint32_t buf[2][EFILE_BUF_WORDS];
+
+static int EFILE_Start(EFILE_TypeDef* f, int pos, const uint8_t* data,
+    int count, uint8_t* out, int* skip);
+
+/**
+ * @brief Sets the key and the encryption functions.
+ * @param key AES-128 key (16 bytes)
+ * @param randomFunc Function giving random bytes for nonces
+ * @param startFunc Function starting AES-CTR of whole blocks (0 - software)
+ * @param waitFunc Function waiting for end of started AES-CTR
+ */
+void EFILE_Init(const uint8_t* key,
+    void (*randomFunc)(uint8_t* buf, uint32_t len),
+    void (*startFunc)(const uint8_t* counter, const uint8_t* in, uint8_t* out,
+        uint32_t len),
+    void (*waitFunc)(void)) {
+
+  AES_SetKey(&aes, key);
+  randomCallback = randomFunc;
+  startCallback = startFunc;
+  waitCallback = waitFunc;
+}
+/**
+ * @brief Opens an encrypted file.
+ * @details The file must exist, its size less the header sector is the
+ * size of the data.
+ * @param f File structure
+ * @param filename Name of file
+ * @retval 0 File opened
+ * @retval 1 File not found, too small or write error
+ */
+uint8_t EFILE_Open(EFILE_TypeDef* f, const char* filename) {
+
+  EFILE_Header hdr;
+
+  f->rdPtr = 0;
+  f->wrPtr = 0;
+  f->file = FAT_OpenFile(filename);
+  if (f->file == -1) {
+    println("File not found");
+    return 1;
+  }
+  if (FAT_GetFileSize(f->file) < EFILE_SECTOR_SIZE) {
+    println("File too small");
+    EFILE_Close(f);
+    return 1;
+  }
+
+  FAT_MoveRdPtr(f->file, 0);
+  if (FAT_ReadFile(f->file, (uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+      hdr.magic == EFILE_MAGIC &&
+      hdr.checksum == CRC_Calc(&hdr, offsetof(EFILE_Header, checksum))) {
+    memcpy(f->nonce, hdr.nonce, EFILE_NONCE_SIZE);
+    return 0;
+  }
+
+  println("New nonce for %s", filename);
+  hdr.magic = EFILE_MAGIC;
+  randomCallback(hdr.nonce, EFILE_NONCE_SIZE);
+  hdr.checksum = CRC_Calc(&hdr, offsetof(EFILE_Header, checksum));
+  FAT_MoveWrPtr(f->file, 0);
+  if (FAT_WriteFile(f->file, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    println("Write error");
+    EFILE_Close(f);
+    return 1;
+  }
+  memcpy(f->nonce, hdr.nonce, EFILE_NONCE_SIZE);
+  return 0;
+}
+/**
+ * @brief Closes an encrypted file.
+ * @param f File structure
+ */
+void EFILE_Close(EFILE_TypeDef* f) {
+
+  if (f->file != -1) {
+    FAT_CloseFile(f->file);
+    f->file = -1;
+  }
+}
+/**
+ * @brief Reads and decrypts data starting at the read pointer.
+ * @param f File structure
+ * @param data Buffer for data
+ * @param count Number of bytes to read
+ * @return Number of bytes read, -1 if file is not opened
+ */
+int EFILE_Read(EFILE_TypeDef* f, uint8_t* data, int count) {
+
+  if (f->file == -1) {
+    return -1;
+  }
+
+  FAT_MoveRdPtr(f->file, EFILE_SECTOR_SIZE + f->rdPtr);
+  int len = FAT_ReadFile(f->file, data, count);
+  if (len <= 0) {
+    return len;
+  }
+
+  // decrypt in pieces of sectors
+  int done = 0;
+  while (done < len) {
+    int skip;
+    uint8_t* piece = (uint8_t*)buf[0];
+    int n = EFILE_Start(f, f->rdPtr + done, data + done, len - done, piece,
+        &skip);
+    if (waitCallback) {
+      waitCallback();
+    }
+    memcpy(data + done, piece + skip, n);
+    done += n;
+  }
+  f->rdPtr += len;
+  return len;
+}
+/**
+ * @brief Encrypts and writes data starting at the write pointer.
+ * @details The next piece is encrypted while the previous one is
+ * written to the card.
+ * @param f File structure
+ * @param data Data
+ * @param count Number of bytes to write
+ * @return Number of bytes written, -1 if file is not opened
+ */
+int EFILE_Write(EFILE_TypeDef* f, const uint8_t* data, int count) {
+
+  int len[2];
+  int skip[2];
+  uint8_t cur = 0;
+  int done = 0;
+  int written = 0;
+
+  if (f->file == -1) {
+    return -1;
+  }
+  if (count <= 0) {
+    return 0;
+  }
+
+  len[cur] = EFILE_Start(f, f->wrPtr, data, count, (uint8_t*)buf[cur],
+      &skip[cur]);
+
+  while (1) {
+
+    if (waitCallback) {
+      waitCallback(); // current piece encrypted
+    }
+
+    int pos = f->wrPtr + done;
+    done += len[cur];
+    if (done < count) {
+      len[cur ^ 1] = EFILE_Start(f, f->wrPtr + done, data + done,
+          count - done, (uint8_t*)buf[cur ^ 1], &skip[cur ^ 1]);
+    }
+
+    FAT_MoveWrPtr(f->file, EFILE_SECTOR_SIZE + pos);
+    int n = FAT_WriteFile(f->file, (uint8_t*)buf[cur] + skip[cur], len[cur]);
+    if (n > 0) {
+      written += n;
+    }
+    if (n != len[cur]) {
+      println("Write error");
+      if (done < count && waitCallback) {
+        waitCallback(); // don't leave a transfer into the buffer running
+      }
+      break;
+    }
+    if (done >= count) {
+      break;
+    }
+    cur ^= 1;
+  }
+
+  f->wrPtr += written;
+  return written;
+}
+/**
+ * @brief Moves the read pointer.
+ * @param f File structure
+ * @param ptr Position in data
+ */
+void EFILE_MoveRdPtr(EFILE_TypeDef* f, int ptr) {
+
+  f->rdPtr = ptr;
+}
+/**
+ * @brief Moves the write pointer.
+ * @param f File structure
+ * @param ptr Position in data
+ */
+void EFILE_MoveWrPtr(EFILE_TypeDef* f, int ptr) {
+
+  f->wrPtr = ptr;
+}
+/**
+ * @brief Gets size of data in file.
+ * @param f File structure
+ * @return Size of data, -1 if file is not opened
+ */
+int EFILE_GetSize(EFILE_TypeDef* f) {
+
+  if (f->file == -1) {
+    return -1;
+  }
+  return FAT_GetFileSize(f->file) - EFILE_SECTOR_SIZE;
+}
+/**
+ * @brief Starts encryption of data up to the end of its sector.
+ * @param f File structure
+ * @param pos Position of data in file
+ * @param data Data
+ * @param count Number of bytes left
+ * @param out Buffer (EFILE_BUF_WORDS words)
+ * @param skip Offset of data in buffer
+ * @return Number of bytes in piece
+ */
+static int EFILE_Start(EFILE_TypeDef* f, int pos, const uint8_t* data,
+    int count, uint8_t* out, int* skip) {
+
+  uint32_t sector = pos / EFILE_SECTOR_SIZE;
+  uint32_t offset = pos % EFILE_SECTOR_SIZE;
+  uint32_t block = offset / AES_BLOCK_SIZE;
+  uint8_t counter[AES_BLOCK_SIZE];
+
+  int n = EFILE_SECTOR_SIZE - offset;
+  if (count < n) {
+    n = count;
+  }
+
+  *skip = offset % AES_BLOCK_SIZE;
+  uint32_t len = (*skip + n + AES_BLOCK_SIZE - 1) & ~(AES_BLOCK_SIZE - 1);
+  memset(out, 0, *skip);
+  memcpy(out + *skip, data, n);
+  memset(out + *skip + n, 0, len - *skip - n);
+
+  memcpy(counter, f->nonce, EFILE_NONCE_SIZE);
+  counter[8] = sector >> 24;
+  counter[9] = sector >> 16;
+  counter[10] = sector >> 8;
+  counter[11] = sector;
+  counter[12] = 0;
+  counter[13] = 0;
+  counter[14] = 0;
+  counter[15] = block;
+
+  if (startCallback) {
+    startCallback(counter, out, out, len);
+  } else {
+    AES_Ctr(&aes, counter, out, out, len);
+  }
+  return n;
+}
+
+/**
+ * @}
+ */
@@ -16,9 +16,13 @@
  */
 
 #include <fat.h>
+#include <bdev.h>
 #include <stdio.h>
 #include <utils.h>
 #include <string.h>
+#include <stddef.h>
+#include <timers.h>
+#include <crc.h>
 
 #ifndef DEBUG
   #define DEBUG
@@ -211,6 +215,11 @@ typedef struct {
   int id;                     ///< File ID
   uint32_t wrPtr;             ///< Pointer to current write location
   uint32_t rdPtr;             ///< Pointer to current read location
+  uint32_t lastCluster;       ///< Last cluster found in the chain (speeds up sequential access)
+  uint32_t lastClusterOffset; ///< Offset of lastCluster from start of file
+  uint8_t dirty;              ///< Nonzero if root dir entry is out of date
+  uint32_t dirtyBytes;        ///< Bytes written since root dir entry was updated
+  uint32_t dirtyTime;         ///< System time of first write after root dir entry was updated
 
 } FAT_File;
 /**
@@ -231,6 +240,9 @@ typedef struct {
   uint32_t dataStartSector;   ///< Sector where data starts
   uint32_t sectorsPerCluster; ///< Number of sectors per cluster
   uint32_t bytesPerSector;    ///< Number of bytes per sector
+  uint32_t numberOfFATs;      ///< Number of copies of FAT
+  uint32_t sectorsPerFAT;     ///< Number of sectors of one FAT
+  uint32_t clusterCount;      ///< Number of data clusters (clusters 2 to clusterCount+1)
 } FAT_PartitionInfo;
 /**
  * @brief Structure containing info about disk structure
@@ -239,18 +251,77 @@ typedef struct {
   uint8_t diskID;
   FAT_PartitionInfo partitionInfo[4];
 } FAT_DiskInfo;
-/**
- * @brief Physical layer callbacks.
- */
-typedef struct {
-  void (*phyInit)(void);
-  uint8_t (*phyReadSectors)(uint8_t* buf, uint32_t sector, uint32_t count);
-  uint8_t (*phyWriteSectors)(uint8_t* buf, uint32_t sector, uint32_t count);
-} FAT_PhysicalCb;
 
 #define FAT_MAX_DISKS     2   ///< Maximum number of mounted disks
 #define MAX_OPENED_FILES  32  ///< Maximum number of opened files
 #define FAT_LAST_CLUSTER  0x0fffffff ///< Last cluster in file
+#define FAT_SYNC_BYTES    16384 ///< Default number of written bytes after which root dir entry is updated
+#define FAT_SYNC_TIME     1000  ///< Default time in ms after which root dir entry is updated
+#define FAT_SNAPSHOT_MAGIC  0x50414e53 ///< Marks a valid snapshot ("SNAP")
+#define FAT_SNAPSHOT_FILES  8   ///< Number of files remembered in snapshot
+#define FAT_DEFRAG_SECTORS      8 ///< Data sectors copied in one defragmenter step
+#define FAT_DEFRAG_FAT_SECTORS  4 ///< FAT sectors searched or freed in one defragmenter step
+
+/**
+ * @brief Root dir location of a recently opened file.
+ */
+typedef struct {
+  char filename[12];      ///< Zero ended file name and extension
+  uint32_t rootDirEntry;  ///< Number of root dir entry for file
+} FAT_SnapshotFile;
+/**
+ * @brief Mount information kept in memory which survives resets.
+ *
+ * @details The snapshot is used instead of reading the MBR and
+ * searching the root directory if it was made for the same card
+ * (CID) and the same volume (boot sector checksum).
+ */
+typedef struct {
+  uint32_t magic;                   ///< FAT_SNAPSHOT_MAGIC if snapshot was saved
+  uint8_t cardId[16];               ///< CID of card the snapshot was made for
+  uint32_t bootSectorSum;           ///< Checksum of boot sector of the volume
+  FAT_PartitionInfo partition;      ///< Geometry of the volume
+  FAT_SnapshotFile files[FAT_SNAPSHOT_FILES]; ///< Recently opened files
+  uint32_t nextFile;                ///< Entry in files replaced next
+  uint32_t checksum;                ///< Checksum of all preceding fields
+} FAT_Snapshot;
+
+_Static_assert(sizeof(FAT_Snapshot) <= FAT_SNAPSHOT_SIZE,
+    "FAT_SNAPSHOT_SIZE too small");
+
+/**
+ * @brief Defragmenter states.
+ */
+typedef enum {
+  FAT_DEFRAG_IDLE,      ///< No file being defragmented
+  FAT_DEFRAG_FIND_RUN,  ///< Searching FAT for a run of free clusters
+  FAT_DEFRAG_COPY,      ///< Copying data to the free run
+  FAT_DEFRAG_LINK,      ///< Writing chain of the free run to FAT
+  FAT_DEFRAG_SWITCH,    ///< Pointing root dir entry to the new chain
+  FAT_DEFRAG_FREE,      ///< Freeing the old chain
+} FAT_DefragState;
+/**
+ * @brief Defragmenter progress.
+ */
+typedef struct {
+  FAT_DefragState state;  ///< Current step
+  uint32_t rootDirEntry;  ///< Number of root dir entry of file
+  uint32_t firstCluster;  ///< First cluster of old chain
+  uint32_t clusters;      ///< Number of clusters in chain
+  uint32_t runStart;      ///< First cluster of free run
+  uint32_t runLength;     ///< Number of free clusters found in run
+  uint32_t cluster;       ///< Next cluster to search, copy or free
+  uint32_t clusterOffset; ///< Next sector to copy in cluster
+  uint32_t done;          ///< Sectors copied or clusters linked
+  uint8_t failed;         ///< Nonzero if the new chain is freed instead of the old one
+  uint8_t written;        ///< Nonzero if the file was written before the switch
+} FAT_Defrag;
+
+/**
+ * @brief Checks if a FAT32 entry marks the end of a cluster chain.
+ * @details Only the lower 28 bits of an entry are valid.
+ */
+#define FAT_IS_LAST_CLUSTER(entry) (((entry) & 0x0fffffff) >= 0x0ffffff8)
 
 /**
  * @brief Opened files
@@ -261,74 +332,279 @@ typedef struct {
 static FAT_File openedFiles[MAX_OPENED_FILES];
 static FAT_DiskInfo mountedDisks[FAT_MAX_DISKS]; ///< Disk info for mounted disks
 static uint8_t buf[512]; ///< Buffer for reading sectors
-static FAT_PhysicalCb phyCallbacks; ///< Physical layer callbacks
+static uint32_t sectInBuffer = UINT32_MAX; ///< Sector currently held in buf
+static uint8_t bufDirty; ///< Nonzero if buf was modified and not yet written
+static BDEV_Device* drive; ///< Block device of the volume
+static FAT_Stats phyStats; ///< Physical layer access statistics
+static uint32_t syncBytes = FAT_SYNC_BYTES; ///< Root dir entry update threshold in bytes
+static uint32_t syncTime = FAT_SYNC_TIME;   ///< Root dir entry update threshold in ms
+static FAT_Snapshot* snapshot; ///< Snapshot in memory surviving resets (0 - none)
+static void (*getCardId)(uint8_t* id); ///< Gets ID of card for snapshot
+static FAT_Defrag defrag; ///< Defragmenter progress
+static uint8_t defragBuf[FAT_DEFRAG_SECTORS * 512]; ///< Buffer for copying clusters
 
 static uint32_t FAT_Cluster2Sector(uint32_t cluster);
 //static void FAT_ListRootDir(void);
 static uint32_t FAT_GetEntryInFAT(uint32_t cluster);
 static int FAT_FindFile(FAT_File* file);
+static int FAT_FindSnapshotFile(FAT_File* file);
+static void FAT_LoadEntry(FAT_File* file, const FAT_RootDirEntry* dirEntry,
+    uint32_t rootDirEntry);
+static int8_t FAT_MountVolume(void);
+static int8_t FAT_RestoreSnapshot(void);
+static void FAT_SaveSnapshot(uint32_t bootSectorSum);
+static void FAT_SnapshotAddFile(const FAT_File* file);
 static int FAT_GetNextId(void);
 static int FAT_GetCluster(uint32_t firstCluster, uint32_t clusterOffset,
     uint32_t* clusterNumber);
 static void FAT_UpdateRootEntry(int file);
+static void FAT_CommitIfNeeded(int file);
+static uint8_t FAT_IsOpened(int file);
+static int FAT_ReadData(int file, uint8_t* data, int count);
+static int FAT_WriteData(int file, const uint8_t* data, int count);
+static void FAT_GetChainInfo(uint32_t firstCluster, FAT_Fragmentation* info);
+static int FAT_NextDirEntry(uint32_t* index, FAT_RootDirEntry* entry);
+static uint32_t FAT_EntrySector(uint32_t cluster);
+static void FAT_SetEntryInBuffer(uint32_t cluster, uint32_t value);
+static uint8_t FAT_WriteFATSector(void);
+static void FAT_DefragCopy(void);
+static uint8_t FAT_DefragSwitch(void);
+static uint8_t FAT_PhyFlush(void);
+static void FAT_PhyError(const char* what, uint32_t sector, uint32_t count);
+
+/**
+ * @brief Reads sectors from the physical drive and updates statistics.
+ * @param data Buffer for data
+ * @param sector First sector to read
+ * @param count Number of sectors to read
+ * @retval 0 Sectors read
+ * @retval 1 Read error
+ */
+static uint8_t FAT_PhyRead(uint8_t* data, uint32_t sector, uint32_t count) {
+
+  phyStats.phyReads++;
+  phyStats.sectorsRead += count;
+  if (BDEV_Read(drive, data, sector, count)) {
+    FAT_PhyError("Read", sector, count);
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Writes sectors to the physical drive and updates statistics.
+ * @param data Data to write
+ * @param sector First sector to write
+ * @param count Number of sectors to write
+ * @retval 0 Sectors written
+ * @retval 1 Write error
+ */
+static uint8_t FAT_PhyWrite(uint8_t* data, uint32_t sector, uint32_t count) {
+
+  if (phyStats.firstWriteTime == 0) {
+    phyStats.firstWriteTime = TIMER_GetTime();
+  }
+  phyStats.phyWrites++;
+  phyStats.sectorsWritten += count;
+  if (BDEV_Write(drive, data, sector, count)) {
+    FAT_PhyError("Write", sector, count);
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Makes data written so far durable.
+ * @details Layers of the block device may keep written sectors in RAM.
+ * @retval 0 Data flushed
+ * @retval 1 Write error
+ */
+static uint8_t FAT_PhyFlush(void) {
+
+  if (BDEV_Flush(drive)) {
+    FAT_PhyError("Flush", 0, 1);
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Records a failed read or write of the physical drive.
+ * @details The drive has already tried to recover, so the error is
+ * only reported.
+ * @param what Kind of access
+ * @param sector First sector
+ * @param count Number of sectors
+ */
+static void FAT_PhyError(const char* what, uint32_t sector, uint32_t count) {
+
+  phyStats.phyErrors++;
+  phyStats.errorSector = sector;
+  println("%s error at sectors %u-%u", what, (unsigned int)sector,
+      (unsigned int)(sector + count - 1));
+}
+/**
+ * @brief Writes the sector buffer back to disk if it was modified.
+ */
+static void FAT_FlushSector(void) {
+
+  if (bufDirty) {
+    bufDirty = 0;
+    FAT_PhyWrite(buf, sectInBuffer, 1);
+    println("FlushSector: Written sector %u", (unsigned int) sectInBuffer);
+  }
+}
 
 /**
  * @brief Convenience function for reading sectors.
  *
  * @details It checks if the sector isn't in the buffer first
- * as a simple caching mechanism.
+ * as a simple caching mechanism. If the read fails, the buffer
+ * holds no sector.
  *
  * @param sector Sector to read.
+ * @retval 0 Sector in buffer
+ * @retval 1 Read error
  */
-static void FAT_ReadSector(uint32_t sector) {
-
-  static uint32_t sectInBuffer = UINT32_MAX;
+static uint8_t FAT_ReadSector(uint32_t sector) {
 
   // check if we already read the sector
   if (sectInBuffer == sector) {
     println("ReadSector: Sector already read");
-    return;
+    return 0;
   }
 
+  // save modified data before the buffer is reused
+  FAT_FlushSector();
+
   sectInBuffer = sector;
-  phyCallbacks.phyReadSectors(buf, sector, 1);
+  if (FAT_PhyRead(buf, sector, 1)) {
+    sectInBuffer = UINT32_MAX; // read again next time
+    return 1;
+  }
   println("ReadSector: Read sector %u", (unsigned int) sector);
-
+  return 0;
 }
 /**
- * @brief Convenience function for reading sectors.
+ * @brief Convenience function for writing sectors.
  *
- * @details It checks if the sector isn't in the buffer first
- * as a simple caching mechanism.
+ * @details Writes the buffer to the given sector. If the write
+ * fails, the buffer holds no sector.
  *
- * @param sector Sector to read.
+ * @param sector Sector to write.
+ * @retval 0 Sector written
+ * @retval 1 Write error
  */
-static void FAT_WriteSector(uint32_t sector) {
+static uint8_t FAT_WriteSector(uint32_t sector) {
 
-  phyCallbacks.phyWriteSectors(buf, sector, 1);
+  bufDirty = 0;
+  sectInBuffer = sector;
+  if (FAT_PhyWrite(buf, sector, 1)) {
+    sectInBuffer = UINT32_MAX; // read the drive's copy next time
+    return 1;
+  }
   println("WriteSector: Written sector %u", (unsigned int) sector);
+  return 0;
+}
+/**
+ * @brief Drops the buffered sector if it lies in a given range.
+ *
+ * @details Called before sectors are transferred directly
+ * between the drive and a user buffer, so that the buffer
+ * never holds a stale copy and is never flushed over new data.
+ *
+ * @param sector First sector of range
+ * @param count Number of sectors in range
+ * @param flush Nonzero to save the buffer first (before reading the range)
+ */
+static void FAT_InvalidateSectors(uint32_t sector, uint32_t count,
+    uint8_t flush) {
+
+  if (sectInBuffer >= sector && sectInBuffer - sector < count) {
+    if (flush) {
+      FAT_FlushSector();
+    }
+    bufDirty = 0;
+    sectInBuffer = UINT32_MAX;
+  }
+}
+/**
+ * @brief Sets memory for the mount snapshot.
+ *
+ * @details The memory should survive resets (e.g. backup SRAM).
+ * After a reset FAT_Init takes the volume geometry from the snapshot
+ * instead of reading the MBR, if the card ID and the boot sector
+ * checksum did not change, and FAT_OpenFile first checks
+ * the root dir entries of recently opened files.
+ * Call before FAT_Init.
+ *
+ * @param store Memory of FAT_SNAPSHOT_SIZE bytes (0 - no snapshot)
+ * @param cardIdFunc Function writing 16 bytes identifying the card
+ */
+void FAT_SetSnapshot(void* store, void (*cardIdFunc)(uint8_t* id)) {
 
+  snapshot = (FAT_Snapshot*)store;
+  getCardId = cardIdFunc;
 }
 /**
  * @brief Initialize FAT file system
- * @param phyInit Physical drive initialization function
- * @param phyReadSectors Read sectors function
- * @param phyWriteSectors Write sectors function
- * @return
+ * @param phyInit Physical drive initialization function (returns 0 if ready)
+ * @param dev Block device of the drive
+ * @retval 0 Volume mounted
+ * @retval -1 Invalid disk signature
+ * @retval -2 Invalid partition signature
+ * @retval -3 Drive initialization failed
  */
-int8_t FAT_Init(void (*phyInit)(void),
-    uint8_t (*phyReadSectors)(uint8_t* buf, uint32_t sector, uint32_t count),
-    uint8_t (*phyWriteSectors)(uint8_t* buf, uint32_t sector, uint32_t count)) {
+int8_t FAT_Init(uint8_t (*phyInit)(void), BDEV_Device* dev) {
 
-  phyCallbacks.phyInit = phyInit;
-  phyCallbacks.phyReadSectors = phyReadSectors;
-  phyCallbacks.phyWriteSectors = phyWriteSectors;
+  uint32_t startTime = TIMER_GetTime();
+
+  drive = dev;
 
   // initialize physical layer
-  phyCallbacks.phyInit();
+  if (phyInit()) {
+    println("Drive not ready");
+    return -3;
+  }
+
+  // nothing valid in sector buffer after (re)initialization
+  sectInBuffer = UINT32_MAX;
+  bufDirty = 0;
+
+  phyStats.snapshotUsed = 0;
+
+  if (FAT_RestoreSnapshot() == 0) {
+    println("Volume restored from snapshot");
+    phyStats.snapshotUsed = 1;
+  } else {
+    int8_t ret = FAT_MountVolume();
+    if (ret) {
+      return ret;
+    }
+    // boot sector is still in buffer
+    FAT_SaveSnapshot(CRC_Calc(buf, 512));
+  }
+
+  // Set all IDs to free slot
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    openedFiles[i].id = -1;
+  }
+  // a file being defragmented is left as it was before the step
+  defrag.state = FAT_DEFRAG_IDLE;
+
+  phyStats.mountTime = TIMER_GetTime() - startTime;
+
+  return 0;
+}
+/**
+ * @brief Reads volume geometry from the MBR and boot sector.
+ * @retval 0 Volume mounted, boot sector left in buffer
+ * @retval -1 Invalid disk signature or MBR not read
+ * @retval -2 Invalid partition signature or boot sector not read
+ */
+static int8_t FAT_MountVolume(void) {
 
   // Read MBR - first sector (0)
-  FAT_ReadSector(0);
+  if (FAT_ReadSector(0)) {
+    return -1;
+  }
 
   FAT_MBR* mbr = (FAT_MBR*)buf;
   if (mbr->signature != 0xaa55) {
@@ -363,7 +639,9 @@ int8_t FAT_Init(void (*phyInit)(void),
   }
 
   // Read boot sector of first partition
-  FAT_ReadSector(mountedDisks[0].partitionInfo[0].startAddress);
+  if (FAT_ReadSector(mountedDisks[0].partitionInfo[0].startAddress)) {
+    return -2;
+  }
 
   FAT32_BootSector* bootSector = (FAT32_BootSector*)buf;
 
@@ -425,6 +703,13 @@ int8_t FAT_Init(void (*phyInit)(void),
 
   mountedDisks[0].partitionInfo[0].bytesPerSector = bootSector->bytesPerSector;
 
+  // needed for changing the FAT and for searching free clusters
+  mountedDisks[0].partitionInfo[0].numberOfFATs = bootSector->numberOfFATs;
+  mountedDisks[0].partitionInfo[0].sectorsPerFAT = bootSector->sectorsPerFAT32;
+  mountedDisks[0].partitionInfo[0].clusterCount =
+      (mountedDisks[0].partitionInfo[0].startAddress +
+      mountedDisks[0].partitionInfo[0].length - clusterStart) / sectorsPerCluster;
+
   uint32_t rootCluster = bootSector->rootCluster;
 
   mountedDisks[0].partitionInfo[0].rootDirSector = FAT_Cluster2Sector(rootCluster);
@@ -432,13 +717,86 @@ int8_t FAT_Init(void (*phyInit)(void),
 
 //  FAT_ListRootDir();
 
-  // Set all IDs to free slot
-  for (int i = 0; i < MAX_OPENED_FILES; i++) {
-    openedFiles[i].id = -1;
+  return 0;
+}
+/**
+ * @brief Takes volume geometry from the snapshot if it is still valid.
+ * @retval 0 Volume restored
+ * @retval -1 No snapshot or snapshot made for another card or volume
+ */
+static int8_t FAT_RestoreSnapshot(void) {
+
+  uint8_t id[16];
+
+  if (!snapshot || !getCardId) {
+    return -1;
+  }
+  if (snapshot->magic != FAT_SNAPSHOT_MAGIC || snapshot->checksum !=
+      CRC_Calc(snapshot, offsetof(FAT_Snapshot, checksum))) {
+    println("No valid snapshot");
+    return -1;
+  }
+  getCardId(id);
+  if (memcmp(id, snapshot->cardId, sizeof(id))) {
+    println("Snapshot made for another card");
+    return -1;
+  }
+  // volume could have been formatted in another device
+  if (FAT_ReadSector(snapshot->partition.startAddress) ||
+      CRC_Calc(buf, 512) != snapshot->bootSectorSum) {
+    println("Snapshot made for another volume");
+    return -1;
   }
 
+  mountedDisks[0].diskID = 0;
+  mountedDisks[0].partitionInfo[0] = snapshot->partition;
+
   return 0;
 }
+/**
+ * @brief Saves geometry of the mounted volume in the snapshot.
+ * @details Files remembered for an earlier volume are forgotten.
+ * @param bootSectorSum Checksum of boot sector of the volume
+ */
+static void FAT_SaveSnapshot(uint32_t bootSectorSum) {
+
+  if (!snapshot || !getCardId) {
+    return;
+  }
+  memset(snapshot, 0, sizeof(FAT_Snapshot));
+  snapshot->magic = FAT_SNAPSHOT_MAGIC;
+  getCardId(snapshot->cardId);
+  snapshot->bootSectorSum = bootSectorSum;
+  snapshot->partition = mountedDisks[0].partitionInfo[0];
+  snapshot->checksum = CRC_Calc(snapshot,
+      offsetof(FAT_Snapshot, checksum));
+}
+/**
+ * @brief Remembers root dir location of a file in the snapshot.
+ * @param file Opened file
+ */
+static void FAT_SnapshotAddFile(const FAT_File* file) {
+
+  if (!snapshot || snapshot->magic != FAT_SNAPSHOT_MAGIC) {
+    return;
+  }
+  FAT_SnapshotFile* entry =
+      &snapshot->files[snapshot->nextFile % FAT_SNAPSHOT_FILES];
+  // replace an outdated entry for the same file
+  for (int i = 0; i < FAT_SNAPSHOT_FILES; i++) {
+    if (!strcmp(snapshot->files[i].filename, file->filename)) {
+      entry = &snapshot->files[i];
+      break;
+    }
+  }
+  if (entry == &snapshot->files[snapshot->nextFile % FAT_SNAPSHOT_FILES]) {
+    snapshot->nextFile = (snapshot->nextFile + 1) % FAT_SNAPSHOT_FILES;
+  }
+  strcpy(entry->filename, file->filename);
+  entry->rootDirEntry = file->rootDirEntry;
+  snapshot->checksum = CRC_Calc(snapshot,
+      offsetof(FAT_Snapshot, checksum));
+}
 /**
  * @brief Opens a file.
  * @param filename Name of file
@@ -453,7 +811,15 @@ int FAT_OpenFile(const char* filename) {
   strcpy(file.filename, filename);
   println("%s: Opening file %s", __FUNCTION__, filename);
 
-  int id = FAT_FindFile(&file);
+  // check recently opened files first
+  int id = FAT_FindSnapshotFile(&file);
+
+  if (id == -1) {
+    id = FAT_FindFile(&file);
+    if (id != -1) {
+      FAT_SnapshotAddFile(&file);
+    }
+  }
 
   if (id != -1) {
     // copy file information structure
@@ -497,10 +863,70 @@ int FAT_CloseFile(int file) {
   if (openedFiles[file].id == -1) {
     return -1; // EOF for not open file
   }
+  // save pending root dir entry changes
+  FAT_SyncFile(file);
   // close file if no errors
   openedFiles[file].id = -1;
   return file;
 }
+/**
+ * @brief Writes pending changes of a file to disk.
+ *
+ * @details Updates the root directory entry of the file if
+ * it changed since the last update.
+ *
+ * @param file ID of file
+ * @retval 0 File synchronized
+ * @retval -1 Incorrect ID, file not opened or write error
+ */
+int FAT_SyncFile(int file) {
+
+  if (!FAT_IsOpened(file)) {
+    return -1;
+  }
+
+  uint32_t errors = phyStats.phyErrors;
+
+  FAT_FlushSector();
+
+  if (openedFiles[file].dirty) {
+    FAT_UpdateRootEntry(file);
+  } else {
+    FAT_PhyFlush();
+  }
+
+  return phyStats.phyErrors == errors ? 0 : -1;
+}
+/**
+ * @brief Sets when root directory entries of written files are updated.
+ *
+ * @details Root directory entries (file size) are kept in memory and
+ * written when the file is closed or synchronized, or when one of the
+ * given thresholds is exceeded, by one file or by all opened files
+ * together. After a power failure at most bytes of data in all files
+ * or ms milliseconds of writes can be lost from the ends of files.
+ *
+ * @param bytes Number of bytes written after which the entry is updated
+ * (0 - update after every write)
+ * @param ms Time after which the entry is updated (0 - no time limit)
+ */
+void FAT_SetSyncPolicy(uint32_t bytes, uint32_t ms) {
+
+  syncBytes = bytes;
+  syncTime = ms;
+}
+/**
+ * @brief Updates root directory entries which exceeded the time threshold.
+ * @details Run this function periodically in the main loop.
+ */
+void FAT_Update(void) {
+
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    if (openedFiles[i].id != -1) {
+      FAT_CommitIfNeeded(i);
+    }
+  }
+}
 /**
  * @brief Move the read pointer to new location in file
  * @param file File ID
@@ -555,27 +981,79 @@ int FAT_MoveWrPtr(int file, int newWrPtr) {
   openedFiles[file].wrPtr = newWrPtr;
   return newWrPtr;
 }
+/**
+ * @brief Gets size of a file.
+ * @param file File ID
+ * @return Size of file in bytes or -1 if error ocurred.
+ */
+int FAT_GetFileSize(int file) {
+
+  if (!FAT_IsOpened(file)) {
+    return -1;
+  }
+  return openedFiles[file].fileSize;
+}
+/**
+ * @brief Checks if a file ID refers to an opened file.
+ * @param file File ID
+ * @retval 1 File is opened
+ * @retval 0 Incorrect ID or file not opened
+ */
+static uint8_t FAT_IsOpened(int file) {
+
+  // if incorrect file ID
+  if (file < 0 || file >= MAX_OPENED_FILES) {
+    println("Incorrect file ID %d", file);
+    return 0;
+  }
+
+  // File not opened
+  if (openedFiles[file].id == -1) {
+    println("File not open");
+    return 0;
+  }
+
+  return 1;
+}
 /**
  * @brief Reads contents of file.
  * @param file ID of opened file
  * @param data Buffer for storing data
  * @param count Number of bytes to read
- * @return Number of bytes read or -1 for EOF
- * TODO Also read next clusters
+ * @return Number of bytes read or -1 for EOF or read error
  */
 int FAT_ReadFile(int file, uint8_t* data, int count) {
 
   println("%s", __FUNCTION__);
 
-  // if incorrect file ID
-  if (file >= MAX_OPENED_FILES) {
-    println("Maximum number of files open");
+  if (!FAT_IsOpened(file)) {
+    return -1; // EOF for not open file
+  }
+  // We have already reached EOF
+  if (openedFiles[file].rdPtr >= openedFiles[file].fileSize) {
+    println("EOF reached");
     return -1;
   }
 
-  // File not opened
-  if (openedFiles[file].id == -1) {
-    println("File not open");
+  return FAT_ReadData(file, data, count);
+}
+/**
+ * @brief Reads contents of file into several buffers.
+ *
+ * @details The buffers are filled in order, as if they were
+ * one continuous buffer. Whole sectors are read straight into
+ * the buffers using multiple block reads, where possible.
+ *
+ * @param file ID of opened file
+ * @param iov Array of buffers
+ * @param iovcnt Number of buffers
+ * @return Number of bytes read or -1 for EOF or read error
+ */
+int FAT_ReadFileV(int file, const FAT_IoVec* iov, int iovcnt) {
+
+  println("%s", __FUNCTION__);
+
+  if (!FAT_IsOpened(file)) {
     return -1; // EOF for not open file
   }
   // We have already reached EOF
@@ -586,61 +1064,15 @@ int FAT_ReadFile(int file, uint8_t* data, int count) {
 
   int len = 0; // number of bytes read
 
-  // jump to sector where read pointer is at (counting from first sector)
-  // each sector is 512 bytes long
-  uint32_t sectorOffset = openedFiles[file].rdPtr / 512;
-
-  // which cluster from start cluster is the sector at
-  uint32_t clusterOffset = sectorOffset/
-      mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-  // sector to read in the cluster
-  sectorOffset = sectorOffset %
-      mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-
-  // find the cluster number where the data is at
-  uint32_t baseCluster = 0;
-  FAT_GetCluster(openedFiles[file].firstCluster, clusterOffset,
-      &baseCluster);
-  uint32_t baseSector = FAT_Cluster2Sector(baseCluster);
-
-  // add number of sectors in the cluster where data is at
-  baseSector += sectorOffset;
-
-  // read data sector
-  FAT_ReadSector(baseSector);
-
-  // start getting data from read pointer (in the current sector)
-  uint8_t* ptr = buf + openedFiles[file].rdPtr % 512;
-
-  println("%s: reading data", __FUNCTION__);
-  for (int i = 0; i < count; i++) {
-
-    data[i] = *ptr++;
-    openedFiles[file].rdPtr++;
-    len++;
-    // check if EOF reached
-    if (openedFiles[file].rdPtr >= openedFiles[file].fileSize) {
-      println("%s: EOF reached", __FUNCTION__);
-      break;
+  for (int i = 0; i < iovcnt; i++) {
+    int ret = FAT_ReadData(file, iov[i].buf, iov[i].len);
+    if (ret == -1) {
+      return -1;
     }
-    // if sector boundary reached
-    if (openedFiles[file].rdPtr % 512 == 0) {
-      println("%s: read new sector", __FUNCTION__);
-      // increment sector counter
-      sectorOffset++;
-      // which sector in cluster is it
-      sectorOffset = sectorOffset %
-          mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-
-      // if first sector, then read new cluster
-      if (sectorOffset == 0) {
-        println("%s: jump to next cluster", __FUNCTION__);
-        // change cluster to next
-        FAT_GetCluster(baseCluster, 1, &baseCluster);
-      }
-      baseSector = FAT_Cluster2Sector(baseCluster) + sectorOffset;
-      FAT_ReadSector(baseSector);
-      ptr = buf;
+    len += ret;
+    // EOF reached
+    if (ret < iov[i].len) {
+      break;
     }
   }
 
@@ -651,158 +1083,701 @@ int FAT_ReadFile(int file, uint8_t* data, int count) {
  * @param file ID of file, to which we write data.
  * @param data Data to write
  * @param count Number of bytes to write
- * @return Number of bytes written.
- * TODO Make this cross sector and cluster boundaries
- * FIXME For now we can write only up to EOF
+ * @return Number of bytes written or -1 for read or write error
+ * FIXME For now we can write only up to the last allocated cluster
  */
 int FAT_WriteFile(int file, const uint8_t* data, int count) {
 
   println("%s", __FUNCTION__);
 
-  // if incorrect file ID
-  if (file >= MAX_OPENED_FILES) {
-    println("Maximum number of files open");
-    return -1;
-  }
-
-  // File not opened
-  if (openedFiles[file].id == -1) {
-    println("File not open");
+  if (!FAT_IsOpened(file)) {
     return -1; // EOF for not open file
   }
-  // We have already reached EOF
-  // TODO Make this cross EOF - adding more data - change file size in root dir
-  if (openedFiles[file].wrPtr >= openedFiles[file].fileSize) {
-    println("%s: EOF reached", __FUNCTION__);
-
-    // TODO Zero out the bytes between wrPtr and filesize
-    // TODO If new cluster we need to add cluster info in FAT
-  }
-
-  int len = 0; // number of bytes written
-
-  // jump to sector where write pointer is at (counting from first sector)
-  // each sector is 512 bytes long
-  uint32_t sectorOffset = openedFiles[file].wrPtr / 512;
-
-  // which cluster from start cluster is the sector at
-  uint32_t clusterOffset = sectorOffset/
-      mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-  // sector to write in the cluster
-  sectorOffset = sectorOffset %
-      mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-
-  // find the cluster number where the data is at
-  uint32_t baseCluster = 0;
-  FAT_GetCluster(openedFiles[file].firstCluster, clusterOffset,
-      &baseCluster);
-  uint32_t baseSector = FAT_Cluster2Sector(baseCluster);
-
-  // add number of sectors in the cluster where data is at
-  baseSector += sectorOffset;
-
-  // read data sector
-  FAT_ReadSector(baseSector);
-
-  // start writing data from write pointer (in the current sector)
-  uint8_t* ptr = buf + openedFiles[file].wrPtr % 512;
-
-  println("%s: writing data", __FUNCTION__);
-  for (int i = 0; i < count; i++) {
-
-    *ptr++ = data[i];
-    openedFiles[file].wrPtr++;
-    len++;
-
-    // if sector boundary reached
-    if (openedFiles[file].wrPtr % 512 == 0) {
-      println("%s: new sector", __FUNCTION__);
-      FAT_WriteSector(baseSector); // save data
-//      FAT_UpdateRootEntry(file);
-      // increment sector counter
-      sectorOffset++;
-      // which sector in cluster is it
-      sectorOffset = sectorOffset %
-          mountedDisks[0].partitionInfo[0].sectorsPerCluster;
-
-      // if first sector, then read new cluster
-      if (sectorOffset == 0) {
-        println("%s: jump to next cluster", __FUNCTION__);
-
-        if (openedFiles[file].wrPtr >= openedFiles[file].fileSize) {
-          // TODO If new cluster then update FAT
-          //        FAT_UpdateCluster();
-        }
-
-        // change cluster to next
-        FAT_GetCluster(baseCluster, 1, &baseCluster);
-
-      }
-      baseSector = FAT_Cluster2Sector(baseCluster) + sectorOffset;
-      FAT_ReadSector(baseSector);
-      ptr = buf;
-    }
 
-    // check if EOF reached and update file size
-    if (openedFiles[file].wrPtr >= openedFiles[file].fileSize) {
-      // if writing to end of file - increment filesize
-      openedFiles[file].fileSize = openedFiles[file].wrPtr;
-    }
-  }
+  int len = FAT_WriteData(file, data, count);
 
-  FAT_WriteSector(baseSector); // save data
-  FAT_UpdateRootEntry(file);
+  FAT_FlushSector(); // save data
+  FAT_CommitIfNeeded(file);
   return len;
 
 }
 /**
- * @brief Updates the root directory entry of a given file.
+ * @brief Writes data from several buffers to a file.
  *
- * @details This function is called after a write to the file
- * in order to update the timestamp and the file length if
- * necessary.
+ * @details The buffers are written in order, as if they were
+ * one continuous buffer, so a record assembled from a header,
+ * data and trailer costs no more sector writes than a single
+ * buffer would. The root directory entry is updated once per call.
  *
- * @param file File ID
+ * @param file ID of file, to which we write data.
+ * @param iov Array of buffers
+ * @param iovcnt Number of buffers
+ * @return Number of bytes written or -1 for read or write error
  */
-static void FAT_UpdateRootEntry(int file) {
-
-  // cluster of root dir
-  uint32_t currentCluster = mountedDisks[0].partitionInfo[0].rootDirCluster;
-
-  // sector where root dir is at
-  uint32_t sector = FAT_Cluster2Sector(currentCluster);
+int FAT_WriteFileV(int file, const FAT_IoVec* iov, int iovcnt) {
 
-  // every root dir entry is 32 bytes
-  // add sector offset of entry
-  sector += openedFiles[file].rootDirEntry * sizeof(FAT_RootDirEntry) / 512;
-
-  // read sector where entry is at
-
-  FAT_ReadSector(sector);
-  println("%s: Read sector %u", __FUNCTION__, (unsigned int)sector);
+  println("%s", __FUNCTION__);
 
-  // point to entry in the current sector
-//  uint8_t* ptr = buf;
-//  ptr += (openedFiles[file].rootDirEntry * sizeof(FAT_RootDirEntry)) % 512;
+  if (!FAT_IsOpened(file)) {
+    return -1; // EOF for not open file
+  }
 
-  FAT_RootDirEntry* dirEntry = (FAT_RootDirEntry*) buf;
-  println("%s: Dir entry %u", __FUNCTION__,
-      (unsigned int)openedFiles[file].rootDirEntry);
-  dirEntry += openedFiles[file].rootDirEntry;
+  int len = 0; // number of bytes written
 
-  char filename[12];
-  char* namePtr = (char*)dirEntry->filename;
-  // copy filename from directory entry
-  for (int k = 0; k < 11; k++) {
-    filename[k] = *namePtr++;
+  for (int i = 0; i < iovcnt; i++) {
+    int ret = FAT_WriteData(file, iov[i].buf, iov[i].len);
+    if (ret == -1) {
+      len = -1;
+      break;
+    }
+    len += ret;
+    // end of allocated clusters reached
+    if (ret < iov[i].len) {
+      break;
+    }
   }
-  filename[11] = 0; // end string
-  dirEntry->fileSize = openedFiles[file].fileSize;
-
-  println("%s: Updating root entry for file: %s, size %u", __FUNCTION__,
-      filename, (unsigned int)openedFiles[file].fileSize);
 
-  FAT_WriteSector(sector);
+  FAT_FlushSector(); // save data
+  FAT_CommitIfNeeded(file);
+  return len;
+}
+/**
+ * @brief Gets physical layer access statistics.
+ * @param stats Structure for statistics (function writes this)
+ */
+void FAT_GetStats(FAT_Stats* stats) {
+
+  *stats = phyStats;
+}
+/**
+ * @brief Zeroes out physical layer access statistics.
+ */
+void FAT_ResetStats(void) {
+
+  memset(&phyStats, 0, sizeof(phyStats));
+}
+/**
+ * @brief Measures fragmentation of an opened file.
+ * @param file File ID
+ * @param info Fragmentation of file (function writes this)
+ * @retval 0 Fragmentation measured
+ * @retval -1 Incorrect ID or file not opened
+ */
+int FAT_GetFragmentation(int file, FAT_Fragmentation* info) {
+
+  if (!FAT_IsOpened(file)) {
+    return -1;
+  }
+  FAT_GetChainInfo(openedFiles[file].firstCluster, info);
+  info->fileSize = openedFiles[file].fileSize;
+  return 0;
+}
+/**
+ * @brief Reports fragmentation of files and of free space.
+ *
+ * @details Calls fileFunc for every file in the root directory. Free
+ * space is measured by reading the whole FAT, which takes a while
+ * on large volumes.
+ *
+ * @param fileFunc Function called for every file (0 - files are not reported)
+ * @param freeSpace Contiguity of free space (function writes this,
+ * 0 - free space is not measured)
+ * @retval 0 Contiguity reported
+ * @retval -1 Read error
+ */
+int8_t FAT_ReportContiguity(void (*fileFunc)(const char* filename,
+    const FAT_Fragmentation* info), FAT_FreeSpace* freeSpace) {
+
+  FAT_PartitionInfo* part = &mountedDisks[0].partitionInfo[0];
+  FAT_RootDirEntry entry;
+  FAT_Fragmentation info;
+  uint32_t index = 0;
+  char filename[12];
+  int ret = -1;
+
+  while (fileFunc && !(ret = FAT_NextDirEntry(&index, &entry))) {
+    memcpy(filename, entry.filename, 11);
+    filename[11] = 0;
+    FAT_GetChainInfo(((uint32_t)entry.firstClusterH << 16) | entry.firstClusterL,
+        &info);
+    info.fileSize = entry.fileSize;
+    fileFunc(filename, &info);
+  }
+  if (ret == -2) {
+    return -1;
+  }
+
+  if (!freeSpace) {
+    return 0;
+  }
+  memset(freeSpace, 0, sizeof(FAT_FreeSpace));
+  freeSpace->clusters = part->clusterCount;
+  freeSpace->clusterSize = part->sectorsPerCluster * part->bytesPerSector;
+
+  uint32_t run = 0;
+  for (uint32_t cluster = 2; cluster < part->clusterCount + 2; cluster++) {
+    if (FAT_ReadSector(FAT_EntrySector(cluster))) {
+      return -1;
+    }
+    if ((((uint32_t*)buf)[cluster % 128] & 0x0fffffff) != 0) {
+      run = 0;
+      continue;
+    }
+    freeSpace->freeClusters++;
+    if (run++ == 0) {
+      freeSpace->freeRuns++;
+    }
+    if (run > freeSpace->largestFreeRun) {
+      freeSpace->largestFreeRun = run;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Starts defragmenting a file.
+ *
+ * @details The file is moved to the first run of free clusters long
+ * enough to hold it, in steps done by FAT_DefragStep. A file opened
+ * with a root dir entry not yet updated is not moved, and writing the
+ * file before it is switched to the new clusters aborts defragmenting.
+ * Opened files are switched to the new clusters. Subdirectories are
+ * not moved.
+ *
+ * @param filename Name of file in root directory (0 - most fragmented file)
+ * @retval 0 Defragmenting started
+ * @retval 1 File is not fragmented
+ * @retval -1 Error: file not found, read error, file has pending writes
+ * or defragmenting in progress
+ */
+int8_t FAT_DefragFile(const char* filename) {
+
+  FAT_RootDirEntry entry;
+  FAT_Fragmentation info;
+  uint32_t index = 0;
+  uint32_t fragments = 0;
+  int found = 0;
+  int ret;
+
+  if (defrag.state != FAT_DEFRAG_IDLE) {
+    println("%s: Defragmenting in progress", __FUNCTION__);
+    return -1;
+  }
+
+  // a chain cut short by a read error would move only part of a file
+  uint32_t errors = phyStats.phyErrors;
+
+  while (!(ret = FAT_NextDirEntry(&index, &entry))) {
+    if ((entry.attributes & 0x10) ||
+        (filename && memcmp(entry.filename, filename, 11))) {
+      continue;
+    }
+    uint32_t cluster = ((uint32_t)entry.firstClusterH << 16) | entry.firstClusterL;
+    FAT_GetChainInfo(cluster, &info);
+    if (filename || info.fragments > fragments) {
+      found = 1;
+      fragments = info.fragments;
+      defrag.rootDirEntry = index - 1;
+      defrag.firstCluster = cluster;
+      defrag.clusters = info.clusters;
+    }
+    if (filename) {
+      break;
+    }
+  }
+
+  if (!found || ret == -2 || phyStats.phyErrors != errors) {
+    println("%s: File not found or not read", __FUNCTION__);
+    return -1;
+  }
+  if (fragments <= 1) {
+    println("%s: File is not fragmented", __FUNCTION__);
+    return 1;
+  }
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    FAT_File* f = &openedFiles[i];
+    if (f->id != -1 && f->rootDirEntry == defrag.rootDirEntry && f->dirty) {
+      println("%s: File has pending writes", __FUNCTION__);
+      return -1;
+    }
+  }
+
+  println("%s: Moving %u clusters in %u fragments", __FUNCTION__,
+      (unsigned int)defrag.clusters, (unsigned int)fragments);
+  defrag.state = FAT_DEFRAG_FIND_RUN;
+  defrag.cluster = 2;
+  defrag.runLength = 0;
+  defrag.failed = 0;
+  defrag.written = 0;
+  return 0;
+}
+/**
+ * @brief Does one step of defragmenting.
+ *
+ * @details Every step does a bounded amount of work: it searches or
+ * frees FAT_DEFRAG_FAT_SECTORS sectors of FAT, copies FAT_DEFRAG_SECTORS
+ * sectors of data, or writes one sector of FAT or root directory.
+ * Run it in the main loop when there is time to spare.
+ *
+ * The data is copied first, then the new chain is written to all FATs,
+ * then the root dir entry is pointed to it and only then the old chain
+ * is freed. A power failure or a write error leaves the file intact,
+ * at worst with clusters of the chains allocated but not used by any file.
+ *
+ * @retval 1 Defragmenting in progress
+ * @retval 0 Defragmenting finished or not started
+ * @retval -1 Defragmenting failed, file intact
+ */
+int8_t FAT_DefragStep(void) {
+
+  FAT_PartitionInfo* part = &mountedDisks[0].partitionInfo[0];
+
+  // data written to the old chain would not be in the new one
+  if (defrag.written && defrag.state != FAT_DEFRAG_IDLE &&
+      defrag.state != FAT_DEFRAG_FREE) {
+    println("%s: File written, moving aborted", __FUNCTION__);
+    defrag.written = 0;
+    if (defrag.state < FAT_DEFRAG_LINK) {
+      defrag.state = FAT_DEFRAG_IDLE; // nothing written to FAT yet
+      return -1;
+    }
+    defrag.failed = 1; // free the clusters linked so far
+    defrag.cluster = defrag.runStart;
+    defrag.state = FAT_DEFRAG_FREE;
+    return 1;
+  }
+
+  switch (defrag.state) {
+
+  case FAT_DEFRAG_IDLE:
+    return 0;
+
+  case FAT_DEFRAG_FIND_RUN:
+    for (int i = 0; i < FAT_DEFRAG_FAT_SECTORS; i++) {
+      if (defrag.cluster >= part->clusterCount + 2) {
+        println("%s: No free run of %u clusters", __FUNCTION__,
+            (unsigned int)defrag.clusters);
+        defrag.state = FAT_DEFRAG_IDLE;
+        return -1;
+      }
+      // check the entries in one sector of FAT
+      if (FAT_ReadSector(FAT_EntrySector(defrag.cluster))) {
+        defrag.state = FAT_DEFRAG_IDLE;
+        return -1;
+      }
+      do {
+        if ((((uint32_t*)buf)[defrag.cluster % 128] & 0x0fffffff) != 0) {
+          defrag.runLength = 0;
+        } else if (defrag.runLength++ == 0) {
+          defrag.runStart = defrag.cluster;
+        }
+        defrag.cluster++;
+        if (defrag.runLength == defrag.clusters) {
+          println("%s: Free run found at cluster %u", __FUNCTION__,
+              (unsigned int)defrag.runStart);
+          defrag.state = FAT_DEFRAG_COPY;
+          defrag.cluster = defrag.firstCluster;
+          defrag.clusterOffset = 0;
+          defrag.done = 0;
+          return 1;
+        }
+      } while (defrag.cluster % 128 && defrag.cluster < part->clusterCount + 2);
+    }
+    return 1;
+
+  case FAT_DEFRAG_COPY:
+    FAT_DefragCopy();
+    if (defrag.failed) {
+      defrag.state = FAT_DEFRAG_IDLE; // nothing written to FAT yet
+      return -1;
+    }
+    if (defrag.done == defrag.clusters * part->sectorsPerCluster) {
+      defrag.state = FAT_DEFRAG_LINK;
+      defrag.done = 0;
+    }
+    return 1;
+
+  case FAT_DEFRAG_LINK:
+  {
+    // link the clusters with entries in one sector of FAT
+    uint32_t cluster = defrag.runStart + defrag.done;
+    if (FAT_ReadSector(FAT_EntrySector(cluster))) {
+      defrag.state = FAT_DEFRAG_IDLE; // linked clusters are lost
+      return -1;
+    }
+    do {
+      defrag.done++;
+      FAT_SetEntryInBuffer(cluster, defrag.done == defrag.clusters ?
+          FAT_LAST_CLUSTER : cluster + 1);
+      cluster++;
+    } while (defrag.done < defrag.clusters && cluster % 128);
+    if (FAT_WriteFATSector()) {
+      defrag.failed = 1; // free the clusters linked so far
+      defrag.cluster = defrag.runStart;
+      defrag.state = FAT_DEFRAG_FREE;
+      return 1;
+    }
+    if (defrag.done == defrag.clusters) {
+      defrag.state = FAT_DEFRAG_SWITCH;
+    }
+    return 1;
+  }
+
+  case FAT_DEFRAG_SWITCH:
+    if (FAT_DefragSwitch()) {
+      println("%s: Both chains left allocated", __FUNCTION__);
+      defrag.state = FAT_DEFRAG_IDLE;
+      return -1;
+    }
+    defrag.state = FAT_DEFRAG_FREE;
+    return 1;
+
+  case FAT_DEFRAG_FREE:
+    for (int i = 0; i < FAT_DEFRAG_FAT_SECTORS; i++) {
+      // free the clusters with entries in one sector of FAT
+      uint32_t sector = FAT_EntrySector(defrag.cluster);
+      uint32_t entry;
+      if (FAT_ReadSector(sector)) {
+        println("%s: Old clusters left allocated", __FUNCTION__);
+        defrag.state = FAT_DEFRAG_IDLE;
+        return defrag.failed ? -1 : 0;
+      }
+      do {
+        entry = ((uint32_t*)buf)[defrag.cluster % 128];
+        FAT_SetEntryInBuffer(defrag.cluster, 0);
+        defrag.cluster = entry & 0x0fffffff;
+      } while (!FAT_IS_LAST_CLUSTER(entry) && defrag.cluster >= 2 &&
+          FAT_EntrySector(defrag.cluster) == sector);
+      if (FAT_WriteFATSector()) {
+        println("%s: Old clusters left allocated", __FUNCTION__);
+        defrag.state = FAT_DEFRAG_IDLE;
+        return -1;
+      }
+      if (FAT_IS_LAST_CLUSTER(entry) || defrag.cluster < 2) {
+        defrag.state = FAT_DEFRAG_IDLE;
+        println("%s: Finished", __FUNCTION__);
+        return defrag.failed ? -1 : 0;
+      }
+    }
+    return 1;
+  }
+
+  return 0;
+}
+/**
+ * @brief Finds the sectors on disk holding a given byte of a file.
+ *
+ * @details Consecutive clusters of the chain are merged, so the
+ * returned run may span more than one cluster. The last cluster
+ * found is remembered in the file structure, so sequential access
+ * does not walk the cluster chain from the start of the file.
+ *
+ * @param file File ID
+ * @param pos Byte position in file
+ * @param sector Sector holding the byte (function writes this)
+ * @param maxSectors Number of sectors the caller wants to access
+ * @return Number of consecutive sectors on disk starting at sector
+ * (0 if position lies beyond the cluster chain)
+ */
+static uint32_t FAT_LocateSector(int file, uint32_t pos, uint32_t* sector,
+    uint32_t maxSectors) {
+
+  FAT_File* f = &openedFiles[file];
+  uint32_t sectorsPerCluster = mountedDisks[0].partitionInfo[0].sectorsPerCluster;
+
+  // empty files have no clusters
+  if (f->firstCluster < 2) {
+    return 0;
+  }
+
+  // sector from start of file and cluster from start of file
+  uint32_t sectorOffset = pos / 512;
+  uint32_t clusterOffset = sectorOffset / sectorsPerCluster;
+  sectorOffset = sectorOffset % sectorsPerCluster;
+
+  // start searching from last found cluster if possible
+  uint32_t cluster = f->firstCluster;
+  uint32_t skip = clusterOffset;
+
+  if (clusterOffset >= f->lastClusterOffset) {
+    cluster = f->lastCluster;
+    skip = clusterOffset - f->lastClusterOffset;
+  }
+
+  if ((uint32_t)FAT_GetCluster(cluster, skip, &cluster) != skip ||
+      FAT_IS_LAST_CLUSTER(cluster)) {
+    println("%s: End of cluster chain", __FUNCTION__);
+    return 0;
+  }
+
+  f->lastCluster = cluster;
+  f->lastClusterOffset = clusterOffset;
+
+  *sector = FAT_Cluster2Sector(cluster) + sectorOffset;
+  uint32_t count = sectorsPerCluster - sectorOffset;
+
+  // merge following clusters if they are consecutive on disk
+  // (the last found cluster stays at pos, the next call may start there)
+  while (count < maxSectors) {
+    uint32_t next = FAT_GetEntryInFAT(cluster) & 0x0fffffff;
+    if (next != cluster + 1) {
+      break;
+    }
+    cluster = next;
+    count += sectorsPerCluster;
+  }
+
+  return count;
+}
+/**
+ * @brief Reads data from file starting at the read pointer.
+ *
+ * @details Partial sectors go through the sector buffer,
+ * whole sectors are read directly into the data buffer.
+ *
+ * @param file ID of opened file
+ * @param data Buffer for storing data
+ * @param count Number of bytes to read
+ * @return Number of bytes read or -1 for read error
+ */
+static int FAT_ReadData(int file, uint8_t* data, int count) {
+
+  FAT_File* f = &openedFiles[file];
+  int len = 0; // number of bytes read
+
+  // don't read beyond EOF
+  if (count <= 0 || f->rdPtr >= f->fileSize) {
+    return 0;
+  }
+  if ((uint32_t)count > f->fileSize - f->rdPtr) {
+    count = f->fileSize - f->rdPtr;
+  }
+
+  while (count > 0) {
+
+    uint32_t sector;
+    uint32_t offset = f->rdPtr % 512;
+    // a partial sector never needs the following clusters
+    uint32_t sectors = FAT_LocateSector(file, f->rdPtr, &sector,
+        (offset == 0 && count >= 512) ? count / 512 : 1);
+    uint32_t n; // bytes transferred in this step
+
+    // chain ends before file size - FAT not read or broken
+    if (sectors == 0) {
+      return -1;
+    }
+
+    if (offset == 0 && count >= 512) {
+      // whole sectors - one multiple block read into user buffer
+      if (sectors > (uint32_t)count / 512) {
+        sectors = count / 512;
+      }
+      FAT_InvalidateSectors(sector, sectors, 1);
+      if (FAT_PhyRead(data, sector, sectors)) {
+        return -1;
+      }
+      n = sectors * 512;
+    } else {
+      // partial sector - go through buffer
+      if (FAT_ReadSector(sector)) {
+        return -1;
+      }
+      n = 512 - offset;
+      if (n > (uint32_t)count) {
+        n = count;
+      }
+      memcpy(data, buf + offset, n);
+    }
+
+    data += n;
+    count -= n;
+    len += n;
+    f->rdPtr += n;
+  }
+
+  return len;
+}
+/**
+ * @brief Writes data to file starting at the write pointer.
+ *
+ * @details Partial sectors are assembled in the sector buffer
+ * and written when the buffer is needed for another sector or
+ * flushed. Whole sectors are written directly from the data buffer.
+ * The root directory entry is not updated.
+ *
+ * @param file ID of opened file
+ * @param data Data to write
+ * @param count Number of bytes to write
+ * @return Number of bytes written or -1 for read or write error
+ */
+static int FAT_WriteData(int file, const uint8_t* data, int count) {
+
+  FAT_File* f = &openedFiles[file];
+  int len = 0; // number of bytes written
+  uint8_t error = 0;
+
+  // the file keeps its old chain if it is being moved (FAT_DefragStep)
+  if (count > 0 && defrag.state != FAT_DEFRAG_IDLE &&
+      defrag.state != FAT_DEFRAG_FREE && f->rootDirEntry == defrag.rootDirEntry) {
+    defrag.written = 1;
+  }
+
+  while (count > 0) {
+
+    uint32_t sector;
+    uint32_t offset = f->wrPtr % 512;
+    // a partial sector never needs the following clusters
+    uint32_t sectors = FAT_LocateSector(file, f->wrPtr, &sector,
+        (offset == 0 && count >= 512) ? count / 512 : 1);
+    uint32_t n; // bytes transferred in this step
+
+    // TODO If new cluster we need to add cluster info in FAT
+    if (sectors == 0) {
+      break;
+    }
+
+    if (offset == 0 && count >= 512) {
+      // whole sectors - one multiple block write from user buffer
+      if (sectors > (uint32_t)count / 512) {
+        sectors = count / 512;
+      }
+      FAT_InvalidateSectors(sector, sectors, 0);
+      if (FAT_PhyWrite((uint8_t*)data, sector, sectors)) {
+        error = 1;
+        break;
+      }
+      n = sectors * 512;
+    } else {
+      // partial sector - modify buffer
+      if (FAT_ReadSector(sector)) {
+        error = 1;
+        break;
+      }
+      n = 512 - offset;
+      if (n > (uint32_t)count) {
+        n = count;
+      }
+      memcpy(buf + offset, data, n);
+      bufDirty = 1;
+    }
+
+    data += n;
+    count -= n;
+    len += n;
+    f->wrPtr += n;
+
+    // if writing to end of file - increment filesize
+    if (f->wrPtr > f->fileSize) {
+      f->fileSize = f->wrPtr;
+      // root dir entry has to be updated
+      if (!f->dirty) {
+        f->dirty = 1;
+        f->dirtyTime = TIMER_GetTime();
+      }
+    }
+  }
+
+  phyStats.bytesWritten += len;
+
+  if (f->dirty) {
+    f->dirtyBytes += len;
+  }
+
+  return error ? -1 : len;
+}
+/**
+ * @brief Updates the root directory entry of a file if a threshold was exceeded.
+ *
+ * @details Pending entries of all opened files are updated as well
+ * when together they cover more than the byte threshold (several files
+ * written in turns, each below the threshold), so at most that much
+ * data in total can be lost.
+ *
+ * @param file File ID
+ */
+static void FAT_CommitIfNeeded(int file) {
+
+  FAT_File* f = &openedFiles[file];
+  uint32_t pending = 0; // bytes not covered by entries of all files
+
+  if (f->dirty && (f->dirtyBytes >= syncBytes ||
+      (syncTime != 0 && TIMER_DelayTimer(syncTime, f->dirtyTime)))) {
+    FAT_UpdateRootEntry(file);
+  }
+
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    if (openedFiles[i].id != -1 && openedFiles[i].dirty) {
+      pending += openedFiles[i].dirtyBytes;
+    }
+  }
+  if (pending < syncBytes) {
+    return;
+  }
+  println("%s: %u bytes pending in all files", __FUNCTION__,
+      (unsigned int)pending);
+  // entries in the same sector are updated together
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    if (openedFiles[i].id != -1 && openedFiles[i].dirty) {
+      FAT_UpdateRootEntry(i);
+    }
+  }
+}
+/**
+ * @brief Updates the root directory entry of a given file.
+ *
+ * @details This function is called after writes to the file
+ * in order to update the file length if necessary. Other
+ * opened files with pending changes, whose entries are in the
+ * same sector, are updated with the same sector write.
+ *
+ * @param file File ID
+ */
+static void FAT_UpdateRootEntry(int file) {
+
+  // cluster of root dir
+  uint32_t currentCluster = mountedDisks[0].partitionInfo[0].rootDirCluster;
+
+  // sector where root dir is at
+  uint32_t firstSector = FAT_Cluster2Sector(currentCluster);
+
+  // every root dir entry is 32 bytes, 16 entries in sector
+  // add sector offset of entry
+  uint32_t sector = firstSector + openedFiles[file].rootDirEntry / 16;
+
+  // read sector where entry is at, entries stay pending if it fails
+  if (FAT_ReadSector(sector)) {
+    return;
+  }
+  println("%s: Read sector %u", __FUNCTION__, (unsigned int)sector);
+
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+
+    FAT_File* f = &openedFiles[i];
+
+    if (i != file && (f->id == -1 || !f->dirty ||
+        firstSector + f->rootDirEntry / 16 != sector)) {
+      continue;
+    }
+
+    // point to entry in the current sector
+    FAT_RootDirEntry* dirEntry = (FAT_RootDirEntry*) buf;
+    dirEntry += f->rootDirEntry % 16;
+
+    dirEntry->fileSize = f->fileSize;
+
+    println("%s: Updating root entry %u, size %u", __FUNCTION__,
+        (unsigned int)f->rootDirEntry, (unsigned int)f->fileSize);
+
+    f->dirty = 0;
+    f->dirtyBytes = 0;
+  }
+
+  // layers below may reorder writes, so data covered by the new
+  // sizes reaches the drive before the entry does
+  FAT_PhyFlush();
+  phyStats.dirWrites++;
+  FAT_WriteSector(sector);
+  // the file size on the drive covers data written so far
+  FAT_PhyFlush();
 }
 /**
  * @brief Gets number of cluster clusterOffset in a file
@@ -823,7 +1798,7 @@ static int FAT_GetCluster(uint32_t firstCluster, uint32_t clusterOffset,
   for (i = 0; i < clusterOffset; i++) {
     entry = FAT_GetEntryInFAT(entry);
     // last cluster reached before we reached clusterOffset
-    if (entry == 0xFFFFFFFF) {
+    if (FAT_IS_LAST_CLUSTER(entry)) {
       *clusterNumber = entry; // return the entry
       return i;
     }
@@ -851,7 +1826,7 @@ static uint32_t FAT_Cluster2Sector(uint32_t cluster) {
 /**
  * @brief Gets FAT entry for given cluster
  * @param cluster Cluster number
- * @return FAT entry for given cluster
+ * @return FAT entry for given cluster (FAT_LAST_CLUSTER if FAT was not read)
  */
 static uint32_t FAT_GetEntryInFAT(uint32_t cluster) {
 
@@ -866,13 +1841,15 @@ static uint32_t FAT_GetEntryInFAT(uint32_t cluster) {
 
 //  uint8_t buf[512]; // buffer for sector data
 
-  // read sector where FAT entry is at
+  // read sector where FAT entry is at, chain ends if it fails
 //  phyCallbacks.phyReadSectors(buf, sector, 1);
-  FAT_ReadSector(sector);
+  if (FAT_ReadSector(sector)) {
+    return FAT_LAST_CLUSTER;
+  }
 
   // the byte number of the entry in the given sector is the remainder
   // of the previous calculation
-  uint8_t offset = (cluster*4) % mountedDisks[0].partitionInfo[0].bytesPerSector;
+  uint32_t offset = (cluster*4) % mountedDisks[0].partitionInfo[0].bytesPerSector;
 
   // the 4-byte entry is at offset
   uint32_t* ret = (uint32_t*)(buf+offset);
@@ -971,14 +1948,7 @@ static int FAT_FindFile(FAT_File* file) {
     if (!strcmp(filename, file->filename)) {
 
       // get all the relevant information about the file
-      file->firstCluster = (((uint32_t)(dirEntry->firstClusterH))<<16) |
-          (uint32_t)dirEntry->firstClusterL;
-      file->fileSize = dirEntry->fileSize;
-      file->attributes = dirEntry->attributes;
-      file->lastModifiedTime = dirEntry->lastModifiedTime;
-      file->lastModifiedDate = dirEntry->lastModifiedDate;
-      file->id = FAT_GetNextId();
-      file->rootDirEntry = i-1;
+      FAT_LoadEntry(file, dirEntry, i-1);
       println("%s, File root dir entry = %u", __FUNCTION__,
           (unsigned int)file->rootDirEntry);
 
@@ -988,9 +1958,6 @@ static int FAT_FindFile(FAT_File* file) {
       FAT_TimeFormat time;
       time.time = file->lastModifiedTime;
 
-      file->rdPtr = 0; // start reading from 1st byte
-      file->wrPtr = 0; // start writing from 1st byte
-
       println("%s: Found file %s of size %u, ID = %u!!!",
           __FUNCTION__, file->filename, (unsigned int)file->fileSize,
           (unsigned int)file->id);
@@ -1024,6 +1991,296 @@ static int FAT_FindFile(FAT_File* file) {
 
   return -1;
 }
+/**
+ * @brief Finds a file among files remembered in the snapshot.
+ *
+ * @details Only the root dir sector holding the remembered entry
+ * is read. The entry is used if it still holds the file.
+ *
+ * @param file Name of the file
+ * @return ID of file or -1 if not found or not read.
+ */
+static int FAT_FindSnapshotFile(FAT_File* file) {
+
+  if (!snapshot || snapshot->magic != FAT_SNAPSHOT_MAGIC) {
+    return -1;
+  }
+
+  for (int i = 0; i < FAT_SNAPSHOT_FILES; i++) {
+
+    uint32_t entry = snapshot->files[i].rootDirEntry;
+
+    if (strcmp(snapshot->files[i].filename, file->filename) ||
+        entry / 16 >= mountedDisks[0].partitionInfo[0].sectorsPerCluster) {
+      continue;
+    }
+
+    if (FAT_ReadSector(mountedDisks[0].partitionInfo[0].rootDirSector +
+        entry / 16)) {
+      return -1;
+    }
+    FAT_RootDirEntry* dirEntry = (FAT_RootDirEntry*)buf + entry % 16;
+
+    if (dirEntry->filename[0] == 0x00 || dirEntry->filename[0] == 0xe5 ||
+        dirEntry->attributes == 0x0f ||
+        memcmp(dirEntry->filename, file->filename, 11)) {
+      println("%s: Entry of file %s changed", __FUNCTION__, file->filename);
+      return -1;
+    }
+
+    FAT_LoadEntry(file, dirEntry, entry);
+    println("%s: Found file %s of size %u, ID = %u",
+        __FUNCTION__, file->filename, (unsigned int)file->fileSize,
+        (unsigned int)file->id);
+
+    return file->id;
+  }
+
+  return -1;
+}
+/**
+ * @brief Fills file structure from a root dir entry.
+ * @param file File structure (function writes this)
+ * @param dirEntry Root dir entry of file
+ * @param rootDirEntry Number of root dir entry
+ */
+static void FAT_LoadEntry(FAT_File* file, const FAT_RootDirEntry* dirEntry,
+    uint32_t rootDirEntry) {
+
+  file->firstCluster = (((uint32_t)(dirEntry->firstClusterH))<<16) |
+      (uint32_t)dirEntry->firstClusterL;
+  file->fileSize = dirEntry->fileSize;
+  file->attributes = dirEntry->attributes;
+  file->lastModifiedTime = dirEntry->lastModifiedTime;
+  file->lastModifiedDate = dirEntry->lastModifiedDate;
+  file->id = FAT_GetNextId();
+  file->rootDirEntry = rootDirEntry;
+
+  file->rdPtr = 0; // start reading from 1st byte
+  file->wrPtr = 0; // start writing from 1st byte
+  file->lastCluster = file->firstCluster;
+  file->lastClusterOffset = 0;
+  file->dirty = 0;
+  file->dirtyBytes = 0;
+}
+/**
+ * @brief Measures fragmentation of a cluster chain.
+ * @param firstCluster First cluster of chain (0 - empty file)
+ * @param info Fragmentation (function writes clusters and fragments)
+ */
+static void FAT_GetChainInfo(uint32_t firstCluster, FAT_Fragmentation* info) {
+
+  uint32_t cluster = firstCluster;
+
+  info->clusters = 0;
+  info->fragments = 0;
+
+  if (cluster < 2) {
+    return;
+  }
+  info->fragments = 1;
+
+  // stop on broken chains running in a loop
+  while (info->clusters <= mountedDisks[0].partitionInfo[0].clusterCount) {
+    uint32_t entry = FAT_GetEntryInFAT(cluster);
+    info->clusters++;
+    if (FAT_IS_LAST_CLUSTER(entry) || (entry & 0x0fffffff) < 2) {
+      break;
+    }
+    if ((entry & 0x0fffffff) != cluster + 1) {
+      info->fragments++;
+    }
+    cluster = entry & 0x0fffffff;
+  }
+}
+/**
+ * @brief Gets the next used entry of the root directory.
+ *
+ * @details Only the first cluster of the root directory is searched,
+ * as in FAT_FindFile. Long name entries and the volume label
+ * are skipped.
+ *
+ * @param index Number of entry to start from (function moves it past
+ * the returned entry)
+ * @param entry Root dir entry (function writes this)
+ * @retval 0 Entry found
+ * @retval -1 No more entries
+ * @retval -2 Read error
+ */
+static int FAT_NextDirEntry(uint32_t* index, FAT_RootDirEntry* entry) {
+
+  uint32_t entries = 16 * mountedDisks[0].partitionInfo[0].sectorsPerCluster;
+
+  while (*index < entries) {
+
+    if (FAT_ReadSector(mountedDisks[0].partitionInfo[0].rootDirSector + *index / 16)) {
+      return -2;
+    }
+    FAT_RootDirEntry* dirEntry = (FAT_RootDirEntry*)buf + *index % 16;
+    (*index)++;
+
+    if (dirEntry->filename[0] == 0x00) {
+      // last root dir entry
+      *index = entries;
+      break;
+    }
+    if (dirEntry->filename[0] == 0xe5 || dirEntry->attributes == 0x0f ||
+        (dirEntry->attributes & 0x08)) {
+      continue;
+    }
+    *entry = *dirEntry;
+    return 0;
+  }
+  return -1;
+}
+/**
+ * @brief Gets the sector of the first FAT holding the entry of a cluster.
+ * @param cluster Cluster number
+ * @return Sector number
+ */
+static uint32_t FAT_EntrySector(uint32_t cluster) {
+
+  return mountedDisks[0].partitionInfo[0].startFatSector + cluster / 128;
+}
+/**
+ * @brief Changes the entry of a cluster in the FAT sector held in buffer.
+ * @details The upper 4 reserved bits of the entry are kept.
+ * @param cluster Cluster number
+ * @param value New entry
+ */
+static void FAT_SetEntryInBuffer(uint32_t cluster, uint32_t value) {
+
+  uint32_t* entry = (uint32_t*)buf + cluster % 128;
+
+  *entry = (*entry & 0xf0000000) | (value & 0x0fffffff);
+}
+/**
+ * @brief Writes the FAT sector held in buffer to all copies of FAT.
+ * @retval 0 Sector written to all copies
+ * @retval 1 Write error
+ */
+static uint8_t FAT_WriteFATSector(void) {
+
+  uint32_t sector = sectInBuffer;
+  uint8_t error = 0;
+
+  error |= FAT_WriteSector(sector);
+  for (uint32_t i = 1; i < mountedDisks[0].partitionInfo[0].numberOfFATs; i++) {
+    error |= FAT_PhyWrite(buf, sector + i * mountedDisks[0].partitionInfo[0].sectorsPerFAT, 1);
+  }
+  return error;
+}
+/**
+ * @brief Copies the next FAT_DEFRAG_SECTORS sectors of a file being defragmented.
+ *
+ * @details Sectors of consecutive clusters are read with one command,
+ * all sectors are written with one command. If a read or the write
+ * fails, defragmenting fails before anything is written to FAT.
+ */
+static void FAT_DefragCopy(void) {
+
+  uint32_t sectorsPerCluster = mountedDisks[0].partitionInfo[0].sectorsPerCluster;
+  uint32_t total = defrag.clusters * sectorsPerCluster;
+  uint32_t n = 0; // sectors in defragBuf
+
+  while (n < FAT_DEFRAG_SECTORS && defrag.done + n < total) {
+
+    uint32_t room = FAT_DEFRAG_SECTORS - n;
+    uint32_t sector = FAT_Cluster2Sector(defrag.cluster) + defrag.clusterOffset;
+    uint32_t count = 0;
+
+    if (room > total - defrag.done - n) {
+      room = total - defrag.done - n;
+    }
+
+    // take sectors until the run of consecutive clusters ends
+    while (1) {
+      uint32_t take = sectorsPerCluster - defrag.clusterOffset;
+      if (take > room - count) {
+        take = room - count;
+      }
+      count += take;
+      defrag.clusterOffset += take;
+      if (defrag.clusterOffset < sectorsPerCluster) {
+        break;
+      }
+      uint32_t next = FAT_GetEntryInFAT(defrag.cluster) & 0x0fffffff;
+      uint8_t consecutive = (next == defrag.cluster + 1);
+      defrag.cluster = next;
+      defrag.clusterOffset = 0;
+      if (!consecutive || count == room) {
+        break;
+      }
+    }
+
+    FAT_InvalidateSectors(sector, count, 1);
+    if (FAT_PhyRead(defragBuf + n * 512, sector, count)) {
+      defrag.failed = 1;
+      return;
+    }
+    n += count;
+  }
+
+  uint32_t dest = FAT_Cluster2Sector(defrag.runStart) + defrag.done;
+  FAT_InvalidateSectors(dest, n, 0);
+  if (FAT_PhyWrite(defragBuf, dest, n)) {
+    defrag.failed = 1;
+    return;
+  }
+  defrag.done += n;
+}
+/**
+ * @brief Points the root dir entry of a file being defragmented to the new chain.
+ *
+ * @details If the copied clusters cannot be flushed or the entry no
+ * longer holds the old chain, the new chain is freed instead of the
+ * old one. If the entry cannot be written, it may hold either chain,
+ * so neither is freed.
+ *
+ * @retval 0 Chain to free is in defrag.cluster
+ * @retval 1 Entry not written
+ */
+static uint8_t FAT_DefragSwitch(void) {
+
+  uint32_t sector = mountedDisks[0].partitionInfo[0].rootDirSector +
+      defrag.rootDirEntry / 16;
+
+  // copied clusters reach the drive before the entry points to them
+  uint8_t error = FAT_PhyFlush();
+
+  error |= FAT_ReadSector(sector);
+  FAT_RootDirEntry* dirEntry = (FAT_RootDirEntry*)buf + defrag.rootDirEntry % 16;
+
+  if (error || (((uint32_t)dirEntry->firstClusterH << 16) |
+      dirEntry->firstClusterL) != defrag.firstCluster) {
+    println("%s: Root dir entry changed or not read", __FUNCTION__);
+    defrag.failed = 1;
+    defrag.cluster = defrag.runStart;
+    return 0;
+  }
+
+  dirEntry->firstClusterH = defrag.runStart >> 16;
+  dirEntry->firstClusterL = defrag.runStart & 0xffff;
+  phyStats.dirWrites++;
+  // the entry reaches the drive before the old chain is freed
+  if (FAT_WriteSector(sector) || FAT_PhyFlush()) {
+    println("%s: Root dir entry not written", __FUNCTION__);
+    defrag.failed = 1;
+    return 1;
+  }
+
+  // opened copies of the file use the new chain
+  for (int i = 0; i < MAX_OPENED_FILES; i++) {
+    FAT_File* f = &openedFiles[i];
+    if (f->id != -1 && f->rootDirEntry == defrag.rootDirEntry) {
+      f->firstCluster = defrag.runStart;
+      f->lastCluster = defrag.runStart;
+      f->lastClusterOffset = 0;
+    }
+  }
+  defrag.cluster = defrag.firstCluster;
+  return 0;
+}
 /**
  * @brief Finds next free ID of file.
  * @return File ID or -1 if no free left.
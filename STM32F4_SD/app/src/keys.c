@@ -16,9 +16,9 @@
  */
 
 #include <keys.h>
-#include <timers.h>
-#include <stdio.h>
 #include <keys_hal.h>
+#include <fifo.h>
+#include <stdio.h>
 
 #ifndef DEBUG
   #define DEBUG
@@ -37,99 +37,216 @@
  * @{
  */
 
-#define DEBOUNCE_TIME 200 ///< Key debounce time in ms
-#define REPEAT_TIME   20  ///< Key repeat time (after this time repeat goes inactive)
+#define KEYS_COUNT          16  ///< Number of keys in matrix
+#define KEYS_SCAN_PERIOD    5   ///< Scan period in ms
+#define KEYS_REPEAT_DELAY   100 ///< Scans before first repeat event (500 ms)
+#define KEYS_REPEAT_PERIOD  20  ///< Scans between repeat events (100 ms)
+#define KEYS_IDLE_SCANS     20  ///< Scans without keys before sleep (100 ms)
+#define KEYS_QUEUE_LEN      32  ///< Length of event queue
+
+/*
+ * Keys are numbered by their bit in the scanned matrix:
+ * 4 * column + row, while the key ID is (column << 4) | row.
+ * An event in the queue is (event << 4) | key number.
+ */
+#define KEYS_ID(key)    ((((key) >> 2) << 4) | ((key) & 0x03))
+#define KEYS_NUMBER(id) ((((id) >> 4) << 2) | ((id) & 0x03))
 
 /**
  * @brief Key structure typedef.
  */
 typedef struct {
-  uint8_t id;  ///< KEY_ID
-  void (*PressCallback)(void);
-  void (*RepeatCallback)(void);
-  uint16_t len;  ///<
-  uint16_t count;  ///<
+  uint8_t id;                     ///< KEY_ID
+  void (*PressCallback)(void);    ///< Called when key is pressed
+  void (*RepeatCallback)(void);   ///< Called periodically while key is held
+  void (*ReleaseCallback)(void);  ///< Called when key is released
 } KEY_TypeDef;
 
-uint8_t currentColumn; ///< Selected keyboard column
+static KEY_TypeDef keys[KEYS_COUNT];  ///< Keys of the matrix
+
+static uint8_t queueBuffer[KEYS_QUEUE_LEN]; ///< Buffer for events
+static FIFO_TypeDef queue;                  ///< Event queue
+
+static uint16_t keyState;     ///< Debounced state of keys (1 - pressed)
+static uint16_t count0;       ///< Bit 0 of vertical debounce counters
+static uint16_t count1;       ///< Bit 1 of vertical debounce counters
+static uint8_t repeatKey;     ///< Key which generates repeat events
+static uint8_t repeatCount;   ///< Scans left until next repeat event
+static uint8_t idleCount;     ///< Scans with no key pressed
+static uint32_t lostEvents;   ///< Events dropped because queue was full
+
+static void KEYS_Scan(void);
+static void KEYS_PostEvent(uint8_t key, KEY_Event_Typedef event);
+
 /**
  * @brief Initialize matrix keyboard
+ * @details The keyboard is scanned in the timer interrupt, the events
+ * are handled by KEYS_Update or read with KEYS_GetEvent.
  */
 void KEYS_Init(void) {
 
-  KEYS_HAL_Init();
-  // first column
-  currentColumn = 0;
+  for (uint8_t i = 0; i < KEYS_COUNT; i++) {
+    keys[i].id = KEYS_ID(i);
+  }
 
-  // select first column as default
-  KEYS_HAL_SelectColumn(0);
+  queue.buf = queueBuffer;
+  queue.len = KEYS_QUEUE_LEN;
+  FIFO_Add(&queue);
 
+  keyState = 0;
+  count0 = count1 = 0xffff; // counters idle
+  repeatKey = KEY_NONE;
+  idleCount = 0;
+
+  KEYS_HAL_Init(KEYS_SCAN_PERIOD, KEYS_Scan);
 }
 /**
- * @brief Checks if any keys are set.
- * @details Run this function in main loop to check for pressed keys.
- * TODO Add repeat, function calling
+ * @brief Sets the functions called for a key.
+ * @details The functions are called by KEYS_Update in the main loop,
+ * not in the interrupt.
+ * @param id Key ID
+ * @param pressCb Called when key is pressed (may be null)
+ * @param repeatCb Called periodically while key is held (may be null)
+ * @param releaseCb Called when key is released (may be null)
  */
-uint8_t KEYS_Update(void) {
+void KEYS_SetCallbacks(uint8_t id, void (*pressCb)(void),
+    void (*repeatCb)(void), void (*releaseCb)(void)) {
 
-  static uint8_t keyId    = KEY_NONE; // stores the pressed button ID
-  static uint8_t lastKey  = KEY_NONE; // stores last key press for hold
-  uint8_t keyValid        = KEY_NONE; // hold a valid debounced key ID
-  uint8_t currentKey      = KEY_NONE; // stores temporary key received from HAL (may be glitch)
+  if (id & 0xcc) { // no such row or column
+    return;
+  }
+
+  KEY_TypeDef* key = &keys[KEYS_NUMBER(id)];
+  key->PressCallback = pressCb;
+  key->RepeatCallback = repeatCb;
+  key->ReleaseCallback = releaseCb;
+}
+/**
+ * @brief Gets the next keyboard event.
+ * @param id Key ID
+ * @param event Type of event
+ * @retval 0 Got event
+ * @retval 1 Queue is empty
+ */
+uint8_t KEYS_GetEvent(uint8_t* id, KEY_Event_Typedef* event) {
 
-  static uint8_t repeatFlag = 0; // repeat flag
-  static uint32_t debounceTimer = 0; // timer for counting debounce time
-  static uint32_t repeatTimer = 0;
+  uint8_t c;
 
-  int8_t row = KEYS_HAL_ReadRow();
+  // disable IRQ so it doesn't screw up FIFO count
+  KEYS_HAL_IrqDisable;
+  uint8_t res = FIFO_Pop(&queue, &c);
+  KEYS_HAL_IrqEnable;
 
-  // if a key press has been recognized
-  if (row != -1) {
-    currentKey = (currentColumn << 4) | row;
-  } else if (TIMER_DelayTimer(REPEAT_TIME, repeatTimer)) { // repeat timeout
-    repeatFlag = 0;
-    lastKey = KEY_NONE;
+  if (res) {
+    return 1;
   }
 
-  // if key value changed start debounce timer for new key
-  if (keyId != currentKey && currentKey != KEY_NONE) {
-
-    if (lastKey == currentKey &&
-        !TIMER_DelayTimer(REPEAT_TIME, repeatTimer)) { // if last key still pressed
-      repeatFlag = 1;
-      repeatTimer = TIMER_GetTime();
-    } else { // new key
-      keyId = currentKey; // store the new key
-      debounceTimer = TIMER_GetTime(); // start debounce timer
-      lastKey = KEY_NONE;
-      repeatFlag = 0;
-    }
+  *id = KEYS_ID(c & 0x0f);
+  *event = (KEY_Event_Typedef)(c >> 4);
+  return 0;
+}
+/**
+ * @brief Handles keyboard events.
+ * @details Run this function in main loop. Calls the key callbacks
+ * for all queued events.
+ * @return ID of the last pressed or repeated key, KEY_NONE if none
+ */
+uint8_t KEYS_Update(void) {
 
+  uint8_t keyValid = KEY_NONE;
+  uint8_t id;
+  KEY_Event_Typedef event;
+
+  while (!KEYS_GetEvent(&id, &event)) {
+
+    KEY_TypeDef* key = &keys[KEYS_NUMBER(id)];
+
+    switch (event) {
+    case KEY_EVENT_PRESS:
+      println("You pressed a key 0x%02x.", id);
+      keyValid = id;
+      if (key->PressCallback) {
+        key->PressCallback();
+      }
+      break;
+    case KEY_EVENT_REPEAT:
+      keyValid = id;
+      if (key->RepeatCallback) {
+        key->RepeatCallback();
+      }
+      break;
+    case KEY_EVENT_RELEASE:
+      if (key->ReleaseCallback) {
+        key->ReleaseCallback();
+      }
+      break;
+    }
   }
-  // if debounce finished, the key is valid
-  if (!repeatFlag && keyId != KEY_NONE &&
-      TIMER_DelayTimer(DEBOUNCE_TIME, debounceTimer)) {
-    keyValid = keyId;
-    println("You pressed a key 0x%02x.", keyValid);
-    lastKey = keyId; // store new last pressed key
-    keyId = KEY_NONE;
-    repeatTimer = TIMER_GetTime(); // start repeatTimer
-  } else if (repeatFlag) {
-    keyValid = lastKey;
+
+  if (lostEvents) {
+    println("Lost %u events", (unsigned int)lostEvents);
+    lostEvents = 0;
   }
 
-  // update column
-  currentColumn++;
+  return keyValid;
+}
+/**
+ * @brief Scans and debounces the keyboard (called in timer interrupt).
+ * @details All 16 keys are debounced at once with 2-bit vertical
+ * counters: a counter counts scans in which the key differs from its
+ * debounced state and is reset by any scan in which it does not. After
+ * 4 such scans in a row the state changes, so a clean edge is reported
+ * after 15-20 ms and a bounce restarts the count.
+ */
+static void KEYS_Scan(void) {
+
+  uint16_t sample = KEYS_HAL_ReadMatrix();
 
-  // if last column reached
-  if (currentColumn == 4) {
-    currentColumn = 0;
+  uint16_t changed = sample ^ keyState;
+  count0 = ~(count0 & changed);
+  count1 = count0 ^ (count1 & changed);
+  changed &= count0 & count1; // counters rolled over
+  keyState ^= changed;
+
+  for (uint8_t i = 0; changed; i++, changed >>= 1) {
+    if (!(changed & 1)) {
+      continue;
+    }
+    if (keyState & (1 << i)) {
+      KEYS_PostEvent(i, KEY_EVENT_PRESS);
+      repeatKey = i; // the last pressed key repeats
+      repeatCount = KEYS_REPEAT_DELAY;
+    } else {
+      KEYS_PostEvent(i, KEY_EVENT_RELEASE);
+      if (repeatKey == i) {
+        repeatKey = KEY_NONE;
+      }
+    }
   }
 
-  KEYS_HAL_SelectColumn(currentColumn);
+  if (repeatKey != KEY_NONE && --repeatCount == 0) {
+    KEYS_PostEvent(repeatKey, KEY_EVENT_REPEAT);
+    repeatCount = KEYS_REPEAT_PERIOD;
+  }
 
-  // if key is valid return ID, if not returns KEY_NONE
-  return keyValid;
+  // wait for a key in EXTI interrupt instead of scanning
+  if (keyState || sample) {
+    idleCount = 0;
+  } else if (++idleCount == KEYS_IDLE_SCANS) {
+    idleCount = 0;
+    KEYS_HAL_Sleep();
+  }
+}
+/**
+ * @brief Puts an event in the queue.
+ * @param key Key number (bit in matrix)
+ * @param event Type of event
+ */
+static void KEYS_PostEvent(uint8_t key, KEY_Event_Typedef event) {
+
+  if (FIFO_Push(&queue, (event << 4) | key)) {
+    lostEvents++;
+  }
 }
 /**
  * @}
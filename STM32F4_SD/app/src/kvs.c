@@ -0,0 +1,838 @@
+/**
+ * @file    kvs.c
+ * @brief   Key-value store in a preallocated file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details The file is divided into segments of KVS_SEGMENT_SIZE bytes.
+ * Records are only ever appended to the newest (active) segment, each
+ * put writes the one sector holding the new record. A record never
+ * crosses a sector boundary. A delete appends a record marked as deleted.
+ *
+ * A segment starts with a header holding its sequence number. At open
+ * the segments are replayed from the oldest to the newest, to rebuild
+ * the RAM index of key hash to record position. The sequence number
+ * is part of every record checksum, so records left from an earlier
+ * use of a segment end the replay of that segment.
+ *
+ * Records still in use are copied out of the oldest segment by
+ * compaction, after which the segment is freed. Compaction runs from
+ * KVS_Update in idle time, or from KVS_Put when no free segment is
+ * left. One free segment is always kept for compaction.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <kvs.h>
+#include <fat.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("KVS--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup KVS
+ * @{
+ */
+
+#define KVS_MAGIC         0x4753564b  ///< Marks a segment header ("KVSG")
+#define KVS_SECTOR_SIZE   512         ///< Size of sector
+#define KVS_INDEX_SIZE    (2 * KVS_MAX_KEYS) ///< Entries in index (power of two)
+#define KVS_NONE          0xffffffff  ///< No position / no segment
+#define KVS_FLAG_DELETED  0x01        ///< Record marks a deleted key
+#define KVS_IDLE_FREE     3           ///< Compact in idle time below this many free segments
+
+/**
+ * @brief Header at the start of every used segment.
+ */
+typedef struct {
+  uint32_t magic;       ///< KVS_MAGIC
+  uint32_t seq;         ///< Sequence number of segment
+  uint32_t checksum;    ///< CRC of magic and seq
+  uint32_t reserved;    ///< Reserved (zero)
+} KVS_SegmentHeader;
+
+/**
+ * @brief Header of a record, followed by the key and the value.
+ */
+typedef struct {
+  uint8_t keyLen;       ///< Length of key (zero ends the sector)
+  uint8_t flags;        ///< KVS_FLAG_DELETED for deleted keys
+  uint16_t valueLen;    ///< Length of value
+  uint32_t checksum;    ///< CRC of lengths, flags, segment seq, key and value
+} KVS_RecordHeader;
+
+/**
+ * @brief Entry of the RAM index.
+ */
+typedef struct {
+  uint32_t hash;        ///< Hash of key
+  uint32_t location;    ///< Position of record in file or KVS_NONE if empty
+  uint16_t size;        ///< Size of record
+} KVS_Entry;
+
+static int kvsFile = -1;  ///< ID of opened file
+static uint32_t segCount; ///< Number of segments in file
+static uint32_t segSeq[KVS_MAX_SEGMENTS];  ///< Sequence numbers of segments (0 - free)
+static uint32_t segLive[KVS_MAX_SEGMENTS]; ///< Bytes of records in use in segments
+static uint32_t nextSeq;  ///< Sequence number for next segment
+static uint32_t active;   ///< Segment being filled
+static uint8_t compacting; ///< Nonzero during compaction
+
+static KVS_Entry keyIndex[KVS_INDEX_SIZE]; ///< RAM index
+static uint32_t keyCount; ///< Number of keys in index
+
+static uint32_t tailPos;  ///< Position of sector being filled
+static uint32_t tailUsed; ///< Bytes used in sector being filled
+static uint8_t tail[KVS_SECTOR_SIZE];    ///< Sector being filled
+static uint8_t readBuf[KVS_SECTOR_SIZE]; ///< Buffer for scanning segments
+static uint8_t recBuf[KVS_SECTOR_SIZE];  ///< Buffer for reading single records
+
+static uint32_t KVS_Append(const char* key, uint8_t keyLen, uint8_t flags,
+    const uint8_t* value, uint16_t valueLen);
+static uint8_t KVS_NewSegment(void);
+static uint8_t KVS_Compact(void);
+static uint32_t KVS_FreeSegments(void);
+static uint32_t KVS_OldestSegment(void);
+static uint8_t KVS_ScanSegment(uint32_t seg,
+    uint8_t (*func)(uint32_t location, const uint8_t* record), uint32_t* end);
+static uint8_t KVS_Replay(uint32_t location, const uint8_t* record);
+static uint8_t KVS_Copy(uint32_t location, const uint8_t* record);
+static uint32_t KVS_CheckRecord(const uint8_t* record, uint32_t room, uint32_t seq);
+static uint8_t KVS_ReadRecord(uint32_t location);
+static int KVS_Find(const char* key, uint8_t keyLen, uint32_t hash);
+static void KVS_Insert(uint32_t hash, uint32_t location, uint16_t size);
+static void KVS_Remove(int slot);
+static uint32_t KVS_Hash(const char* key, uint8_t keyLen);
+static uint32_t KVS_RecordSize(uint8_t keyLen, uint16_t valueLen);
+static uint32_t KVS_RecordCrc(const KVS_RecordHeader* hdr,
+    const uint8_t* data, uint32_t seq);
+
+/**
+ * @brief Opens the key-value store.
+ *
+ * @details The file must exist, its size limits the number of segments.
+ * A file holding no valid segments is an empty store.
+ *
+ * @param filename Name of file
+ * @retval 0 Store opened
+ * @retval 1 Error: file not found, too small, read error or index full
+ */
+uint8_t KVS_Open(const char* filename) {
+
+  KVS_SegmentHeader hdr;
+
+  kvsFile = FAT_OpenFile(filename);
+  if (kvsFile == -1) {
+    println("File not found");
+    return 1;
+  }
+
+  segCount = FAT_GetFileSize(kvsFile) / KVS_SEGMENT_SIZE;
+  if (segCount > KVS_MAX_SEGMENTS) {
+    segCount = KVS_MAX_SEGMENTS;
+  }
+  // active segment, free segment for compaction and one more
+  if (segCount < 3) {
+    println("File too small");
+    KVS_Close();
+    return 1;
+  }
+
+  for (int i = 0; i < KVS_INDEX_SIZE; i++) {
+    keyIndex[i].location = KVS_NONE;
+  }
+  keyCount = 0;
+  nextSeq = 1;
+  active = KVS_NONE;
+  compacting = 0;
+
+  for (uint32_t seg = 0; seg < segCount; seg++) {
+    FAT_MoveRdPtr(kvsFile, seg * KVS_SEGMENT_SIZE);
+    if (FAT_ReadFile(kvsFile, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+      println("Read error");
+      KVS_Close();
+      return 1;
+    }
+    segLive[seg] = 0;
+    segSeq[seg] = 0;
+    if (hdr.magic == KVS_MAGIC && hdr.seq != 0 && hdr.checksum ==
+        CRC_Calc(&hdr, 2 * sizeof(uint32_t))) {
+      segSeq[seg] = hdr.seq;
+      if (hdr.seq >= nextSeq) {
+        nextSeq = hdr.seq + 1;
+      }
+    }
+  }
+
+  // replay segments from oldest to newest
+  uint32_t lastSeq = 0;
+  uint32_t end = 0;
+  for (;;) {
+    uint32_t seg = KVS_NONE;
+    for (uint32_t i = 0; i < segCount; i++) {
+      if (segSeq[i] > lastSeq && (seg == KVS_NONE || segSeq[i] < segSeq[seg])) {
+        seg = i;
+      }
+    }
+    if (seg == KVS_NONE) {
+      break;
+    }
+    if (KVS_ScanSegment(seg, KVS_Replay, &end)) {
+      KVS_Close();
+      return 1;
+    }
+    lastSeq = segSeq[seg];
+    active = seg;
+  }
+
+  if (active != KVS_NONE) {
+    // continue in the last sector holding records
+    tailPos = end & ~(KVS_SECTOR_SIZE - 1);
+    tailUsed = end & (KVS_SECTOR_SIZE - 1);
+    if (tailUsed == 0) {
+      tailPos -= KVS_SECTOR_SIZE;
+      tailUsed = KVS_SECTOR_SIZE;
+    }
+    FAT_MoveRdPtr(kvsFile, tailPos);
+    FAT_ReadFile(kvsFile, tail, KVS_SECTOR_SIZE);
+    memset(tail + tailUsed, 0, KVS_SECTOR_SIZE - tailUsed);
+  }
+
+  println("%u keys, %u of %u segments free", (unsigned int)keyCount,
+      (unsigned int)KVS_FreeSegments(), (unsigned int)segCount);
+  return 0;
+}
+/**
+ * @brief Closes the key-value store.
+ * @retval 0 Store closed
+ * @retval 1 Store was not opened
+ */
+uint8_t KVS_Close(void) {
+
+  if (kvsFile == -1) {
+    return 1;
+  }
+  FAT_CloseFile(kvsFile);
+  kvsFile = -1;
+  return 0;
+}
+/**
+ * @brief Makes the records written so far durable.
+ *
+ * @details KVS_Put and KVS_Delete return when the record is written
+ * to the file, which may still be in the cache of the block device.
+ * After this call the records survive a power failure.
+ *
+ * @retval 0 Store synchronized
+ * @retval 1 Store not opened or write error
+ */
+uint8_t KVS_Sync(void) {
+
+  if (kvsFile == -1 || FAT_SyncFile(kvsFile)) {
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Reads the value of a key.
+ * @param key Key (null terminated string)
+ * @param value Buffer for value
+ * @param maxLen Size of buffer (longer values are truncated)
+ * @return Length of value or -1 if key was not found
+ */
+int KVS_Get(const char* key, uint8_t* value, int maxLen) {
+
+  size_t keyLen = strlen(key);
+
+  if (kvsFile == -1 || keyLen == 0 || keyLen > KVS_MAX_KEY) {
+    return -1;
+  }
+  // record is left in recBuf
+  if (KVS_Find(key, keyLen, KVS_Hash(key, keyLen)) == -1) {
+    return -1;
+  }
+  KVS_RecordHeader* hdr = (KVS_RecordHeader*)recBuf;
+  int len = hdr->valueLen;
+  memcpy(value, recBuf + sizeof(KVS_RecordHeader) + keyLen,
+      len < maxLen ? len : maxLen);
+  return len;
+}
+/**
+ * @brief Writes the value of a key.
+ * @param key Key (null terminated string, at most KVS_MAX_KEY characters)
+ * @param value Value
+ * @param len Length of value (at most KVS_MAX_VALUE)
+ * @retval 0 Value written
+ * @retval 1 Error: bad arguments, store full or write error
+ */
+uint8_t KVS_Put(const char* key, const uint8_t* value, int len) {
+
+  size_t keyLen = strlen(key);
+
+  if (kvsFile == -1 || keyLen == 0 || keyLen > KVS_MAX_KEY ||
+      len < 0 || len > KVS_MAX_VALUE) {
+    return 1;
+  }
+
+  uint32_t hash = KVS_Hash(key, keyLen);
+  int slot = KVS_Find(key, keyLen, hash);
+  if (slot == -1 && keyCount >= KVS_MAX_KEYS) {
+    println("Index full");
+    return 1;
+  }
+
+  // compaction during append moves records, but not index entries
+  uint32_t location = KVS_Append(key, keyLen, 0, value, len);
+  if (location == KVS_NONE) {
+    return 1;
+  }
+  uint16_t size = KVS_RecordSize(keyLen, len);
+
+  if (slot == -1) {
+    KVS_Insert(hash, location, size);
+  } else {
+    segLive[keyIndex[slot].location / KVS_SEGMENT_SIZE] -= keyIndex[slot].size;
+    keyIndex[slot].location = location;
+    keyIndex[slot].size = size;
+  }
+  segLive[location / KVS_SEGMENT_SIZE] += size;
+  return 0;
+}
+/**
+ * @brief Deletes a key.
+ * @param key Key (null terminated string)
+ * @retval 0 Key deleted or not found
+ * @retval 1 Error: store full or write error
+ */
+uint8_t KVS_Delete(const char* key) {
+
+  size_t keyLen = strlen(key);
+
+  if (kvsFile == -1 || keyLen == 0 || keyLen > KVS_MAX_KEY) {
+    return 1;
+  }
+
+  int slot = KVS_Find(key, keyLen, KVS_Hash(key, keyLen));
+  if (slot == -1) {
+    return 0;
+  }
+  if (KVS_Append(key, keyLen, KVS_FLAG_DELETED, 0, 0) == KVS_NONE) {
+    return 1;
+  }
+  segLive[keyIndex[slot].location / KVS_SEGMENT_SIZE] -= keyIndex[slot].size;
+  KVS_Remove(slot);
+  return 0;
+}
+/**
+ * @brief Compacts one segment if few segments are free.
+ *
+ * @details Should be called in the main loop, when there is time
+ * to spare. The oldest segment is compacted only if at most half
+ * of it is in use, so compaction always frees space.
+ */
+void KVS_Update(void) {
+
+  if (kvsFile == -1 || KVS_FreeSegments() >= KVS_IDLE_FREE) {
+    return;
+  }
+  uint32_t seg = KVS_OldestSegment();
+  if (seg != KVS_NONE && segLive[seg] <= KVS_SEGMENT_SIZE / 2) {
+    KVS_Compact();
+  }
+}
+/**
+ * @brief Appends a record to the active segment.
+ * @param key Key
+ * @param keyLen Length of key
+ * @param flags Record flags
+ * @param value Value
+ * @param valueLen Length of value
+ * @return Position of record in file or KVS_NONE on error
+ */
+static uint32_t KVS_Append(const char* key, uint8_t keyLen, uint8_t flags,
+    const uint8_t* value, uint16_t valueLen) {
+
+  uint32_t size = KVS_RecordSize(keyLen, valueLen);
+
+  while (active == KVS_NONE || tailUsed + size > KVS_SECTOR_SIZE) {
+    if (active != KVS_NONE && tailPos + KVS_SECTOR_SIZE <
+        (active + 1) * KVS_SEGMENT_SIZE) {
+      // next sector of active segment
+      tailPos += KVS_SECTOR_SIZE;
+      tailUsed = 0;
+      memset(tail, 0, KVS_SECTOR_SIZE);
+    } else if (KVS_NewSegment()) {
+      return KVS_NONE;
+    }
+  }
+
+  KVS_RecordHeader hdr;
+  uint8_t* data = tail + tailUsed + sizeof(KVS_RecordHeader);
+
+  memcpy(data, key, keyLen);
+  memcpy(data + keyLen, value, valueLen);
+  hdr.keyLen = keyLen;
+  hdr.flags = flags;
+  hdr.valueLen = valueLen;
+  hdr.checksum = KVS_RecordCrc(&hdr, data, segSeq[active]);
+  memcpy(tail + tailUsed, &hdr, sizeof(hdr));
+
+  FAT_MoveWrPtr(kvsFile, tailPos);
+  if (FAT_WriteFile(kvsFile, tail, KVS_SECTOR_SIZE) != KVS_SECTOR_SIZE) {
+    println("Write error");
+    memset(tail + tailUsed, 0, size);
+    return KVS_NONE;
+  }
+
+  uint32_t location = tailPos + tailUsed;
+  tailUsed += size;
+  return location;
+}
+/**
+ * @brief Makes a free segment the active segment.
+ *
+ * @details Outside compaction, segments are compacted first, until
+ * one free segment is left over for later compaction. Compaction
+ * may leave room in a new active segment, then no segment is taken.
+ *
+ * @retval 0 Active segment has changed
+ * @retval 1 Error: store full or write error
+ */
+static uint8_t KVS_NewSegment(void) {
+
+  if (!compacting) {
+    uint32_t prev = active;
+    for (uint32_t i = 0; i < segCount && KVS_FreeSegments() < 2; i++) {
+      if (KVS_Compact()) {
+        break;
+      }
+    }
+    if (KVS_FreeSegments() < 2) {
+      println("Store full");
+      return 1;
+    }
+    if (active != prev) {
+      return 0;
+    }
+  }
+
+  uint32_t seg = 0;
+  while (seg < segCount && segSeq[seg] != 0) {
+    seg++;
+  }
+  if (seg == segCount) {
+    println("No free segment");
+    return 1;
+  }
+
+  KVS_SegmentHeader hdr;
+  hdr.magic = KVS_MAGIC;
+  hdr.seq = nextSeq++;
+  hdr.checksum = CRC_Calc(&hdr, 2 * sizeof(uint32_t));
+  hdr.reserved = 0;
+
+  // header is written together with first record
+  segSeq[seg] = hdr.seq;
+  segLive[seg] = 0;
+  active = seg;
+  tailPos = seg * KVS_SEGMENT_SIZE;
+  memset(tail, 0, KVS_SECTOR_SIZE);
+  memcpy(tail, &hdr, sizeof(hdr));
+  tailUsed = sizeof(hdr);
+  return 0;
+}
+/**
+ * @brief Copies records in use out of the oldest segment and frees it.
+ *
+ * @details The segment is freed only after all records were copied,
+ * so the store stays consistent if power fails during compaction.
+ *
+ * @retval 0 Segment freed
+ * @retval 1 Error: nothing to compact, read or write error
+ */
+static uint8_t KVS_Compact(void) {
+
+  uint32_t seg = KVS_OldestSegment();
+  uint32_t end;
+
+  if (seg == KVS_NONE) {
+    return 1;
+  }
+
+  compacting = 1;
+  uint8_t ret = KVS_ScanSegment(seg, KVS_Copy, &end);
+  compacting = 0;
+  if (ret) {
+    return 1;
+  }
+
+  // copies reach the card before the segment they came from is freed
+  if (FAT_SyncFile(kvsFile)) {
+    println("Sync error");
+    return 1;
+  }
+  KVS_SegmentHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  FAT_MoveWrPtr(kvsFile, seg * KVS_SEGMENT_SIZE);
+  if (FAT_WriteFile(kvsFile, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    println("Write error");
+    return 1;
+  }
+  segSeq[seg] = 0;
+  segLive[seg] = 0;
+  return 0;
+}
+/**
+ * @brief Counts free segments.
+ * @return Number of free segments
+ */
+static uint32_t KVS_FreeSegments(void) {
+
+  uint32_t count = 0;
+
+  for (uint32_t i = 0; i < segCount; i++) {
+    if (segSeq[i] == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+/**
+ * @brief Finds the oldest used segment other than the active one.
+ * @return Number of segment or KVS_NONE if there is none
+ */
+static uint32_t KVS_OldestSegment(void) {
+
+  uint32_t seg = KVS_NONE;
+
+  for (uint32_t i = 0; i < segCount; i++) {
+    if (segSeq[i] != 0 && i != active &&
+        (seg == KVS_NONE || segSeq[i] < segSeq[seg])) {
+      seg = i;
+    }
+  }
+  return seg;
+}
+/**
+ * @brief Calls a function for every valid record of a segment.
+ *
+ * @details Records are read sector by sector into readBuf. The scan
+ * ends at the first sector without valid records.
+ *
+ * @param seg Number of segment
+ * @param func Function called with position and contents of record
+ * (nonzero return value ends the scan)
+ * @param end Position after last valid record (function writes this)
+ * @retval 0 Segment scanned
+ * @retval 1 Error: read error or func returned nonzero
+ */
+static uint8_t KVS_ScanSegment(uint32_t seg,
+    uint8_t (*func)(uint32_t location, const uint8_t* record), uint32_t* end) {
+
+  uint32_t start = seg * KVS_SEGMENT_SIZE;
+
+  *end = start + sizeof(KVS_SegmentHeader);
+
+  for (uint32_t pos = start; pos < start + KVS_SEGMENT_SIZE;
+      pos += KVS_SECTOR_SIZE) {
+
+    FAT_MoveRdPtr(kvsFile, pos);
+    if (FAT_ReadFile(kvsFile, readBuf, KVS_SECTOR_SIZE) != KVS_SECTOR_SIZE) {
+      println("Read error");
+      return 1;
+    }
+
+    uint32_t offset = (pos == start) ? sizeof(KVS_SegmentHeader) : 0;
+    uint32_t size;
+    uint32_t count = 0;
+
+    while ((size = KVS_CheckRecord(readBuf + offset,
+        KVS_SECTOR_SIZE - offset, segSeq[seg])) != 0) {
+      if (func(pos + offset, readBuf + offset)) {
+        return 1;
+      }
+      offset += size;
+      count++;
+    }
+    if (count == 0) {
+      break;
+    }
+    *end = pos + offset;
+  }
+  return 0;
+}
+/**
+ * @brief Adds a record to the index while opening the store.
+ * @param location Position of record
+ * @param record Record
+ * @retval 0 Record added
+ * @retval 1 Error: index full
+ */
+static uint8_t KVS_Replay(uint32_t location, const uint8_t* record) {
+
+  KVS_RecordHeader hdr;
+  const char* key = (const char*)record + sizeof(hdr);
+
+  memcpy(&hdr, record, sizeof(hdr));
+
+  uint32_t hash = KVS_Hash(key, hdr.keyLen);
+  uint16_t size = KVS_RecordSize(hdr.keyLen, hdr.valueLen);
+  int slot = KVS_Find(key, hdr.keyLen, hash);
+
+  if (slot != -1) {
+    segLive[keyIndex[slot].location / KVS_SEGMENT_SIZE] -= keyIndex[slot].size;
+    if (hdr.flags & KVS_FLAG_DELETED) {
+      KVS_Remove(slot);
+      return 0;
+    }
+    keyIndex[slot].location = location;
+    keyIndex[slot].size = size;
+  } else if (hdr.flags & KVS_FLAG_DELETED) {
+    return 0;
+  } else if (keyCount >= KVS_MAX_KEYS) {
+    println("Index full");
+    return 1;
+  } else {
+    KVS_Insert(hash, location, size);
+  }
+  segLive[location / KVS_SEGMENT_SIZE] += size;
+  return 0;
+}
+/**
+ * @brief Copies a record to the active segment during compaction.
+ *
+ * @details Only records the index points to are copied. Deleted
+ * records are dropped, since they are in the oldest segment and
+ * no older record of their key is left.
+ *
+ * @param location Position of record
+ * @param record Record
+ * @retval 0 Record copied or dropped
+ * @retval 1 Error: write error
+ */
+static uint8_t KVS_Copy(uint32_t location, const uint8_t* record) {
+
+  KVS_RecordHeader hdr;
+  const char* key = (const char*)record + sizeof(hdr);
+
+  memcpy(&hdr, record, sizeof(hdr));
+  if (hdr.flags & KVS_FLAG_DELETED) {
+    return 0;
+  }
+
+  // find entry by position, without reading the key again
+  uint32_t hash = KVS_Hash(key, hdr.keyLen);
+  uint32_t i = hash & (KVS_INDEX_SIZE - 1);
+  while (keyIndex[i].location != KVS_NONE && keyIndex[i].location != location) {
+    i = (i + 1) & (KVS_INDEX_SIZE - 1);
+  }
+  if (keyIndex[i].location == KVS_NONE) {
+    return 0;
+  }
+
+  uint32_t newLocation = KVS_Append(key, hdr.keyLen, 0,
+      (const uint8_t*)key + hdr.keyLen, hdr.valueLen);
+  if (newLocation == KVS_NONE) {
+    return 1;
+  }
+  keyIndex[i].location = newLocation;
+  segLive[location / KVS_SEGMENT_SIZE] -= keyIndex[i].size;
+  segLive[newLocation / KVS_SEGMENT_SIZE] += keyIndex[i].size;
+  return 0;
+}
+/**
+ * @brief Checks a record.
+ * @param record Record
+ * @param room Bytes left in sector
+ * @param seq Sequence number of segment
+ * @return Size of record or 0 if there is no valid record
+ */
+static uint32_t KVS_CheckRecord(const uint8_t* record, uint32_t room, uint32_t seq) {
+
+  KVS_RecordHeader hdr;
+
+  if (room < sizeof(hdr)) {
+    return 0;
+  }
+  memcpy(&hdr, record, sizeof(hdr));
+
+  uint32_t size = KVS_RecordSize(hdr.keyLen, hdr.valueLen);
+  if (hdr.keyLen == 0 || hdr.keyLen > KVS_MAX_KEY ||
+      hdr.valueLen > KVS_MAX_VALUE || size > room) {
+    return 0;
+  }
+  if (hdr.checksum != KVS_RecordCrc(&hdr, record + sizeof(hdr), seq)) {
+    return 0;
+  }
+  return size;
+}
+/**
+ * @brief Reads a record into recBuf.
+ * @param location Position of record
+ * @retval 0 Record read
+ * @retval 1 Error: read error or damaged record
+ */
+static uint8_t KVS_ReadRecord(uint32_t location) {
+
+  uint32_t room = KVS_SECTOR_SIZE - location % KVS_SECTOR_SIZE;
+
+  // records never cross sectors, fat.c reads the sector once
+  FAT_MoveRdPtr(kvsFile, location);
+  if (FAT_ReadFile(kvsFile, recBuf, sizeof(KVS_RecordHeader)) !=
+      sizeof(KVS_RecordHeader)) {
+    println("Read error");
+    return 1;
+  }
+  KVS_RecordHeader* hdr = (KVS_RecordHeader*)recBuf;
+  uint32_t size = KVS_RecordSize(hdr->keyLen, hdr->valueLen);
+  if (size > room || FAT_ReadFile(kvsFile, recBuf + sizeof(KVS_RecordHeader),
+      size - sizeof(KVS_RecordHeader)) != (int)(size - sizeof(KVS_RecordHeader))) {
+    println("Read error");
+    return 1;
+  }
+  if (KVS_CheckRecord(recBuf, room, segSeq[location / KVS_SEGMENT_SIZE]) == 0) {
+    println("Damaged record at %u", (unsigned int)location);
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Finds a key in the index.
+ *
+ * @details Keys of entries with a matching hash are compared with
+ * the key of the record in the file. The last record read stays
+ * in recBuf.
+ *
+ * @param key Key
+ * @param keyLen Length of key
+ * @param hash Hash of key
+ * @return Index entry or -1 if key was not found
+ */
+static int KVS_Find(const char* key, uint8_t keyLen, uint32_t hash) {
+
+  uint32_t i = hash & (KVS_INDEX_SIZE - 1);
+
+  while (keyIndex[i].location != KVS_NONE) {
+    if (keyIndex[i].hash == hash && !KVS_ReadRecord(keyIndex[i].location)) {
+      KVS_RecordHeader* hdr = (KVS_RecordHeader*)recBuf;
+      if (hdr->keyLen == keyLen &&
+          memcmp(recBuf + sizeof(KVS_RecordHeader), key, keyLen) == 0) {
+        return i;
+      }
+    }
+    i = (i + 1) & (KVS_INDEX_SIZE - 1);
+  }
+  return -1;
+}
+/**
+ * @brief Adds an entry to the index.
+ * @param hash Hash of key
+ * @param location Position of record
+ * @param size Size of record
+ */
+static void KVS_Insert(uint32_t hash, uint32_t location, uint16_t size) {
+
+  uint32_t i = hash & (KVS_INDEX_SIZE - 1);
+
+  while (keyIndex[i].location != KVS_NONE) {
+    i = (i + 1) & (KVS_INDEX_SIZE - 1);
+  }
+  keyIndex[i].hash = hash;
+  keyIndex[i].location = location;
+  keyIndex[i].size = size;
+  keyCount++;
+}
+/**
+ * @brief Removes an entry from the index.
+ *
+ * @details Following entries are moved back into the gap, so
+ * that every entry stays reachable from its home position.
+ *
+ * @param slot Index entry
+ */
+static void KVS_Remove(int slot) {
+
+  uint32_t i = slot;
+  uint32_t j = slot;
+
+  for (;;) {
+    j = (j + 1) & (KVS_INDEX_SIZE - 1);
+    if (keyIndex[j].location == KVS_NONE) {
+      break;
+    }
+    uint32_t home = keyIndex[j].hash & (KVS_INDEX_SIZE - 1);
+    // move entry if its home is not between the gap and its place
+    if (((j - home) & (KVS_INDEX_SIZE - 1)) >= ((j - i) & (KVS_INDEX_SIZE - 1))) {
+      keyIndex[i] = keyIndex[j];
+      i = j;
+    }
+  }
+  keyIndex[i].location = KVS_NONE;
+  keyCount--;
+}
+/**
+ * @brief Calculates the hash of a key (FNV-1a).
+ * @param key Key
+ * @param keyLen Length of key
+ * @return Hash
+ */
+static uint32_t KVS_Hash(const char* key, uint8_t keyLen) {
+
+  uint32_t hash = 2166136261u;
+
+  for (int i = 0; i < keyLen; i++) {
+    hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+  }
+  return hash;
+}
+/**
+ * @brief Calculates the size of a record, rounded up to 4 bytes.
+ * @param keyLen Length of key
+ * @param valueLen Length of value
+ * @return Size of record
+ */
+static uint32_t KVS_RecordSize(uint8_t keyLen, uint16_t valueLen) {
+
+  return (sizeof(KVS_RecordHeader) + keyLen + valueLen + 3) & ~3;
+}
+/**
+ * @brief Calculates the CRC of a record.
+ * @param hdr Record header
+ * @param data Key and value
+ * @param seq Sequence number of segment holding the record
+ * @return CRC
+ */
+static uint32_t KVS_RecordCrc(const KVS_RecordHeader* hdr,
+    const uint8_t* data, uint32_t seq) {
+
+  uint32_t fields[2];
+
+  fields[0] = hdr->keyLen | (hdr->flags << 8) | (hdr->valueLen << 16);
+  fields[1] = seq;
+  return CRC_Update(CRC_Calc(fields, sizeof(fields)), data,
+      hdr->keyLen + hdr->valueLen);
+}
+
+/**
+ * @}
+ */
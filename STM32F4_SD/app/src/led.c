@@ -12,6 +12,9 @@
  * LED number.
  * The various LED ports and pins are defined in
  * led_hal.c and led_hal.h.
+ * LED_StartPattern and LED_ShowError play a pattern from
+ * the pattern table in hardware, without using the CPU,
+ * until the state of the LED is changed.
  *
  * @verbatim
  * Copyright (c) 2014 Michal Ksiezopolski.
@@ -46,7 +49,49 @@
  * @{
  */
 
+#define LED_MAX_STEPS 256 ///< Maximum number of pattern steps (LED_HAL_STEP_TIME each)
+#define LED_MAX_ERROR 7   ///< Maximum error code shown
+
+/**
+ * @brief Pattern segment.
+ */
+typedef struct {
+  uint8_t level;  ///< Brightness at end of segment in percent
+  uint8_t fade;   ///< Nonzero - brightness changes gradually during segment
+  uint16_t time;  ///< Duration in ms
+} LED_Segment_TypeDef;
+
+/**
+ * @brief Pattern description.
+ */
+typedef struct {
+  const LED_Segment_TypeDef* segments;  ///< Segments played in a loop
+  uint8_t count;                        ///< Number of segments
+} LED_PatternDesc_TypeDef;
+
+static const LED_Segment_TypeDef blink[] = {
+    {100, 0, 500}, {0, 0, 500}};
+static const LED_Segment_TypeDef blinkFast[] = {
+    {100, 0, 100}, {0, 0, 100}};
+static const LED_Segment_TypeDef breathe[] = {
+    {100, 1, 1500}, {0, 1, 1500}, {0, 0, 500}};
+static const LED_Segment_TypeDef heartbeat[] = {
+    {100, 0, 100}, {0, 0, 100}, {100, 0, 100}, {0, 0, 700}};
+
+/**
+ * @brief Pattern table (indexed by LED_Pattern_TypeDef)
+ */
+static const LED_PatternDesc_TypeDef patterns[LED_PATTERN_COUNT] = {
+    {blink,     sizeof(blink) / sizeof(blink[0])},
+    {blinkFast, sizeof(blinkFast) / sizeof(blinkFast[0])},
+    {breathe,   sizeof(breathe) / sizeof(breathe[0])},
+    {heartbeat, sizeof(heartbeat) / sizeof(heartbeat[0])}};
+
 static LED_State_TypeDef ledState[MAX_LEDS]; ///< States of the LEDs (MAX_LEDS is hardware dependent)
+static uint16_t ledSteps[MAX_LEDS][LED_MAX_STEPS]; ///< Rendered patterns (read by DMA)
+
+static void LED_Play(LED_Number_TypeDef led,
+    const LED_Segment_TypeDef* segments, uint8_t count);
 
 /**
  * @brief Add an LED.
@@ -80,6 +125,9 @@ void LED_ChangeState(LED_Number_TypeDef led, LED_State_TypeDef state) {
     println("Error: Uninitialized LED %d!", (int)led);
     return;
   } else {
+    if (ledState[led] == LED_PATTERN) {
+      LED_HAL_StopPattern(led);
+    }
     if (state == LED_OFF) {
       LED_HAL_ChangeState(led, 0); // turn off LED
     } else if (state == LED_ON) {
@@ -105,6 +153,10 @@ void LED_Toggle(LED_Number_TypeDef led) {
     println("Error: Uninitialized LED %d!", (int)led);
     return;
   } else {
+    if (ledState[led] == LED_PATTERN) {
+      LED_HAL_StopPattern(led); // LED is off now
+      ledState[led] = LED_OFF;
+    }
     if (ledState[led] == LED_OFF) {
       ledState[led] = LED_ON;
     } else if (ledState[led] == LED_ON) {
@@ -114,6 +166,100 @@ void LED_Toggle(LED_Number_TypeDef led) {
   }
 }
 
+/**
+ * @brief Plays a pattern from the pattern table.
+ * @param led LED number.
+ * @param pattern Pattern
+ */
+void LED_StartPattern(LED_Number_TypeDef led, LED_Pattern_TypeDef pattern) {
+
+  if (pattern >= LED_PATTERN_COUNT) {
+    println("Error: Incorrect pattern %d!", (int)pattern);
+    return;
+  }
+
+  LED_Play(led, patterns[pattern].segments, patterns[pattern].count);
+}
+/**
+ * @brief Shows an error code.
+ * @details The LED flashes code times and pauses, in a loop.
+ * @param led LED number.
+ * @param code Error code (1 - LED_MAX_ERROR)
+ */
+void LED_ShowError(LED_Number_TypeDef led, uint8_t code) {
+
+  LED_Segment_TypeDef segments[2 * LED_MAX_ERROR];
+
+  if (code == 0 || code > LED_MAX_ERROR) {
+    println("Error: Incorrect error code %d!", (int)code);
+    return;
+  }
+
+  for (uint8_t i = 0; i < code; i++) {
+    segments[2 * i] = (LED_Segment_TypeDef){100, 0, 200};
+    segments[2 * i + 1] = (LED_Segment_TypeDef){0, 0, 300};
+  }
+  segments[2 * code - 1].time = 1500; // pause before repeating
+
+  LED_Play(led, segments, 2 * code);
+}
+/**
+ * @brief Renders pattern segments to steps and starts playing them.
+ * @details Brightness is squared to get the duty, so fades look
+ * linear to the eye.
+ * @param led LED number.
+ * @param segments Pattern segments
+ * @param count Number of segments
+ */
+static void LED_Play(LED_Number_TypeDef led,
+    const LED_Segment_TypeDef* segments, uint8_t count) {
+
+  if (led >= MAX_LEDS) {
+    println("Error: Incorrect LED number %d!", (int)led);
+    return;
+  }
+
+  if (ledState[led] == LED_UNUSED) {
+    println("Error: Uninitialized LED %d!", (int)led);
+    return;
+  }
+
+  // DMA must not read the table while it is rendered
+  if (ledState[led] == LED_PATTERN) {
+    LED_HAL_StopPattern(led);
+    ledState[led] = LED_OFF;
+  }
+
+  uint16_t* steps = ledSteps[led];
+  uint16_t n = 0;
+  int32_t level = segments[count - 1].level; // pattern loops
+
+  for (uint8_t i = 0; i < count; i++) {
+
+    uint16_t segmentSteps = segments[i].time / LED_HAL_STEP_TIME;
+    int32_t start = level;
+
+    for (uint16_t j = 0; j < segmentSteps; j++) {
+      if (n == LED_MAX_STEPS) {
+        println("Error: Pattern too long!");
+        return;
+      }
+      if (segments[i].fade) {
+        level = start + (segments[i].level - start) * (j + 1) / segmentSteps;
+      } else {
+        level = segments[i].level;
+      }
+      steps[n++] = level * level * LED_HAL_PWM_MAX / 10000;
+    }
+  }
+
+  if (n == 0) {
+    return;
+  }
+
+  LED_HAL_StartPattern(led, steps, n);
+  ledState[led] = LED_PATTERN;
+}
 /**
  * @}
  */
@@ -0,0 +1,330 @@
+/**
+ * @file    pack.c
+ * @brief   Lossless compression of sample blocks.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Blocks of 16-bit samples of interleaved channels are
+ * compressed before they are written, e.g.:
+ *
+ *   len = PACK_Compress(samples, count, channels, buf);
+ *   FAT_WriteFile(file, buf, len);
+ *
+ * Every channel is predicted from its previous samples (first or second
+ * order, chosen per block), the prediction errors are mapped to
+ * unsigned numbers (zig-zag) and Rice coded, with the Rice parameter
+ * chosen for every group of PACK_GROUP numbers. Sensor data changes
+ * slowly, so most errors take a few bits. A block which would not get
+ * smaller is stored as it is, so it grows by the header at most.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <pack.h>
+#include <crc.h>
+#include <string.h>
+
+/**
+ * @addtogroup PACK
+ * @{
+ */
+
+#define PACK_GROUP    16  ///< Numbers coded with the same Rice parameter
+#define PACK_K_BITS   4   ///< Bits of Rice parameter
+#define PACK_ESCAPE   16  ///< Quotient marking a number stored in 16 bits
+
+/**
+ * @brief Bit stream (most significant bit first).
+ */
+typedef struct {
+  uint8_t* p;       ///< Next byte
+  uint8_t* end;     ///< End of buffer
+  uint32_t acc;     ///< Bits not yet written or read
+  uint8_t bits;     ///< Number of bits in acc
+  uint8_t overflow; ///< Nonzero if end of buffer was reached
+} PACK_Bits;
+
+static uint8_t PACK_Encode(const int16_t* samples, uint16_t count,
+    uint8_t channels, uint8_t order, uint8_t* out, uint8_t* end, int* len);
+static uint8_t PACK_Decode(const uint8_t* in, const uint8_t* end,
+    int16_t* samples, uint16_t count, uint8_t channels, uint8_t order);
+static void PACK_Put(PACK_Bits* s, uint32_t value, uint8_t n);
+static uint32_t PACK_Get(PACK_Bits* s, uint8_t n);
+
+/**
+ * @brief Compresses a block of samples.
+ * @param samples Samples (channels interleaved)
+ * @param count Number of samples (multiple of channels)
+ * @param channels Number of channels
+ * @param out Buffer for PACK_MAX_PACKED(count) bytes
+ * @return Length of compressed block, -1 if parameters are wrong
+ */
+int PACK_Compress(const int16_t* samples, uint16_t count, uint8_t channels,
+    uint8_t* out) {
+
+  if (count > PACK_MAX_SAMPLES || channels == 0 ||
+      channels > PACK_MAX_CHANNELS || count % channels) {
+    return -1;
+  }
+
+  PACK_Header hdr;
+  uint8_t* payload = out + sizeof(PACK_Header);
+  uint8_t* end = payload + 2 * count;
+  int len;
+
+  hdr.magic = PACK_MAGIC;
+  hdr.channels = channels;
+  hdr.count = count;
+  hdr.checksum = CRC_Calc(samples, 2 * count);
+
+  // choose predictor by sum of errors of both
+  uint32_t error1 = 0;
+  uint32_t error2 = 0;
+  for (uint16_t i = 2 * channels; i < count; i++) {
+    int32_t d1 = samples[i] - samples[i - channels];
+    int32_t d2 = d1 - (samples[i - channels] - samples[i - 2 * channels]);
+    error1 += d1 < 0 ? -d1 : d1;
+    error2 += d2 < 0 ? -d2 : d2;
+  }
+  uint8_t order = error2 < error1 ? 2 : 1;
+
+  if (!PACK_Encode(samples, count, channels, order, payload, end, &len)) {
+    hdr.method = order == 2 ? PACK_DELTA2 : PACK_DELTA1;
+  } else {
+    hdr.method = PACK_STORED;
+    len = 2 * count;
+    memcpy(payload, samples, len);
+  }
+  hdr.length = len;
+  memcpy(out, &hdr, sizeof(PACK_Header));
+
+  return sizeof(PACK_Header) + len;
+}
+/**
+ * @brief Decompresses a block.
+ * @param in Compressed block (header first)
+ * @param len Number of bytes available
+ * @param samples Buffer for samples
+ * @param maxCount Size of buffer in samples
+ * @return Number of samples, -1 if block is damaged or too large
+ */
+int PACK_Decompress(const uint8_t* in, int len, int16_t* samples,
+    uint16_t maxCount) {
+
+  PACK_Header hdr;
+
+  if (len < (int)sizeof(PACK_Header)) {
+    return -1;
+  }
+  memcpy(&hdr, in, sizeof(PACK_Header));
+  if (hdr.magic != PACK_MAGIC || hdr.count > maxCount ||
+      hdr.channels == 0 || hdr.channels > PACK_MAX_CHANNELS ||
+      hdr.count % hdr.channels ||
+      len < (int)sizeof(PACK_Header) + hdr.length) {
+    return -1;
+  }
+
+  const uint8_t* payload = in + sizeof(PACK_Header);
+
+  switch (hdr.method) {
+  case PACK_STORED:
+    if (hdr.length != 2 * hdr.count) {
+      return -1;
+    }
+    memcpy(samples, payload, hdr.length);
+    break;
+  case PACK_DELTA1:
+  case PACK_DELTA2:
+    if (PACK_Decode(payload, payload + hdr.length, samples, hdr.count,
+        hdr.channels, hdr.method == PACK_DELTA2 ? 2 : 1)) {
+      return -1;
+    }
+    break;
+  default:
+    return -1;
+  }
+
+  if (CRC_Calc(samples, 2 * hdr.count) != hdr.checksum) {
+    return -1;
+  }
+  return hdr.count;
+}
+/**
+ * @brief Codes prediction errors of samples.
+ * @param samples Samples
+ * @param count Number of samples
+ * @param channels Number of channels
+ * @param order Order of predictor (1 or 2)
+ * @param out Output buffer
+ * @param end End of output buffer
+ * @param len Number of bytes written
+ * @retval 0 Samples coded
+ * @retval 1 Output would not fit in buffer
+ */
+static uint8_t PACK_Encode(const int16_t* samples, uint16_t count,
+    uint8_t channels, uint8_t order, uint8_t* out, uint8_t* end, int* len) {
+
+  PACK_Bits s = {out, end, 0, 0, 0};
+  int16_t last[PACK_MAX_CHANNELS] = {0};  // previous sample of channel
+  int16_t delta[PACK_MAX_CHANNELS] = {0}; // previous difference of channel
+  uint16_t group[PACK_GROUP];
+  uint8_t n = 0;
+
+  for (uint16_t i = 0; i < count; i++) {
+
+    uint8_t c = i % channels;
+    int16_t d = samples[i] - last[c];
+    int16_t e = (order == 2) ? (int16_t)(d - delta[c]) : d;
+    last[c] = samples[i];
+    delta[c] = d;
+
+    group[n++] = (uint16_t)((e << 1) ^ (e >> 15)); // zig-zag
+
+    if (n < PACK_GROUP && i < count - 1) {
+      continue;
+    }
+
+    // Rice parameter near log2 of mean, best of three
+    uint32_t sum = 0;
+    for (uint8_t j = 0; j < n; j++) {
+      sum += group[j];
+    }
+    uint8_t k = 0;
+    while (k < 15 && (sum / n) >> k) {
+      k++;
+    }
+    uint8_t best = k;
+    uint32_t bestCost = UINT32_MAX;
+    for (uint8_t t = k ? k - 1 : 0; t <= k + 1 && t <= 15; t++) {
+      uint32_t cost = 0;
+      for (uint8_t j = 0; j < n; j++) {
+        uint32_t q = group[j] >> t;
+        cost += (q < PACK_ESCAPE) ? q + 1 + t : PACK_ESCAPE + 16;
+      }
+      if (cost < bestCost) {
+        bestCost = cost;
+        best = t;
+      }
+    }
+
+    PACK_Put(&s, best, PACK_K_BITS);
+    for (uint8_t j = 0; j < n; j++) {
+      uint32_t q = group[j] >> best;
+      if (q < PACK_ESCAPE) {
+        PACK_Put(&s, ((1 << q) - 1) << 1, q + 1); // q ones and a zero
+        PACK_Put(&s, group[j] & ((1 << best) - 1), best);
+      } else {
+        PACK_Put(&s, (1 << PACK_ESCAPE) - 1, PACK_ESCAPE);
+        PACK_Put(&s, group[j], 16);
+      }
+    }
+    if (s.overflow) {
+      return 1;
+    }
+    n = 0;
+  }
+
+  PACK_Put(&s, 0, 7); // flush last bits
+  if (s.overflow) {
+    return 1;
+  }
+  *len = s.p - out;
+  return 0;
+}
+/**
+ * @brief Decodes prediction errors to samples.
+ * @param in Coded data
+ * @param end End of coded data
+ * @param samples Buffer for samples
+ * @param count Number of samples
+ * @param channels Number of channels
+ * @param order Order of predictor (1 or 2)
+ * @retval 0 Samples decoded
+ * @retval 1 Data damaged
+ */
+static uint8_t PACK_Decode(const uint8_t* in, const uint8_t* end,
+    int16_t* samples, uint16_t count, uint8_t channels, uint8_t order) {
+
+  PACK_Bits s = {(uint8_t*)in, (uint8_t*)end, 0, 0, 0};
+  int16_t last[PACK_MAX_CHANNELS] = {0};
+  int16_t delta[PACK_MAX_CHANNELS] = {0};
+  uint8_t k = 0;
+
+  for (uint16_t i = 0; i < count; i++) {
+
+    if (i % PACK_GROUP == 0) {
+      k = PACK_Get(&s, PACK_K_BITS);
+    }
+
+    uint8_t q = 0;
+    while (q < PACK_ESCAPE && PACK_Get(&s, 1)) {
+      q++;
+    }
+    uint16_t u = (q < PACK_ESCAPE) ? (q << k) | PACK_Get(&s, k) :
+        PACK_Get(&s, 16);
+    if (s.overflow) {
+      return 1;
+    }
+
+    int16_t e = (u >> 1) ^ -(u & 1);
+    uint8_t c = i % channels;
+    int16_t d = (order == 2) ? (int16_t)(e + delta[c]) : e;
+    samples[i] = last[c] + d;
+    last[c] = samples[i];
+    delta[c] = d;
+  }
+  return 0;
+}
+/**
+ * @brief Writes bits to stream.
+ * @param s Stream
+ * @param value Bits (right aligned)
+ * @param n Number of bits (up to 24)
+ */
+static void PACK_Put(PACK_Bits* s, uint32_t value, uint8_t n) {
+
+  s->acc = (s->acc << n) | value;
+  s->bits += n;
+
+  while (s->bits >= 8) {
+    if (s->p == s->end) {
+      s->overflow = 1;
+      s->bits = 0;
+      return;
+    }
+    s->bits -= 8;
+    *s->p++ = s->acc >> s->bits;
+  }
+}
+/**
+ * @brief Reads bits from stream.
+ * @param s Stream
+ * @param n Number of bits (up to 24)
+ * @return Bits (right aligned), zeros after end of stream
+ */
+static uint32_t PACK_Get(PACK_Bits* s, uint8_t n) {
+
+  while (s->bits < n) {
+    if (s->p == s->end) {
+      s->overflow = 1;
+      s->acc <<= 8;
+    } else {
+      s->acc = (s->acc << 8) | *s->p++;
+    }
+    s->bits += 8;
+  }
+  s->bits -= n;
+  return (s->acc >> s->bits) & ((1 << n) - 1);
+}
+
+/**
+ * @}
+ */
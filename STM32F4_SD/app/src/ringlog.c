@@ -0,0 +1,378 @@
+/**
+ * @file    ringlog.c
+ * @brief   Circular log in a preallocated file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <ringlog.h>
+#include <fat.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("RINGLOG--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup RINGLOG
+ * @{
+ */
+
+static uint8_t RINGLOG_WriteHeader(RINGLOG_TypeDef* log);
+static uint8_t RINGLOG_WriteBlocks(RINGLOG_TypeDef* log);
+static void RINGLOG_FinishBlock(RINGLOG_TypeDef* log);
+static uint8_t RINGLOG_Recover(RINGLOG_TypeDef* log);
+
+/**
+ * @brief Opens a log.
+ *
+ * @details The file must exist and its size sets the size of the log.
+ * Allocate it in one piece (e.g. on a freshly formatted card),
+ * so blocks are written with multi-block writes. If the file holds
+ * no valid header, an empty log is created. Blocks written after the
+ * last header update are found again, so at most the blocks
+ * still in RAM are lost after a power failure.
+ *
+ * @param log Log structure
+ * @param filename Name of file
+ * @retval 0 Log opened
+ * @retval 1 Error: file not found or too small
+ */
+uint8_t RINGLOG_Open(RINGLOG_TypeDef* log, const char* filename) {
+
+  RINGLOG_Header hdr[RINGLOG_HEADER_BLOCKS];
+  int valid = -1;
+
+  log->file = FAT_OpenFile(filename);
+  if (log->file == -1) {
+    println("File %s not found", filename);
+    return 1;
+  }
+
+  int size = FAT_GetFileSize(log->file);
+  if (size < (RINGLOG_HEADER_BLOCKS + RINGLOG_BUFFER_BLOCKS) * RINGLOG_BLOCK_SIZE) {
+    println("File %s too small", filename);
+    FAT_CloseFile(log->file);
+    return 1;
+  }
+
+  log->blockCount = size / RINGLOG_BLOCK_SIZE - RINGLOG_HEADER_BLOCKS;
+  log->bufBlocks = 0;
+  log->bufUsed = 0;
+
+  // choose the newest valid header
+  for (int i = 0; i < RINGLOG_HEADER_BLOCKS; i++) {
+    FAT_MoveRdPtr(log->file, i * RINGLOG_BLOCK_SIZE);
+    if (FAT_ReadFile(log->file, (uint8_t*)&hdr[i], sizeof(RINGLOG_Header)) !=
+        sizeof(RINGLOG_Header)) {
+      continue;
+    }
+    if (hdr[i].magic != RINGLOG_MAGIC || hdr[i].blockCount != log->blockCount ||
+        hdr[i].checksum != CRC_Calc(&hdr[i],
+            offsetof(RINGLOG_Header, checksum))) {
+      continue;
+    }
+    if (valid == -1 || (int32_t)(hdr[i].commit - hdr[valid].commit) > 0) {
+      valid = i;
+    }
+  }
+
+  if (valid == -1) {
+    println("No valid header, creating empty log of %u blocks",
+        (unsigned int)log->blockCount);
+    log->commit = 0;
+    log->nextSeq = 0;
+    log->oldestSeq = 0;
+    log->commitSeq = 0;
+    // write both copies
+    RINGLOG_WriteHeader(log);
+    return RINGLOG_WriteHeader(log);
+  }
+
+  log->commit = hdr[valid].commit;
+  log->nextSeq = hdr[valid].nextSeq;
+  log->oldestSeq = hdr[valid].oldestSeq;
+  log->commitSeq = log->nextSeq;
+  log->commitOldest = log->oldestSeq;
+
+  return RINGLOG_Recover(log);
+}
+/**
+ * @brief Appends a record to the log.
+ *
+ * @details Records are collected in RAM and written in multi-block
+ * writes. When the log is full, the oldest blocks are overwritten.
+ *
+ * @param log Log structure
+ * @param data Record
+ * @param len Length of record (at most RINGLOG_MAX_RECORD)
+ * @retval 0 Record appended
+ * @retval 1 Error: record too long or write error
+ */
+uint8_t RINGLOG_Append(RINGLOG_TypeDef* log, const uint8_t* data, uint16_t len) {
+
+  if (len > RINGLOG_MAX_RECORD) {
+    println("Record too long");
+    return 1;
+  }
+
+  // start new block if record doesn't fit
+  if (log->bufUsed + 2 + len > RINGLOG_PAYLOAD) {
+    RINGLOG_FinishBlock(log);
+    if (log->bufBlocks == RINGLOG_BUFFER_BLOCKS && RINGLOG_WriteBlocks(log)) {
+      return 1;
+    }
+  }
+
+  uint8_t* ptr = log->buf + log->bufBlocks * RINGLOG_BLOCK_SIZE +
+      sizeof(RINGLOG_BlockHeader) + log->bufUsed;
+
+  ptr[0] = len & 0xff;
+  ptr[1] = len >> 8;
+  memcpy(ptr + 2, data, len);
+  log->bufUsed += 2 + len;
+
+  return 0;
+}
+/**
+ * @brief Writes all records collected in RAM and updates the header.
+ * @details The unused part of the current block is left empty.
+ * @param log Log structure
+ * @retval 0 Log flushed
+ * @retval 1 Write error
+ */
+uint8_t RINGLOG_Flush(RINGLOG_TypeDef* log) {
+
+  if (log->bufUsed) {
+    RINGLOG_FinishBlock(log);
+  }
+  if (RINGLOG_WriteBlocks(log)) {
+    return 1;
+  }
+  if (log->commitSeq != log->nextSeq) {
+    return RINGLOG_WriteHeader(log);
+  }
+  return 0;
+}
+/**
+ * @brief Flushes and closes a log.
+ * @param log Log structure
+ * @retval 0 Log closed
+ * @retval 1 Write error
+ */
+uint8_t RINGLOG_Close(RINGLOG_TypeDef* log) {
+
+  uint8_t ret = RINGLOG_Flush(log);
+  FAT_CloseFile(log->file);
+  log->file = -1;
+  return ret;
+}
+/**
+ * @brief Reads a block of the log.
+ *
+ * @details Valid blocks have sequence numbers from oldestSeq
+ * to nextSeq - 1. Blocks still in RAM are not read.
+ *
+ * @param log Log structure
+ * @param seq Sequence number of block
+ * @param block Buffer for RINGLOG_BLOCK_SIZE bytes
+ * @return Number of payload bytes in block or -1 if block is not valid
+ */
+int RINGLOG_ReadBlock(RINGLOG_TypeDef* log, uint32_t seq, uint8_t* block) {
+
+  RINGLOG_BlockHeader* hdr = (RINGLOG_BlockHeader*)block;
+
+  if ((int32_t)(seq - log->oldestSeq) < 0 ||
+      (int32_t)(seq - (log->nextSeq - log->bufBlocks)) >= 0) {
+    return -1;
+  }
+
+  FAT_MoveRdPtr(log->file, (RINGLOG_HEADER_BLOCKS + seq % log->blockCount) *
+      RINGLOG_BLOCK_SIZE);
+  if (FAT_ReadFile(log->file, block, RINGLOG_BLOCK_SIZE) != RINGLOG_BLOCK_SIZE) {
+    return -1;
+  }
+
+  if (hdr->seq != seq || hdr->used > RINGLOG_PAYLOAD || hdr->checksum !=
+      CRC_Update(CRC_Calc(block, offsetof(RINGLOG_BlockHeader, checksum)),
+      block + sizeof(RINGLOG_BlockHeader), hdr->used)) {
+    return -1;
+  }
+  return hdr->used;
+}
+/**
+ * @brief Writes the header to the older of the two copies.
+ *
+ * @details The header covers the blocks already in the file. When
+ * the log is full, the blocks which may be overwritten before the
+ * next periodic update are dropped from the log now, so the header
+ * never counts an overwritten block as valid. The file is synchronized
+ * before and after the header, as block device layers may reorder
+ * writes.
+ *
+ * @param log Log structure
+ * @retval 0 Header written
+ * @retval 1 Write error
+ */
+static uint8_t RINGLOG_WriteHeader(RINGLOG_TypeDef* log) {
+
+  uint8_t sector[RINGLOG_BLOCK_SIZE];
+  RINGLOG_Header* hdr = (RINGLOG_Header*)sector;
+  uint32_t written = log->nextSeq - log->bufBlocks;
+  uint32_t reach = written + RINGLOG_COMMIT_BLOCKS + RINGLOG_BUFFER_BLOCKS;
+
+  if (reach - log->oldestSeq > log->blockCount) {
+    log->oldestSeq = reach - log->blockCount;
+    if ((int32_t)(log->oldestSeq - written) > 0) {
+      log->oldestSeq = written; // log shorter than one update period
+    }
+  }
+
+  memset(sector, 0, sizeof(sector));
+  log->commit++;
+  hdr->magic = RINGLOG_MAGIC;
+  hdr->commit = log->commit;
+  hdr->blockCount = log->blockCount;
+  hdr->nextSeq = written;
+  hdr->oldestSeq = log->oldestSeq;
+  hdr->checksum = CRC_Calc(sector, offsetof(RINGLOG_Header, checksum));
+
+  FAT_SyncFile(log->file); // blocks reach the card before the header covering them
+  FAT_MoveWrPtr(log->file, (log->commit % RINGLOG_HEADER_BLOCKS) *
+      RINGLOG_BLOCK_SIZE);
+  if (FAT_WriteFile(log->file, sector, RINGLOG_BLOCK_SIZE) != RINGLOG_BLOCK_SIZE) {
+    println("Header write error");
+    return 1;
+  }
+  FAT_SyncFile(log->file); // and the header before dropped blocks are overwritten
+  log->commitSeq = written;
+  log->commitOldest = log->oldestSeq;
+  return 0;
+}
+/**
+ * @brief Closes the current block and assigns it a sequence number.
+ * @param log Log structure
+ */
+static void RINGLOG_FinishBlock(RINGLOG_TypeDef* log) {
+
+  uint8_t* block = log->buf + log->bufBlocks * RINGLOG_BLOCK_SIZE;
+  RINGLOG_BlockHeader* hdr = (RINGLOG_BlockHeader*)block;
+
+  hdr->seq = log->nextSeq;
+  hdr->used = log->bufUsed;
+  hdr->reserved = 0;
+  memset(block + sizeof(RINGLOG_BlockHeader) + log->bufUsed, 0,
+      RINGLOG_PAYLOAD - log->bufUsed);
+  hdr->checksum = CRC_Update(CRC_Calc(block,
+      offsetof(RINGLOG_BlockHeader, checksum)),
+      block + sizeof(RINGLOG_BlockHeader), hdr->used);
+
+  log->nextSeq++;
+  if (log->nextSeq - log->oldestSeq > log->blockCount) {
+    log->oldestSeq = log->nextSeq - log->blockCount; // overwrite oldest
+  }
+  log->bufBlocks++;
+  log->bufUsed = 0;
+}
+/**
+ * @brief Writes finished blocks from RAM to the file.
+ *
+ * @details Blocks are written in at most two multi-block writes
+ * (two if they wrap around the end of the file). The header is
+ * updated every RINGLOG_COMMIT_BLOCKS blocks, and before the blocks
+ * if they overwrite blocks the header still counts as valid.
+ *
+ * @param log Log structure
+ * @retval 0 Blocks written
+ * @retval 1 Write error
+ */
+static uint8_t RINGLOG_WriteBlocks(RINGLOG_TypeDef* log) {
+
+  uint32_t seq = log->nextSeq - log->bufBlocks;
+  uint32_t done = 0;
+
+  // blocks still valid in the header are dropped before they are overwritten
+  if ((int32_t)(log->oldestSeq - log->commitOldest) > 0 &&
+      RINGLOG_WriteHeader(log)) {
+    return 1;
+  }
+
+  while (done < log->bufBlocks) {
+    uint32_t index = (seq + done) % log->blockCount;
+    uint32_t count = log->bufBlocks - done;
+    if (index + count > log->blockCount) {
+      count = log->blockCount - index; // wrap around
+    }
+    FAT_MoveWrPtr(log->file, (RINGLOG_HEADER_BLOCKS + index) * RINGLOG_BLOCK_SIZE);
+    int len = count * RINGLOG_BLOCK_SIZE;
+    if (FAT_WriteFile(log->file, log->buf + done * RINGLOG_BLOCK_SIZE, len) != len) {
+      println("Block write error");
+      return 1;
+    }
+    done += count;
+  }
+  log->bufBlocks = 0;
+
+  if (log->nextSeq - log->commitSeq >= RINGLOG_COMMIT_BLOCKS) {
+    return RINGLOG_WriteHeader(log);
+  }
+  return 0;
+}
+/**
+ * @brief Finds blocks written after the last header update.
+ *
+ * @details Blocks are checked starting from nextSeq of the header,
+ * until a block with a wrong sequence number or checksum is found.
+ *
+ * @param log Log structure
+ * @retval 0 Log recovered
+ * @retval 1 Write error
+ */
+static uint8_t RINGLOG_Recover(RINGLOG_TypeDef* log) {
+
+  uint32_t found = 0;
+
+  // read blocks through the RAM buffer (it is empty now)
+  while (found < log->blockCount) {
+    log->nextSeq++;
+    if (RINGLOG_ReadBlock(log, log->nextSeq - 1, log->buf) == -1) {
+      log->nextSeq--;
+      break;
+    }
+    found++;
+  }
+  if (found == 0) {
+    return 0;
+  }
+
+  println("Recovered %u blocks", (unsigned int)found);
+  if (log->nextSeq - log->oldestSeq > log->blockCount) {
+    log->oldestSeq = log->nextSeq - log->blockCount;
+  }
+  return RINGLOG_WriteHeader(log);
+}
+
+/**
+ * @}
+ */
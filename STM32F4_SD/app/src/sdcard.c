@@ -15,10 +15,14 @@
  * @endverbatim
  */
 
+// with SD_USE_SDIO the card is on the SDIO bus (sdio_card.c)
+#ifndef SD_USE_SDIO
+
 #include <sdcard.h>
 #include <spi1.h>
 #include <timers.h>
 #include <stdio.h>
+#include <string.h>
 #include <utils.h>
 
 /**
@@ -52,6 +56,7 @@
 #define SD_SET_BLOCKLEN             16  ///< Selects block length in bytes for all following block commands
 #define SD_READ_SINGLE_BLOCK        17  ///< Reads a block of size set by SET_BLOCKLEN
 #define SD_READ_MULTIPLE_BLOCK      18  ///< Continuously transfers data blocks from card to host until interrupted by STOP_TRANSMISSION
+#define SD_SET_BLOCK_COUNT          23  ///< Sets number of blocks of following multiple block transfer
 #define SD_WRITE_BLOCK              24  ///< Writes a block of size set by SET_BLOCKLEN
 #define SD_WRITE_MULTIPLE_BLOCK     25  ///< Continuously writes blocks of data until a stop transmission token is sent
 #define SD_PROGRAM_CSD              27  ///< Programs the programmable bits of CSD
@@ -67,6 +72,7 @@
 #define SD_ACMD_SEND_OP_COND        41  ///< Activates the card initialization process, sends host capacity.
 #define SD_ACMD_SEND_SCR            51  ///< Reads SD Configuration register
 #define SD_SEND_NUM_WR_BLOCKS       22  ///< Gets number of well written blocks
+#define SD_SET_WR_BLK_ERASE_COUNT   23  ///< Sets number of blocks to pre-erase before writing
 
 /*
  * Other SD defines
@@ -75,6 +81,15 @@
 #define SD_IF_COND_VOLT   (1<<8)  ///< Signifies voltage range 2.7-3.6V
 #define SD_ACMD41_HCS     (1<<30) ///< Host can handle SDSC and SDHC cards
 
+#define SD_TOKEN_TIMEOUT  100 ///< Time for card to send register or sector data [ms]
+#define SD_BUSY_TIMEOUT   500   ///< Longest busy after write or stop [ms]
+#define SD_RESYNC_BYTES   10    ///< Dummy bytes sent with card deselected (80 clocks)
+#define SD_FAST_DIVIDER   4     ///< SPI clock divider after initialization
+#define SD_SLOWEST_DIVIDER 256  ///< Largest SPI clock divider
+#define SD_CRC_RETRIES    3     ///< Repeats of a command or block after CRC error
+#define SD_R1_COM_CRC     0x08  ///< R1: CRC of command was wrong
+#define SD_SCR_CMD23      0x02  ///< CMD23 support bit in byte 3 of SCR (CMD_SUPPORT)
+
 /*
  * Control tokens
  */
@@ -99,9 +114,33 @@
 #define SD_HAL_TransmitData SPI1_Transmit
 #define SD_HAL_ReadBuffer   SPI1_ReadBuffer
 #define SD_HAL_WriteBuffer  SPI1_WriteBuffer
+#define SD_HAL_Transfer     SPI1_Transfer
+#define SD_HAL_ReadBlockCrc SPI1_ReadBlockCrc
+#define SD_HAL_WriteBlockCrc SPI1_WriteBlockCrc
+#define SD_HAL_SetClockDivider SPI1_SetClockDivider
+
+/*
+ * Results of a run of sectors
+ */
+#define SD_RUN_OK     0 ///< All sectors transferred
+#define SD_RUN_ERROR  1 ///< Transfer failed
+#define SD_RUN_CRC    2 ///< Sector failed CRC check (may be repeated)
 
 static uint8_t isSDHC; ///< Is the card SDHC?
 static uint64_t cardCapacity; ///< Capacity of SD card in bytes
+static uint8_t cardCID[16]; ///< Contents of CID register read during initialization
+static uint8_t initPowerUp; ///< Card is powering up (ACMD41 is sent)
+static uint32_t initStart; ///< Time of SD_StartInit
+static uint32_t initTime; ///< Time of last ACMD41
+static uint32_t initInterval; ///< Time until next ACMD41 [ms]
+static SD_InitStats initStats; ///< Statistics of last initialization
+static uint8_t cmd23Supported; ///< SCR says card supports SET_BLOCK_COUNT
+static uint8_t crcMode; ///< Card checks CRC of commands and data
+static uint8_t policy = SD_POLICY_DEFAULT; ///< Command selection policy
+static uint8_t appCmd; ///< Last command was APP_CMD
+static SD_CommandStats cmdStats; ///< Numbers of commands sent
+static SD_RecoveryStats recoveryStats; ///< Errors and their recovery
+static uint16_t clockDivider = SD_FAST_DIVIDER; ///< SPI clock divider for transfers
 
 /**
  * @brief SD Card R1 response structure
@@ -248,22 +287,62 @@ typedef struct {
 static uint8_t SD_SendCommand(uint8_t cmd, uint32_t args);
 static void SD_GetResponseR3orR7(uint8_t* buf);
 static SD_ResponseR1 SD_ReadOCR(SD_OCR* ocr);
-static void SD_ReadCID(SD_CID* cid);
-static void SD_ReadCSD(SD_CSD* csd);
+static uint8_t SD_ReadCID(SD_CID* cid);
+static uint8_t SD_ReadCSD(SD_CSD* csd);
+static void SD_SendOpCond(void);
+static uint8_t SD_Identify(void);
+static void SD_InitDone(uint8_t error);
+static uint8_t SD_WaitToken(void);
+static uint8_t SD_ReadSCR(void);
+static uint8_t SD_WaitBusy(void);
+static uint8_t SD_Recover(uint8_t (*run)(uint8_t**, uint32_t*, uint32_t*),
+    uint8_t* buf, uint32_t sector, uint32_t count);
+static uint8_t SD_RecoveryStep(uint8_t tier);
+static uint8_t SD_ReadStatus(void);
+static uint8_t SD_RunError(uint8_t r1);
+static uint8_t SD_ReadRun(uint8_t** buf, uint32_t* sector, uint32_t* count);
+static uint8_t SD_WriteRun(uint8_t** buf, uint32_t* sector, uint32_t* count);
+static uint8_t SD_Crc7(const uint8_t* buf, uint8_t len);
 
 /**
  * @brief Initialize the SD card.
  *
  * @details This function initializes both SDSC and SDHC cards.
- * It uses low-level SPI functions.
+ * It uses low-level SPI functions. It waits until the card
+ * finishes power up, see SD_StartInit for initialization which
+ * doesn't block.
+ *
+ * @retval 0 Card is ready
+ * @retval 1 No card or initialization failed
+ */
+uint8_t SD_Init(void) {
+
+  SD_StartInit();
+  return SD_WaitInit();
+}
+/**
+ * @brief Starts initialization of the SD card.
  *
+ * @details Resets the card and starts its power up, which takes
+ * up to hundreds of ms. Other work can be done while the card
+ * powers up, as long as SD_PollInit is called, or SD_WaitInit
+ * before the card is used.
  */
-void SD_Init(void) {
+void SD_StartInit(void) {
 
   int i; // for counter
   uint8_t buf[10]; // buffer for responses
   SD_OCR ocr;
 
+  initStart = TIMER_GetTime();
+  initPowerUp = 0;
+  initStats.powerUpTime = 0;
+  initStats.polls = 0;
+  cardCapacity = 0;
+  for (i = 0; i < 16; i++) {
+    cardCID[i] = 0;
+  }
+
   SD_HAL_Init(); // Initialize SPI interface.
 
   SD_HAL_SelectCard();
@@ -278,6 +357,13 @@ void SD_Init(void) {
   // send CMD0
   resp.responseR1 = SD_SendCommand(SD_GO_IDLE_STATE, 0);
 
+  // MISO stays high without a card
+  if (resp.responseR1 == 0xff) {
+    println("No card");
+    SD_HAL_DeselectCard();
+    SD_InitDone(1);
+    return;
+  }
   // Check response errors
   if (resp.responseR1 != 0x01) {
     println("GO_IDLE_STATE error");
@@ -313,36 +399,229 @@ void SD_Init(void) {
     println("READ_OCR error");
   }
 
-  // Send ACMD41 until card goes out of IDLE state
-  for (i=0; i<10; i++) {
+  // CMD59 - card checks CRC of all commands and data blocks from now on
+  resp.responseR1 = SD_SendCommand(SD_CRC_ON_OFF, 1);
+  crcMode = (resp.responseR1 == 0x01);
+  if (!crcMode) {
+    println("CRC_ON_OFF error");
+  }
 
-    resp.responseR1 = SD_SendCommand(SD_APP_CMD, 0);
-    resp.responseR1 = SD_SendCommand(SD_ACMD_SEND_OP_COND, SD_ACMD41_HCS);
-    // Without this delay card wouldn't initialize the first time after
-    // power was connected.
-    TIMER_Delay(20);
-    if (resp.responseR1 == 0x00) { // Card left IDLE state and no errors
-      break;
-    }
+  // first ACMD41 starts the power up
+  initPowerUp = 1;
+  initInterval = SD_INIT_INTERVAL_MIN;
+  SD_SendOpCond();
 
-    if (i == 9) {
-      println("Failed to initialize SD card");
-      while(1);
-    }
+  SD_HAL_DeselectCard();
+}
+/**
+ * @brief Continues initialization of the SD card.
+ *
+ * @details Sends the next ACMD41 when its interval has passed and reads
+ * the card registers when the card has left IDLE state. Returns at once
+ * otherwise.
+ *
+ * @retval 0 Initialization finished (or wasn't started)
+ * @retval 1 Card is still powering up
+ */
+uint8_t SD_PollInit(void) {
+
+  if (!initPowerUp) {
+    return 0;
+  }
+  if (TIMER_GetTime() - initTime < initInterval) {
+    return 1;
+  }
+
+  SD_HAL_SelectCard();
+  SD_SendOpCond();
+  SD_HAL_DeselectCard();
+
+  return initPowerUp;
+}
+/**
+ * @brief Waits until the card started by SD_StartInit is initialized.
+ * @retval 0 Card is ready
+ * @retval 1 No card or initialization failed
+ */
+uint8_t SD_WaitInit(void) {
+
+  while (SD_PollInit());
+  return initStats.error;
+}
+/**
+ * @brief Gets statistics of the last initialization.
+ * @param stats Statistics (function writes this)
+ */
+void SD_GetInitStats(SD_InitStats* stats) {
+
+  *stats = initStats;
+  for (int i = 0; i < 16; i++) {
+    stats->cid[i] = cardCID[i];
+  }
+}
+/**
+ * @brief Gets the capacity of the card.
+ * @return Card capacity in bytes.
+ */
+uint64_t SD_ReadCapacity(void) {
+
+  return cardCapacity;
+}
+/**
+ * @brief Gets the CID register of the card.
+ * @details The register is read during SD_Init. Its manufacturer
+ * ID, name and serial number identify the card.
+ * @param cid Buffer for 16 bytes of CID (function writes this)
+ */
+void SD_GetCID(uint8_t* cid) {
+
+  for (int i = 0; i < 16; i++) {
+    cid[i] = cardCID[i];
+  }
+}
+/**
+ * @brief Read sectors from SD card
+ * @details Errors are recovered from as described in SD_Recover. The
+ * sector which could not be read is in SD_RecoveryStats.
+ * @param buf Data buffer
+ * @param sector Start sector
+ * @param count Number of sectors to read
+ * @retval 0 Read was successful
+ * @retval 1 Error occurred
+ */
+uint8_t SD_ReadSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  return SD_Recover(SD_ReadRun, buf, sector, count);
+}
+/**
+ * @brief Write sectors to SD card
+ * @details Errors are recovered from as described in SD_Recover. The
+ * sector which could not be written is in SD_RecoveryStats.
+ * @param buf Data buffer
+ * @param sector First sector to write
+ * @param count Number of sectors to write
+ * @retval 0 Write was successful
+ * @retval 1 Error occurred
+ */
+uint8_t SD_WriteSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  return SD_Recover(SD_WriteRun, buf, sector, count);
+}
+/**
+ * @brief Turns CRC checking of commands and data on or off.
+ * @details CRC is turned on during initialization if the card accepts
+ * it. Data CRC is calculated by the SPI, so it costs no time.
+ * @param on 1 - on, 0 - off
+ * @retval 0 Card accepted the change
+ * @retval 1 Error occurred
+ */
+uint8_t SD_SetCrcMode(uint8_t on) {
+
+  SD_ResponseR1 resp;
+
+  SD_HAL_SelectCard();
+  resp.responseR1 = SD_SendCommand(SD_CRC_ON_OFF, on ? 1 : 0);
+  SD_HAL_DeselectCard();
+
+  if (resp.responseR1 & ~0x01) {
+    println("SD_CRC_ON_OFF error");
+    return 1;
   }
+  crcMode = on ? 1 : 0;
+  return 0;
+}
+/**
+ * @brief Sets which commands transfer sectors.
+ * @details For comparing the commands, all are used by default.
+ * @param newPolicy SD_POLICY_ flags
+ */
+void SD_SetCommandPolicy(uint8_t newPolicy) {
+
+  policy = newPolicy;
+}
+/**
+ * @brief Gets numbers of commands sent since start or last clear.
+ * @param stats Numbers of commands (function writes this)
+ */
+void SD_GetCommandStats(SD_CommandStats* stats) {
+
+  *stats = cmdStats;
+}
+/**
+ * @brief Clears numbers of commands.
+ */
+void SD_ClearCommandStats(void) {
+
+  memset(&cmdStats, 0, sizeof(cmdStats));
+}
+/**
+ * @brief Gets errors of transfers and their recovery since start or
+ * last clear.
+ * @param stats Statistics (function writes this)
+ */
+void SD_GetRecoveryStats(SD_RecoveryStats* stats) {
+
+  *stats = recoveryStats;
+}
+/**
+ * @brief Clears statistics of recovery.
+ */
+void SD_ClearRecoveryStats(void) {
+
+  memset(&recoveryStats, 0, sizeof(recoveryStats));
+}
+/**
+ * @brief Sends ACMD41 once during power up of the card.
+ * @details The card must be selected. A card which is still busy
+ * is asked again after twice as long, up to SD_INIT_INTERVAL_MAX.
+ */
+static void SD_SendOpCond(void) {
+
+  SD_ResponseR1 resp;
+
+  resp.responseR1 = SD_SendCommand(SD_APP_CMD, 0);
+  resp.responseR1 = SD_SendCommand(SD_ACMD_SEND_OP_COND, SD_ACMD41_HCS);
+  initTime = TIMER_GetTime();
+  initStats.polls++;
+
+  if (resp.responseR1 == 0x00) { // Card left IDLE state and no errors
+    initStats.powerUpTime = initTime - initStart;
+    SD_InitDone(SD_Identify());
+  } else if (initTime - initStart > SD_INIT_TIMEOUT) {
+    println("Card not ready after %u ms", (unsigned int)(initTime - initStart));
+    SD_InitDone(1);
+  } else if (initInterval < SD_INIT_INTERVAL_MAX) {
+    initInterval *= 2;
+  }
+}
+/**
+ * @brief Reads the card registers after power up.
+ * @details The card must be selected.
+ * @retval 0 Card is ready
+ * @retval 1 Registers could not be read
+ */
+static uint8_t SD_Identify(void) {
+
+  SD_OCR ocr;
+  SD_ResponseR1 resp;
 
   // read CID
   SD_CID cid;
-  SD_ReadCID(&cid);
+  if (SD_ReadCID(&cid)) {
+    return 1;
+  }
   // read CSD to get card capacity
   SD_CSD csd;
-  SD_ReadCSD(&csd);
+  if (SD_ReadCSD(&csd)) {
+    return 1;
+  }
 
   // Read Card Capacity Status - SDSC or SDHC?
   resp = SD_ReadOCR(&ocr);
 
   if (resp.responseR1 != 0x00) {
     println("READ_OCR error");
+    return 1;
   }
 
   // check capacity
@@ -354,109 +633,422 @@ void SD_Init(void) {
     isSDHC = 0;
   }
 
-  SD_HAL_DeselectCard();
+  // only optional commands depend on SCR, so the card works without it
+  cmd23Supported = 0;
+  if (SD_ReadSCR()) {
+    println("SCR not read");
+  }
+  return 0;
+}
+/**
+ * @brief Ends initialization and saves its statistics.
+ * @param error Nonzero if initialization failed
+ */
+static void SD_InitDone(uint8_t error) {
+
+  initPowerUp = 0;
+  initStats.error = error;
+  initStats.initTime = TIMER_GetTime() - initStart;
 
+  if (error) {
+    cardCapacity = 0;
+    println("Failed to initialize SD card");
+  } else {
+    println("Card ready in %u ms, %u ACMD41", (unsigned int)initStats.initTime,
+        (unsigned int)initStats.polls);
+    SD_HAL_SetClockDivider(clockDivider); // initialized at slow clock
+  }
 }
 /**
- * @brief Gets the capacity of the card.
- * @return Card capacity in bytes.
+ * @brief Waits for the start block token of register data.
+ * @retval 0 Token received
+ * @retval 1 Timeout
  */
-uint64_t SD_ReadCapacity(void) {
+static uint8_t SD_WaitToken(void) {
 
-  return cardCapacity;
+  uint32_t start = TIMER_GetTime();
+
+  while (SD_HAL_TransmitData(0xff) != SD_TOKEN_SBR_MBR_SBW) {
+    if (TIMER_GetTime() - start > SD_TOKEN_TIMEOUT) {
+      println("No data token");
+      return 1;
+    }
+  }
+  return 0;
 }
 /**
- * @brief Read sectors from SD card
+ * @brief Transfers sectors and recovers from errors.
+ * @details After an error the transfer is continued from the failed
+ * sector after each recovery tier in turn, from the cheapest (repeating
+ * the sector) to initializing the card again. CRC errors are repeated
+ * up to SD_CRC_RETRIES times before going to the next tier. When a
+ * sector is transferred, the next error starts again from the first
+ * tier.
+ * @param run Function transferring sectors
  * @param buf Data buffer
- * @param sector Start sector
- * @param count Number of sectors to write
- * @retval 0 Read was successful
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Transfer was successful
  * @retval 1 Error occurred
  */
-uint8_t SD_ReadSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+static uint8_t SD_Recover(uint8_t (*run)(uint8_t**, uint32_t*, uint32_t*),
+    uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  uint8_t result;
+  uint8_t tier = SD_TIER_RETRY;
+  uint8_t tries = 0;
+  uint32_t left = count;
+  uint32_t start;
+
+  result = run(&buf, &sector, &count);
+  if (result == SD_RUN_OK) {
+    return 0;
+  }
+  recoveryStats.errors++;
+
+  while (result != SD_RUN_OK) {
+    if (count < left) {
+      // some sectors were transferred - start again from first tier
+      left = count;
+      tier = SD_TIER_RETRY;
+      tries = 0;
+    } else if (tries >= ((tier == SD_TIER_RETRY && result == SD_RUN_CRC) ?
+        SD_CRC_RETRIES : 1)) {
+      if (++tier == SD_TIERS) {
+        recoveryStats.failed++;
+        recoveryStats.errorSector = sector;
+        println("Error at sector %u", (unsigned int)sector);
+        return 1;
+      }
+      tries = 0;
+    }
+    tries++;
+    recoveryStats.attempts[tier]++;
+
+    start = TIMER_GetTime();
+    if (SD_RecoveryStep(tier) == 0) {
+      result = run(&buf, &sector, &count);
+    }
+    recoveryStats.time[tier] += TIMER_GetTime() - start;
+  }
+
+  recoveryStats.recovered[tier]++;
+  return 0;
+}
+/**
+ * @brief Brings the card back to a state for a transfer.
+ * @param tier Recovery tier
+ * @retval 0 Transfer may be repeated
+ * @retval 1 Tier can't help
+ */
+static uint8_t SD_RecoveryStep(uint8_t tier) {
+
+  uint8_t result = 0;
+  uint8_t crc = crcMode;
+  uint16_t div;
+
+  switch (tier) {
+  case SD_TIER_RESYNC:
+    // card resets its command framing with clocks while deselected
+    SD_HAL_DeselectCard();
+    for (int i = 0; i < SD_RESYNC_BYTES; i++) {
+      SD_HAL_TransmitData(0xff);
+    }
+    SD_HAL_SelectCard();
+    result = SD_WaitBusy();
+    SD_HAL_DeselectCard();
+    break;
+  case SD_TIER_STATUS:
+    // stop anything still going on and clear error bits of status
+    SD_HAL_SelectCard();
+    SD_SendCommand(SD_STOP_TRANSMISSION, 0);
+    result = SD_WaitBusy();
+    if (result == 0) {
+      result = SD_ReadStatus();
+    }
+    SD_HAL_DeselectCard();
+    break;
+  case SD_TIER_SLOW:
+    div = SD_HAL_SetClockDivider(SD_SLOWEST_DIVIDER);
+    if (div >= SD_SLOWEST_DIVIDER) {
+      result = 1; // nothing slower
+    } else {
+      clockDivider = div * 2;
+      println("SPI clock divided by %u", (unsigned int)clockDivider);
+    }
+    SD_HAL_SetClockDivider(clockDivider);
+    break;
+  case SD_TIER_REINIT:
+    result = SD_Init();
+    if (result == 0 && !crc) {
+      result = SD_SetCrcMode(0);
+    }
+    break;
+  default:
+    break;
+  }
+  return result;
+}
+/**
+ * @brief Reads card status (CMD13).
+ * @details Reading clears the error bits. The card must be selected.
+ * @retval 0 Card answered
+ * @retval 1 No response
+ */
+static uint8_t SD_ReadStatus(void) {
+
+  uint8_t r1;
+  uint8_t r2;
+
+  r1 = SD_SendCommand(SD_SEND_STATUS, 0);
+  if (r1 == 0xff) {
+    println("SD_SEND_STATUS error");
+    return 1;
+  }
+  r2 = SD_HAL_TransmitData(0xff); // second byte of R2
+  if (r1 || r2) {
+    println("Card status %02x %02x", (unsigned int)r1, (unsigned int)r2);
+  }
+  return 0;
+}
+/**
+ * @brief Result of a run which ended with a command error.
+ * @param r1 Response to the command
+ * @return SD_RUN_CRC if the command was damaged, otherwise SD_RUN_ERROR
+ */
+static uint8_t SD_RunError(uint8_t r1) {
+
+  return (r1 != 0xff && (r1 & SD_R1_COM_CRC)) ? SD_RUN_CRC : SD_RUN_ERROR;
+}
+/**
+ * @brief Reads sectors with one read command.
+ * @details Stops at the first error. The arguments are moved past the
+ * sectors read.
+ * @param buf Data buffer
+ * @param sector First sector
+ * @param count Number of sectors
+ * @return SD_RUN_OK, SD_RUN_ERROR or SD_RUN_CRC
+ */
+static uint8_t SD_ReadRun(uint8_t** buf, uint32_t* sector, uint32_t* count) {
 
   SD_ResponseR1 resp;
+  uint8_t single = (*count == 1) && (policy & SD_POLICY_SINGLE);
+  uint8_t counted = !single && cmd23Supported && (policy & SD_POLICY_CMD23);
+  uint8_t result = SD_RUN_OK;
 
-  // SDSC cards use byte addressing, SDHC use block addressing
-  if (!isSDHC) {
-    sector *= 512;
+  if (*count == 0) {
+    return SD_RUN_OK;
   }
 
   SD_HAL_SelectCard();
 
-  resp.responseR1 = SD_SendCommand(SD_READ_MULTIPLE_BLOCK, sector);
+  // card stops by itself after a known number of blocks
+  if (counted) {
+    resp.responseR1 = SD_SendCommand(SD_SET_BLOCK_COUNT, *count);
+    if (resp.responseR1 != 0x00) {
+      println("SD_SET_BLOCK_COUNT error");
+      SD_HAL_DeselectCard();
+      return SD_RunError(resp.responseR1);
+    }
+  }
+
+  // SDSC cards use byte addressing, SDHC use block addressing
+  resp.responseR1 = SD_SendCommand(single ? SD_READ_SINGLE_BLOCK :
+      SD_READ_MULTIPLE_BLOCK, isSDHC ? *sector : *sector * 512);
 
   if (resp.responseR1 != 0x00) {
-    println("SD_READ_MULTIPLE_BLOCK error");
+    println("SD_READ_BLOCK error");
     SD_HAL_DeselectCard();
-    return 1;
+    return SD_RunError(resp.responseR1);
   }
 
-  while (count) {
-    while (SD_HAL_TransmitData(0xff) != SD_TOKEN_SBR_MBR_SBW); // wait for data token
-    SD_HAL_ReadBuffer(buf, 512);
-    SD_HAL_TransmitData(0xff);
-    SD_HAL_TransmitData(0xff); // two bytes CRC
-    count--;
-    buf += 512; // move buffer pointer forward
+  while (*count) {
+    if (SD_WaitToken()) {
+      result = SD_RUN_ERROR;
+      break;
+    }
+    if (crcMode) {
+      if (SD_HAL_ReadBlockCrc(*buf, 512)) {
+        cmdStats.crcErrors++;
+        result = SD_RUN_CRC;
+        break;
+      }
+    } else {
+      SD_HAL_ReadBuffer(*buf, 512);
+      SD_HAL_TransmitData(0xff);
+      SD_HAL_TransmitData(0xff); // two bytes CRC
+    }
+    (*count)--;
+    (*sector)++;
+    *buf += 512; // move buffer pointer forward
   }
 
-  resp.responseR1 = SD_SendCommand(SD_STOP_TRANSMISSION, 0);
+  // stop also ends a counted read early
+  if (!single && (!counted || *count)) {
+    resp.responseR1 = SD_SendCommand(SD_STOP_TRANSMISSION, 0);
 
-  // R1b response - check busy flag
-  while(!SD_HAL_TransmitData(0xff));
+    // R1b response - check busy flag
+    if (SD_WaitBusy()) {
+      result = SD_RUN_ERROR;
+    }
+  }
 
   SD_HAL_DeselectCard();
 
-  return 0;
+  return result;
 }
 /**
- * @brief Write sectors to SD card
+ * @brief Writes sectors with one write command.
+ * @details Stops at the first error. The arguments are moved past the
+ * sectors written.
  * @param buf Data buffer
- * @param sector First sector to write
- * @param count Number of sectors to write
- * @retval 0 Read was successful
- * @retval 1 Error occurred
+ * @param sector First sector
+ * @param count Number of sectors
+ * @return SD_RUN_OK, SD_RUN_ERROR or SD_RUN_CRC
  */
-uint8_t SD_WriteSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+static uint8_t SD_WriteRun(uint8_t** buf, uint32_t* sector, uint32_t* count) {
 
   SD_ResponseR1 resp;
+  uint8_t single = (*count == 1) && (policy & SD_POLICY_SINGLE);
+  uint8_t counted = !single && cmd23Supported && (policy & SD_POLICY_CMD23);
+  uint8_t result = SD_RUN_OK;
+  uint8_t dataResp;
 
-  // SDSC cards use byte addressing, SDHC use block addressing
-  if (!isSDHC) {
-    sector *= 512;
+  if (*count == 0) {
+    return SD_RUN_OK;
   }
 
   SD_HAL_SelectCard();
 
-  resp.responseR1 = SD_SendCommand(SD_WRITE_MULTIPLE_BLOCK, sector);
+  // card can erase all blocks at once instead of block by block
+  if (!single && (policy & SD_POLICY_PRE_ERASE)) {
+    resp.responseR1 = SD_SendCommand(SD_APP_CMD, 0);
+    if (resp.responseR1 == 0x00) {
+      resp.responseR1 = SD_SendCommand(SD_SET_WR_BLK_ERASE_COUNT, *count);
+    }
+    if (resp.responseR1 != 0x00) {
+      println("SD_SET_WR_BLK_ERASE_COUNT error");
+      SD_HAL_DeselectCard();
+      return SD_RunError(resp.responseR1);
+    }
+  }
+  // card ends by itself after a known number of blocks
+  if (counted) {
+    resp.responseR1 = SD_SendCommand(SD_SET_BLOCK_COUNT, *count);
+    if (resp.responseR1 != 0x00) {
+      println("SD_SET_BLOCK_COUNT error");
+      SD_HAL_DeselectCard();
+      return SD_RunError(resp.responseR1);
+    }
+  }
+
+  // SDSC cards use byte addressing, SDHC use block addressing
+  resp.responseR1 = SD_SendCommand(single ? SD_WRITE_BLOCK :
+      SD_WRITE_MULTIPLE_BLOCK, isSDHC ? *sector : *sector * 512);
 
   if (resp.responseR1 != 0x00) {
-    println("SD_WRITE_MULTIPLE_BLOCK error");
+    println("SD_WRITE_BLOCK error");
     SD_HAL_DeselectCard();
-    return 1;
+    return SD_RunError(resp.responseR1);
   }
 
-  while (count) {
-    SD_HAL_TransmitData(0xfc); // send start block token
-    SD_HAL_WriteBuffer(buf, 512);
-    SD_HAL_TransmitData(0xff);
-    SD_HAL_TransmitData(0xff); // two bytes CRC
-    count--;
-    buf += 512; // move buffer pointer forward
+  while (*count) {
+    // send start block token
+    SD_HAL_TransmitData(single ? SD_TOKEN_SBR_MBR_SBW : SD_TOKEN_MBW_START);
+    if (crcMode) {
+      SD_HAL_WriteBlockCrc(*buf, 512);
+    } else {
+      SD_HAL_WriteBuffer(*buf, 512);
+      SD_HAL_TransmitData(0xff);
+      SD_HAL_TransmitData(0xff); // two bytes CRC
+    }
 
     // data response
+    dataResp = SD_HAL_TransmitData(0xff) & 0x1f;
+
+    // wait while card is busy
+    if (SD_WaitBusy()) {
+      result = SD_RUN_ERROR;
+      break;
+    }
+    if (dataResp != SD_TOKEN_DATA_ACCEPTED) {
+      println("Data rejected (%02x)", (unsigned int)dataResp);
+      if (dataResp == SD_TOKEN_DATA_CRC) {
+        cmdStats.crcErrors++;
+        result = SD_RUN_CRC;
+      } else {
+        result = SD_RUN_ERROR;
+      }
+      break;
+    }
+    (*count)--;
+    (*sector)++;
+    *buf += 512; // move buffer pointer forward
+  }
+
+  // stop token also ends a counted write early
+  if (!single && (!counted || *count)) {
+    SD_HAL_TransmitData(SD_TOKEN_MBW_STOP); // stop transmission token
     SD_HAL_TransmitData(0xff);
+    // wait while card is busy
+    if (SD_WaitBusy()) {
+      result = SD_RUN_ERROR;
+    }
+  }
+
+  SD_HAL_DeselectCard();
+
+  return result;
+}
+/**
+ * @brief Waits while card is busy (holds MISO low).
+ * @retval 0 Card is ready
+ * @retval 1 Timeout
+ */
+static uint8_t SD_WaitBusy(void) {
+
+  uint32_t start = TIMER_GetTime();
+
+  while (!SD_HAL_TransmitData(0xff)) {
+    cmdStats.busyBytes++;
+    if (TIMER_GetTime() - start > SD_BUSY_TIMEOUT) {
+      println("Card busy");
+      return 1;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Reads SCR register and the commands supported by the card.
+ * @retval 0 Register read
+ * @retval 1 Error occurred
+ */
+static uint8_t SD_ReadSCR(void) {
+
+  uint8_t buf[8];
+  SD_ResponseR1 resp;
+
+  SD_SendCommand(SD_APP_CMD, 0);
+  resp.responseR1 = SD_SendCommand(SD_ACMD_SEND_SCR, 0);
 
-    while(!SD_HAL_TransmitData(0xff)); // wait while card is busy
+  if (resp.responseR1 != 0x00) {
+    println("SD_SEND_SCR error");
+    return 1;
   }
 
-  SD_HAL_TransmitData(0xfd); // stop transmission token
+  // SCR is sent as a data block
+  if (SD_WaitToken()) {
+    return 1;
+  }
+  SD_HAL_ReadBuffer(buf, 8);
   SD_HAL_TransmitData(0xff);
-  while(!SD_HAL_TransmitData(0xff)); // wait while card is busy
+  SD_HAL_TransmitData(0xff); // two bytes CRC
 
-  SD_HAL_DeselectCard();
+  cmd23Supported = (buf[3] & SD_SCR_CMD23) ? 1 : 0;
+  println("SCR: spec %u, CMD23 %s", (unsigned int)(buf[0] & 0x0f),
+      cmd23Supported ? "supported" : "not supported");
 
+  SD_HAL_TransmitData(0xff);
   return 0;
 }
 /**
@@ -497,8 +1089,10 @@ static SD_ResponseR1 SD_ReadOCR(SD_OCR* ocr) {
 /**
  * @brief Read CID register of SD card
  * @param cid Structure for filling CID register.
+ * @retval 0 Register read
+ * @retval 1 Error occurred
  */
-static void SD_ReadCID(SD_CID* cid) {
+static uint8_t SD_ReadCID(SD_CID* cid) {
 
   uint8_t buf[16];
   SD_ResponseR1 resp;
@@ -507,12 +1101,14 @@ static void SD_ReadCID(SD_CID* cid) {
 
   if (resp.responseR1 != 0x00) {
     println("SD_SEND_CID error");
-    return;
+    return 1;
   }
 
   // Read CID implemented as read block
   // So do the same as for read block
-  while (SD_HAL_TransmitData(0xff) != SD_TOKEN_SBR_MBR_SBW); // wait for data token
+  if (SD_WaitToken()) {
+    return 1;
+  }
   SD_HAL_ReadBuffer(buf, 16);
   SD_HAL_TransmitData(0xff);
   SD_HAL_TransmitData(0xff); // two bytes CRC
@@ -520,13 +1116,13 @@ static void SD_ReadCID(SD_CID* cid) {
   uint8_t* ptr = (uint8_t*)cid;
   for (int i = 0; i < 16; i++) {
     ptr[i] = buf[i];
+    cardCID[i] = buf[i];
   }
 
   hexdumpC(buf, 16);
 
-  // R1b response - check busy flag
-  while(!SD_HAL_TransmitData(0xff));
-
+  SD_HAL_TransmitData(0xff);
+  return 0;
 }
 /**
  * @brief Read CSD register of SD card
@@ -535,8 +1131,10 @@ static void SD_ReadCID(SD_CID* cid) {
  * variable holding the capacity of the card in bytes.
  *
  * @param csd Structure for filling CSD register.
+ * @retval 0 Register read
+ * @retval 1 Error occurred
  */
-static void SD_ReadCSD(SD_CSD* csd) {
+static uint8_t SD_ReadCSD(SD_CSD* csd) {
 
   uint8_t buf[16];
   SD_ResponseR1 resp;
@@ -545,12 +1143,14 @@ static void SD_ReadCSD(SD_CSD* csd) {
 
   if (resp.responseR1 != 0x00) {
     println("SD_SEND_CSD error");
-    return;
+    return 1;
   }
 
   // Read CID implemented as read block
   // So do the same as for read block
-  while (SD_HAL_TransmitData(0xff) != SD_TOKEN_SBR_MBR_SBW); // wait for data token
+  if (SD_WaitToken()) {
+    return 1;
+  }
   SD_HAL_ReadBuffer(buf, 16);
   SD_HAL_TransmitData(0xff);
   SD_HAL_TransmitData(0xff); // two bytes CRC
@@ -573,9 +1173,8 @@ static void SD_ReadCSD(SD_CSD* csd) {
   // with %llu format
   println("Card capacity: %u", (unsigned int)cardCapacity);
 
-  // R1b response - check busy flag
-  while(!SD_HAL_TransmitData(0xff));
-
+  SD_HAL_TransmitData(0xff);
+  return 0;
 }
 /**
  * @brief Sends a command to the SD card.
@@ -589,31 +1188,100 @@ static void SD_ReadCSD(SD_CSD* csd) {
  */
 static uint8_t SD_SendCommand(uint8_t cmd, uint32_t args) {
 
-  SD_HAL_TransmitData(0x40 | cmd);
-  SD_HAL_TransmitData(args >> 24); // MSB first
-  SD_HAL_TransmitData(args >> 16);
-  SD_HAL_TransmitData(args >> 8);
-  SD_HAL_TransmitData(args);
+  uint8_t frame[6];
+  uint8_t resp[8];
+  uint8_t retries;
+  uint8_t app = appCmd;
 
-  // CRC is irrelevant while using SPI interface - only checked for some commands.
-  switch (cmd) {
-  case SD_GO_IDLE_STATE:
-    SD_HAL_TransmitData(0x95);
-    break;
-  case SD_SEND_IF_COND:
-    SD_HAL_TransmitData(0x87);
-    break;
-  default:
-    SD_HAL_TransmitData(0xff);
+  if (app) {
+    cmdStats.acmd[cmd % SD_COMMANDS]++;
+  } else {
+    cmdStats.cmd[cmd % SD_COMMANDS]++;
+  }
+  appCmd = (cmd == SD_APP_CMD);
+
+  frame[0] = 0x40 | cmd;
+  frame[1] = args >> 24; // MSB first
+  frame[2] = args >> 16;
+  frame[3] = args >> 8;
+  frame[4] = args;
+  // CRC is checked for CMD0 and CMD8 and for all commands in CRC mode
+  frame[5] = SD_Crc7(frame, 5) | 0x01; // end bit
+
+  for (retries = 0; ; retries++) {
+    // Practice has shown that a valid response token
+    // is sent as the second byte by the card.
+    // So, we send a dummy byte first.
+    memcpy(resp, frame, sizeof(frame));
+    resp[6] = 0xff;
+    resp[7] = 0xff;
+
+    // whole command and response in one transfer without gaps
+    SD_HAL_Transfer(resp, resp, sizeof(resp));
+//    println("Response to cmd %d is %02x", cmd, resp[7]);
+
+    // A damaged command has no effect, so it can be sent again.
+    // Application commands would need APP_CMD again - caller repeats them.
+    if (resp[7] == 0xff || !(resp[7] & SD_R1_COM_CRC)) {
+      break;
+    }
+    cmdStats.crcErrors++;
+    if (app || retries == SD_CRC_RETRIES) {
+      break;
+    }
   }
-  // Practice has shown that a valid response token
-  // is sent as the second byte by the card.
-  // So, we send a dummy byte first.
-  SD_HAL_TransmitData(0xff);
-  uint8_t ret = SD_HAL_TransmitData(0xff);
-//  println("Response to cmd %d is %02x", cmd, ret);
 
-  return ret;
+  return resp[7];
+}
+/**
+ * @brief Calculates CRC7 of a command.
+ * @param buf Command bytes
+ * @param len Number of bytes
+ * @return CRC7 in the upper seven bits
+ */
+static uint8_t SD_Crc7(const uint8_t* buf, uint8_t len) {
+
+  // CRC7 (x^7 + x^3 + 1) of every byte value, shifted left by one bit
+  static const uint8_t crc7Table[256] = {
+    0x00, 0x12, 0x24, 0x36, 0x48, 0x5a, 0x6c, 0x7e,
+    0x90, 0x82, 0xb4, 0xa6, 0xd8, 0xca, 0xfc, 0xee,
+    0x32, 0x20, 0x16, 0x04, 0x7a, 0x68, 0x5e, 0x4c,
+    0xa2, 0xb0, 0x86, 0x94, 0xea, 0xf8, 0xce, 0xdc,
+    0x64, 0x76, 0x40, 0x52, 0x2c, 0x3e, 0x08, 0x1a,
+    0xf4, 0xe6, 0xd0, 0xc2, 0xbc, 0xae, 0x98, 0x8a,
+    0x56, 0x44, 0x72, 0x60, 0x1e, 0x0c, 0x3a, 0x28,
+    0xc6, 0xd4, 0xe2, 0xf0, 0x8e, 0x9c, 0xaa, 0xb8,
+    0xc8, 0xda, 0xec, 0xfe, 0x80, 0x92, 0xa4, 0xb6,
+    0x58, 0x4a, 0x7c, 0x6e, 0x10, 0x02, 0x34, 0x26,
+    0xfa, 0xe8, 0xde, 0xcc, 0xb2, 0xa0, 0x96, 0x84,
+    0x6a, 0x78, 0x4e, 0x5c, 0x22, 0x30, 0x06, 0x14,
+    0xac, 0xbe, 0x88, 0x9a, 0xe4, 0xf6, 0xc0, 0xd2,
+    0x3c, 0x2e, 0x18, 0x0a, 0x74, 0x66, 0x50, 0x42,
+    0x9e, 0x8c, 0xba, 0xa8, 0xd6, 0xc4, 0xf2, 0xe0,
+    0x0e, 0x1c, 0x2a, 0x38, 0x46, 0x54, 0x62, 0x70,
+    0x82, 0x90, 0xa6, 0xb4, 0xca, 0xd8, 0xee, 0xfc,
+    0x12, 0x00, 0x36, 0x24, 0x5a, 0x48, 0x7e, 0x6c,
+    0xb0, 0xa2, 0x94, 0x86, 0xf8, 0xea, 0xdc, 0xce,
+    0x20, 0x32, 0x04, 0x16, 0x68, 0x7a, 0x4c, 0x5e,
+    0xe6, 0xf4, 0xc2, 0xd0, 0xae, 0xbc, 0x8a, 0x98,
+    0x76, 0x64, 0x52, 0x40, 0x3e, 0x2c, 0x1a, 0x08,
+    0xd4, 0xc6, 0xf0, 0xe2, 0x9c, 0x8e, 0xb8, 0xaa,
+    0x44, 0x56, 0x60, 0x72, 0x0c, 0x1e, 0x28, 0x3a,
+    0x4a, 0x58, 0x6e, 0x7c, 0x02, 0x10, 0x26, 0x34,
+    0xda, 0xc8, 0xfe, 0xec, 0x92, 0x80, 0xb6, 0xa4,
+    0x78, 0x6a, 0x5c, 0x4e, 0x30, 0x22, 0x14, 0x06,
+    0xe8, 0xfa, 0xcc, 0xde, 0xa0, 0xb2, 0x84, 0x96,
+    0x2e, 0x3c, 0x0a, 0x18, 0x66, 0x74, 0x42, 0x50,
+    0xbe, 0xac, 0x9a, 0x88, 0xf6, 0xe4, 0xd2, 0xc0,
+    0x1c, 0x0e, 0x38, 0x2a, 0x54, 0x46, 0x70, 0x62,
+    0x8c, 0x9e, 0xa8, 0xba, 0xc4, 0xd6, 0xe0, 0xf2
+  };
+  uint8_t crc = 0;
+
+  while (len--) {
+    crc = crc7Table[crc ^ *buf++];
+  }
+  return crc;
 }
 /**
  * @brief Get R3 or R7 response from card
@@ -626,13 +1294,10 @@ static uint8_t SD_SendCommand(uint8_t cmd, uint32_t args) {
  */
 static void SD_GetResponseR3orR7(uint8_t* buf) {
 
-  uint8_t i = 0;
-  buf[i++] = SD_HAL_TransmitData(0xff);
-  buf[i++] = SD_HAL_TransmitData(0xff);
-  buf[i++] = SD_HAL_TransmitData(0xff);
-  buf[i++] = SD_HAL_TransmitData(0xff);
-
+  SD_HAL_ReadBuffer(buf, 4);
 }
 /**
  * @}
  */
+
+#endif /* SD_USE_SDIO */
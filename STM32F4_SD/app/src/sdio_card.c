@@ -0,0 +1,676 @@
+/**
+ * @file    sdio_card.c
+ * @brief   SD card control functions (SDIO 4-bit bus).
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details The same functions as in sdcard.c, for a card connected to
+ * the SDIO interface. It is used instead of sdcard.c if SD_USE_SDIO is
+ * defined, FAT_Init and diskio.c don't change.
+ *
+ * The card is identified on a 1-bit bus at 400 kHz, then the bus is
+ * switched to 4 bits at 24 MHz and, if the card supports it, to high
+ * speed (48 MHz) with CMD6. Sectors are moved by DMA with multiple
+ * block commands. Buffers which are not word aligned are moved through
+ * an aligned sector buffer, one sector at a time.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifdef SD_USE_SDIO
+
+#include <sdcard.h>
+#include <sdio_hal.h>
+#include <timers.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @addtogroup SD_CARD
+ * @{
+ */
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("SD--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/*
+ * SD commands used in SD bus mode
+ */
+#define SD_GO_IDLE_STATE          0   ///< Resets SD Card.
+#define SD_ALL_SEND_CID           2   ///< Asks all cards for CID.
+#define SD_SEND_RELATIVE_ADDR     3   ///< Asks card to publish a new relative address (RCA).
+#define SD_SWITCH_FUNC            6   ///< Checks or switches card function (high speed).
+#define SD_SELECT_CARD            7   ///< Selects card (goes to transfer state).
+#define SD_SEND_IF_COND           8   ///< Asks card whether it can operate in given voltage range.
+#define SD_SEND_CSD               9   ///< Ask for card specific data (CSD).
+#define SD_STOP_TRANSMISSION      12  ///< Stops multiple block transfer.
+#define SD_SEND_STATUS            13  ///< Ask for card status.
+#define SD_SET_BLOCKLEN           16  ///< Sets block length (SDSC only).
+#define SD_READ_SINGLE_BLOCK      17  ///< Reads a block.
+#define SD_READ_MULTIPLE_BLOCK    18  ///< Reads blocks until STOP_TRANSMISSION.
+#define SD_WRITE_BLOCK            24  ///< Writes a block.
+#define SD_WRITE_MULTIPLE_BLOCK   25  ///< Writes blocks until STOP_TRANSMISSION.
+#define SD_APP_CMD                55  ///< Next command is application specific command
+/*
+ * Application specific commands, ACMD
+ */
+#define SD_ACMD_SET_BUS_WIDTH     6   ///< Sets data bus width.
+#define SD_ACMD_SET_WR_BLK_ERASE  23  ///< Sets number of blocks to pre-erase before writing.
+#define SD_ACMD_SEND_OP_COND      41  ///< Activates the card initialization process, sends host capacity.
+
+/*
+ * Other SD defines
+ */
+#define SD_IF_COND_CHECK    0xaa        ///< Check pattern for SEND_IF_COND command
+#define SD_IF_COND_VOLT     (1<<8)      ///< Signifies voltage range 2.7-3.6V
+#define SD_ACMD41_HCS       (1<<30)     ///< Host can handle SDSC and SDHC cards
+#define SD_ACMD41_VOLTAGE   0x00ff8000  ///< Voltage window 2.7-3.6V
+#define SD_OCR_BUSY         (1u<<31)    ///< Card finished power up
+#define SD_OCR_CCS          (1<<30)     ///< Card capacity status (SDHC)
+#define SD_BUS_WIDTH_4      2           ///< ACMD6 argument for 4-bit bus
+#define SD_SWITCH_HS        0x80fffff1  ///< CMD6: switch function group 1 to high speed
+#define SD_CCC_SWITCH       (1<<10)     ///< Command class 10 (switch function)
+
+/*
+ * Card status (R1)
+ */
+#define SD_STATUS_ERRORS    0xfdf98008  ///< Error bits of card status
+#define SD_STATUS_READY     (1<<8)      ///< Ready for data
+#define SD_STATUS_STATE(s)  (((s) >> 9) & 0x0f) ///< Current state
+#define SD_STATE_TRAN       4           ///< Transfer state
+
+#define SD_BUSY_TIMEOUT     500   ///< Time for card to finish programming [ms]
+#define SD_SECTOR_LOG2      9     ///< Sector size as power of 2
+#define SD_SECTOR_SIZE      512   ///< Sector size
+
+static uint8_t isSDHC; ///< Is the card SDHC?
+static uint32_t cardRCA; ///< Relative card address (shifted to argument position)
+static uint64_t cardCapacity; ///< Capacity of SD card in bytes
+static uint8_t cardCID[16]; ///< Contents of CID register read during initialization
+static uint32_t sectorBuf[SD_SECTOR_SIZE / 4]; ///< Aligned buffer for DMA
+static uint8_t initPowerUp; ///< Card is powering up (ACMD41 is sent)
+static uint8_t initVersion2; ///< Card answered CMD8
+static uint32_t initStart; ///< Time of SD_StartInit
+static uint32_t initTime; ///< Time of last ACMD41
+static uint32_t initInterval; ///< Time until next ACMD41 [ms]
+static SD_InitStats initStats; ///< Statistics of last initialization
+static uint8_t policy = SD_POLICY_DEFAULT; ///< Command selection policy
+static uint8_t appCmd; ///< Last command was APP_CMD
+static SD_CommandStats cmdStats; ///< Numbers of commands sent
+static SD_RecoveryStats recoveryStats; ///< Errors of transfers
+
+static uint8_t SD_HalCommand(uint8_t cmd, uint32_t arg, SDIO_HAL_Response resp,
+    uint8_t checkCrc, uint32_t* response);
+static uint8_t SD_Command(uint8_t cmd, uint32_t arg, uint32_t* status);
+static uint8_t SD_AppCommand(uint8_t cmd, uint32_t arg);
+static uint8_t SD_WaitReady(void);
+static uint8_t SD_Transfer(uint8_t* buf, uint32_t sector, uint32_t count,
+    uint8_t read);
+static uint64_t SD_CsdCapacity(const uint32_t* csd);
+static uint8_t SD_SwitchHighSpeed(void);
+static void SD_SendOpCond(void);
+static uint8_t SD_Identify(uint8_t ccs);
+static void SD_InitDone(uint8_t error);
+static uint8_t SD_Failed(uint8_t result, uint32_t sector);
+
+/**
+ * @brief Initialize the SD card.
+ *
+ * @details This function initializes both SDSC and SDHC cards.
+ * If initialization fails the capacity stays 0. It waits until
+ * the card finishes power up, see SD_StartInit for initialization
+ * which doesn't block.
+ *
+ * @retval 0 Card is ready
+ * @retval 1 No card or initialization failed
+ */
+uint8_t SD_Init(void) {
+
+  SD_StartInit();
+  return SD_WaitInit();
+}
+/**
+ * @brief Starts initialization of the SD card.
+ *
+ * @details Resets the card and starts its power up, which takes
+ * up to hundreds of ms. Other work can be done while the card
+ * powers up, as long as SD_PollInit is called, or SD_WaitInit
+ * before the card is used.
+ */
+void SD_StartInit(void) {
+
+  uint32_t resp[4];
+
+  initStart = TIMER_GetTime();
+  initPowerUp = 0;
+  initStats.powerUpTime = 0;
+  initStats.polls = 0;
+  cardCapacity = 0;
+  memset(cardCID, 0, sizeof(cardCID));
+  SDIO_HAL_Init();
+
+  SD_HalCommand(SD_GO_IDLE_STATE, 0, SDIO_HAL_RESP_NONE, 1, 0);
+
+  // only version 2 cards answer CMD8
+  initVersion2 = (SD_HalCommand(SD_SEND_IF_COND, SD_IF_COND_VOLT | SD_IF_COND_CHECK,
+      SDIO_HAL_RESP_SHORT, 1, resp) == SDIO_HAL_OK);
+  if (initVersion2 && (resp[0] & 0xfff) != (SD_IF_COND_VOLT | SD_IF_COND_CHECK)) {
+    println("SEND_IF_COND error");
+    SD_InitDone(1);
+    return;
+  }
+
+  // first ACMD41 starts the power up
+  initPowerUp = 1;
+  initInterval = SD_INIT_INTERVAL_MIN;
+  SD_SendOpCond();
+}
+/**
+ * @brief Continues initialization of the SD card.
+ *
+ * @details Sends the next ACMD41 when its interval has passed and
+ * identifies the card when it has finished power up. Returns at once
+ * otherwise.
+ *
+ * @retval 0 Initialization finished (or wasn't started)
+ * @retval 1 Card is still powering up
+ */
+uint8_t SD_PollInit(void) {
+
+  if (!initPowerUp) {
+    return 0;
+  }
+  if (TIMER_GetTime() - initTime < initInterval) {
+    return 1;
+  }
+  SD_SendOpCond();
+  return initPowerUp;
+}
+/**
+ * @brief Waits until the card started by SD_StartInit is initialized.
+ * @retval 0 Card is ready
+ * @retval 1 No card or initialization failed
+ */
+uint8_t SD_WaitInit(void) {
+
+  while (SD_PollInit());
+  return initStats.error;
+}
+/**
+ * @brief Gets statistics of the last initialization.
+ * @param stats Statistics (function writes this)
+ */
+void SD_GetInitStats(SD_InitStats* stats) {
+
+  *stats = initStats;
+  memcpy(stats->cid, cardCID, sizeof(cardCID));
+}
+/**
+ * @brief Gets the capacity of the card.
+ * @return Card capacity in bytes (0 if the card was not initialized).
+ */
+uint64_t SD_ReadCapacity(void) {
+
+  return cardCapacity;
+}
+/**
+ * @brief Gets the CID register of the card.
+ * @details The register is read during SD_Init. Its manufacturer
+ * ID, name and serial number identify the card.
+ * @param cid Buffer for 16 bytes of CID (function writes this)
+ */
+void SD_GetCID(uint8_t* cid) {
+
+  for (int i = 0; i < 16; i++) {
+    cid[i] = cardCID[i];
+  }
+}
+/**
+ * @brief Read sectors from SD card
+ * @details Errors are not recovered from on this bus, the sector where
+ * the failed transfer started is in SD_RecoveryStats.
+ * @param buf Data buffer
+ * @param sector Start sector
+ * @param count Number of sectors to read
+ * @retval 0 Read was successful
+ * @retval 1 Error occurred
+ */
+uint8_t SD_ReadSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (((uint32_t)(uintptr_t)buf & 0x03) == 0) {
+    return SD_Failed(SD_Transfer(buf, sector, count, 1), sector);
+  }
+
+  // DMA moves whole words
+  for (uint32_t i = 0; i < count; i++) {
+    if (SD_Transfer((uint8_t*)sectorBuf, sector + i, 1, 1)) {
+      return SD_Failed(1, sector + i);
+    }
+    memcpy(buf + i * SD_SECTOR_SIZE, sectorBuf, SD_SECTOR_SIZE);
+  }
+  return 0;
+}
+/**
+ * @brief Write sectors to SD card
+ * @details Errors are not recovered from on this bus, the sector where
+ * the failed transfer started is in SD_RecoveryStats.
+ * @param buf Data buffer
+ * @param sector First sector to write
+ * @param count Number of sectors to write
+ * @retval 0 Write was successful
+ * @retval 1 Error occurred
+ */
+uint8_t SD_WriteSectors(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (((uint32_t)(uintptr_t)buf & 0x03) == 0) {
+    return SD_Failed(SD_Transfer(buf, sector, count, 0), sector);
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    memcpy(sectorBuf, buf + i * SD_SECTOR_SIZE, SD_SECTOR_SIZE);
+    if (SD_Transfer((uint8_t*)sectorBuf, sector + i, 1, 0)) {
+      return SD_Failed(1, sector + i);
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Sets which commands transfer sectors.
+ * @details For comparing the commands, all are used by default. SCR
+ * is not read on this bus, so SD_POLICY_CMD23 has no effect.
+ * @param newPolicy SD_POLICY_ flags
+ */
+void SD_SetCommandPolicy(uint8_t newPolicy) {
+
+  policy = newPolicy;
+}
+/**
+ * @brief Gets errors of transfers since start or last clear.
+ * @details The recovery tiers are used only on the SPI bus, so only
+ * errors and failed transfers are counted.
+ * @param stats Statistics (function writes this)
+ */
+void SD_GetRecoveryStats(SD_RecoveryStats* stats) {
+
+  *stats = recoveryStats;
+}
+/**
+ * @brief Clears statistics of errors.
+ */
+void SD_ClearRecoveryStats(void) {
+
+  memset(&recoveryStats, 0, sizeof(recoveryStats));
+}
+/**
+ * @brief Turns CRC checking on or off.
+ * @details CRC of commands and data is always checked by the SDIO, so
+ * this does nothing.
+ * @param on 1 - on, 0 - off
+ * @retval 0 Always
+ */
+uint8_t SD_SetCrcMode(uint8_t on) {
+
+  (void)on;
+  return 0;
+}
+/**
+ * @brief Gets numbers of commands sent since start or last clear.
+ * @param stats Numbers of commands (function writes this)
+ */
+void SD_GetCommandStats(SD_CommandStats* stats) {
+
+  *stats = cmdStats;
+}
+/**
+ * @brief Clears numbers of commands.
+ */
+void SD_ClearCommandStats(void) {
+
+  memset(&cmdStats, 0, sizeof(cmdStats));
+}
+/**
+ * @brief Sends ACMD41 once during power up of the card.
+ * @details Identifies the card when it has finished power up. A card
+ * which is still busy is asked again after twice as long, up to
+ * SD_INIT_INTERVAL_MAX.
+ */
+static void SD_SendOpCond(void) {
+
+  uint32_t ocr = 0;
+
+  if (SD_HalCommand(SD_APP_CMD, 0, SDIO_HAL_RESP_SHORT, 1, 0) ||
+      SD_HalCommand(SD_ACMD_SEND_OP_COND, SD_ACMD41_VOLTAGE |
+      (initVersion2 ? SD_ACMD41_HCS : 0), SDIO_HAL_RESP_SHORT, 0, &ocr)) {
+    ocr = 0;
+  }
+  initTime = TIMER_GetTime();
+  initStats.polls++;
+
+  if (ocr & SD_OCR_BUSY) {
+    initStats.powerUpTime = initTime - initStart;
+    SD_InitDone(SD_Identify((ocr & SD_OCR_CCS) ? 1 : 0));
+  } else if (initTime - initStart > SD_INIT_TIMEOUT) {
+    println("Card not ready after %u ms", (unsigned int)(initTime - initStart));
+    SD_InitDone(1);
+  } else if (initInterval < SD_INIT_INTERVAL_MAX) {
+    initInterval *= 2;
+  }
+}
+/**
+ * @brief Ends initialization and saves its statistics.
+ * @param error Nonzero if initialization failed
+ */
+static void SD_InitDone(uint8_t error) {
+
+  initPowerUp = 0;
+  initStats.error = error;
+  initStats.initTime = TIMER_GetTime() - initStart;
+
+  if (error) {
+    cardCapacity = 0;
+    println("Failed to initialize SD card");
+  } else {
+    println("Card ready in %u ms, %u ACMD41", (unsigned int)initStats.initTime,
+        (unsigned int)initStats.polls);
+  }
+}
+/**
+ * @brief Reads the card registers and sets up the bus after power up.
+ * @details Sets the capacity if the card is ready for transfers.
+ * @param ccs Card capacity status from OCR
+ * @retval 0 Card is ready
+ * @retval 1 Error occurred
+ */
+static uint8_t SD_Identify(uint8_t ccs) {
+
+  uint32_t resp[4];
+
+  isSDHC = ccs ? 1 : 0;
+  println("%s card connected", isSDHC ? "SDHC" : "SDSC");
+
+  // CID, MSB first (the interface drops the end bit)
+  if (SD_HalCommand(SD_ALL_SEND_CID, 0, SDIO_HAL_RESP_LONG, 1, resp)) {
+    println("ALL_SEND_CID error");
+    return 1;
+  }
+  for (int i = 0; i < 16; i++) {
+    cardCID[i] = resp[i / 4] >> (24 - 8 * (i % 4));
+  }
+  cardCID[15] |= 1;
+
+  if (SD_HalCommand(SD_SEND_RELATIVE_ADDR, 0, SDIO_HAL_RESP_SHORT, 1, resp)) {
+    println("SEND_RELATIVE_ADDR error");
+    return 1;
+  }
+  cardRCA = resp[0] & 0xffff0000;
+
+  if (SD_HalCommand(SD_SEND_CSD, cardRCA, SDIO_HAL_RESP_LONG, 1, resp)) {
+    println("SEND_CSD error");
+    return 1;
+  }
+  uint64_t capacity = SD_CsdCapacity(resp);
+  uint32_t classes = resp[1] >> 20;
+
+  // transfer state
+  if (SD_Command(SD_SELECT_CARD, cardRCA, 0) || SD_WaitReady()) {
+    println("SELECT_CARD error");
+    return 1;
+  }
+
+  if (SD_AppCommand(SD_ACMD_SET_BUS_WIDTH, SD_BUS_WIDTH_4)) {
+    println("SET_BUS_WIDTH error");
+    return 1;
+  }
+  SDIO_HAL_SetBus(1, SDIO_HAL_CLOCK_24MHZ);
+
+  if (!isSDHC && SD_Command(SD_SET_BLOCKLEN, SD_SECTOR_SIZE, 0)) {
+    println("SET_BLOCKLEN error");
+    return 1;
+  }
+
+  if ((classes & SD_CCC_SWITCH) && !SD_SwitchHighSpeed()) {
+    SDIO_HAL_SetBus(1, SDIO_HAL_CLOCK_48MHZ);
+    println("High speed mode");
+  }
+
+  // capacity is set when the card is ready
+  cardCapacity = capacity;
+  println("Card capacity: %u", (unsigned int)cardCapacity);
+  return 0;
+}
+/**
+ * @brief Moves sectors with DMA.
+ * @param buf Data buffer (word aligned)
+ * @param sector First sector
+ * @param count Number of sectors
+ * @param read 1 - read, 0 - write
+ * @retval 0 Transfer was successful
+ * @retval 1 Error occurred
+ */
+static uint8_t SD_Transfer(uint8_t* buf, uint32_t sector, uint32_t count,
+    uint8_t read) {
+
+  uint8_t multi = (count > 1) || !(policy & SD_POLICY_SINGLE);
+  uint8_t result;
+
+  if (count == 0) {
+    return 0;
+  }
+
+  // SDSC cards use byte addressing, SDHC use block addressing
+  if (!isSDHC) {
+    sector *= SD_SECTOR_SIZE;
+  }
+
+  // card can erase all blocks at once instead of block by block
+  if (!read && multi && (policy & SD_POLICY_PRE_ERASE) &&
+      SD_AppCommand(SD_ACMD_SET_WR_BLK_ERASE, count)) {
+    println("SET_WR_BLK_ERASE_COUNT error");
+    return 1;
+  }
+
+  if (read) {
+    // data path must wait for the data before the command is sent
+    SDIO_HAL_StartData(buf, SD_SECTOR_LOG2, count, 1);
+    if (SD_Command(multi ? SD_READ_MULTIPLE_BLOCK : SD_READ_SINGLE_BLOCK,
+        sector, 0)) {
+      println("READ_BLOCK error");
+      SDIO_HAL_StopData();
+      return 1;
+    }
+  } else {
+    if (SD_Command(multi ? SD_WRITE_MULTIPLE_BLOCK : SD_WRITE_BLOCK,
+        sector, 0)) {
+      println("WRITE_BLOCK error");
+      return 1;
+    }
+    SDIO_HAL_StartData(buf, SD_SECTOR_LOG2, count, 0);
+  }
+
+  result = SDIO_HAL_WaitData();
+  if (result == SDIO_HAL_CRC) {
+    cmdStats.crcErrors++;
+  }
+  if (result != SDIO_HAL_OK) {
+    println("Data error %u", (unsigned int)result);
+  }
+
+  // stop also after errors, so the card goes back to transfer state
+  if (multi) {
+    SD_Command(SD_STOP_TRANSMISSION, 0, 0);
+  }
+  if (SD_WaitReady()) {
+    return 1;
+  }
+  return (result != SDIO_HAL_OK);
+}
+/**
+ * @brief Counts a failed transfer.
+ * @param result Result of transfer
+ * @param sector Sector where the transfer started
+ * @return result
+ */
+static uint8_t SD_Failed(uint8_t result, uint32_t sector) {
+
+  if (result) {
+    recoveryStats.errors++;
+    recoveryStats.failed++;
+    recoveryStats.errorSector = sector;
+  }
+  return result;
+}
+/**
+ * @brief Sends a command and counts it.
+ * @param cmd Command
+ * @param arg Argument
+ * @param resp Kind of response
+ * @param checkCrc Check CRC of response
+ * @param response Response (may be 0)
+ * @return Result of SDIO_HAL_Command
+ */
+static uint8_t SD_HalCommand(uint8_t cmd, uint32_t arg, SDIO_HAL_Response resp,
+    uint8_t checkCrc, uint32_t* response) {
+
+  uint8_t result;
+
+  if (appCmd) {
+    cmdStats.acmd[cmd % SD_COMMANDS]++;
+  } else {
+    cmdStats.cmd[cmd % SD_COMMANDS]++;
+  }
+  appCmd = (cmd == SD_APP_CMD);
+
+  result = SDIO_HAL_Command(cmd, arg, resp, checkCrc, response);
+  if (result == SDIO_HAL_CRC) {
+    cmdStats.crcErrors++;
+  }
+  return result;
+}
+/**
+ * @brief Sends a command with R1 response.
+ * @param cmd Command
+ * @param arg Argument
+ * @param status Card status (may be 0)
+ * @retval 0 Command accepted
+ * @retval 1 No response, CRC error or error bits in status
+ */
+static uint8_t SD_Command(uint8_t cmd, uint32_t arg, uint32_t* status) {
+
+  uint32_t resp;
+
+  if (SD_HalCommand(cmd, arg, SDIO_HAL_RESP_SHORT, 1, &resp)) {
+    return 1;
+  }
+  if (status) {
+    *status = resp;
+  }
+  return (resp & SD_STATUS_ERRORS) ? 1 : 0;
+}
+/**
+ * @brief Sends an application specific command with R1 response.
+ * @param cmd Command
+ * @param arg Argument
+ * @retval 0 Command accepted
+ * @retval 1 Error
+ */
+static uint8_t SD_AppCommand(uint8_t cmd, uint32_t arg) {
+
+  if (SD_Command(SD_APP_CMD, cardRCA, 0)) {
+    return 1;
+  }
+  return SD_Command(cmd, arg, 0);
+}
+/**
+ * @brief Waits until the card is ready for data in transfer state.
+ * @details The card is busy while it programs written data.
+ * @retval 0 Card ready
+ * @retval 1 Timeout or error
+ */
+static uint8_t SD_WaitReady(void) {
+
+  uint32_t status;
+  uint32_t start = TIMER_GetTime();
+
+  while (1) {
+    if (SD_Command(SD_SEND_STATUS, cardRCA, &status)) {
+      println("SEND_STATUS error");
+      return 1;
+    }
+    if ((status & SD_STATUS_READY) &&
+        SD_STATUS_STATE(status) == SD_STATE_TRAN) {
+      return 0;
+    }
+    if (TIMER_GetTime() - start > SD_BUSY_TIMEOUT) {
+      println("Card busy");
+      return 1;
+    }
+  }
+}
+/**
+ * @brief Gets the capacity from the CSD register.
+ * @param csd CSD register (4 words, MSB first)
+ * @return Card capacity in bytes
+ */
+static uint64_t SD_CsdCapacity(const uint32_t* csd) {
+
+  if ((csd[0] >> 30) == 1) {
+    // CSD version 2.0: size counted in blocks of 512K
+    uint32_t size = ((csd[1] & 0x3f) << 16) | (csd[2] >> 16);
+    return (uint64_t)(size + 1) * 512 * 1024;
+  }
+
+  // CSD version 1.0
+  uint32_t blockLen = (csd[1] >> 16) & 0x0f;
+  uint32_t size = ((csd[1] & 0x3ff) << 2) | (csd[2] >> 30);
+  uint32_t mult = (csd[2] >> 15) & 0x07;
+  return (uint64_t)(size + 1) << (mult + 2 + blockLen);
+}
+/**
+ * @brief Switches the card to high speed mode.
+ * @details Reads the 64 byte status of CMD6 in set mode. Function group
+ * 1 is switched to high speed if the card supports it.
+ * @retval 0 Card switched
+ * @retval 1 Card doesn't support high speed or error
+ */
+static uint8_t SD_SwitchHighSpeed(void) {
+
+  uint8_t* status = (uint8_t*)sectorBuf;
+
+  SDIO_HAL_StartData(status, 6, 1, 1);
+  if (SD_Command(SD_SWITCH_FUNC, SD_SWITCH_HS, 0)) {
+    SDIO_HAL_StopData();
+    return 1;
+  }
+  if (SDIO_HAL_WaitData() != SDIO_HAL_OK) {
+    return 1;
+  }
+
+  // bits 379:376 - function selected in group 1
+  if ((status[16] & 0x0f) != 1) {
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @}
+ */
+
+#endif /* SD_USE_SDIO */
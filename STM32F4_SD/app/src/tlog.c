@@ -0,0 +1,468 @@
+/**
+ * @file    tlog.c
+ * @brief   Time-indexed record file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <tlog.h>
+#include <fat.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifndef DEBUG
+  #define DEBUG
+#endif
+
+#ifdef DEBUG
+  #define print(str, args...) printf(""str"%s",##args,"")
+  #define println(str, args...) printf("TLOG--> "str"%s",##args,"\r\n")
+#else
+  #define print(str, args...) (void)0
+  #define println(str, args...) (void)0
+#endif
+
+/**
+ * @addtogroup TLOG
+ * @{
+ */
+
+static uint8_t readBuf[TLOG_BLOCK_SIZE]; ///< Buffer for reading blocks
+
+static uint8_t TLOG_WriteHeader(TLOG_TypeDef* log);
+static uint8_t TLOG_WriteBlock(TLOG_TypeDef* log);
+static uint8_t TLOG_WriteEntry(TLOG_TypeDef* log, const TLOG_BlockHeader* hdr);
+static uint8_t TLOG_ReadEntry(TLOG_TypeDef* log, uint32_t entry,
+    TLOG_IndexEntry* data);
+static void TLOG_ClearBlock(TLOG_TypeDef* log);
+
+/**
+ * @brief Opens a time-indexed record file.
+ *
+ * @details Both files must exist, their sizes limit the number of
+ * records. If the index file holds no valid header, both files are
+ * emptied. Blocks written after the last index header update are
+ * found again and indexed.
+ *
+ * @param log Log structure
+ * @param dataName Name of data file
+ * @param indexName Name of index file
+ * @retval 0 Files opened
+ * @retval 1 Error: file not found, too small or write error
+ */
+uint8_t TLOG_Open(TLOG_TypeDef* log, const char* dataName, const char* indexName) {
+
+  TLOG_IndexHeader hdr;
+
+  log->dataFile = FAT_OpenFile(dataName);
+  log->indexFile = FAT_OpenFile(indexName);
+  if (log->dataFile == -1 || log->indexFile == -1) {
+    println("Files not found");
+    TLOG_Close(log);
+    return 1;
+  }
+
+  log->maxBlocks = FAT_GetFileSize(log->dataFile) / TLOG_BLOCK_SIZE;
+  log->maxEntries = (FAT_GetFileSize(log->indexFile) / TLOG_BLOCK_SIZE - 1) *
+      (TLOG_BLOCK_SIZE / sizeof(TLOG_IndexEntry));
+  // every block must be reachable from the index
+  if (log->maxBlocks > log->maxEntries * TLOG_INDEX_BLOCKS) {
+    log->maxBlocks = log->maxEntries * TLOG_INDEX_BLOCKS;
+  }
+  if (log->maxBlocks == 0) {
+    println("Files too small");
+    FAT_CloseFile(log->dataFile);
+    FAT_CloseFile(log->indexFile);
+    return 1;
+  }
+
+  FAT_MoveRdPtr(log->indexFile, 0);
+  int len = FAT_ReadFile(log->indexFile, (uint8_t*)&hdr, sizeof(hdr));
+
+  if (len != sizeof(hdr) || hdr.magic != TLOG_INDEX_MAGIC || hdr.blocksPerEntry != TLOG_INDEX_BLOCKS ||
+      hdr.blockCount > log->maxBlocks || hdr.checksum !=
+      CRC_Calc(&hdr, offsetof(TLOG_IndexHeader, checksum))) {
+    println("No valid index, emptying files");
+    // blocks of earlier generations are not valid, unread header has none
+    log->generation = len == sizeof(hdr) ? hdr.generation + 1 : 0;
+    log->blockCount = 0;
+    log->lastTime = 0;
+    TLOG_ClearBlock(log);
+    return TLOG_WriteHeader(log);
+  }
+
+  log->generation = hdr.generation;
+  log->blockCount = hdr.blockCount;
+  log->lastTime = 0;
+  TLOG_ClearBlock(log);
+
+  if (log->blockCount && TLOG_ReadBlock(log, log->blockCount - 1, readBuf) != -1) {
+    log->lastTime = ((TLOG_BlockHeader*)readBuf)->lastTime;
+  }
+
+  // find blocks written after header update
+  uint32_t found = 0;
+  while (log->blockCount < log->maxBlocks &&
+      TLOG_ReadBlock(log, log->blockCount, readBuf) != -1) {
+    TLOG_BlockHeader* blockHdr = (TLOG_BlockHeader*)readBuf;
+    if (blockHdr->block % TLOG_INDEX_BLOCKS == 0 &&
+        TLOG_WriteEntry(log, blockHdr)) {
+      return 1;
+    }
+    log->lastTime = blockHdr->lastTime;
+    log->blockCount++;
+    found++;
+  }
+
+  if (found) {
+    println("Recovered %u blocks", (unsigned int)found);
+    return TLOG_WriteHeader(log);
+  }
+  return 0;
+}
+/**
+ * @brief Appends a record.
+ * @param log Log structure
+ * @param time Timestamp of record (not smaller than previous one)
+ * @param data Record data
+ * @param len Length of data (at most TLOG_MAX_RECORD)
+ * @retval 0 Record appended
+ * @retval 1 Error: wrong timestamp or length, file full or write error
+ */
+uint8_t TLOG_Append(TLOG_TypeDef* log, uint32_t time, const uint8_t* data,
+    uint16_t len) {
+
+  TLOG_BlockHeader* hdr = (TLOG_BlockHeader*)log->block;
+
+  if (time < log->lastTime || len > TLOG_MAX_RECORD) {
+    println("Wrong record");
+    return 1;
+  }
+  if (log->blockCount >= log->maxBlocks) {
+    println("File full");
+    return 1;
+  }
+
+  // write block if record doesn't fit
+  if ((uint32_t)hdr->used + 6 + len > TLOG_PAYLOAD) {
+    if (TLOG_WriteBlock(log)) {
+      return 1;
+    }
+    log->blockCount++;
+    TLOG_ClearBlock(log);
+    // header is updated once per index entry
+    if ((log->blockCount - 1) % TLOG_INDEX_BLOCKS == 0 && TLOG_WriteHeader(log)) {
+      return 1;
+    }
+    if (log->blockCount >= log->maxBlocks) {
+      println("File full");
+      return 1;
+    }
+  }
+
+  uint8_t* ptr = log->block + sizeof(TLOG_BlockHeader) + hdr->used;
+  memcpy(ptr, &time, 4);
+  ptr[4] = len & 0xff;
+  ptr[5] = len >> 8;
+  memcpy(ptr + 6, data, len);
+
+  if (hdr->count == 0) {
+    hdr->firstTime = time;
+  }
+  hdr->lastTime = time;
+  hdr->count++;
+  hdr->used += 6 + len;
+  log->lastTime = time;
+
+  return 0;
+}
+/**
+ * @brief Writes the block being filled and updates the index header.
+ *
+ * @details Records appended later are added to the same block,
+ * which is then written again.
+ *
+ * @param log Log structure
+ * @retval 0 Files synchronized
+ * @retval 1 Write error
+ */
+uint8_t TLOG_Sync(TLOG_TypeDef* log) {
+
+  if (((TLOG_BlockHeader*)log->block)->count && TLOG_WriteBlock(log)) {
+    return 1;
+  }
+  return TLOG_WriteHeader(log);
+}
+/**
+ * @brief Synchronizes and closes a time-indexed record file.
+ * @param log Log structure
+ * @retval 0 Files closed
+ * @retval 1 Write error
+ */
+uint8_t TLOG_Close(TLOG_TypeDef* log) {
+
+  uint8_t ret = 0;
+
+  if (log->dataFile != -1 && log->indexFile != -1) {
+    ret = TLOG_Sync(log);
+  }
+  if (log->dataFile != -1) {
+    FAT_CloseFile(log->dataFile);
+  }
+  if (log->indexFile != -1) {
+    FAT_CloseFile(log->indexFile);
+  }
+  log->dataFile = -1;
+  log->indexFile = -1;
+  return ret;
+}
+/**
+ * @brief Finds first block which may hold records with a given timestamp.
+ *
+ * @details The index is searched with binary search, then at most
+ * TLOG_INDEX_BLOCKS + 1 block headers are read.
+ *
+ * @param log Log structure
+ * @param time Timestamp
+ * @return Number of block or -1 if all records are older
+ */
+int TLOG_FindBlock(TLOG_TypeDef* log, uint32_t time) {
+
+  TLOG_IndexEntry entry;
+  uint32_t start = 0;
+  int lo = 0;
+  int hi = (log->blockCount + TLOG_INDEX_BLOCKS - 1) / TLOG_INDEX_BLOCKS - 1;
+
+  // find last entry older than time
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (TLOG_ReadEntry(log, mid, &entry)) {
+      return -1;
+    }
+    if (entry.firstTime < time) {
+      start = entry.block;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  // block in RAM is the last one
+  for (uint32_t block = start; block <= log->blockCount; block++) {
+    if (TLOG_ReadBlock(log, block, readBuf) > 0 &&
+        ((TLOG_BlockHeader*)readBuf)->lastTime >= time) {
+      return block;
+    }
+  }
+  return -1;
+}
+/**
+ * @brief Reads a data block.
+ *
+ * @details Block number blockCount is the block being filled,
+ * it is copied from RAM.
+ *
+ * @param log Log structure
+ * @param block Number of block
+ * @param buf Buffer for TLOG_BLOCK_SIZE bytes
+ * @return Number of records in block or -1 if block is not valid
+ */
+int TLOG_ReadBlock(TLOG_TypeDef* log, uint32_t block, uint8_t* buf) {
+
+  TLOG_BlockHeader* hdr = (TLOG_BlockHeader*)buf;
+
+  if (block == log->blockCount && ((TLOG_BlockHeader*)log->block)->count) {
+    memcpy(buf, log->block, TLOG_BLOCK_SIZE);
+    return hdr->count;
+  }
+  if (block >= log->maxBlocks) {
+    return -1;
+  }
+
+  FAT_MoveRdPtr(log->dataFile, block * TLOG_BLOCK_SIZE);
+  if (FAT_ReadFile(log->dataFile, buf, TLOG_BLOCK_SIZE) != TLOG_BLOCK_SIZE) {
+    return -1;
+  }
+  if (hdr->magic != TLOG_BLOCK_MAGIC || hdr->generation != log->generation ||
+      hdr->block != block || hdr->used > TLOG_PAYLOAD ||
+      hdr->checksum != CRC_Update(CRC_Calc(buf,
+      offsetof(TLOG_BlockHeader, checksum)),
+      buf + sizeof(TLOG_BlockHeader), hdr->used)) {
+    return -1;
+  }
+  return hdr->count;
+}
+/**
+ * @brief Reads records from a time range.
+ * @param log Log structure
+ * @param from First timestamp
+ * @param to Last timestamp
+ * @param callback Function called for every record in range
+ * @return Number of records found
+ */
+int TLOG_Query(TLOG_TypeDef* log, uint32_t from, uint32_t to,
+    void (*callback)(uint32_t time, const uint8_t* data, uint16_t len)) {
+
+  int found = 0;
+  int block = TLOG_FindBlock(log, from);
+
+  if (block == -1) {
+    return 0;
+  }
+
+  for (; block <= (int)log->blockCount; block++) {
+    int count = TLOG_ReadBlock(log, block, readBuf);
+    if (count == -1) {
+      break;
+    }
+    uint8_t* ptr = readBuf + sizeof(TLOG_BlockHeader);
+    for (int i = 0; i < count; i++) {
+      uint32_t time;
+      memcpy(&time, ptr, 4);
+      uint16_t len = ptr[4] | (ptr[5] << 8);
+      if (time > to) {
+        return found;
+      }
+      if (time >= from) {
+        callback(time, ptr + 6, len);
+        found++;
+      }
+      ptr += 6 + len;
+    }
+  }
+  return found;
+}
+/**
+ * @brief Writes the index header.
+ *
+ * @details The data file is synchronized before the header is written
+ * and the index file after it, so a header on the card never counts
+ * blocks still waiting in the cache.
+ *
+ * @param log Log structure
+ * @retval 0 Header written
+ * @retval 1 Write error
+ */
+static uint8_t TLOG_WriteHeader(TLOG_TypeDef* log) {
+
+  TLOG_IndexHeader hdr;
+
+  hdr.magic = TLOG_INDEX_MAGIC;
+  hdr.generation = log->generation;
+  hdr.blocksPerEntry = TLOG_INDEX_BLOCKS;
+  hdr.blockCount = log->blockCount;
+  hdr.checksum = CRC_Calc(&hdr, offsetof(TLOG_IndexHeader, checksum));
+
+  // blocks reach the card before the header counting them
+  if (FAT_SyncFile(log->dataFile)) {
+    println("Data sync error");
+    return 1;
+  }
+  FAT_MoveWrPtr(log->indexFile, 0);
+  if (FAT_WriteFile(log->indexFile, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+      FAT_SyncFile(log->indexFile)) {
+    println("Index write error");
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Writes the block being filled to the data file.
+ * @details The first block of every TLOG_INDEX_BLOCKS gets an index entry.
+ * @param log Log structure
+ * @retval 0 Block written
+ * @retval 1 Write error
+ */
+static uint8_t TLOG_WriteBlock(TLOG_TypeDef* log) {
+
+  TLOG_BlockHeader* hdr = (TLOG_BlockHeader*)log->block;
+
+  hdr->magic = TLOG_BLOCK_MAGIC;
+  hdr->generation = log->generation;
+  hdr->block = log->blockCount;
+  hdr->checksum = CRC_Update(CRC_Calc(log->block,
+      offsetof(TLOG_BlockHeader, checksum)),
+      log->block + sizeof(TLOG_BlockHeader), hdr->used);
+
+  FAT_MoveWrPtr(log->dataFile, log->blockCount * TLOG_BLOCK_SIZE);
+  if (FAT_WriteFile(log->dataFile, log->block, TLOG_BLOCK_SIZE) !=
+      TLOG_BLOCK_SIZE) {
+    println("Block write error");
+    return 1;
+  }
+  if (hdr->block % TLOG_INDEX_BLOCKS == 0) {
+    return TLOG_WriteEntry(log, hdr);
+  }
+  return 0;
+}
+/**
+ * @brief Writes the index entry for a block.
+ * @details The block is synchronized before its entry, like the header.
+ * @param log Log structure
+ * @param hdr Header of block
+ * @retval 0 Entry written
+ * @retval 1 Write error
+ */
+static uint8_t TLOG_WriteEntry(TLOG_TypeDef* log, const TLOG_BlockHeader* hdr) {
+
+  TLOG_IndexEntry entry;
+
+  entry.firstTime = hdr->firstTime;
+  entry.block = hdr->block;
+
+  // block reaches the card before the entry pointing to it
+  if (FAT_SyncFile(log->dataFile)) {
+    println("Data sync error");
+    return 1;
+  }
+  FAT_MoveWrPtr(log->indexFile, TLOG_BLOCK_SIZE +
+      hdr->block / TLOG_INDEX_BLOCKS * sizeof(TLOG_IndexEntry));
+  if (FAT_WriteFile(log->indexFile, (uint8_t*)&entry, sizeof(entry)) !=
+      sizeof(entry) || FAT_SyncFile(log->indexFile)) {
+    println("Index write error");
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Reads an index entry.
+ * @param log Log structure
+ * @param entry Number of entry
+ * @param data Entry (function writes this)
+ * @retval 0 Entry read
+ * @retval 1 Read error
+ */
+static uint8_t TLOG_ReadEntry(TLOG_TypeDef* log, uint32_t entry,
+    TLOG_IndexEntry* data) {
+
+  FAT_MoveRdPtr(log->indexFile, TLOG_BLOCK_SIZE + entry * sizeof(TLOG_IndexEntry));
+  if (FAT_ReadFile(log->indexFile, (uint8_t*)data, sizeof(TLOG_IndexEntry)) !=
+      sizeof(TLOG_IndexEntry)) {
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Empties the block being filled.
+ * @param log Log structure
+ */
+static void TLOG_ClearBlock(TLOG_TypeDef* log) {
+
+  memset(log->block, 0, TLOG_BLOCK_SIZE);
+}
+
+/**
+ * @}
+ */
@@ -17,6 +17,20 @@
 #define MMC		1
 #define USB		2
 
+static BDEV_Device* drive;	/* Block device of the card (0: not attached) */
+
+
+/*-----------------------------------------------------------------------*/
+/* Attach the Block Device                                               */
+/*-----------------------------------------------------------------------*/
+
+void disk_attach (
+	BDEV_Device* dev		/* Top of the block device stack */
+)
+{
+	drive = dev;
+}
+
 
 /*-----------------------------------------------------------------------*/
 /* Inidialize a Drive                                                    */
@@ -38,10 +52,7 @@ DSTATUS disk_initialize (
 //		return stat;
 
 //	case MMC :
-		SD_Init();
-
-		// translate the reslut code here
-		stat = RES_OK;
+		stat = SD_Init() ? STA_NOINIT : 0;
 		return stat;
 
 //	case USB :
@@ -121,11 +132,12 @@ DRESULT disk_read (
 //	case MMC :
 		// translate the arguments here
 
-		result = SD_ReadSectors(buff, sector, count);
+		if (!drive) return RES_NOTRDY;
+		result = BDEV_Read(drive, buff, sector, count);
 
 		// translate the reslut code here
 
-		return RES_OK;
+		return result ? RES_ERROR : RES_OK;
 
 //	case USB :
 		// translate the arguments here
@@ -169,11 +181,12 @@ DRESULT disk_write (
 //	case MMC :
 		// translate the arguments here
 
-		result = SD_WriteSectors(buff, sector, count);
+		if (!drive) return RES_NOTRDY;
+		result = BDEV_Write(drive, buff, sector, count);
 
 		// translate the reslut code here
 
-		return RES_OK;
+		return result ? RES_ERROR : RES_OK;
 
 //	case USB :
 		// translate the arguments here
@@ -216,11 +229,25 @@ DRESULT disk_ioctl (
 //	case MMC :
 		// pre-process here
 
-//		result = MMC_disk_ioctl(cmd, buff);
+		if (!drive) return RES_NOTRDY;
+		switch (cmd) {
+		case CTRL_SYNC :
+			result = BDEV_Flush(drive);
+			break;
+#if _USE_ERASE
+		case CTRL_ERASE_SECTOR :
+			result = BDEV_Trim(drive, ((DWORD*)buff)[0],
+					((DWORD*)buff)[1] - ((DWORD*)buff)[0] + 1);
+			break;
+#endif
+		default :
+			result = 0;
+			break;
+		}
 
 		// post-process here
 
-		return RES_OK;
+		return result ? RES_ERROR : RES_OK;
 
 //	case USB :
 		// pre-process here
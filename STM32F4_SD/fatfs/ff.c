@@ -156,6 +156,39 @@
 #endif
 
 
+/* Metadata journal feature */
+#if _FS_JOURNAL
+#if _FS_READONLY
+#error _FS_JOURNAL must be 0 at read-only cfg.
+#endif
+#if _FS_TINY
+#error _FS_JOURNAL cannot be used with _FS_TINY.
+#endif
+#if _FS_JOURNALSIZE < 1 || _FS_JOURNALSIZE > 125
+#error Wrong journal size configuration.
+#endif
+#define JNL_NAME	_T("/JOURNAL.SYS")	/* Journal file in the root directory */
+#define JNL_MAGIC	0x4C4E4A46			/* Commit record signature "FJNL" */
+#define JH_Magic	0					/* Commit record: Signature (4) */
+#define JH_Count	4					/* Commit record: Number of sectors (4) */
+#define JH_Sum		8					/* Commit record: Sum of signature, count and table (4) */
+#define JH_Table	12					/* Commit record: Home sectors (4 each) */
+#endif
+
+
+/* Mount snapshot feature */
+#if _FS_SNAPSHOT
+#define SNP_MAGIC	0x50414E53			/* Snapshot entry signature "SNAP" */
+typedef struct {
+	DWORD	magic;		/* SNP_MAGIC if the entry is valid */
+	BYTE	cid[16];	/* ID of the card the entry was made for */
+	DWORD	bsect;		/* Boot sector of the volume */
+	DWORD	bsum;		/* Sum of the boot sector */
+	DWORD	sum;		/* Sum of the entry */
+} SNAPSHOT;
+#endif
+
+
 /* File access control feature */
 #if _FS_LOCK
 #if _FS_READONLY
@@ -495,6 +528,13 @@ FATFS *FatFs[_VOLUMES];		/* Pointer to the file system objects (logical drives)
 static
 WORD Fsid;					/* File system mount ID */
 
+#if _FS_SNAPSHOT
+static
+SNAPSHOT *Snapshot;			/* Snapshot entries of the logical drives (NULL:not used) */
+static
+void (*GetCardId)(BYTE*);	/* Function reading the card ID */
+#endif
+
 #if _FS_RPATH && _VOLUMES >= 2
 static
 BYTE CurrVol;				/* Current drive */
@@ -750,7 +790,7 @@ void clear_lock (	/* Clear lock entries of the volume */
 /*-----------------------------------------------------------------------*/
 #if !_FS_READONLY
 static
-FRESULT sync_window (
+FRESULT write_window (	/* Write the window to its home location */
 	FATFS* fs		/* File system object */
 )
 {
@@ -764,6 +804,13 @@ FRESULT sync_window (
 			return FR_DISK_ERR;
 		fs->wflag = 0;
 		if (wsect - fs->fatbase < fs->fsize) {		/* Is it in the FAT area? */
+#if _FS_LAZYMIRROR
+			if (fs->mflag) {						/* Mirror it later */
+				nf = (wsect - fs->fatbase) / ((fs->fsize + _FS_MIRRORMAP - 1) / _FS_MIRRORMAP);
+				fs->mmap[nf / 8] |= 1 << (nf % 8);
+				return FR_OK;
+			}
+#endif
 			for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
 				wsect += fs->fsize;
 				disk_write(fs->drv, fs->win, wsect, 1);
@@ -772,6 +819,120 @@ FRESULT sync_window (
 	}
 	return FR_OK;
 }
+
+
+#if _FS_JOURNAL
+static
+UINT find_journal (	/* Index of the sector in the journal (jcnt:Not in the journal) */
+	FATFS* fs,		/* File system object */
+	DWORD sect		/* Home sector number */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < fs->jcnt && fs->jtab[i] != sect; i++) ;
+	return i;
+}
+
+
+static
+FRESULT apply_journal (	/* Copy the sectors in the journal to their home locations */
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < fs->jcnt; i++) {
+		if (fs->jtab[i] == 0xFFFFFFFF) continue;	/* Dropped sector */
+		mem_cpy(fs->win, fs->jbuf[i], SS(fs));
+		fs->winsect = fs->jtab[i];
+		fs->wflag = 1;
+		if (write_window(fs) != FR_OK)
+			return FR_DISK_ERR;
+	}
+	if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)	/* Home sectors reach the disk before the record is retired */
+		return FR_DISK_ERR;
+	mem_set(fs->win, 0, SS(fs));			/* Retire the commit record */
+	fs->winsect = 0xFFFFFFFF;
+	if (disk_write(fs->drv, fs->win, fs->jsect, 1))
+		return FR_DISK_ERR;
+	fs->jcnt = 0;
+	return FR_OK;
+}
+
+
+static
+FRESULT commit_journal (	/* Commit the journal and apply it */
+	FATFS* fs		/* File system object (window must be clean) */
+)
+{
+	UINT i;
+	DWORD sum;
+
+
+	if (!fs->jsect || !fs->jcnt) return FR_OK;
+	mem_set(fs->win, 0, SS(fs));			/* Create commit record */
+	ST_DWORD(fs->win+JH_Magic, JNL_MAGIC);
+	ST_DWORD(fs->win+JH_Count, fs->jcnt);
+	sum = JNL_MAGIC + fs->jcnt;
+	for (i = 0; i < fs->jcnt; i++) {
+		ST_DWORD(fs->win+JH_Table+i*4, fs->jtab[i]);
+		sum += fs->jtab[i];
+	}
+	ST_DWORD(fs->win+JH_Sum, sum);
+	fs->winsect = 0xFFFFFFFF;
+	if (disk_write(fs->drv, fs->jbuf[0], fs->jsect + 1, fs->jcnt))	/* Write the journal sectors at once */
+		return FR_DISK_ERR;
+	if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)	/* Journal sectors reach the disk before the record */
+		return FR_DISK_ERR;
+	if (disk_write(fs->drv, fs->win, fs->jsect, 1))	/* Changes are committed from now on */
+		return FR_DISK_ERR;
+	if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)	/* Record reaches the disk before home sectors */
+		return FR_DISK_ERR;
+	return apply_journal(fs);
+}
+
+
+static
+FRESULT put_journal (	/* Put the window to the journal buffer */
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i;
+	DWORD wsect;
+
+
+	i = find_journal(fs, fs->winsect);		/* Sector already in the journal is overwritten */
+	mem_cpy(fs->jbuf[i], fs->win, SS(fs));
+	fs->wflag = 0;
+	if (i == fs->jcnt) fs->jtab[fs->jcnt++] = fs->winsect;
+	if (fs->jcnt == _FS_JOURNALSIZE) {		/* Journal is full */
+		wsect = fs->winsect;
+		if (commit_journal(fs) != FR_OK)
+			return FR_DISK_ERR;
+		mem_cpy(fs->win, fs->jbuf[i], SS(fs));	/* Restore the window, the caller may still own it */
+		fs->winsect = wsect;
+	}
+	return FR_OK;
+}
+#endif
+
+
+static
+FRESULT sync_window (
+	FATFS* fs		/* File system object */
+)
+{
+	if (fs->wflag) {	/* Write back the sector if it is dirty */
+#if _FS_JOURNAL
+		if (fs->jsect) return put_journal(fs);	/* Metadata goes to the journal */
+#endif
+		return write_window(fs);
+	}
+	return FR_OK;
+}
 #endif
 
 
@@ -785,6 +946,16 @@ FRESULT move_window (
 #if !_FS_READONLY
 		if (sync_window(fs) != FR_OK)
 			return FR_DISK_ERR;
+#if _FS_JOURNAL
+		if (fs->jsect) {			/* Newest copy of the sector may be in the journal */
+			UINT i = find_journal(fs, sector);
+			if (i < fs->jcnt) {
+				mem_cpy(fs->win, fs->jbuf[i], SS(fs));
+				fs->winsect = sector;
+				return FR_OK;
+			}
+		}
+#endif
 #endif
 		if (disk_read(fs->drv, fs->win, sector, 1))
 			return FR_DISK_ERR;
@@ -797,6 +968,110 @@ FRESULT move_window (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Lazy FAT mirroring                                                    */
+/*-----------------------------------------------------------------------*/
+#if !_FS_READONLY && _FS_LAZYMIRROR
+static
+FRESULT set_fat_clean (	/* FR_OK: successful, FR_DISK_ERR: failed */
+	FATFS* fs,		/* File system object (FAT16/32 only) */
+	BYTE clean		/* 1:FAT copies are identical, 0:FAT copies differ */
+)
+{
+	BYTE *p;
+	UINT nf;
+	FRESULT res;
+
+
+	if (clean && disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)	/* FAT copies reach the disk before the clean flag */
+		return FR_DISK_ERR;
+	res = move_window(fs, fs->fatbase);		/* FAT[1] is in the first FAT sector */
+	if (res != FR_OK) return res;
+	if (fs->fs_type == FS_FAT32) {
+		p = &fs->win[4 + 3];				/* Clean shutdown bit is bit 27 of FAT[1] */
+		*p = clean ? (*p | 0x08) : (*p & ~0x08);
+	} else {
+		p = &fs->win[2 + 1];				/* Clean shutdown bit is bit 15 of FAT[1] */
+		*p = clean ? (*p | 0x80) : (*p & ~0x80);
+	}
+	if (clean) {							/* Clean flag goes to the other copies before the first one */
+		for (nf = 1; nf < fs->n_fats; nf++) {
+			if (disk_write(fs->drv, fs->win, fs->winsect + nf * fs->fsize, 1))
+				return FR_DISK_ERR;
+		}
+		if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)
+			return FR_DISK_ERR;
+	}
+	fs->wflag = 1;
+	fs->mflag = 1;							/* Write the first copy only */
+	res = sync_window(fs);
+	if (clean) {
+		fs->mflag = 0;
+		mem_set(fs->mmap, 0, sizeof fs->mmap);
+	}
+	if (res == FR_OK && !clean && disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)	/* Dirty flag reaches the disk before the first change */
+		res = FR_DISK_ERR;
+	return res;
+}
+
+
+static
+FRESULT sync_mirror (	/* FR_OK: successful, FR_DISK_ERR: failed */
+	FATFS* fs		/* File system object */
+)
+{
+	DWORD sect, gsize;
+	UINT i, nf;
+	FRESULT res;
+
+
+	if (!fs->mflag) return FR_OK;			/* FAT copies are identical */
+	res = sync_window(fs);
+	if (res != FR_OK) return res;
+	gsize = (fs->fsize + _FS_MIRRORMAP - 1) / _FS_MIRRORMAP;	/* FAT sectors per map bit */
+	for (i = 0; i < _FS_MIRRORMAP; i++) {
+		if (!(fs->mmap[i / 8] & (1 << (i % 8)))) continue;
+		for (sect = i * gsize; sect < (i + 1) * gsize && sect < fs->fsize; sect++) {
+			res = move_window(fs, fs->fatbase + sect);	/* Copy the sector from the first FAT */
+			if (res != FR_OK) return res;
+			for (nf = 1; nf < fs->n_fats; nf++) {
+				if (disk_write(fs->drv, fs->win, fs->fatbase + sect + nf * fs->fsize, 1))
+					return FR_DISK_ERR;
+			}
+		}
+	}
+	mem_set(fs->mmap, 0, sizeof fs->mmap);
+	return set_fat_clean(fs, 1);
+}
+
+
+static
+FRESULT check_mirror (	/* FR_OK: successful, FR_DISK_ERR: failed */
+	FATFS* fs		/* File system object (just mounted) */
+)
+{
+	FRESULT res;
+	BYTE clean;
+
+
+	fs->mflag = 0;
+	mem_set(fs->mmap, 0, sizeof fs->mmap);
+	if (fs->fs_type == FS_FAT12 || fs->n_fats < 2) return FR_OK;
+	res = move_window(fs, fs->fatbase);
+	if (res != FR_OK) return res;
+	clean = (fs->fs_type == FS_FAT32) ? (fs->win[4 + 3] & 0x08) : (fs->win[2 + 1] & 0x80);
+	if (!clean) {							/* Previous session was interrupted */
+		mem_set(fs->mmap, 0xFF, sizeof fs->mmap);	/* Copy the whole first FAT */
+		fs->mflag = 1;
+		res = sync_mirror(fs);
+	}
+	return res;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Synchronize file system and strage device                             */
 /*-----------------------------------------------------------------------*/
@@ -810,6 +1085,14 @@ FRESULT sync_fs (	/* FR_OK: successful, FR_DISK_ERR: failed */
 
 
 	res = sync_window(fs);
+#if _FS_JOURNAL && _FS_LAZYMIRROR
+	if (res == FR_OK && fs->mflag)	/* Other FAT copies are written directly, so commit the first one before */
+		res = commit_journal(fs);
+#endif
+#if _FS_LAZYMIRROR
+	if (res == FR_OK)
+		res = sync_mirror(fs);
+#endif
 	if (res == FR_OK) {
 		/* Update FSINFO sector if needed */
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {
@@ -822,9 +1105,18 @@ FRESULT sync_fs (	/* FR_OK: successful, FR_DISK_ERR: failed */
 			ST_DWORD(fs->win+FSI_Nxt_Free, fs->last_clust);
 			/* Write it into the FSINFO sector */
 			fs->winsect = fs->volbase + 1;
+#if _FS_JOURNAL
+			fs->wflag = 1;
+			res = sync_window(fs);
+#else
 			disk_write(fs->drv, fs->win, fs->winsect, 1);
+#endif
 			fs->fsi_flag = 0;
 		}
+#if _FS_JOURNAL
+		if (res == FR_OK)
+			res = commit_journal(fs);
+#endif
 		/* Make sure that no pending write process in the physical drive */
 		if (disk_ioctl(fs->drv, CTRL_SYNC, 0) != RES_OK)
 			res = FR_DISK_ERR;
@@ -921,6 +1213,12 @@ FRESULT put_fat (
 		res = FR_INT_ERR;
 
 	} else {
+#if _FS_LAZYMIRROR
+		if (!fs->mflag && fs->fs_type != FS_FAT12 && fs->n_fats >= 2) {
+			res = set_fat_clean(fs, 0);		/* Mark FAT copies as different before the first change */
+			if (res != FR_OK) return res;
+		}
+#endif
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;
@@ -992,6 +1290,15 @@ FRESULT remove_chain (
 			if (nxt == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }	/* Disk error? */
 			res = put_fat(fs, clst, 0);			/* Mark the cluster "empty" */
 			if (res != FR_OK) break;
+#if _FS_JOURNAL
+			if (fs->jsect) {					/* Drop journaled sectors of the cluster, it can be reused for file data */
+				UINT i;
+				DWORD sect = clust2sect(fs, clst);
+				for (i = 0; i < fs->jcnt; i++) {
+					if (fs->jtab[i] - sect < fs->csize) fs->jtab[i] = 0xFFFFFFFF;
+				}
+			}
+#endif
 			if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSINFO */
 				fs->free_clust++;
 				fs->fsi_flag |= 1;
@@ -2126,6 +2433,66 @@ int get_ldnumber (		/* Returns logical drive number (-1:invalid drive) */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Open the metadata journal and copy committed sectors home             */
+/*-----------------------------------------------------------------------*/
+#if _FS_JOURNAL
+static
+FRESULT open_journal (	/* FR_OK: successful (with or without journal), FR_DISK_ERR: failed */
+	FATFS* fs		/* File system object (just mounted) */
+)
+{
+	FRESULT res;
+	DIR dj;
+	DWORD clst, ncl, n, sum;
+	UINT i;
+	DEF_NAMEBUF;
+
+
+	fs->jsect = 0; fs->jcnt = 0;
+	dj.fs = fs;
+	INIT_BUF(dj);
+	res = follow_path(&dj, JNL_NAME);
+	if (res == FR_OK && dj.dir && !(dj.dir[DIR_Attr] & AM_DIR)
+		&& LD_DWORD(dj.dir+DIR_FileSize) >= (DWORD)(_FS_JOURNALSIZE + 1) * SS(fs)) {
+		clst = ld_clust(fs, dj.dir);
+		ncl = (_FS_JOURNALSIZE + fs->csize) / fs->csize;
+		if (clst >= 2 && clst + ncl <= fs->n_fatent) {
+			for (n = 1; n < ncl; n++) {		/* The journal must be contiguous */
+				sum = get_fat(fs, clst + n - 1);
+				if (sum == 0xFFFFFFFF) res = FR_DISK_ERR;
+				if (sum != clst + n) break;
+			}
+			if (n == ncl) fs->jsect = clust2sect(fs, clst);
+		}
+	}
+	FREE_BUF();
+	if (res == FR_NO_FILE || res == FR_NO_PATH) res = FR_OK;	/* No journal on the volume */
+
+	if (res == FR_OK && fs->jsect) {	/* Check the commit record */
+		fs->winsect = 0xFFFFFFFF;
+		if (disk_read(fs->drv, fs->win, fs->jsect, 1)) return FR_DISK_ERR;
+		n = LD_DWORD(fs->win+JH_Count);
+		if (LD_DWORD(fs->win+JH_Magic) == JNL_MAGIC && n >= 1 && n <= _FS_JOURNALSIZE) {
+			sum = JNL_MAGIC + n;
+			for (i = 0; i < n; i++) {
+				fs->jtab[i] = LD_DWORD(fs->win+JH_Table+i*4);
+				sum += fs->jtab[i];
+			}
+			if (sum == LD_DWORD(fs->win+JH_Sum)) {	/* Committed but not applied */
+				if (disk_read(fs->drv, fs->jbuf[0], fs->jsect + 1, n)) return FR_DISK_ERR;
+				fs->jcnt = n;
+				res = apply_journal(fs);
+			}
+		}
+	}
+	return res;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Load a sector and check if it is an FAT boot sector                   */
 /*-----------------------------------------------------------------------*/
@@ -2154,6 +2521,78 @@ BYTE check_fs (	/* 0:FAT boor sector, 1:Valid boor sector but not FAT, 2:Not a b
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Mount snapshot                                                        */
+/*-----------------------------------------------------------------------*/
+#if _FS_SNAPSHOT
+static
+DWORD sum_words (	/* Sum of the words in a memory block */
+	const BYTE* p,	/* Pointer to the block */
+	UINT cnt		/* Size of the block in bytes (multiple of 4) */
+)
+{
+	DWORD sum = 0;
+
+
+	for ( ; cnt; cnt -= 4, p += 4) sum += LD_DWORD(p);
+	return sum;
+}
+
+
+static
+BYTE load_snapshot (	/* 0:Boot sector loaded, 1:No valid entry for the card and volume, 3:Disk error */
+	FATFS* fs,		/* File system object */
+	int vol,		/* Logical drive number */
+	DWORD* bsect	/* Boot sector number (function writes it when loaded) */
+)
+{
+	SNAPSHOT *sp;
+	BYTE id[16];
+
+
+	if (!Snapshot || !GetCardId) return 1;
+	sp = &Snapshot[vol];
+	if (sp->magic != SNP_MAGIC || sp->sum != sum_words((const BYTE*)sp, (UINT)((BYTE*)&sp->sum - (BYTE*)sp)))
+		return 1;
+	GetCardId(id);
+	if (mem_cmp(id, sp->cid, sizeof id)) return 1;	/* Another card */
+	switch (check_fs(fs, sp->bsect)) {
+	case 0 :
+		if (sum_words(fs->win, SS(fs)) == sp->bsum) break;
+		return 1;							/* Another volume */
+	case 3 :
+		return 3;
+	default :
+		return 1;
+	}
+	*bsect = sp->bsect;
+	return 0;
+}
+
+
+static
+void save_snapshot (
+	FATFS* fs,		/* File system object (boot sector in the window) */
+	int vol,		/* Logical drive number */
+	DWORD bsect		/* Boot sector number */
+)
+{
+	SNAPSHOT *sp;
+
+
+	if (!Snapshot || !GetCardId) return;
+	sp = &Snapshot[vol];
+	sp->magic = SNP_MAGIC;
+	GetCardId(sp->cid);
+	sp->bsect = bsect;
+	sp->bsum = sum_words(fs->win, SS(fs));
+	sp->sum = sum_words((const BYTE*)sp, (UINT)((BYTE*)&sp->sum - (BYTE*)sp));
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Find logical drive and check if the volume is mounted                 */
 /*-----------------------------------------------------------------------*/
@@ -2210,6 +2649,10 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 #endif
 	/* Find an FAT partition on the drive. Supports only generic partitioning, FDISK and SFD. */
 	bsect = 0;
+#if _FS_SNAPSHOT
+	fmt = load_snapshot(fs, vol, &bsect);		/* Load the boot sector remembered for the card */
+	if (fmt)
+#endif
 	fmt = check_fs(fs, bsect);					/* Load sector 0 and check if it is an FAT boot sector as SFD */
 	if (fmt == 1 || (!fmt && (LD2PT(vol)))) {	/* Not an FAT boot sector or forced partition number */
 		UINT i;
@@ -2283,6 +2726,9 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 	}
 	if (fs->fsize < (szbfat + (SS(fs) - 1)) / SS(fs))	/* (BPB_FATSz must not be less than needed) */
 		return FR_NO_FILESYSTEM;
+#if _FS_SNAPSHOT
+	save_snapshot(fs, vol, bsect);	/* Remember the boot sector for the next mount */
+#endif
 
 #if !_FS_READONLY
 	/* Initialize cluster allocation information */
@@ -2317,6 +2763,25 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 #endif
 #if _FS_LOCK			/* Clear file lock semaphores */
 	clear_lock(fs);
+#endif
+#if !_FS_READONLY && (_FS_LAZYMIRROR || _FS_JOURNAL)
+	fs->wflag = 0; fs->winsect = 0xFFFFFFFF;
+#if _FS_LAZYMIRROR
+	fs->mflag = 0;
+#endif
+#if _FS_JOURNAL
+	fs->jsect = 0; fs->jcnt = 0;
+	if (!(stat & STA_PROTECT) && open_journal(fs) != FR_OK) {	/* Finish the last commit if needed */
+		fs->fs_type = 0;
+		return FR_DISK_ERR;
+	}
+#endif
+#if _FS_LAZYMIRROR
+	if (!(stat & STA_PROTECT) && check_mirror(fs) != FR_OK) {	/* Repair FAT copies if needed */
+		fs->fs_type = 0;
+		return FR_DISK_ERR;
+	}
+#endif
 #endif
 
 	return FR_OK;
@@ -2359,6 +2824,23 @@ FRESULT validate (	/* FR_OK(0): The object is valid, !=0: Invalid */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Set Memory for the Mount Snapshot                                     */
+/*-----------------------------------------------------------------------*/
+#if _FS_SNAPSHOT
+void f_setsnapshot (
+	void* store,				/* Memory kept across resets (SZ_SNAPSHOT bytes, NULL:not used) */
+	void (*cardid)(BYTE* id)	/* Function reading the 16 byte card ID */
+)
+{
+	Snapshot = (SNAPSHOT*)store;
+	GetCardId = cardid;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Mount/Unmount a Logical Drive                                         */
 /*-----------------------------------------------------------------------*/
@@ -2380,6 +2862,10 @@ FRESULT f_mount (
 	cfs = FatFs[vol];					/* Pointer to fs object */
 
 	if (cfs) {
+#if !_FS_READONLY && (_FS_LAZYMIRROR || _FS_JOURNAL)
+		if (cfs->fs_type)				/* Write pending FAT changes before unmounting */
+			sync_fs(cfs);
+#endif
 #if _FS_LOCK
 		clear_lock(cfs);
 #endif
@@ -2789,6 +3275,8 @@ FRESULT f_sync (
 #endif
 			/* Update the directory entry */
 			res = move_window(fp->fs, fp->dir_sect);
+			if (res == FR_OK && disk_ioctl(fp->fs->drv, CTRL_SYNC, 0) != RES_OK)	/* Data and FAT reach the disk before the entry */
+				res = FR_DISK_ERR;
 			if (res == FR_OK) {
 				dir = fp->dir_ptr;
 				dir[DIR_Attr] |= AM_ARC;					/* Set archive bit */
@@ -3742,6 +4230,100 @@ FRESULT f_rename (
 
 
 
+
+#if !_FS_READONLY && _FS_LAZYMIRROR
+/*-----------------------------------------------------------------------*/
+/* Mirror the FAT while the Application is Idle                          */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_idle (
+	const TCHAR* path	/* Logical drive number */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	/* Get logical drive number */
+	res = find_volume(&fs, &path, 1);
+	if (res == FR_OK && fs->mflag)		/* Copy changed FAT sectors to the other FAT copies */
+		res = sync_fs(fs);
+
+	LEAVE_FF(fs, res);
+}
+#endif
+
+
+
+#if _FS_JOURNAL
+/*-----------------------------------------------------------------------*/
+/* Create a Metadata Journal                                             */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_mkjournal (
+	const TCHAR* path	/* Logical drive number */
+)
+{
+	FRESULT res;
+	DIR dj;
+	BYTE *dir;
+	DWORD scl, clst, ncl, n, tm;
+	DEF_NAMEBUF;
+
+
+	/* Get logical drive number */
+	res = find_volume(&dj.fs, &path, 1);
+	if (res == FR_OK) {
+		INIT_BUF(dj);
+		res = follow_path(&dj, JNL_NAME);
+		if (res == FR_OK) res = FR_EXIST;		/* Journal is already existing */
+		if (res == FR_NO_FILE) {				/* Allocate contiguous clusters for the journal */
+			ncl = (_FS_JOURNALSIZE + dj.fs->csize) / dj.fs->csize;
+			scl = clst = 0; res = FR_OK;
+			for (n = 0; n < ncl && res == FR_OK; n++) {
+				clst = create_chain(dj.fs, clst);
+				if (clst == 0) res = FR_DENIED;
+				else if (clst == 1) res = FR_INT_ERR;
+				else if (clst == 0xFFFFFFFF) res = FR_DISK_ERR;
+				else if (!scl) scl = clst;
+				else if (clst != scl + n) res = FR_DENIED;	/* No contiguous free area at the allocation point */
+			}
+			if (res == FR_OK)
+				res = sync_window(dj.fs);
+			if (res == FR_OK) {					/* Clear the commit record */
+				mem_set(dj.fs->win, 0, SS(dj.fs));
+				dj.fs->winsect = 0xFFFFFFFF;
+				if (disk_write(dj.fs->drv, dj.fs->win, clust2sect(dj.fs, scl), 1))
+					res = FR_DISK_ERR;
+			}
+			if (res == FR_OK) res = dir_register(&dj);	/* Register the journal to the root directory */
+			if (res != FR_OK) {
+				if (scl) remove_chain(dj.fs, scl);
+			} else {
+				dir = dj.dir;
+				tm = get_fattime();
+				dir[DIR_Attr] = AM_RDO | AM_HID | AM_SYS;
+				ST_DWORD(dir+DIR_CrtTime, tm);
+				ST_DWORD(dir+DIR_WrtTime, tm);
+				st_clust(dir, scl);
+				ST_DWORD(dir+DIR_FileSize, (DWORD)(_FS_JOURNALSIZE + 1) * SS(dj.fs));
+				dj.fs->wflag = 1;
+				res = sync_fs(dj.fs);
+				if (res == FR_OK) {				/* Journal metadata changes from now on */
+					dj.fs->jsect = clust2sect(dj.fs, scl);
+					dj.fs->jcnt = 0;
+				}
+			}
+		}
+		FREE_BUF();
+	}
+
+	LEAVE_FF(dj.fs, res);
+}
+#endif
+
+
+
 #if _USE_LABEL
 /*-----------------------------------------------------------------------*/
 /* Get volume label                                                      */
@@ -103,6 +103,16 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory start sector (FAT32:Cluster#) */
 	DWORD	database;		/* Data start sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
+#if !_FS_READONLY && _FS_LAZYMIRROR
+	BYTE	mflag;			/* Mirror flag (b0:FAT copies differ) */
+	BYTE	mmap[_FS_MIRRORMAP / 8];	/* Map of FAT sectors not yet copied to other FATs */
+#endif
+#if !_FS_READONLY && _FS_JOURNAL
+	DWORD	jsect;			/* Journal start sector (0:No journal) */
+	UINT	jcnt;			/* Number of sectors in the journal */
+	DWORD	jtab[_FS_JOURNALSIZE];	/* Home sectors of the sectors in the journal */
+	BYTE	jbuf[_FS_JOURNALSIZE][_MAX_SS];	/* Sectors in the journal, written at commit */
+#endif
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
 } FATFS;
 
@@ -231,6 +241,9 @@ FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
 FRESULT f_mkfs (const TCHAR* path, BYTE sfd, UINT au);				/* Create a file system on the volume */
 FRESULT f_fdisk (BYTE pdrv, const DWORD szt[], void* work);			/* Divide a physical drive into some partitions */
+FRESULT f_idle (const TCHAR* path);									/* Mirror the FAT while the application is idle */
+FRESULT f_mkjournal (const TCHAR* path);							/* Create a metadata journal on the volume */
+void f_setsnapshot (void* store, void (*cardid)(BYTE* id));		/* Set memory for the mount snapshot */
 int f_putc (TCHAR c, FIL* fp);										/* Put a character to the file */
 int f_puts (const TCHAR* str, FIL* cp);								/* Put a string to the file */
 int f_printf (FIL* fp, const TCHAR* str, ...);						/* Put a formatted string to the file */
@@ -319,6 +332,10 @@ int ff_del_syncobj (_SYNC_t sobj);				/* Delete a sync object */
 #define CREATE_LINKMAP	0xFFFFFFFF
 
 
+/* Mount snapshot feature */
+#define SZ_SNAPSHOT	((16 + 4 * sizeof (DWORD)) * _VOLUMES)	/* Bytes of memory for f_setsnapshot */
+
+
 
 /*--------------------------------*/
 /* Multi-byte word access macros  */
@@ -177,6 +177,49 @@
 */
 
 
+#ifndef _FS_LAZYMIRROR
+#define _FS_LAZYMIRROR	0	/* 0:Disable or 1:Enable */
+#endif
+#define _FS_MIRRORMAP	256	/* Number of bits in the dirty FAT sector map (multiple of 8) */
+/* When _FS_LAZYMIRROR is set to 1, changes to the FAT are written only to the first
+/  FAT copy. Changed FAT sectors are recorded in a map and copied to the other FAT
+/  copies when the file system is synchronized (f_sync, f_close and other functions
+/  which modify the volume), unmounted or when f_idle is called. While the copies
+/  differ, the clean shutdown bit in FAT[1] is cleared, so copies left different by
+/  a power failure are repaired on the next mount. Each map bit covers 1/_FS_MIRRORMAP
+/  of the FAT. FAT12 volumes are always mirrored immediately. Setting and clearing the
+/  flag costs three sector writes per synchronization, so the option saves writes when
+/  FAT sectors are written back more than once between synchronizations (see
+/  tools/mirror_test.c). The option may also be set on the compiler command line. */
+
+
+#ifndef _FS_JOURNAL
+#define _FS_JOURNAL		0	/* 0:Disable or 1:Enable */
+#endif
+#define _FS_JOURNALSIZE	32	/* Number of sectors in the journal (1 to 125) */
+/* When _FS_JOURNAL is set to 1, volumes with a journal file (created by f_mkjournal)
+/  keep changes to the FAT, directories and FSINFO in the journal until the file
+/  system is synchronized. The changed sectors are kept in the file system object
+/  (_FS_JOURNALSIZE * _MAX_SS bytes) and synchronization writes them to the journal
+/  with one multi-sector write, then a commit record, and then copies them to their
+/  home locations. A journal committed but not copied when power failed is copied
+/  on the next mount, so a power failure never leaves a half updated FAT, directory
+/  entry and FSINFO. If an operation changes more than _FS_JOURNALSIZE sectors, the
+/  journal is committed in the middle of it. The option may also be set on the
+/  compiler command line (PC tests in tools/). */
+
+
+#ifndef _FS_SNAPSHOT
+#define _FS_SNAPSHOT	0	/* 0:Disable or 1:Enable */
+#endif
+/* When _FS_SNAPSHOT is set to 1, f_setsnapshot() gives FatFs memory kept across
+/  resets (backup SRAM). Every mount stores there the boot sector number of the
+/  volume with the card ID and a sum of the boot sector. When both still match, the
+/  next mount reads the boot sector directly and skips the partition table. The BPB
+/  is still parsed from the boot sector, and FSINFO is still read because another
+/  host may change the free cluster hints without touching the boot sector. */
+
+
 
 /*---------------------------------------------------------------------------/
 / System Configurations
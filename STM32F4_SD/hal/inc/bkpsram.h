@@ -0,0 +1,42 @@
+/**
+ * @file    bkpsram.h
+ * @brief   Backup SRAM access
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ * 
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the 
+ * accompanying materials are made available 
+ * under the terms of the GNU Public License 
+ * v3.0 which accompanies this distribution, 
+ * and is available at 
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef BKPSRAM_H_
+#define BKPSRAM_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  BKPSRAM BKPSRAM
+ * @brief     Backup SRAM access functions
+ */
+
+/**
+ * @addtogroup BKPSRAM
+ * @{
+ */
+
+#define BKPSRAM_SIZE 4096 ///< Size of backup SRAM in bytes
+
+void  BKPSRAM_Init        (void);
+void* BKPSRAM_GetAddress  (uint32_t offset);
+
+/**
+ * @}
+ */
+
+#endif /* BKPSRAM_H_ */
@@ -0,0 +1,42 @@
+/**
+ * @file    crc_hal.h
+ * @brief   CRC calculation unit
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef CRC_HAL_H_
+#define CRC_HAL_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  CRC_HAL CRC_HAL
+ * @brief     CRC calculation unit functions
+ */
+
+/**
+ * @addtogroup CRC_HAL
+ * @{
+ */
+
+#define CRC_HAL_DMA_MIN 128 ///< Smallest number of words fed by DMA
+
+void      CRC_HAL_Init    (void);
+uint32_t  CRC_HAL_Update  (uint32_t crc, const uint32_t* data, uint32_t words);
+
+/**
+ * @}
+ */
+
+#endif /* CRC_HAL_H_ */
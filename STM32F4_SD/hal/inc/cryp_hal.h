@@ -0,0 +1,42 @@
+/**
+ * @file    cryp_hal.h
+ * @brief   Cryptographic processor (STM32F415/417 only)
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef CRYP_HAL_H_
+#define CRYP_HAL_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  CRYP_HAL CRYP_HAL
+ * @brief     Cryptographic processor functions
+ */
+
+/**
+ * @addtogroup CRYP_HAL
+ * @{
+ */
+
+void  CRYP_HAL_Init   (const uint8_t* key);
+void  CRYP_HAL_Start  (const uint8_t* counter, const uint8_t* in, uint8_t* out,
+    uint32_t len);
+void  CRYP_HAL_Wait   (void);
+
+/**
+ * @}
+ */
+
+#endif /* CRYP_HAL_H_ */
@@ -0,0 +1,47 @@
+/**
+ * @file    flash_hal.h
+ * @brief   HAL - Internal flash sectors of the configuration store
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ * 
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the 
+ * accompanying materials are made available 
+ * under the terms of the GNU Public License 
+ * v3.0 which accompanies this distribution, 
+ * and is available at 
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef FLASH_HAL_H_
+#define FLASH_HAL_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  FLASH_HAL FLASH_HAL
+ * @brief     HAL - Internal flash functions for the configuration store.
+ */
+
+/**
+ * @addtogroup FLASH_HAL
+ * @{
+ */
+
+#define FLASH_HAL_SECTORS     2         ///< Number of sectors used by configuration store
+#define FLASH_HAL_SECTOR_SIZE 0x20000   ///< Size of sector in bytes (128K)
+
+uint8_t         FLASH_HAL_Erase       (uint8_t sector);
+uint8_t         FLASH_HAL_Program     (uint8_t sector, uint32_t offset,
+                                       const uint32_t* data, uint32_t words);
+const uint32_t* FLASH_HAL_GetAddress  (uint8_t sector);
+void            FLASH_HAL_SetAccelerator(uint8_t prefetch, uint8_t icache,
+                                       uint8_t dcache);
+
+/**
+ * @}
+ */
+
+#endif /* FLASH_HAL_H_ */
@@ -19,6 +19,7 @@
 #define KEYS_HAL_H_
 
 #include <inttypes.h>
+#include <stm32f4xx.h>
 
 /**
  * @defgroup  KEYS_HAL KEYS_HAL
@@ -30,9 +31,15 @@
  * @{
  */
 
-int8_t KEYS_HAL_ReadRow(void);
-void KEYS_HAL_SelectColumn(uint8_t col);
-void KEYS_HAL_Init(void);
+int8_t    KEYS_HAL_ReadRow(void);
+void      KEYS_HAL_SelectColumn(uint8_t col);
+uint16_t  KEYS_HAL_ReadMatrix(void);
+void      KEYS_HAL_Sleep(void);
+void      KEYS_HAL_Init(uint32_t period, void (*scanCb)(void));
+
+// scan timer interrupt - disable when touching data shared with scanCb
+#define KEYS_HAL_IrqEnable  NVIC_EnableIRQ(TIM7_IRQn);
+#define KEYS_HAL_IrqDisable NVIC_DisableIRQ(TIM7_IRQn);
 
 /**
  * @}
@@ -30,11 +30,15 @@
  * @{
  */
 
-#define MAX_LEDS    4 ///< Maximum number of LEDs available in design
+#define MAX_LEDS          4     ///< Maximum number of LEDs available in design
+#define LED_HAL_PWM_MAX   1000  ///< PWM duty for full brightness
+#define LED_HAL_STEP_TIME 20    ///< Time of one pattern step in ms
 
 void LED_HAL_Init         (uint8_t led);
 void LED_HAL_Toggle       (uint8_t led);
 void LED_HAL_ChangeState  (uint8_t led, uint8_t state);
+void LED_HAL_StartPattern (uint8_t led, const uint16_t* steps, uint16_t count);
+void LED_HAL_StopPattern  (uint8_t led);
 
 /**
  * @}
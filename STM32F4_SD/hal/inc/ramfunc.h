@@ -0,0 +1,38 @@
+/**
+ * @file    ramfunc.h
+ * @brief   Functions executed from RAM.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Functions marked with RAMFUNC go to the .ramfunc section,
+ * which the linker script puts at the start of .data, so the startup
+ * code copies them from flash to SRAM together with initialized data.
+ * They run without flash wait states and ART cache misses, even while
+ * the flash is being programmed. CCM RAM is not connected to the
+ * instruction bus, so it can't hold code. Calls between flash and RAM
+ * go through long branch veneers added by the linker.
+ *
+ * With RAMFUNC_IN_FLASH defined the functions stay in flash, to compare
+ * both builds.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+#ifdef RAMFUNC_IN_FLASH
+  #define RAMFUNC
+#else
+  #define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#endif
+
+#endif /* RAMFUNC_H_ */
@@ -0,0 +1,40 @@
+/**
+ * @file    rng_hal.h
+ * @brief   Random number generator
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef RNG_HAL_H_
+#define RNG_HAL_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  RNG_HAL RNG_HAL
+ * @brief     Random number generator functions
+ */
+
+/**
+ * @addtogroup RNG_HAL
+ * @{
+ */
+
+void  RNG_HAL_Init  (void);
+void  RNG_HAL_Read  (uint8_t* buf, uint32_t len);
+
+/**
+ * @}
+ */
+
+#endif /* RNG_HAL_H_ */
@@ -0,0 +1,69 @@
+/**
+ * @file    sdio_hal.h
+ * @brief   SDIO interface (4-bit SD bus)
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef SDIO_HAL_H_
+#define SDIO_HAL_H_
+
+#include <inttypes.h>
+
+/**
+ * @defgroup  SDIO_HAL SDIO_HAL
+ * @brief     SDIO interface functions
+ */
+
+/**
+ * @addtogroup SDIO_HAL
+ * @{
+ */
+
+/**
+ * @brief Kinds of command responses.
+ */
+typedef enum {
+  SDIO_HAL_RESP_NONE,   ///< No response (CMD0)
+  SDIO_HAL_RESP_SHORT,  ///< 48 bit response (R1, R3, R6, R7)
+  SDIO_HAL_RESP_LONG,   ///< 136 bit response (R2)
+} SDIO_HAL_Response;
+
+/**
+ * @brief Bus clock frequencies.
+ */
+typedef enum {
+  SDIO_HAL_CLOCK_INIT,  ///< 400 kHz for identification
+  SDIO_HAL_CLOCK_24MHZ, ///< Default speed (up to 25 MHz)
+  SDIO_HAL_CLOCK_48MHZ, ///< High speed (up to 50 MHz), after CMD6
+} SDIO_HAL_Clock;
+
+#define SDIO_HAL_OK       0 ///< Command or transfer ended
+#define SDIO_HAL_TIMEOUT  1 ///< No response or data timeout
+#define SDIO_HAL_CRC      2 ///< CRC error
+#define SDIO_HAL_ERROR    3 ///< FIFO underrun/overrun or start bit error
+
+void    SDIO_HAL_Init       (void);
+void    SDIO_HAL_SetBus     (uint8_t wide, SDIO_HAL_Clock clock);
+uint8_t SDIO_HAL_Command    (uint8_t cmd, uint32_t arg, SDIO_HAL_Response resp,
+    uint8_t checkCrc, uint32_t* response);
+void    SDIO_HAL_StartData  (uint8_t* buf, uint8_t blockSizeLog2, uint32_t blocks,
+    uint8_t read);
+uint8_t SDIO_HAL_WaitData   (void);
+void    SDIO_HAL_StopData   (void);
+
+/**
+ * @}
+ */
+
+#endif /* SDIO_HAL_H_ */
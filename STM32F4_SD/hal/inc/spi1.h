@@ -30,6 +30,8 @@
  * @{
  */
 
+#define SPI1_FRAME16_MIN  16  ///< Shortest transfer using 16-bit frames (with SPI1_USE_16BIT)
+
 uint8_t SPI1_Transmit       (uint8_t data);
 void    SPI1_Init           (void);
 void    SPI1_Select         (void);
@@ -38,6 +40,12 @@ void    SPI1_ReadBuffer     (uint8_t* buf, uint32_t len);
 void    SPI1_WriteBuffer    (uint8_t* buf, uint32_t len);
 void    SPI1_SendBuffer     (uint8_t* buf, uint32_t len);
 void    SPI1_TransmitBuffer (uint8_t* rx_buf, uint8_t* tx_buf, uint32_t len);
+void    SPI1_Transfer       (const uint8_t* tx, uint8_t* rx, uint32_t len);
+uint16_t SPI1_ReadBlockCrc  (uint8_t* buf, uint32_t len);
+uint16_t SPI1_WriteBlockCrc (const uint8_t* buf, uint32_t len);
+void    SPI1_ReadBufferFlash(uint8_t* buf, uint32_t len);
+
+uint16_t SPI1_SetClockDivider(uint16_t div);
 
 /**
  * @}
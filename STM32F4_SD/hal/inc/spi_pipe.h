@@ -0,0 +1,144 @@
+/**
+ * @file    spi_pipe.h
+ * @brief   Pipelined polled SPI transfer.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details The next frame is written to the data register as soon as
+ * TXE is set, while the previous one is still shifted out, and the
+ * received frame is read in the same loop. The shift register always
+ * has the next frame waiting, so the clock runs without gaps between
+ * frames as long as the loop is faster than one frame.
+ *
+ * The received frame has to be read before the next one is complete,
+ * otherwise it is overwritten (overrun). Interrupts are locked only
+ * from writing a frame to reading the previous one, which is at most
+ * one frame time. An interrupt outside this window only stops the
+ * clock after the frame already written.
+ *
+ * The file is included by the driver of a particular SPI (and by the
+ * PC model of the bus) after defining:
+ *
+ * - SPI_PIPE_TXE()         nonzero when transmit register is empty
+ * - SPI_PIPE_RXNE()        nonzero when receive register is not empty
+ * - SPI_PIPE_WRITE(x)      writes data register
+ * - SPI_PIPE_READ()        reads data register
+ * - SPI_PIPE_LOCK(state)   saves interrupt state in state and locks them
+ * - SPI_PIPE_UNLOCK(state) restores interrupt state
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef SPI_PIPE_H_
+#define SPI_PIPE_H_
+
+#include <inttypes.h>
+
+/**
+ * @addtogroup SPI1
+ * @{
+ */
+
+#define SPI_PIPE_DUMMY 0xff ///< Sent when there is no transmit buffer
+
+/**
+ * @brief Transfers 8-bit frames.
+ * @param tx Transmitted data (0 - send SPI_PIPE_DUMMY)
+ * @param rx Received data (0 - discard)
+ * @param len Number of frames
+ */
+static inline __attribute__((always_inline)) void SPI_PIPE_Transfer8(
+    const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  uint32_t state;
+  uint8_t data;
+
+  if (!len) {
+    return;
+  }
+
+  while (!SPI_PIPE_TXE());
+  SPI_PIPE_WRITE(tx ? *tx++ : SPI_PIPE_DUMMY); // goes straight to shift register
+
+  while (--len) {
+    while (!SPI_PIPE_TXE()); // previous frame moved to shift register
+    SPI_PIPE_LOCK(state);
+    SPI_PIPE_WRITE(tx ? *tx++ : SPI_PIPE_DUMMY);
+    while (!SPI_PIPE_RXNE()); // previous frame received
+    data = SPI_PIPE_READ();
+    SPI_PIPE_UNLOCK(state);
+    if (rx) {
+      *rx++ = data;
+    }
+  }
+
+  while (!SPI_PIPE_RXNE()); // last frame
+  data = SPI_PIPE_READ();
+  if (rx) {
+    *rx = data;
+  }
+}
+/**
+ * @brief Transfers 16-bit frames.
+ * @details Bytes are sent in the order of the buffers (first byte in
+ * the high half of a frame, which is sent first). The SPI has to be
+ * set to 16-bit frames.
+ * @param tx Transmitted data (0 - send SPI_PIPE_DUMMY)
+ * @param rx Received data (0 - discard)
+ * @param len Number of frames (half the number of bytes)
+ */
+static inline __attribute__((always_inline)) void SPI_PIPE_Transfer16(
+    const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  uint32_t state;
+  uint16_t data;
+
+  if (!len) {
+    return;
+  }
+
+  while (!SPI_PIPE_TXE());
+  SPI_PIPE_WRITE(tx ? (tx[0] << 8) | tx[1] :
+      (SPI_PIPE_DUMMY << 8) | SPI_PIPE_DUMMY);
+  if (tx) {
+    tx += 2;
+  }
+
+  while (--len) {
+    while (!SPI_PIPE_TXE());
+    SPI_PIPE_LOCK(state);
+    SPI_PIPE_WRITE(tx ? (tx[0] << 8) | tx[1] :
+        (SPI_PIPE_DUMMY << 8) | SPI_PIPE_DUMMY);
+    while (!SPI_PIPE_RXNE());
+    data = SPI_PIPE_READ();
+    SPI_PIPE_UNLOCK(state);
+    if (tx) {
+      tx += 2;
+    }
+    if (rx) {
+      *rx++ = data >> 8;
+      *rx++ = data;
+    }
+  }
+
+  while (!SPI_PIPE_RXNE());
+  data = SPI_PIPE_READ();
+  if (rx) {
+    *rx++ = data >> 8;
+    *rx = data;
+  }
+}
+
+/**
+ * @}
+ */
+
+#endif /* SPI_PIPE_H_ */
@@ -33,6 +33,7 @@
 
 void    UART2_Init(uint32_t baud, void(*rxCb)(uint8_t), uint8_t(*txCb)(uint8_t*));
 void    UART2_TxEnable(void);
+uint32_t UART2_MeasureEntry(void);
 
 // HAL functions for use in higher level
 #define COMM_HAL_Init       UART2_Init
@@ -0,0 +1,59 @@
+/**
+ * @file    bkpsram.c
+ * @brief   Backup SRAM access
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ * 
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the 
+ * accompanying materials are made available 
+ * under the terms of the GNU Public License 
+ * v3.0 which accompanies this distribution, 
+ * and is available at 
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <bkpsram.h>
+
+/**
+ * @addtogroup BKPSRAM
+ * @{
+ */
+
+/**
+ * @brief Initialize backup SRAM
+ *
+ * @details Enables write access to the backup domain and the backup
+ * regulator, so the contents of backup SRAM survive resets (and
+ * loss of main power when VBAT is connected).
+ */
+void BKPSRAM_Init(void) {
+
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR, ENABLE);
+  PWR_BackupAccessCmd(ENABLE); // allow writing to backup domain
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_BKPSRAM, ENABLE);
+
+  PWR_BackupRegulatorCmd(ENABLE);
+  // wait until backup regulator is ready
+  while (PWR_GetFlagStatus(PWR_FLAG_BRR) == RESET);
+}
+/**
+ * @brief Get address of a location in backup SRAM
+ * @param offset Offset from start of backup SRAM
+ * @return Address of location or 0 if offset is out of range
+ */
+void* BKPSRAM_GetAddress(uint32_t offset) {
+
+  if (offset >= BKPSRAM_SIZE) {
+    return 0;
+  }
+  return (void*)(uintptr_t)(BKPSRAM_BASE + offset);
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,108 @@
+/**
+ * @file    crc_hal.c
+ * @brief   CRC calculation unit
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <crc_hal.h>
+
+/**
+ * @addtogroup CRC_HAL
+ * @{
+ */
+
+/*
+ * Large blocks are written to the CRC data register by a memory to
+ * memory transfer (only DMA2 can do it). DMA2 cannot read the CCM RAM.
+ */
+#define CRC_DMA_STREAM    DMA2_Stream7
+#define CRC_DMA_TC_FLAG   DMA_FLAG_TCIF7
+#define CRC_DMA_MAX       0xffff      ///< Maximum words in one transfer
+#define CRC_CCM_START     0x10000000  ///< Start of CCM RAM
+#define CRC_CCM_END       0x10010000  ///< End of CCM RAM
+
+/**
+ * @brief Initializes the CRC unit.
+ */
+void CRC_HAL_Init(void) {
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC | RCC_AHB1Periph_DMA2, ENABLE);
+}
+/**
+ * @brief Continues a CRC over words.
+ * @details The CRC unit always starts from 0xFFFFFFFF and cannot be
+ * loaded, but as the first word is XORed with the current value, writing
+ * it XORed with crc ^ 0xFFFFFFFF continues from crc.
+ * @param crc CRC of preceding data
+ * @param data Words (aligned)
+ * @param words Number of words
+ * @return CRC
+ */
+uint32_t CRC_HAL_Update(uint32_t crc, const uint32_t* data, uint32_t words) {
+
+  if (words == 0) {
+    return crc;
+  }
+
+  CRC_ResetDR();
+  CRC->DR = *data++ ^ crc ^ 0xffffffff;
+  words--;
+
+  uint32_t address = (uint32_t)data;
+  if (words < CRC_HAL_DMA_MIN ||
+      (address >= CRC_CCM_START && address < CRC_CCM_END)) {
+    while (words--) {
+      CRC->DR = *data++;
+    }
+    return CRC->DR;
+  }
+
+  DMA_InitTypeDef DMA_InitStructure;
+  DMA_StructInit(&DMA_InitStructure);
+  DMA_InitStructure.DMA_Channel             = DMA_Channel_0;
+  DMA_InitStructure.DMA_Memory0BaseAddr     = (uint32_t)&CRC->DR;
+  DMA_InitStructure.DMA_DIR                 = DMA_DIR_MemoryToMemory;
+  DMA_InitStructure.DMA_PeripheralInc       = DMA_PeripheralInc_Enable;
+  DMA_InitStructure.DMA_MemoryInc           = DMA_MemoryInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_Word;
+  DMA_InitStructure.DMA_MemoryDataSize      = DMA_MemoryDataSize_Word;
+  DMA_InitStructure.DMA_Mode                = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority            = DMA_Priority_Low;
+  DMA_InitStructure.DMA_FIFOMode            = DMA_FIFOMode_Enable; // needed for memory to memory
+  DMA_InitStructure.DMA_FIFOThreshold       = DMA_FIFOThreshold_Full;
+
+  while (words) {
+
+    uint32_t n = words < CRC_DMA_MAX ? words : CRC_DMA_MAX;
+
+    // in memory to memory mode the peripheral port is the source
+    DMA_InitStructure.DMA_PeripheralBaseAddr  = (uint32_t)data;
+    DMA_InitStructure.DMA_BufferSize          = n;
+    DMA_DeInit(CRC_DMA_STREAM);
+    DMA_Init(CRC_DMA_STREAM, &DMA_InitStructure);
+    DMA_Cmd(CRC_DMA_STREAM, ENABLE);
+
+    while (DMA_GetFlagStatus(CRC_DMA_STREAM, CRC_DMA_TC_FLAG) == RESET);
+
+    data += n;
+    words -= n;
+  }
+
+  return CRC->DR;
+}
+
+/**
+ * @}
+ */
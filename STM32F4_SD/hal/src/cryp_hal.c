@@ -0,0 +1,149 @@
+/**
+ * @file    cryp_hal.c
+ * @brief   Cryptographic processor (STM32F415/417 only)
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details The processor encrypts in AES-CTR mode while DMA2 feeds the
+ * input FIFO (stream 6) and empties the output FIFO (stream 5), so the
+ * CPU is free until CRYP_HAL_Wait. The STM32F405/407 have no
+ * cryptographic processor, there the software AES is used.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <cryp_hal.h>
+
+/**
+ * @addtogroup CRYP_HAL
+ * @{
+ */
+
+#define CRYP_DMA_IN       DMA2_Stream6
+#define CRYP_DMA_OUT      DMA2_Stream5
+#define CRYP_DMA_CHANNEL  DMA_Channel_2
+#define CRYP_DMA_OUT_TC   DMA_FLAG_TCIF5
+
+static CRYP_KeyInitTypeDef keyInit; ///< Key loaded before every operation
+
+static uint32_t CRYP_HAL_Load(const uint8_t* p);
+
+/**
+ * @brief Initializes the cryptographic processor.
+ * @param key AES-128 key (16 bytes)
+ */
+void CRYP_HAL_Init(const uint8_t* key) {
+
+  RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_CRYP, ENABLE);
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+
+  // a 128 bit key goes to the last two key registers
+  CRYP_KeyStructInit(&keyInit);
+  keyInit.CRYP_Key2Left   = CRYP_HAL_Load(key);
+  keyInit.CRYP_Key2Right  = CRYP_HAL_Load(key + 4);
+  keyInit.CRYP_Key3Left   = CRYP_HAL_Load(key + 8);
+  keyInit.CRYP_Key3Right  = CRYP_HAL_Load(key + 12);
+}
+/**
+ * @brief Starts AES-CTR encryption of data.
+ * @details Returns at once, CRYP_HAL_Wait must be called before the
+ * output is used or the next operation is started.
+ * @param counter Initial counter block (16 bytes)
+ * @param in Input data (aligned, not in CCM RAM)
+ * @param out Output data (aligned, not in CCM RAM, may be the same as in)
+ * @param len Length of data (multiple of 16)
+ */
+void CRYP_HAL_Start(const uint8_t* counter, const uint8_t* in, uint8_t* out,
+    uint32_t len) {
+
+  CRYP_InitTypeDef CRYP_InitStructure;
+  CRYP_IVInitTypeDef CRYP_IVInitStructure;
+  DMA_InitTypeDef DMA_InitStructure;
+
+  CRYP_Cmd(DISABLE);
+  CRYP_FIFOFlush();
+
+  CRYP_InitStructure.CRYP_AlgoDir   = CRYP_AlgoDir_Encrypt;
+  CRYP_InitStructure.CRYP_AlgoMode  = CRYP_AlgoMode_AES_CTR;
+  CRYP_InitStructure.CRYP_DataType  = CRYP_DataType_8b;
+  CRYP_InitStructure.CRYP_KeySize   = CRYP_KeySize_128b;
+  CRYP_Init(&CRYP_InitStructure);
+  CRYP_KeyInit(&keyInit);
+
+  CRYP_IVInitStructure.CRYP_IV0Left   = CRYP_HAL_Load(counter);
+  CRYP_IVInitStructure.CRYP_IV0Right  = CRYP_HAL_Load(counter + 4);
+  CRYP_IVInitStructure.CRYP_IV1Left   = CRYP_HAL_Load(counter + 8);
+  CRYP_IVInitStructure.CRYP_IV1Right  = CRYP_HAL_Load(counter + 12);
+  CRYP_IVInit(&CRYP_IVInitStructure);
+
+  DMA_StructInit(&DMA_InitStructure);
+  DMA_InitStructure.DMA_Channel             = CRYP_DMA_CHANNEL;
+  DMA_InitStructure.DMA_BufferSize          = len / 4;
+  DMA_InitStructure.DMA_PeripheralInc       = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_MemoryInc           = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_Word;
+  DMA_InitStructure.DMA_MemoryDataSize      = DMA_MemoryDataSize_Word;
+  DMA_InitStructure.DMA_Mode                = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority            = DMA_Priority_High;
+  DMA_InitStructure.DMA_FIFOMode            = DMA_FIFOMode_Enable;
+  // a burst of 4 words takes the whole FIFO (RM0090 FIFO threshold table)
+  DMA_InitStructure.DMA_FIFOThreshold       = DMA_FIFOThreshold_Full;
+  DMA_InitStructure.DMA_MemoryBurst         = DMA_MemoryBurst_INC4;
+  DMA_InitStructure.DMA_PeripheralBurst     = DMA_PeripheralBurst_INC4;
+
+  // input: memory to input FIFO
+  DMA_InitStructure.DMA_PeripheralBaseAddr  = (uint32_t)&CRYP->DR;
+  DMA_InitStructure.DMA_Memory0BaseAddr     = (uint32_t)in;
+  DMA_InitStructure.DMA_DIR                 = DMA_DIR_MemoryToPeripheral;
+  DMA_DeInit(CRYP_DMA_IN);
+  DMA_Init(CRYP_DMA_IN, &DMA_InitStructure);
+
+  // output: output FIFO to memory
+  DMA_InitStructure.DMA_PeripheralBaseAddr  = (uint32_t)&CRYP->DOUT;
+  DMA_InitStructure.DMA_Memory0BaseAddr     = (uint32_t)out;
+  DMA_InitStructure.DMA_DIR                 = DMA_DIR_PeripheralToMemory;
+  DMA_DeInit(CRYP_DMA_OUT);
+  DMA_Init(CRYP_DMA_OUT, &DMA_InitStructure);
+
+  DMA_Cmd(CRYP_DMA_OUT, ENABLE);
+  DMA_Cmd(CRYP_DMA_IN, ENABLE);
+  CRYP_DMACmd(CRYP_DMAReq_DataIN | CRYP_DMAReq_DataOUT, ENABLE);
+  CRYP_Cmd(ENABLE);
+}
+/**
+ * @brief Waits until the started operation ends.
+ */
+void CRYP_HAL_Wait(void) {
+
+  if (!(CRYP_DMA_OUT->CR & DMA_SxCR_EN) &&
+      DMA_GetFlagStatus(CRYP_DMA_OUT, CRYP_DMA_OUT_TC) == RESET) {
+    return; // nothing started
+  }
+
+  while (DMA_GetFlagStatus(CRYP_DMA_OUT, CRYP_DMA_OUT_TC) == RESET);
+
+  DMA_ClearFlag(CRYP_DMA_OUT, CRYP_DMA_OUT_TC);
+  CRYP_DMACmd(CRYP_DMAReq_DataIN | CRYP_DMAReq_DataOUT, DISABLE);
+  CRYP_Cmd(DISABLE);
+}
+/**
+ * @brief Loads a big endian word.
+ */
+static uint32_t CRYP_HAL_Load(const uint8_t* p) {
+
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+      ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,57 @@
+/**
+ * @file    dwt.c
+ * @brief   Cycle counter of the debug unit
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <dwt.h>
+
+/**
+ * @addtogroup DWT
+ * @{
+ */
+
+/**
+ * @brief Starts the cycle counter.
+ * @details The counter runs at the core clock and wraps after
+ * about 25 s at 168 MHz, differences of readings stay valid.
+ * It is not cleared, since the startup code starts it at reset
+ * to time the boot.
+ */
+void DWT_Init(void) {
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // enable trace unit
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+/**
+ * @brief Reads the cycle counter.
+ * @return Core clock cycles
+ */
+uint32_t DWT_GetCycles(void) {
+
+  return DWT->CYCCNT;
+}
+/**
+ * @brief Gets the rate of the cycle counter.
+ * @return Core clock in Hz
+ */
+uint32_t DWT_GetFrequency(void) {
+
+  return SystemCoreClock;
+}
+
+/**
+ * @}
+ */
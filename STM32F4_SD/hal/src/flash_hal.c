@@ -0,0 +1,133 @@
+/**
+ * @file    flash_hal.c
+ * @brief   HAL - Internal flash sectors of the configuration store
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ * 
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the 
+ * accompanying materials are made available 
+ * under the terms of the GNU Public License 
+ * v3.0 which accompanies this distribution, 
+ * and is available at 
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <flash_hal.h>
+#include <stm32f4xx.h>
+
+/**
+ * @addtogroup FLASH_HAL
+ * @{
+ */
+
+/**
+ * @brief Flash sectors used by configuration store
+ *
+ * @details These are the last two sectors of the 1M flash,
+ * left out of the FLASH region in mem.ld.
+ */
+static const uint32_t flashSector[FLASH_HAL_SECTORS] = {
+    FLASH_Sector_10,
+    FLASH_Sector_11};
+/**
+ * @brief Addresses of flash sectors
+ */
+static const uint32_t flashAddress[FLASH_HAL_SECTORS] = {
+    0x080C0000,
+    0x080E0000};
+
+/**
+ * @brief Erase a sector.
+ *
+ * @details Erasing takes up to 2 s (typically 1 s). The CPU
+ * stalls on every flash access while erase is in progress.
+ *
+ * @param sector Sector number (0 to FLASH_HAL_SECTORS-1)
+ * @retval 0 Sector erased
+ * @retval 1 Erase error
+ */
+uint8_t FLASH_HAL_Erase(uint8_t sector) {
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+      FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+  FLASH_Status status = FLASH_EraseSector(flashSector[sector], VoltageRange_3);
+
+  FLASH_Lock();
+  return status != FLASH_COMPLETE;
+}
+/**
+ * @brief Program words in a sector.
+ *
+ * @details Programming can only clear bits, so the words
+ * should be erased (0xffffffff) before.
+ *
+ * @param sector Sector number (0 to FLASH_HAL_SECTORS-1)
+ * @param offset Offset in sector (multiple of 4)
+ * @param data Data
+ * @param words Number of words to program
+ * @retval 0 Words programmed
+ * @retval 1 Programming error
+ */
+uint8_t FLASH_HAL_Program(uint8_t sector, uint32_t offset,
+    const uint32_t* data, uint32_t words) {
+
+  uint8_t ret = 0;
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+      FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+  for (uint32_t i = 0; i < words; i++) {
+    // word access needs 2.7 V to 3.6 V supply (VoltageRange_3)
+    if (FLASH_ProgramWord(flashAddress[sector] + offset + 4 * i, data[i]) !=
+        FLASH_COMPLETE) {
+      ret = 1;
+      break;
+    }
+  }
+
+  FLASH_Lock();
+  return ret;
+}
+/**
+ * @brief Get address of a sector.
+ *
+ * @details Flash is memory mapped, so it is read directly.
+ *
+ * @param sector Sector number (0 to FLASH_HAL_SECTORS-1)
+ * @return Address of sector
+ */
+const uint32_t* FLASH_HAL_GetAddress(uint8_t sector) {
+
+  return (const uint32_t*)(uintptr_t)flashAddress[sector];
+}
+/**
+ * @brief Configures the flash accelerator (ART).
+ * @details The caches are disabled and reset before enabling, since
+ * they can only be reset while disabled. The wait states are left as
+ * set by SystemInit.
+ * @param prefetch Enable prefetch buffer
+ * @param icache Enable instruction cache
+ * @param dcache Enable data cache
+ */
+void FLASH_HAL_SetAccelerator(uint8_t prefetch, uint8_t icache,
+    uint8_t dcache) {
+
+  FLASH_InstructionCacheCmd(DISABLE);
+  FLASH_DataCacheCmd(DISABLE);
+  FLASH_InstructionCacheReset();
+  FLASH_DataCacheReset();
+
+  FLASH_PrefetchBufferCmd(prefetch ? ENABLE : DISABLE);
+  FLASH_InstructionCacheCmd(icache ? ENABLE : DISABLE);
+  FLASH_DataCacheCmd(dcache ? ENABLE : DISABLE);
+}
+
+/**
+ * @}
+ */
@@ -41,10 +41,33 @@
 #define KEYS_COL_PORT   GPIOE
 #define KEYS_COL_CLOCK  RCC_AHB1Periph_GPIOE
 
+#define KEYS_ROW_PINS (KEYS_ROW0_PIN | KEYS_ROW1_PIN | KEYS_ROW2_PIN | KEYS_ROW3_PIN)
+#define KEYS_COL_PINS (KEYS_COL0_PIN | KEYS_COL1_PIN | KEYS_COL2_PIN | KEYS_COL3_PIN)
+#define KEYS_ROW_SHIFT 11 ///< Position of row 0 in port
+
+/*
+ * Wake-up interrupt on row pins, used while no key is pressed.
+ */
+#define KEYS_EXTI_PORT  EXTI_PortSourceGPIOE
+#define KEYS_EXTI_LINES (EXTI_Line11 | EXTI_Line12 | EXTI_Line13 | EXTI_Line14)
+
+#define KEYS_SETTLE_TIME 50 ///< Loop count to let rows settle after column change
+
+static void (*scanCallback)(void); ///< Called on every scan timer tick
+
+static void KEYS_HAL_Wake(void);
+
 /**
  * @brief Initialize 4x4 matrix keyboard
+ * @details Starts TIM7 calling the scan callback every period. The
+ * row pins also get falling edge interrupts, which are unmasked only
+ * when the keyboard is put to sleep with KEYS_HAL_Sleep.
+ * @param period Scan period in ms
+ * @param scanCb Scan callback (called in interrupt)
  */
-void KEYS_HAL_Init(void) {
+void KEYS_HAL_Init(uint32_t period, void (*scanCb)(void)) {
+
+  scanCallback = scanCb;
 
   // Enable clocks
   RCC_AHB1PeriphClockCmd(KEYS_ROW_CLOCK, ENABLE);
@@ -53,8 +76,7 @@ void KEYS_HAL_Init(void) {
   GPIO_InitTypeDef GPIO_InitStructure;
 
   // Configure row pins in input pulled-up mode
-  GPIO_InitStructure.GPIO_Pin   = KEYS_ROW0_PIN | KEYS_ROW1_PIN |
-      KEYS_ROW2_PIN | KEYS_ROW3_PIN;
+  GPIO_InitStructure.GPIO_Pin   = KEYS_ROW_PINS;
   GPIO_InitStructure.GPIO_OType = GPIO_OType_PP; // irrelevant
   GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz; // irrelevant
   GPIO_InitStructure.GPIO_Mode  = GPIO_Mode_IN;
@@ -63,8 +85,7 @@ void KEYS_HAL_Init(void) {
   GPIO_Init(KEYS_ROW_PORT, &GPIO_InitStructure);
 
   // Configure column pins in output push/pull mode
-  GPIO_InitStructure.GPIO_Pin   = KEYS_COL0_PIN | KEYS_COL1_PIN |
-      KEYS_COL2_PIN | KEYS_COL3_PIN;
+  GPIO_InitStructure.GPIO_Pin   = KEYS_COL_PINS;
   GPIO_InitStructure.GPIO_Mode  = GPIO_Mode_OUT;
   GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
   GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz; // less interference
@@ -72,6 +93,48 @@ void KEYS_HAL_Init(void) {
 
   GPIO_Init(KEYS_COL_PORT, &GPIO_InitStructure);
 
+  // no column selected
+  GPIO_SetBits(KEYS_COL_PORT, KEYS_COL_PINS);
+
+  // Connect row pins to EXTI lines, lines stay masked for now
+  RCC_APB2PeriphClockCmd(RCC_APB2Periph_SYSCFG, ENABLE);
+  SYSCFG_EXTILineConfig(KEYS_EXTI_PORT, EXTI_PinSource11);
+  SYSCFG_EXTILineConfig(KEYS_EXTI_PORT, EXTI_PinSource12);
+  SYSCFG_EXTILineConfig(KEYS_EXTI_PORT, EXTI_PinSource13);
+  SYSCFG_EXTILineConfig(KEYS_EXTI_PORT, EXTI_PinSource14);
+
+  EXTI_InitTypeDef EXTI_InitStructure;
+  EXTI_InitStructure.EXTI_Line    = KEYS_EXTI_LINES;
+  EXTI_InitStructure.EXTI_Mode    = EXTI_Mode_Interrupt;
+  EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Falling;
+  EXTI_InitStructure.EXTI_LineCmd = DISABLE;
+  EXTI_Init(&EXTI_InitStructure);
+
+  // Scan timer - 10kHz clock
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM7, ENABLE);
+
+  TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+  TIM_TimeBaseStructure.TIM_Prescaler = 8400 - 1;
+  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+  TIM_TimeBaseStructure.TIM_Period = period * 10 - 1;
+  TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+  TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+  TIM_TimeBaseInit(TIM7, &TIM_TimeBaseStructure);
+
+  // Same priority for both interrupts, so they never preempt each other
+  NVIC_InitTypeDef NVIC_InitStructure;
+  NVIC_InitStructure.NVIC_IRQChannel = TIM7_IRQn;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 2;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+
+  NVIC_InitStructure.NVIC_IRQChannel = EXTI15_10_IRQn;
+  NVIC_Init(&NVIC_InitStructure);
+
+  TIM_ITConfig(TIM7, TIM_IT_Update, ENABLE);
+
+  TIM_Cmd(TIM7, ENABLE); // enable timer
 }
 /**
  * @brief Select a column
@@ -122,6 +185,83 @@ int8_t KEYS_HAL_ReadRow(void) {
 
   return -1;
 }
+/**
+ * @brief Reads the whole keyboard.
+ * @details Selects every column in turn and reads all four rows.
+ * Afterwards no column is selected.
+ * @return Bitmap of pressed keys, bit (4 * column + row)
+ */
+uint16_t KEYS_HAL_ReadMatrix(void) {
+
+  uint16_t matrix = 0;
+
+  for (uint8_t col = 0; col < 4; col++) {
+    KEYS_HAL_SelectColumn(col);
+    // wait for pull-ups to charge rows of previous column
+    for (volatile uint8_t i = 0; i < KEYS_SETTLE_TIME; i++);
+    // negate, because we use low level for keypress
+    uint16_t rows = ~GPIO_ReadInputData(KEYS_ROW_PORT) & KEYS_ROW_PINS;
+    matrix |= (rows >> KEYS_ROW_SHIFT) << (4 * col);
+  }
+  KEYS_HAL_SelectColumn(4); // deselect all
+
+  return matrix;
+}
+/**
+ * @brief Stops scanning until a key is pressed.
+ * @details All columns are driven low, so any key pulls its row low
+ * and the EXTI interrupt restarts the scan timer. Call from the scan
+ * callback when no key is pressed.
+ */
+void KEYS_HAL_Sleep(void) {
+
+  TIM_Cmd(TIM7, DISABLE);
+  GPIO_ResetBits(KEYS_COL_PORT, KEYS_COL_PINS);
+
+  for (volatile uint8_t i = 0; i < KEYS_SETTLE_TIME; i++);
+  EXTI_ClearITPendingBit(KEYS_EXTI_LINES);
+  EXTI->IMR |= KEYS_EXTI_LINES;
+
+  // key pressed before interrupt was enabled - no edge will come
+  if ((GPIO_ReadInputData(KEYS_ROW_PORT) & KEYS_ROW_PINS) != KEYS_ROW_PINS) {
+    KEYS_HAL_Wake();
+  }
+}
+/**
+ * @brief Restarts scanning after sleep.
+ */
+static void KEYS_HAL_Wake(void) {
+
+  EXTI->IMR &= ~KEYS_EXTI_LINES;
+  EXTI_ClearITPendingBit(KEYS_EXTI_LINES);
+  GPIO_SetBits(KEYS_COL_PORT, KEYS_COL_PINS);
+
+  TIM_SetCounter(TIM7, 0);
+  TIM_Cmd(TIM7, ENABLE);
+}
+/**
+ * @brief IRQ handler for TIM7 (keyboard scan)
+ */
+void TIM7_IRQHandler(void) {
+
+  if (TIM_GetFlagStatus(TIM7, TIM_FLAG_Update) != RESET) {
+    // clear flag
+    TIM_ClearFlag(TIM7, TIM_FLAG_Update);
+
+    if (scanCallback) {
+      scanCallback();
+    }
+  }
+}
+/**
+ * @brief IRQ handler for EXTI lines 10-15 (key pressed during sleep)
+ */
+void EXTI15_10_IRQHandler(void) {
+
+  if (EXTI->PR & KEYS_EXTI_LINES) {
+    KEYS_HAL_Wake();
+  }
+}
 /**
  * @}
  */
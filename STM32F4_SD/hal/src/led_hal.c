@@ -47,6 +47,55 @@ static uint32_t ledClk[MAX_LEDS] = {
     RCC_AHB1Periph_GPIOD,
     RCC_AHB1Periph_GPIOD,
     RCC_AHB1Periph_GPIOD};
+/**
+ * @brief LED pin sources (for alternate function)
+ */
+static uint8_t ledPinSource[MAX_LEDS] = {
+    GPIO_PinSource12,
+    GPIO_PinSource13,
+    GPIO_PinSource14,
+    GPIO_PinSource15};
+
+/*
+ * Patterns are played without the CPU: TIM4 generates PWM on the LED
+ * pins (channels 1-4) and TIM5 ticks every pattern step. The compare
+ * event of TIM5 channel n requests a DMA transfer of the next step from
+ * a circular table to the duty register of TIM4 channel n, so every
+ * LED has its own stream and pattern length.
+ */
+#define LED_PWM_TIMER     TIM4
+#define LED_PWM_AF        GPIO_AF_TIM4
+#define LED_STEP_TIMER    TIM5
+#define LED_DMA_CHANNEL   DMA_Channel_6 ///< TIM5 requests on DMA1
+
+/**
+ * @brief PWM duty registers
+ */
+static volatile uint32_t* const ledDuty[MAX_LEDS] = {
+    &TIM4->CCR1,
+    &TIM4->CCR2,
+    &TIM4->CCR3,
+    &TIM4->CCR4};
+/**
+ * @brief Step timer DMA requests
+ */
+static const uint16_t ledStepRequest[MAX_LEDS] = {
+    TIM_DMA_CC1,
+    TIM_DMA_CC2,
+    TIM_DMA_CC3,
+    TIM_DMA_CC4};
+/**
+ * @brief DMA streams serving step timer requests
+ */
+static DMA_Stream_TypeDef* const ledStream[MAX_LEDS] = {
+    DMA1_Stream2, // TIM5_CH1
+    DMA1_Stream4, // TIM5_CH2
+    DMA1_Stream0, // TIM5_CH3
+    DMA1_Stream1};// TIM5_CH4
+
+static uint8_t timersStarted; ///< Nonzero if pattern timers are running
+
+static void LED_HAL_TimersInit(void);
 
 /**
  * @brief Add an LED.
@@ -95,6 +144,132 @@ void LED_HAL_ChangeState(uint8_t led, uint8_t state) {
 
 }
 
+/**
+ * @brief Starts playing a pattern on an LED.
+ * @details The steps are PWM duties (0 - LED_HAL_PWM_MAX), one per
+ * LED_HAL_STEP_TIME, repeated forever. The table is read by DMA, so it
+ * must stay valid until LED_HAL_StopPattern.
+ * @param led LED number.
+ * @param steps Table of steps
+ * @param count Number of steps
+ */
+void LED_HAL_StartPattern(uint8_t led, const uint16_t* steps, uint16_t count) {
+
+  if (!timersStarted) {
+    LED_HAL_TimersInit();
+  }
+  LED_HAL_StopPattern(led);
+
+  *ledDuty[led] = steps[0];
+
+  DMA_InitTypeDef DMA_InitStructure;
+  DMA_StructInit(&DMA_InitStructure);
+  DMA_InitStructure.DMA_Channel             = LED_DMA_CHANNEL;
+  DMA_InitStructure.DMA_PeripheralBaseAddr  = (uint32_t)ledDuty[led];
+  DMA_InitStructure.DMA_Memory0BaseAddr     = (uint32_t)steps;
+  DMA_InitStructure.DMA_DIR                 = DMA_DIR_MemoryToPeripheral;
+  DMA_InitStructure.DMA_BufferSize          = count;
+  DMA_InitStructure.DMA_PeripheralInc       = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_MemoryInc           = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_HalfWord;
+  DMA_InitStructure.DMA_MemoryDataSize      = DMA_MemoryDataSize_HalfWord;
+  DMA_InitStructure.DMA_Mode                = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Priority            = DMA_Priority_Low;
+  DMA_Init(ledStream[led], &DMA_InitStructure);
+  DMA_Cmd(ledStream[led], ENABLE);
+
+  TIM_DMACmd(LED_STEP_TIMER, ledStepRequest[led], ENABLE);
+
+  // connect pin to PWM output
+  GPIO_PinAFConfig(ledPort[led], ledPinSource[led], LED_PWM_AF);
+
+  GPIO_InitTypeDef GPIO_InitStructure;
+  GPIO_InitStructure.GPIO_Pin   = ledPin[led];
+  GPIO_InitStructure.GPIO_Mode  = GPIO_Mode_AF;
+  GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+  GPIO_InitStructure.GPIO_PuPd  = GPIO_PuPd_NOPULL;
+  GPIO_Init(ledPort[led], &GPIO_InitStructure);
+}
+/**
+ * @brief Stops the pattern of an LED.
+ * @details The pin goes back to GPIO output and the LED is off.
+ * @param led LED number.
+ */
+void LED_HAL_StopPattern(uint8_t led) {
+
+  if (!timersStarted) {
+    return;
+  }
+
+  TIM_DMACmd(LED_STEP_TIMER, ledStepRequest[led], DISABLE);
+  DMA_Cmd(ledStream[led], DISABLE);
+  while (DMA_GetCmdStatus(ledStream[led]) != DISABLE); // finish transfer
+  DMA_DeInit(ledStream[led]); // clear flags
+
+  ledPort[led]->BSRRH = ledPin[led]; // reset bit
+
+  GPIO_InitTypeDef GPIO_InitStructure;
+  GPIO_InitStructure.GPIO_Pin   = ledPin[led];
+  GPIO_InitStructure.GPIO_Mode  = GPIO_Mode_OUT;
+  GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+  GPIO_InitStructure.GPIO_PuPd  = GPIO_PuPd_NOPULL;
+  GPIO_Init(ledPort[led], &GPIO_InitStructure);
+}
+/**
+ * @brief Starts the PWM and step timers.
+ */
+static void LED_HAL_TimersInit(void) {
+
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4 | RCC_APB1Periph_TIM5, ENABLE);
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+  // PWM timer - 1MHz clock, 1kHz PWM
+  TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+  TIM_TimeBaseStructure.TIM_Prescaler = 84 - 1;
+  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+  TIM_TimeBaseStructure.TIM_Period = LED_HAL_PWM_MAX - 1;
+  TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+  TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+  TIM_TimeBaseInit(LED_PWM_TIMER, &TIM_TimeBaseStructure);
+
+  TIM_OCInitTypeDef TIM_OCInitStructure;
+  TIM_OCStructInit(&TIM_OCInitStructure);
+  TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+  TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+  TIM_OCInitStructure.TIM_Pulse = 0;
+  TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+
+  // duty changes at end of PWM period - no glitches
+  TIM_OC1Init(LED_PWM_TIMER, &TIM_OCInitStructure);
+  TIM_OC1PreloadConfig(LED_PWM_TIMER, TIM_OCPreload_Enable);
+  TIM_OC2Init(LED_PWM_TIMER, &TIM_OCInitStructure);
+  TIM_OC2PreloadConfig(LED_PWM_TIMER, TIM_OCPreload_Enable);
+  TIM_OC3Init(LED_PWM_TIMER, &TIM_OCInitStructure);
+  TIM_OC3PreloadConfig(LED_PWM_TIMER, TIM_OCPreload_Enable);
+  TIM_OC4Init(LED_PWM_TIMER, &TIM_OCInitStructure);
+  TIM_OC4PreloadConfig(LED_PWM_TIMER, TIM_OCPreload_Enable);
+  TIM_ARRPreloadConfig(LED_PWM_TIMER, ENABLE);
+
+  // Step timer - 10kHz clock, compare events of all channels at start
+  // of every step, no outputs
+  TIM_TimeBaseStructure.TIM_Prescaler = 8400 - 1;
+  TIM_TimeBaseStructure.TIM_Period = LED_HAL_STEP_TIME * 10 - 1;
+  TIM_TimeBaseInit(LED_STEP_TIMER, &TIM_TimeBaseStructure);
+
+  TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_Timing;
+  TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Disable;
+  TIM_OC1Init(LED_STEP_TIMER, &TIM_OCInitStructure);
+  TIM_OC2Init(LED_STEP_TIMER, &TIM_OCInitStructure);
+  TIM_OC3Init(LED_STEP_TIMER, &TIM_OCInitStructure);
+  TIM_OC4Init(LED_STEP_TIMER, &TIM_OCInitStructure);
+
+  TIM_Cmd(LED_PWM_TIMER, ENABLE);
+  TIM_Cmd(LED_STEP_TIMER, ENABLE);
+
+  timersStarted = 1;
+}
 /**
  * @}
  */
@@ -0,0 +1,58 @@
+/**
+ * @file    rng_hal.c
+ * @brief   Random number generator
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <rng_hal.h>
+#include <string.h>
+
+/**
+ * @addtogroup RNG_HAL
+ * @{
+ */
+
+/**
+ * @brief Starts the random number generator.
+ */
+void RNG_HAL_Init(void) {
+
+  RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_RNG, ENABLE);
+  RNG_Cmd(ENABLE);
+}
+/**
+ * @brief Reads random bytes.
+ * @details A new number is ready every 40 periods of the 48 MHz clock,
+ * so this takes about 1 us per word.
+ * @param buf Buffer for bytes
+ * @param len Number of bytes
+ */
+void RNG_HAL_Read(uint8_t* buf, uint32_t len) {
+
+  while (len) {
+
+    while (RNG_GetFlagStatus(RNG_FLAG_DRDY) == RESET);
+
+    uint32_t value = RNG_GetRandomNumber();
+    uint32_t n = len < 4 ? len : 4;
+    memcpy(buf, &value, n);
+    buf += n;
+    len -= n;
+  }
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,274 @@
+/**
+ * @file    sdio_hal.c
+ * @brief   SDIO interface (4-bit SD bus)
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Pins: PC8-PC11 - D0-D3, PC12 - CK, PD2 - CMD (AF12, D0-D3
+ * and CMD need pull-ups). Data is moved by DMA2 stream 3 channel 4 with
+ * the SDIO as flow controller, so transfers of any number of blocks
+ * need no CPU. The SDIO clock is 48 MHz from the PLL.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stm32f4xx.h>
+#include <sdio_hal.h>
+
+/**
+ * @addtogroup SDIO_HAL
+ * @{
+ */
+
+#define SDIO_DMA_STREAM     DMA2_Stream3
+#define SDIO_DMA_CHANNEL    DMA_Channel_4
+#define SDIO_DMA_TC_FLAG    DMA_FLAG_TCIF3
+#define SDIO_DMA_FLAGS      (DMA_FLAG_FEIF3 | DMA_FLAG_DMEIF3 | DMA_FLAG_TEIF3 | \
+                            DMA_FLAG_HTIF3 | DMA_FLAG_TCIF3)
+
+#define SDIO_DIV_INIT       118         ///< 48 MHz / (118 + 2) = 400 kHz
+#define SDIO_DIV_24MHZ      0           ///< 48 MHz / (0 + 2) = 24 MHz
+#define SDIO_DATA_TIMEOUT   0x02000000  ///< Data timeout in bus clocks (about 1 s at 24 MHz)
+
+#define SDIO_CMD_FLAGS      (SDIO_FLAG_CCRCFAIL | SDIO_FLAG_CTIMEOUT | \
+                            SDIO_FLAG_CMDREND | SDIO_FLAG_CMDSENT)
+#define SDIO_DATA_ERRORS    (SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | \
+                            SDIO_FLAG_TXUNDERR | SDIO_FLAG_RXOVERR | SDIO_FLAG_STBITERR)
+#define SDIO_STATIC_FLAGS   (SDIO_CMD_FLAGS | SDIO_DATA_ERRORS | \
+                            SDIO_FLAG_DATAEND | SDIO_FLAG_DBCKEND)
+
+/**
+ * @brief Initializes the SDIO interface.
+ * @details The bus is 1-bit wide and clocked at 400 kHz, as needed for
+ * card identification.
+ */
+void SDIO_HAL_Init(void) {
+
+  GPIO_InitTypeDef GPIO_InitStructure;
+
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOC | RCC_AHB1Periph_GPIOD |
+      RCC_AHB1Periph_DMA2, ENABLE);
+  RCC_APB2PeriphClockCmd(RCC_APB2Periph_SDIO, ENABLE);
+
+  GPIO_PinAFConfig(GPIOC, GPIO_PinSource8, GPIO_AF_SDIO);
+  GPIO_PinAFConfig(GPIOC, GPIO_PinSource9, GPIO_AF_SDIO);
+  GPIO_PinAFConfig(GPIOC, GPIO_PinSource10, GPIO_AF_SDIO);
+  GPIO_PinAFConfig(GPIOC, GPIO_PinSource11, GPIO_AF_SDIO);
+  GPIO_PinAFConfig(GPIOC, GPIO_PinSource12, GPIO_AF_SDIO);
+  GPIO_PinAFConfig(GPIOD, GPIO_PinSource2, GPIO_AF_SDIO);
+
+  // data lines and command with pull-ups
+  GPIO_InitStructure.GPIO_Pin   = GPIO_Pin_8 | GPIO_Pin_9 | GPIO_Pin_10 |
+      GPIO_Pin_11;
+  GPIO_InitStructure.GPIO_Mode  = GPIO_Mode_AF;
+  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_100MHz;
+  GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+  GPIO_InitStructure.GPIO_PuPd  = GPIO_PuPd_UP;
+  GPIO_Init(GPIOC, &GPIO_InitStructure);
+
+  GPIO_InitStructure.GPIO_Pin   = GPIO_Pin_2;
+  GPIO_Init(GPIOD, &GPIO_InitStructure);
+
+  // clock without pull-up
+  GPIO_InitStructure.GPIO_Pin   = GPIO_Pin_12;
+  GPIO_InitStructure.GPIO_PuPd  = GPIO_PuPd_NOPULL;
+  GPIO_Init(GPIOC, &GPIO_InitStructure);
+
+  SDIO_DeInit();
+  SDIO_HAL_SetBus(0, SDIO_HAL_CLOCK_INIT);
+  SDIO_SetPowerState(SDIO_PowerState_ON);
+  SDIO_ClockCmd(ENABLE);
+}
+/**
+ * @brief Sets width and clock of the bus.
+ * @param wide 0 - 1-bit bus, 1 - 4-bit bus
+ * @param clock Bus clock
+ */
+void SDIO_HAL_SetBus(uint8_t wide, SDIO_HAL_Clock clock) {
+
+  SDIO_InitTypeDef SDIO_InitStructure;
+
+  SDIO_InitStructure.SDIO_ClockEdge           = SDIO_ClockEdge_Rising;
+  SDIO_InitStructure.SDIO_ClockBypass         = (clock == SDIO_HAL_CLOCK_48MHZ) ?
+      SDIO_ClockBypass_Enable : SDIO_ClockBypass_Disable;
+  SDIO_InitStructure.SDIO_ClockPowerSave      = SDIO_ClockPowerSave_Disable;
+  SDIO_InitStructure.SDIO_BusWide             = wide ? SDIO_BusWide_4b :
+      SDIO_BusWide_1b;
+  // hardware flow control can corrupt data on the STM32F4 (see errata)
+  SDIO_InitStructure.SDIO_HardwareFlowControl = SDIO_HardwareFlowControl_Disable;
+  SDIO_InitStructure.SDIO_ClockDiv            = (clock == SDIO_HAL_CLOCK_INIT) ?
+      SDIO_DIV_INIT : SDIO_DIV_24MHZ;
+  SDIO_Init(&SDIO_InitStructure);
+}
+/**
+ * @brief Sends a command and waits for the response.
+ * @param cmd Command index
+ * @param arg Argument
+ * @param resp Kind of response
+ * @param checkCrc 0 for responses without valid CRC (R3)
+ * @param response Response (4 words for long response, most significant
+ * first, 1 word for short one), may be 0 if not needed
+ * @retval SDIO_HAL_OK Response received
+ * @retval SDIO_HAL_TIMEOUT No response
+ * @retval SDIO_HAL_CRC Wrong CRC of response
+ */
+uint8_t SDIO_HAL_Command(uint8_t cmd, uint32_t arg, SDIO_HAL_Response resp,
+    uint8_t checkCrc, uint32_t* response) {
+
+  SDIO_CmdInitTypeDef SDIO_CmdInitStructure;
+  uint32_t status;
+
+  SDIO_ClearFlag(SDIO_CMD_FLAGS);
+
+  SDIO_CmdInitStructure.SDIO_Argument = arg;
+  SDIO_CmdInitStructure.SDIO_CmdIndex = cmd;
+  SDIO_CmdInitStructure.SDIO_Response = (resp == SDIO_HAL_RESP_LONG) ?
+      SDIO_Response_Long : (resp == SDIO_HAL_RESP_SHORT) ?
+      SDIO_Response_Short : SDIO_Response_No;
+  SDIO_CmdInitStructure.SDIO_Wait     = SDIO_Wait_No;
+  SDIO_CmdInitStructure.SDIO_CPSM     = SDIO_CPSM_Enable;
+  SDIO_SendCommand(&SDIO_CmdInitStructure);
+
+  if (resp == SDIO_HAL_RESP_NONE) {
+    while (!(SDIO->STA & SDIO_FLAG_CMDSENT));
+    SDIO_ClearFlag(SDIO_CMD_FLAGS);
+    return SDIO_HAL_OK;
+  }
+
+  do {
+    status = SDIO->STA;
+  } while (!(status & (SDIO_FLAG_CMDREND | SDIO_FLAG_CCRCFAIL |
+      SDIO_FLAG_CTIMEOUT)));
+  SDIO_ClearFlag(SDIO_CMD_FLAGS);
+
+  if (status & SDIO_FLAG_CTIMEOUT) {
+    return SDIO_HAL_TIMEOUT;
+  }
+  if ((status & SDIO_FLAG_CCRCFAIL) && checkCrc) {
+    return SDIO_HAL_CRC;
+  }
+
+  if (response) {
+    response[0] = SDIO_GetResponse(SDIO_RESP1);
+    if (resp == SDIO_HAL_RESP_LONG) {
+      response[1] = SDIO_GetResponse(SDIO_RESP2);
+      response[2] = SDIO_GetResponse(SDIO_RESP3);
+      response[3] = SDIO_GetResponse(SDIO_RESP4);
+    }
+  }
+  return SDIO_HAL_OK;
+}
+/**
+ * @brief Starts a data transfer with DMA.
+ * @details For reading this is called before the read command, for
+ * writing after the write command was answered.
+ * @param buf Data (word aligned, not in CCM RAM)
+ * @param blockSizeLog2 Block size as power of 2 (9 for 512 bytes)
+ * @param blocks Number of blocks
+ * @param read 1 - from card, 0 - to card
+ */
+void SDIO_HAL_StartData(uint8_t* buf, uint8_t blockSizeLog2, uint32_t blocks,
+    uint8_t read) {
+
+  DMA_InitTypeDef DMA_InitStructure;
+  SDIO_DataInitTypeDef SDIO_DataInitStructure;
+
+  SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+
+  DMA_Cmd(SDIO_DMA_STREAM, DISABLE);
+  while (SDIO_DMA_STREAM->CR & DMA_SxCR_EN);
+  DMA_ClearFlag(SDIO_DMA_STREAM, SDIO_DMA_FLAGS);
+
+  DMA_StructInit(&DMA_InitStructure);
+  DMA_InitStructure.DMA_Channel             = SDIO_DMA_CHANNEL;
+  DMA_InitStructure.DMA_PeripheralBaseAddr  = (uint32_t)&SDIO->FIFO;
+  DMA_InitStructure.DMA_Memory0BaseAddr     = (uint32_t)buf;
+  DMA_InitStructure.DMA_DIR                 = read ? DMA_DIR_PeripheralToMemory :
+      DMA_DIR_MemoryToPeripheral;
+  DMA_InitStructure.DMA_BufferSize          = 0; // SDIO controls the flow
+  DMA_InitStructure.DMA_PeripheralInc       = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_MemoryInc           = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize  = DMA_PeripheralDataSize_Word;
+  DMA_InitStructure.DMA_MemoryDataSize      = DMA_MemoryDataSize_Word;
+  DMA_InitStructure.DMA_Mode                = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority            = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_FIFOMode            = DMA_FIFOMode_Enable;
+  DMA_InitStructure.DMA_FIFOThreshold       = DMA_FIFOThreshold_Full;
+  DMA_InitStructure.DMA_MemoryBurst         = DMA_MemoryBurst_INC4;
+  DMA_InitStructure.DMA_PeripheralBurst     = DMA_PeripheralBurst_INC4;
+  DMA_Init(SDIO_DMA_STREAM, &DMA_InitStructure);
+  DMA_FlowControllerConfig(SDIO_DMA_STREAM, DMA_FlowCtrl_Peripheral);
+  DMA_Cmd(SDIO_DMA_STREAM, ENABLE);
+
+  SDIO_DMACmd(ENABLE);
+
+  SDIO_DataInitStructure.SDIO_DataTimeOut   = SDIO_DATA_TIMEOUT;
+  SDIO_DataInitStructure.SDIO_DataLength    = blocks << blockSizeLog2;
+  SDIO_DataInitStructure.SDIO_DataBlockSize = (uint32_t)blockSizeLog2 << 4;
+  SDIO_DataInitStructure.SDIO_TransferDir   = read ? SDIO_TransferDir_ToSDIO :
+      SDIO_TransferDir_ToCard;
+  SDIO_DataInitStructure.SDIO_TransferMode  = SDIO_TransferMode_Block;
+  SDIO_DataInitStructure.SDIO_DPSM          = SDIO_DPSM_Enable;
+  SDIO_DataConfig(&SDIO_DataInitStructure);
+}
+/**
+ * @brief Waits for the end of a data transfer.
+ * @retval SDIO_HAL_OK All data moved
+ * @retval SDIO_HAL_TIMEOUT Data timeout
+ * @retval SDIO_HAL_CRC CRC error of data
+ * @retval SDIO_HAL_ERROR FIFO or start bit error
+ */
+uint8_t SDIO_HAL_WaitData(void) {
+
+  uint32_t status;
+
+  do {
+    status = SDIO->STA;
+  } while (!(status & (SDIO_FLAG_DATAEND | SDIO_DATA_ERRORS)));
+
+  SDIO_DMACmd(DISABLE);
+
+  if (status & SDIO_DATA_ERRORS) {
+    DMA_Cmd(SDIO_DMA_STREAM, DISABLE);
+  }
+  // last words go from the DMA FIFO to memory after DATAEND
+  while (SDIO_DMA_STREAM->CR & DMA_SxCR_EN);
+  SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+
+  if (status & SDIO_FLAG_DTIMEOUT) {
+    return SDIO_HAL_TIMEOUT;
+  }
+  if (status & SDIO_FLAG_DCRCFAIL) {
+    return SDIO_HAL_CRC;
+  }
+  if (status & SDIO_DATA_ERRORS) {
+    return SDIO_HAL_ERROR;
+  }
+  return SDIO_HAL_OK;
+}
+/**
+ * @brief Cancels a started data transfer (command was not answered).
+ */
+void SDIO_HAL_StopData(void) {
+
+  SDIO_DataInitTypeDef SDIO_DataInitStructure;
+
+  SDIO_DMACmd(DISABLE);
+  SDIO_DataStructInit(&SDIO_DataInitStructure); // DPSM disabled
+  SDIO_DataConfig(&SDIO_DataInitStructure);
+  DMA_Cmd(SDIO_DMA_STREAM, DISABLE);
+  while (SDIO_DMA_STREAM->CR & DMA_SxCR_EN);
+  SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+}
+
+/**
+ * @}
+ */
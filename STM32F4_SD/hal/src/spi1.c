@@ -3,6 +3,15 @@
  * @brief   SPI control functions
  * @date    22 kwi 2014
  * @author  Michal Ksiezopolski
+ *
+ * @details The byte transfer functions run from RAM (see ramfunc.h)
+ * and use the registers directly, since the library functions are in
+ * flash. Buffers are transferred with the pipelined loop of spi_pipe.h,
+ * with 16-bit frames for longer ones if SPI1_USE_16BIT is defined.
+ *
+ * The CRC unit of the SPI is set to the CRC16 of SD cards. It gives a
+ * 16-bit CRC only with 16-bit frames, so data blocks checked by CRC are
+ * always transferred in 16-bit frames.
  * 
  * @verbatim
  * Copyright (c) 2014 Michal Ksiezopolski.
@@ -16,13 +25,55 @@
  */
 
 #include <spi1.h>
+#include <ramfunc.h>
 #include <stm32f4xx.h>
 
+#define SPI_PIPE_TXE()          (SPI1->SR & SPI_I2S_FLAG_TXE)
+#define SPI_PIPE_RXNE()         (SPI1->SR & SPI_I2S_FLAG_RXNE)
+#define SPI_PIPE_WRITE(x)       (SPI1->DR = (x))
+#define SPI_PIPE_READ()         (SPI1->DR)
+#define SPI_PIPE_LOCK(state)    do { (state) = __get_PRIMASK(); \
+                                  __disable_irq(); } while (0)
+#define SPI_PIPE_UNLOCK(state)  __set_PRIMASK(state)
+
+#include <spi_pipe.h>
+
 /**
  * @addtogroup SPI1
  * @{
  */
 
+/**
+ * @brief Sends and receives a byte.
+ * @param data Sent data
+ * @return Received data
+ */
+static inline __attribute__((always_inline)) uint8_t SPI1_Byte(uint8_t data) {
+
+  // Loop while transmit register in not empty
+  while (!(SPI1->SR & SPI_I2S_FLAG_TXE));
+
+  SPI1->DR = data; // Send byte (start transmit)
+
+  // Wait for new data (transmit end)
+  while (!(SPI1->SR & SPI_I2S_FLAG_RXNE));
+
+  return SPI1->DR; // Received data
+}
+/**
+ * @brief Sets size of frames and CRC calculation.
+ * @details Waits for the end of the last frame, since both can be
+ * changed only with SPI disabled. Enabling CRC clears it.
+ * @param bits SPI_CR1_DFF for 16-bit frames, SPI_CR1_CRCEN for CRC
+ */
+static inline __attribute__((always_inline)) void SPI1_SetFrame(uint16_t bits) {
+
+  while (SPI1->SR & SPI_I2S_FLAG_BSY);
+  SPI1->CR1 &= ~(SPI_CR1_SPE | SPI_CR1_CRCEN);
+  SPI1->CR1 = (SPI1->CR1 & ~SPI_CR1_DFF) | bits;
+  SPI1->CR1 |= SPI_CR1_SPE;
+}
+
 /**
  * @brief Initialize SPI1 and SS pin.
  */
@@ -73,10 +124,10 @@ void SPI1_Init(void) {
   SPI_InitStruct.SPI_NSS                = SPI_NSS_Soft; // software chip select
   SPI_InitStruct.SPI_BaudRatePrescaler  = SPI_BaudRatePrescaler_256;
   SPI_InitStruct.SPI_FirstBit           = SPI_FirstBit_MSB;
-  SPI_InitStruct.SPI_CRCPolynomial      = 7;
+  SPI_InitStruct.SPI_CRCPolynomial      = 0x1021; // CRC16 of SD cards
   SPI_Init(SPI1, &SPI_InitStruct);
 
-  SPI_CalculateCRC(SPI1, DISABLE);
+  SPI_CalculateCRC(SPI1, DISABLE); // enabled only for data blocks
   SPI_Cmd(SPI1, ENABLE); // enable SPI1
 
 }
@@ -101,21 +152,79 @@ void SPI1_Deselect(void) {
  * @return Received data
  * @warning Blocking function!
  */
-uint8_t SPI1_Transmit(uint8_t data) {
+RAMFUNC uint8_t SPI1_Transmit(uint8_t data) {
 
-  uint8_t i;
+  return SPI1_Byte(data);
+}
+/**
+ * @brief Transfer multiple data on SPI1.
+ * @details The clock runs without gaps between bytes.
+ * @param tx Transmit buffer (0 - send 0xff)
+ * @param rx Receive buffer (0 - discard received data)
+ * @param len Number of bytes to transfer.
+ * @warning Blocking function!
+ */
+RAMFUNC void SPI1_Transfer(const uint8_t* tx, uint8_t* rx, uint32_t len) {
 
-  // Loop while transmit register in not empty
-  while(SPI_I2S_GetFlagStatus(SPI1, SPI_I2S_FLAG_TXE) == RESET);
+#ifdef SPI1_USE_16BIT
+  if (len >= SPI1_FRAME16_MIN) {
+    SPI1_SetFrame(SPI_CR1_DFF);
+    SPI_PIPE_Transfer16(tx, rx, len / 2);
+    SPI1_SetFrame(0);
+    if (tx) {
+      tx += len & ~1;
+    }
+    if (rx) {
+      rx += len & ~1;
+    }
+    len &= 1;
+  }
+#endif
+  SPI_PIPE_Transfer8(tx, rx, len);
+}
+/**
+ * @brief Reads a data block and checks its CRC.
+ * @details The CRC unit calculates the CRC over the block and the CRC
+ * received after it, which gives 0 for correct data.
+ * @param buf Buffer for data
+ * @param len Length of data (even)
+ * @return 0 if CRC is correct
+ * @warning Blocking function!
+ */
+RAMFUNC uint16_t SPI1_ReadBlockCrc(uint8_t* buf, uint32_t len) {
 
-  SPI_I2S_SendData(SPI1, data); // Send byte (start transmit)
+  uint8_t crc[2];
+  uint16_t result;
 
-  // Wait for new data (transmit end)
-  while(SPI_I2S_GetFlagStatus(SPI1, SPI_I2S_FLAG_RXNE) == RESET);
+  SPI1_SetFrame(SPI_CR1_DFF | SPI_CR1_CRCEN);
+  SPI_PIPE_Transfer16(0, buf, len / 2);
+  SPI_PIPE_Transfer16(0, crc, 1);
+  result = SPI1->RXCRCR;
+  SPI1_SetFrame(0);
+
+  return result;
+}
+/**
+ * @brief Writes a data block followed by its CRC.
+ * @param buf Data
+ * @param len Length of data (even)
+ * @return CRC sent
+ * @warning Blocking function!
+ */
+RAMFUNC uint16_t SPI1_WriteBlockCrc(const uint8_t* buf, uint32_t len) {
 
-  i = SPI_I2S_ReceiveData(SPI1); // Received data
+  uint8_t crc[2];
+  uint16_t result;
 
-  return i;
+  SPI1_SetFrame(SPI_CR1_DFF | SPI_CR1_CRCEN);
+  SPI_PIPE_Transfer16(buf, 0, len / 2);
+  result = SPI1->TXCRCR; // the last frame was shifted out
+  crc[0] = result >> 8;
+  crc[1] = result;
+  SPI_PIPE_Transfer16(crc, 0, 1);
+  SPI1_SetFrame(0);
+
+  return result;
 }
 /**
  * @brief Send multiple data on SPI1.
@@ -125,9 +234,7 @@ uint8_t SPI1_Transmit(uint8_t data) {
  */
 void SPI1_SendBuffer(uint8_t* buf, uint32_t len) {
 
-  while (len--) {
-    SPI1_Transmit(*buf++);
-  }
+  SPI1_Transfer(buf, 0, len);
 }
 /**
  * @brief Read multiple data on SPI1.
@@ -137,9 +244,7 @@ void SPI1_SendBuffer(uint8_t* buf, uint32_t len) {
  */
 void SPI1_ReadBuffer(uint8_t* buf, uint32_t len) {
 
-  while (len--) {
-    *buf++ = SPI1_Transmit(0xff);
-  }
+  SPI1_Transfer(0, buf, len);
 }
 /**
  * @brief Write multiple data on SPI1.
@@ -149,9 +254,7 @@ void SPI1_ReadBuffer(uint8_t* buf, uint32_t len) {
  */
 void SPI1_WriteBuffer(uint8_t* buf, uint32_t len) {
 
-  while (len--) {
-    SPI1_Transmit(*buf++);
-  }
+  SPI1_Transfer(buf, 0, len);
 }
 /**
  * @brief Transmit multiple data on SPI1.
@@ -161,11 +264,34 @@ void SPI1_WriteBuffer(uint8_t* buf, uint32_t len) {
  */
 void SPI1_TransmitBuffer(uint8_t* rx_buf, uint8_t* tx_buf, uint32_t len) {
 
-  while (len--) {
-    *rx_buf = SPI1_Transmit(*tx_buf);
-    tx_buf++;
-    rx_buf++;
+  SPI1_Transfer(tx_buf, rx_buf, len);
+}
+/**
+ * @brief Copy of the 8-bit loop of SPI1_ReadBuffer which runs from flash.
+ * @details For comparing execution from flash and from RAM.
+ * @param buf Buffer to place read data.
+ * @param len Number of bytes to read.
+ */
+void SPI1_ReadBufferFlash(uint8_t* buf, uint32_t len) {
+
+  SPI_PIPE_Transfer8(0, buf, len);
+}
+/**
+ * @brief Sets the clock of SPI1.
+ * @details Change it only between transfers.
+ * @param div Divider of the APB2 clock (2 to 256, rounded up to power of 2)
+ * @return Previous divider
+ */
+uint16_t SPI1_SetClockDivider(uint16_t div) {
+
+  uint16_t br = 0;
+  uint16_t old = 2 << ((SPI1->CR1 & SPI_CR1_BR) >> 3);
+
+  while ((2 << br) < div && br < 7) {
+    br++;
   }
+  SPI1->CR1 = (SPI1->CR1 & ~SPI_CR1_BR) | (br << 3);
+  return old;
 }
 
 /**
@@ -16,6 +16,7 @@
  */
 
 #include <uart2.h>
+#include <ramfunc.h>
 #include <stm32f4xx.h>
 
 /**
@@ -26,6 +27,9 @@
 void    (*rxCallback)(uint8_t);   ///< Callback function for receiving data
 uint8_t (*txCallback)(uint8_t*);  ///< Callback function for transmitting data
 
+static volatile uint32_t entryCycles; ///< Cycle counter at handler entry
+static volatile uint8_t entered;      ///< Handler entered since measurement start
+
 /**
  * @brief Initialize USART2
  * @param baud
@@ -95,31 +99,64 @@ void UART2_Init(uint32_t baud, void(*rxCb)(uint8_t), uint8_t(*txCb)(uint8_t*) )
 void UART2_TxEnable(void) {
   USART_ITConfig(USART2, USART_IT_TXE, ENABLE);
 }
+/**
+ * @brief Measures interrupt entry latency.
+ * @details Pends the USART2 interrupt in software and compares the cycle
+ * counter before it with the one saved first thing in the handler.
+ * Requires the DWT cycle counter to be running. Nothing is
+ * transferred, since no flag of the USART is set.
+ * @return Cycles from pending the interrupt to the handler, 0 if
+ * the handler wasn't entered.
+ */
+uint32_t UART2_MeasureEntry(void) {
+
+  uint32_t start;
+
+  entered = 0;
+  start = DWT->CYCCNT;
+  NVIC_SetPendingIRQ(USART2_IRQn);
+  __DSB();
+  __ISB();
+
+  if (!entered) {
+    return 0;
+  }
+  return entryCycles - start;
+}
 
 /**
  * @brief IRQ handler for USART2
+ * @details Runs from RAM and reads registers directly, since the
+ * library functions are in flash.
  */
-void USART2_IRQHandler(void) {
+RAMFUNC void USART2_IRQHandler(void) {
+
+  uint32_t sr;
+
+  entryCycles = DWT->CYCCNT;
+  entered = 1;
+
+  sr = USART2->SR;
 
   // If transmit buffer empty interrupt
-  if(USART_GetITStatus(USART2, USART_IT_TXE) != RESET) {
+  if ((USART2->CR1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE)) {
 
     uint8_t c;
 
     if (txCallback) { // if not NULL
       // get data from higher layer using callback
       if (txCallback(&c)) {
-        USART_SendData(USART2, c); // Send data
+        USART2->DR = c; // Send data
       } else { // if no more data to send disable the transmitter
-        USART_ITConfig(USART2, USART_IT_TXE, DISABLE);
+        USART2->CR1 &= ~USART_CR1_TXEIE;
       }
     }
   }
 
   // If RX buffer not empty interrupt
-  if(USART_GetITStatus(USART2, USART_IT_RXNE) != RESET) {
+  if ((USART2->CR1 & USART_CR1_RXNEIE) && (sr & USART_SR_RXNE)) {
 
-    uint8_t c = USART_ReceiveData(USART2); // Get data from UART
+    uint8_t c = USART2->DR; // Get data from UART
 
     if (rxCallback) { // if not NULL
       rxCallback(c); // send received data to higher layer
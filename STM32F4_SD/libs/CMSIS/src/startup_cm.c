@@ -25,6 +25,7 @@
 // perform all initialisations (define USE_STARTUP_FILES).
 
 #include <sys/types.h>
+#include <stdint.h>
 
 #if defined (__cplusplus)
 extern "C"
@@ -51,6 +52,17 @@ inline void
 data_init(unsigned int* from, unsigned int* section_begin,
     unsigned int* section_end);
 
+// Cycle counter of the DWT unit, started at reset to time the boot.
+#define DEMCR_REG       (*(volatile uint32_t*)0xE000EDFC)
+#define DWT_CTRL_REG    (*(volatile uint32_t*)0xE0001000)
+#define DWT_CYCCNT_REG  (*(volatile uint32_t*)0xE0001004)
+#define DEMCR_TRCENA    (1 << 24)
+#define DWT_CYCCNTENA   (1 << 0)
+
+// Cycle counter after clearing .bss, copying .data and SystemInit,
+// read by boot.c. It is in .bss, so it is written only after clearing.
+uint32_t boot_cycles[3];
+
 // Begin address for the initialisation values of the .data section.
 // defined in linker script
 extern unsigned int _sidata;
@@ -100,9 +112,18 @@ __attribute__((always_inline))
 data_init(unsigned int* from, unsigned int* section_begin,
     unsigned int* section_end)
 {
-  // Iterate and copy word by word.
+  // Copy four words per iteration (load/store multiple), then the rest.
   // It is assumed that the pointers are word aligned.
   unsigned int *p = section_begin;
+  while (p + 4 <= section_end)
+    {
+      p[0] = from[0];
+      p[1] = from[1];
+      p[2] = from[2];
+      p[3] = from[3];
+      p += 4;
+      from += 4;
+    }
   while (p < section_end)
     *p++ = *from++;
 }
@@ -113,9 +134,17 @@ inline void
 __attribute__((always_inline))
 bss_init(unsigned int* section_begin, unsigned int* section_end)
 {
-  // Iterate and clear word by word.
+  // Clear four words per iteration (store multiple), then the rest.
   // It is assumed that the pointers are word aligned.
   unsigned int *p = section_begin;
+  while (p + 4 <= section_end)
+    {
+      p[0] = 0;
+      p[1] = 0;
+      p[2] = 0;
+      p[3] = 0;
+      p += 4;
+    }
   while (p < section_end)
     *p++ = 0;
 }
@@ -216,11 +245,17 @@ void __attribute__ ((section(".after_vectors")))
 Reset_Handler(void)
 {
 
+  // Start the cycle counter, boot phases are timed from here.
+  DEMCR_REG |= DEMCR_TRCENA;
+  DWT_CYCCNT_REG = 0;
+  DWT_CTRL_REG |= DWT_CYCCNTENA;
+
   // Use Old Style Data and BSS section initialisation,
   // That will initialise a single BSS sections.
 
   // Zero fill the bss segment
   bss_init(&__bss_start__, &__bss_end__);
+  boot_cycles[0] = DWT_CYCCNT_REG;
 
   // Call the standard library initialisation (mandatory, SystemInit()
   // and C++ static constructors are called from here).
@@ -251,9 +286,11 @@ system_init()
   // so we must be sure it is executed somewhere.
   // (for example librdimon)
   data_init(&_sidata, &_sdata, &_edata);
+  boot_cycles[1] = DWT_CYCCNT_REG;
 
   // Call the CSMSIS system initialisation routine
   SystemInit();
+  boot_cycles[2] = DWT_CYCCNT_REG;
 }
 
 // The .preinit_array_sysinit section is defined in sections.ld as the first
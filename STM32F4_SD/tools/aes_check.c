@@ -0,0 +1,293 @@
+/**
+ * @file    aes_check.c
+ * @brief   PC check of AES-128 against known-answer vectors.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Checks aes.c with the example of FIPS-197 (appendix C.1) and
+ * the CTR-AES128 vectors of NIST SP 800-38A (F.5.1), also with partial
+ * blocks and in place. Then efile.c is run on a file in memory (the FAT
+ * functions are replaced here): data written in pieces of many sizes
+ * must read back the same and every sector must match AES-CTR with the
+ * documented counter block, both with software encryption and with a
+ * model of the CRYP unit which encrypts only when waited for (so data
+ * used too early is caught). At the end the throughput of counter
+ * mode encryption is compared with copying the data:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o aes_check aes_check.c \
+ *       ../app/src/aes.c ../app/src/efile.c ../app/src/crc.c
+ *   ./aes_check > /dev/null
+ *
+ * Throughput with the CRYP unit and of whole encrypted file writes is
+ * measured on the device with the :ENC command.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <aes.h>
+#include <efile.h>
+#include <fat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_LEN   4096  ///< Length of benchmark data
+#define BENCH_RUNS  5000  ///< Runs of benchmark
+#define FILE_SIZE   (9 * EFILE_SECTOR_SIZE) ///< Size of file in memory
+
+static const uint8_t fipsKey[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+static const uint8_t fipsPlain[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+static const uint8_t fipsCipher[16] = {
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+
+static const uint8_t ctrKey[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+static const uint8_t ctrCounter[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+static const uint8_t ctrPlain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+static const uint8_t ctrCipher[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+    0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+    0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+    0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+    0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee};
+
+static uint8_t disk[FILE_SIZE];  ///< File in memory
+static int diskRdPtr;             ///< Read pointer of file
+static int diskWrPtr;             ///< Write pointer of file
+
+/**
+ * @brief FAT functions used by efile.c, working on disk.
+ */
+int FAT_OpenFile(const char* filename) {
+  (void)filename;
+  return 0;
+}
+int FAT_CloseFile(int file) {
+  return file;
+}
+int FAT_GetFileSize(int file) {
+  (void)file;
+  return FILE_SIZE;
+}
+int FAT_MoveRdPtr(int file, int ptr) {
+  (void)file;
+  return diskRdPtr = ptr;
+}
+int FAT_MoveWrPtr(int file, int ptr) {
+  (void)file;
+  return diskWrPtr = ptr;
+}
+int FAT_ReadFile(int file, uint8_t* data, int count) {
+  (void)file;
+  if (count > FILE_SIZE - diskRdPtr) {
+    count = FILE_SIZE - diskRdPtr;
+  }
+  memcpy(data, disk + diskRdPtr, count);
+  diskRdPtr += count;
+  return count;
+}
+int FAT_WriteFile(int file, const uint8_t* data, int count) {
+  (void)file;
+  if (count > FILE_SIZE - diskWrPtr) {
+    count = FILE_SIZE - diskWrPtr;
+  }
+  memcpy(disk + diskWrPtr, data, count);
+  diskWrPtr += count;
+  return count;
+}
+
+/**
+ * @brief Model of the CRYP unit: encrypts when waited for.
+ */
+static AES_Context unitKey;
+static uint8_t unitCounter[16];
+static uint8_t* unitData;
+static uint32_t unitLen;
+
+static void unitStart(const uint8_t* counter, const uint8_t* in, uint8_t* out,
+    uint32_t len) {
+  if (in != out || len % 16 || unitData) {
+    fprintf(stderr, "Wrong use of CRYP unit\n");
+    exit(1);
+  }
+  memcpy(unitCounter, counter, 16);
+  unitData = out;
+  unitLen = len;
+}
+static void unitWait(void) {
+  if (unitData) {
+    AES_Ctr(&unitKey, unitCounter, unitData, unitData, unitLen);
+    unitData = 0;
+  }
+}
+/**
+ * @brief Not random nonce, for repeatable results.
+ */
+static void nonce(uint8_t* buf, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    buf[i] = 0xa0 + i;
+  }
+}
+
+/**
+ * @brief Writes and reads an encrypted file.
+ * @return 1 if data or ciphertext is wrong
+ */
+static int checkFile(void) {
+
+  static uint8_t plain[FILE_SIZE - EFILE_SECTOR_SIZE];
+  static uint8_t readBack[FILE_SIZE - EFILE_SECTOR_SIZE];
+  EFILE_TypeDef f;
+  int size = sizeof(plain);
+
+  memset(disk, 0xff, sizeof(disk));
+  for (int i = 0; i < size; i++) {
+    plain[i] = rand();
+  }
+  if (EFILE_Open(&f, "TEST    DAT") || EFILE_GetSize(&f) != size) {
+    return 1;
+  }
+
+  // pieces of growing size, not aligned to blocks or sectors
+  for (int pos = 0, n = 1; pos < size; pos += n, n = n * 3 + 1) {
+    if (n > size - pos) {
+      n = size - pos;
+    }
+    if (EFILE_Write(&f, plain + pos, n) != n) {
+      return 1;
+    }
+  }
+
+  // file must stay readable after opening again
+  EFILE_Close(&f);
+  if (EFILE_Open(&f, "TEST    DAT")) {
+    return 1;
+  }
+  for (int pos = 0, n = 700; pos < size; pos += n, n = n / 2 + 5) {
+    if (n > size - pos) {
+      n = size - pos;
+    }
+    if (EFILE_Read(&f, readBack + pos, n) != n) {
+      return 1;
+    }
+  }
+  if (memcmp(plain, readBack, size)) {
+    return 1;
+  }
+
+  // every sector is AES-CTR of the documented counter
+  for (int s = 0; s < size / EFILE_SECTOR_SIZE; s++) {
+    uint8_t counter[16] = {0};
+    uint8_t sector[EFILE_SECTOR_SIZE];
+    nonce(counter, EFILE_NONCE_SIZE);
+    counter[11] = s;
+    AES_Ctr(&unitKey, counter, disk + (s + 1) * EFILE_SECTOR_SIZE, sector,
+        EFILE_SECTOR_SIZE);
+    if (memcmp(sector, plain + s * EFILE_SECTOR_SIZE, EFILE_SECTOR_SIZE)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Prints result of a check.
+ * @return 1 if failed
+ */
+static int result(const char* name, int ok) {
+
+  fprintf(stderr, "%-24s %s\n", name, ok ? "ok" : "FAILED");
+  return !ok;
+}
+/**
+ * @brief Seconds since an earlier time.
+ */
+static double since(const struct timespec* t0) {
+
+  struct timespec t1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+int main(void) {
+
+  AES_Context ctx;
+  uint8_t buf[64];
+  int failed = 0;
+
+  AES_SetKey(&ctx, fipsKey);
+  AES_Encrypt(&ctx, fipsPlain, buf);
+  failed |= result("FIPS-197 C.1", !memcmp(buf, fipsCipher, 16));
+
+  AES_SetKey(&ctx, ctrKey);
+  AES_Ctr(&ctx, ctrCounter, ctrPlain, buf, 64);
+  failed |= result("SP 800-38A F.5.1", !memcmp(buf, ctrCipher, 64));
+
+  // in place and ending with a partial block
+  memcpy(buf, ctrPlain, 64);
+  AES_Ctr(&ctx, ctrCounter, buf, buf, 37);
+  failed |= result("in place, partial block", !memcmp(buf, ctrCipher, 37) &&
+      !memcmp(buf + 37, ctrPlain + 37, 27));
+
+  // decryption is the same operation
+  AES_Ctr(&ctx, ctrCounter, ctrCipher, buf, 64);
+  failed |= result("SP 800-38A F.5.2", !memcmp(buf, ctrPlain, 64));
+
+  AES_SetKey(&unitKey, ctrKey);
+  EFILE_Init(ctrKey, nonce, 0, 0);
+  failed |= result("file, software", !checkFile());
+  EFILE_Init(ctrKey, nonce, unitStart, unitWait);
+  failed |= result("file, CRYP model", !checkFile());
+
+  static uint8_t data[BENCH_LEN];
+  static uint8_t out[BENCH_LEN];
+  struct timespec t0;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int r = 0; r < BENCH_RUNS; r++) {
+    data[r % BENCH_LEN]++;
+    memcpy(out, data, BENCH_LEN);
+  }
+  double copy = since(&t0);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int r = 0; r < BENCH_RUNS; r++) {
+    AES_Ctr(&ctx, ctrCounter, data, out, BENCH_LEN);
+  }
+  double ctr = since(&t0);
+
+  fprintf(stderr, "copy %.0f MB/s, AES-CTR %.1f MB/s (%.1f ns/byte)\n",
+      BENCH_RUNS * (double)BENCH_LEN / copy / 1e6,
+      BENCH_RUNS * (double)BENCH_LEN / ctr / 1e6,
+      ctr * 1e9 / BENCH_RUNS / BENCH_LEN);
+
+  return failed;
+}
@@ -0,0 +1,280 @@
+/**
+ * @file    bdev_bench.c
+ * @brief   PC benchmark of the block device layers.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs the same file system like workload through stacks of
+ * layers over a RAM disk and prints the cost of the layers in cycles
+ * (TSC on x86, ns elsewhere) per request, together with the number of
+ * requests and sectors reaching the drive:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o bdev_bench bdev_bench.c \
+ *       ../app/src/bdev.c
+ *   ./bdev_bench
+ *
+ * The workload is made of single sector reads and writes of a few FAT
+ * and directory sectors, files appended sector by sector, reads of
+ * whole clusters and a flush every FLUSH_EVERY requests, as fat.c and
+ * FatFs do. Every read is compared with a copy of the disk kept by the
+ * benchmark, and the disk itself is compared after the last flush. On
+ * the device a drive request costs far more than the layers, so the
+ * drive requests saved by the cache and coalescer are what counts;
+ * the cycles show what the layers add to each request.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <bdev.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+#define DISK_SECTORS  4096  ///< Size of RAM disk
+#define REQUESTS      20000 ///< Requests of workload
+#define RUNS          20    ///< Runs of workload for every stack
+#define FLUSH_EVERY   64    ///< Requests between flushes
+#define HOT_SECTORS   6     ///< FAT and directory sectors
+#define CLUSTER       8     ///< Sectors in cluster
+#define CACHE_LINES   8     ///< Lines of cache
+#define COALESCE      8     ///< Sectors of coalescer
+
+/**
+ * @brief Request of the workload.
+ */
+typedef struct {
+  uint8_t op;       ///< Operation
+  uint32_t sector;  ///< First sector
+  uint32_t count;   ///< Number of sectors
+  uint8_t fill;     ///< Value of written data
+} Request;
+
+static uint8_t disk[DISK_SECTORS * BDEV_SECTOR_SIZE];   ///< RAM disk
+static uint8_t shadow[DISK_SECTORS * BDEV_SECTOR_SIZE]; ///< Expected contents
+static Request workload[REQUESTS];
+static uint32_t driveRequests; ///< Requests reaching the drive
+static uint32_t driveSectors;  ///< Sectors transferred by the drive
+
+static BDEV_Drive drive;
+static BDEV_Stats stats;
+static BDEV_Cache cache;
+static BDEV_CacheLine lines[CACHE_LINES];
+static uint8_t cacheData[CACHE_LINES * BDEV_SECTOR_SIZE];
+static BDEV_Coalescer coalescer;
+static uint8_t coalescerBuf[COALESCE * BDEV_SECTOR_SIZE];
+
+/**
+ * @brief Reads sectors of the RAM disk.
+ */
+static uint8_t ramRead(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  driveRequests++;
+  driveSectors += count;
+  memcpy(buf, disk + sector * BDEV_SECTOR_SIZE, count * BDEV_SECTOR_SIZE);
+  return 0;
+}
+/**
+ * @brief Writes sectors of the RAM disk.
+ */
+static uint8_t ramWrite(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  driveRequests++;
+  driveSectors += count;
+  memcpy(disk + sector * BDEV_SECTOR_SIZE, buf, count * BDEV_SECTOR_SIZE);
+  return 0;
+}
+/**
+ * @brief Returns a time stamp.
+ * @return TSC cycles on x86, ns elsewhere
+ */
+static uint64_t stamp(void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+/**
+ * @brief Makes the workload.
+ */
+static void makeWorkload(void) {
+
+  uint32_t file = 1024; // end of file being appended
+  uint32_t seed = 2014;
+
+  for (int i = 0; i < REQUESTS; i++) {
+    Request* r = &workload[i];
+    seed = seed * 1103515245 + 12345;
+    uint32_t dice = (seed >> 16) % 100;
+
+    r->fill = (uint8_t)i;
+    r->count = 1;
+    if ((i + 1) % FLUSH_EVERY == 0) {
+      r->op = BDEV_FLUSH;
+      r->sector = r->count = 0;
+    } else if (dice < 35) { // FAT and directory lookups
+      r->op = BDEV_READ;
+      r->sector = 32 + (seed >> 8) % HOT_SECTORS;
+    } else if (dice < 55) { // FAT and directory updates
+      r->op = BDEV_WRITE;
+      r->sector = 32 + (seed >> 8) % HOT_SECTORS;
+    } else if (dice < 85) { // file appended
+      r->op = BDEV_WRITE;
+      r->sector = file++;
+      if (file == DISK_SECTORS) {
+        file = 1024;
+      }
+    } else if (dice < 97) { // whole cluster read
+      r->op = BDEV_READ;
+      r->sector = 1024 + (seed >> 8) % ((DISK_SECTORS - 1024) / CLUSTER) * CLUSTER;
+      r->count = CLUSTER;
+    } else { // file deleted
+      r->op = BDEV_TRIM;
+      r->sector = 1024 + (seed >> 8) % ((DISK_SECTORS - 1024) / CLUSTER) * CLUSTER;
+      r->count = CLUSTER;
+    }
+  }
+}
+/**
+ * @brief Runs the workload through a stack.
+ * @param top Top of stack
+ * @param check Compare data with the expected contents
+ * @return Number of errors
+ */
+static int run(BDEV_Device* top, int check) {
+
+  static uint8_t buf[CLUSTER * BDEV_SECTOR_SIZE];
+  int errors = 0;
+
+  for (int i = 0; i < REQUESTS; i++) {
+    Request* r = &workload[i];
+    uint32_t bytes = r->count * BDEV_SECTOR_SIZE;
+    uint8_t* expected = shadow + r->sector * BDEV_SECTOR_SIZE;
+
+    switch (r->op) {
+    case BDEV_READ:
+      errors += BDEV_Read(top, buf, r->sector, r->count);
+      if (check && memcmp(buf, expected, bytes)) {
+        errors++;
+      }
+      break;
+    case BDEV_WRITE:
+      memset(buf, r->fill, bytes);
+      errors += BDEV_Write(top, buf, r->sector, r->count);
+      if (check) {
+        memcpy(expected, buf, bytes);
+      }
+      break;
+    case BDEV_FLUSH:
+      errors += BDEV_Flush(top);
+      break;
+    default:
+      errors += BDEV_Trim(top, r->sector, r->count);
+      if (check) { // contents of trimmed sectors are not defined
+        memcpy(expected, disk + r->sector * BDEV_SECTOR_SIZE, bytes);
+      }
+      break;
+    }
+  }
+  errors += BDEV_Flush(top);
+  if (check && memcmp(disk, shadow, sizeof(disk))) {
+    errors++;
+  }
+  return errors;
+}
+/**
+ * @brief Builds a stack over the RAM disk.
+ * @param layers Layers from the drive up: 1 - coalescer, 2 - cache,
+ * 4 - statistics
+ * @return Top of stack
+ */
+static BDEV_Device* build(int layers) {
+
+  BDEV_Device* top;
+
+  BDEV_InitDrive(&drive, ramRead, ramWrite);
+  top = &drive.dev;
+  if (layers & 1) {
+    BDEV_InitCoalescer(&coalescer, top, coalescerBuf, COALESCE);
+    top = &coalescer.dev;
+  }
+  if (layers & 2) {
+    BDEV_InitCache(&cache, top, lines, cacheData, CACHE_LINES);
+    top = &cache.dev;
+  }
+  if (layers & 4) {
+    BDEV_InitStats(&stats, top);
+    top = &stats.dev;
+  }
+  return top;
+}
+
+int main(void) {
+
+  static const struct {
+    const char* name;
+    int layers;
+  } stacks[] = {
+    {"drive",                           0},
+    {"stats > drive",                   4},
+    {"coalescer > drive",               1},
+    {"cache > drive",                   2},
+    {"cache > coalescer > drive",       3},
+    {"stats > cache > coalescer > drive", 7},
+  };
+  int errors = 0;
+
+  makeWorkload();
+
+  fprintf(stderr, "%-34s %10s %10s %10s\n", "stack", "cyc/req", "drv req",
+      "drv sect");
+
+  for (unsigned s = 0; s < sizeof(stacks) / sizeof(stacks[0]); s++) {
+    uint64_t best = UINT64_MAX;
+    int runErrors = 0;
+
+    for (int n = 0; n < RUNS; n++) {
+      memset(disk, 0, sizeof(disk));
+      memset(shadow, 0, sizeof(shadow));
+      BDEV_Device* top = build(stacks[s].layers);
+      driveRequests = driveSectors = 0;
+
+      uint64_t start = stamp();
+      runErrors += run(top, n == 0);
+      uint64_t time = stamp() - start;
+      if (n > 0 && time < best) { // first run checks data
+        best = time;
+      }
+    }
+    fprintf(stderr, "%-34s %10.1f %10u %10u %s\n", stacks[s].name,
+        (double)best / REQUESTS, (unsigned)driveRequests, (unsigned)driveSectors,
+        runErrors ? "FAILED" : "ok");
+    errors += runErrors;
+  }
+
+  BDEV_Counters counters;
+  BDEV_GetCounters(&stats, &counters);
+  fprintf(stderr, "last run: %u reads %u writes %u flushes %u trims, "
+      "cache %u hits %u misses %u written back, %u writes merged\n",
+      (unsigned)counters.requests[BDEV_READ], (unsigned)counters.requests[BDEV_WRITE],
+      (unsigned)counters.requests[BDEV_FLUSH], (unsigned)counters.requests[BDEV_TRIM],
+      (unsigned)cache.hits, (unsigned)cache.misses, (unsigned)cache.writeBacks,
+      (unsigned)coalescer.merged);
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file    config_sim.c
+ * @brief   PC simulation of the configuration store.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ *
+ * @details Runs the CONFIG module on the PC, on simulated flash
+ * sectors which behave like the STM32F4 flash: erasing sets all
+ * bits, programming can only clear them.
+ *
+ *   gcc -I../app/inc -I../hal/inc -o config_sim config_sim.c ../app/src/config.c \
+ *       ../app/src/crc.c
+ *   ./config_sim > /dev/null
+ *
+ * Random items are written until every sector was erased several
+ * times, with power failing at random programming operations. After
+ * every failure the store is initialized again and each item must
+ * hold either its last value or the value being written. The number
+ * of erases per sector and the time of CONFIG_Init with a full
+ * sector are printed. Debug messages of the module go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <config.h>
+#include <flash_hal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WORDS (FLASH_HAL_SECTOR_SIZE / 4) ///< Words in sector
+#define ROUNDS 6  ///< Erases of every sector to simulate
+
+static uint32_t flash[FLASH_HAL_SECTORS][WORDS]; ///< Simulated flash
+static uint32_t erases[FLASH_HAL_SECTORS];  ///< Number of erases of sectors
+static uint32_t failAfter;  ///< Operations left before power fails (0 - never)
+static int powerFailed;     ///< Nonzero after power failure
+
+static uint8_t value[CONFIG_MAX_ID][CONFIG_MAX_LEN]; ///< Last written values
+static int valueLen[CONFIG_MAX_ID];  ///< Lengths of last written values (0 - no value)
+
+/**
+ * @brief Checks if power fails at this operation.
+ * @return Nonzero if power failed
+ */
+static int fail(void) {
+
+  if (powerFailed || (failAfter && --failAfter == 0)) {
+    powerFailed = 1;
+  }
+  return powerFailed;
+}
+/**
+ * @brief Simulated sector erase.
+ * @param sector Sector number
+ * @retval 0 Sector erased
+ * @retval 1 Power failed (sector partly erased)
+ */
+uint8_t FLASH_HAL_Erase(uint8_t sector) {
+
+  if (fail()) {
+    // erase stopped half way
+    for (int i = 0; i < WORDS; i += 2) {
+      flash[sector][i] = 0xffffffff;
+    }
+    return 1;
+  }
+  memset(flash[sector], 0xff, sizeof(flash[sector]));
+  erases[sector]++;
+  return 0;
+}
+/**
+ * @brief Simulated programming.
+ * @param sector Sector number
+ * @param offset Offset in sector
+ * @param data Data
+ * @param words Number of words
+ * @retval 0 Words programmed
+ * @retval 1 Power failed
+ */
+uint8_t FLASH_HAL_Program(uint8_t sector, uint32_t offset,
+    const uint32_t* data, uint32_t words) {
+
+  for (uint32_t i = 0; i < words; i++) {
+    if (fail()) {
+      return 1;
+    }
+    uint32_t* word = &flash[sector][offset / 4 + i];
+    if (*word != 0xffffffff) {
+      fprintf(stderr, "Programming word which is not erased (sector %d offset %u)\n",
+          sector, (unsigned int)(offset + 4 * i));
+      exit(1);
+    }
+    *word &= data[i];
+  }
+  return 0;
+}
+/**
+ * @brief Simulated flash address.
+ * @param sector Sector number
+ * @return Address of sector
+ */
+const uint32_t* FLASH_HAL_GetAddress(uint8_t sector) {
+
+  return flash[sector];
+}
+/**
+ * @brief Returns monotonic time.
+ * @return Time in us
+ */
+static double now(void) {
+
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+/**
+ * @brief Checks all items after initialization.
+ * @param id ID of item being written at power failure (-1 - none)
+ * @param newValue Value being written
+ * @param newLen Length of value being written
+ */
+static void check(int id, const uint8_t* newValue, int newLen) {
+
+  uint8_t buf[CONFIG_MAX_LEN];
+
+  for (int i = 0; i < CONFIG_MAX_ID; i++) {
+    int len = CONFIG_Read(i, buf, sizeof(buf));
+    int oldOk = (len == valueLen[i] || (len == -1 && valueLen[i] == 0)) &&
+        (len <= 0 || memcmp(buf, value[i], len) == 0);
+    int newOk = i == id && (len == newLen || (len == -1 && newLen == 0)) &&
+        (len <= 0 || memcmp(buf, newValue, len) == 0);
+    if (!oldOk && !newOk) {
+      fprintf(stderr, "Item %d has wrong value\n", i);
+      exit(1);
+    }
+    if (newOk && !oldOk) {
+      valueLen[i] = newLen;
+      memcpy(value[i], newValue, newLen);
+    }
+  }
+}
+
+int main(void) {
+
+  uint8_t buf[CONFIG_MAX_LEN];
+  uint32_t writes = 0;
+  uint32_t failures = 0;
+
+  memset(flash, 0xff, sizeof(flash));
+  memset(valueLen, 0, sizeof(valueLen));
+  srand(1);
+
+  if (CONFIG_Init()) {
+    fprintf(stderr, "Init failed\n");
+    return 1;
+  }
+
+  while (erases[FLASH_HAL_SECTORS - 1] < ROUNDS) {
+
+    int id = rand() % CONFIG_MAX_ID;
+    int len = (rand() % 8) ? rand() % 32 : rand() % (CONFIG_MAX_LEN + 1);
+    for (int i = 0; i < len; i++) {
+      buf[i] = rand();
+    }
+
+    if (rand() % 50 == 0) {
+      failAfter = 1 + rand() % 100;
+    }
+
+    if (CONFIG_Write(id, buf, len) == 0) {
+      valueLen[id] = len;
+      memcpy(value[id], buf, len);
+      writes++;
+    } else if (!powerFailed) {
+      fprintf(stderr, "Write failed\n");
+      return 1;
+    }
+
+    if (powerFailed) {
+      failures++;
+      powerFailed = 0;
+      failAfter = 0;
+      if (CONFIG_Init()) {
+        fprintf(stderr, "Init failed\n");
+        return 1;
+      }
+      check(id, buf, len);
+    } else if (failAfter == 0) {
+      check(-1, 0, 0);
+    }
+  }
+
+  fprintf(stderr, "%u writes, %u power failures\n",
+      (unsigned int)writes, (unsigned int)failures);
+  for (int i = 0; i < FLASH_HAL_SECTORS; i++) {
+    fprintf(stderr, "sector %d: %u erases\n", i, (unsigned int)erases[i]);
+  }
+
+  // count records filling a sector, then fill it again almost fully
+  uint32_t records = 0;
+  uint32_t v = 0;
+  uint32_t erased = erases[0] + erases[1];
+  while (erases[0] + erases[1] < erased + 2) {
+    if (erases[0] + erases[1] == erased + 1) {
+      records++;
+    }
+    v++;
+    CONFIG_Write(v % CONFIG_MAX_ID, &v, sizeof(v));
+  }
+  for (uint32_t i = 0; i < records - 10; i++) {
+    v++;
+    CONFIG_Write(v % CONFIG_MAX_ID, &v, sizeof(v));
+  }
+  double start = now();
+  CONFIG_Init();
+  double initTime = now() - start;
+  start = now();
+  for (int i = 0; i < CONFIG_MAX_ID; i++) {
+    CONFIG_Read(i, buf, sizeof(buf));
+  }
+  double readTime = (now() - start) / CONFIG_MAX_ID;
+  fprintf(stderr, "init with %u records: %.1f us, read %.3f us per item\n",
+      (unsigned int)records, initTime, readTime);
+  return 0;
+}
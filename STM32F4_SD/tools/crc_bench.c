@@ -0,0 +1,149 @@
+/**
+ * @file    crc_bench.c
+ * @brief   PC check and benchmark of the CRC module.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Checks that crc.c gives the same results as the STM32 CRC
+ * unit, modelled bit by bit as described in the reference manual, and
+ * prints the throughput of the table:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o crc_bench crc_bench.c \
+ *       ../app/src/crc.c
+ *   ./crc_bench
+ *
+ * The model of the unit is also installed with CRC_Init, the same way
+ * CRC_HAL_Update is on the device, so that continuing a CRC from any
+ * value (done by XORing the first word) and mixing the unit with the
+ * table for unaligned data are checked too. The throughput of the unit
+ * itself is measured on the device with the :CRC command.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <crc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DATA_LEN  4096  ///< Length of test data
+#define RUNS      20000 ///< Runs of throughput test
+
+static uint32_t data[DATA_LEN / 4 + 1]; ///< Test data (aligned)
+static uint32_t dr;                      ///< Data register of modelled unit
+
+/**
+ * @brief Writes a word to the modelled data register.
+ */
+static void unitWrite(uint32_t word) {
+
+  dr ^= word;
+  for (int i = 0; i < 32; i++) {
+    dr = (dr & 0x80000000) ? (dr << 1) ^ 0x04c11db7 : dr << 1;
+  }
+}
+/**
+ * @brief Model of CRC_HAL_Update.
+ */
+static uint32_t unitUpdate(uint32_t crc, const uint32_t* words, uint32_t n) {
+
+  if (n == 0) {
+    return crc;
+  }
+  dr = 0xffffffff; // reset
+  unitWrite(*words++ ^ crc ^ 0xffffffff);
+  while (--n) {
+    unitWrite(*words++);
+  }
+  return dr;
+}
+/**
+ * @brief Reference CRC of data padded to whole words.
+ */
+static uint32_t reference(const uint8_t* p, uint32_t len) {
+
+  dr = 0xffffffff;
+  while (len) {
+    uint32_t word = 0;
+    uint32_t n = len < 4 ? len : 4;
+    memcpy(&word, p, n);
+    unitWrite(word);
+    p += n;
+    len -= n;
+  }
+  return dr;
+}
+/**
+ * @brief Compares CRC_Calc with the reference.
+ * @return Number of errors
+ */
+static int check(const char* name) {
+
+  const uint8_t* bytes = (const uint8_t*)data;
+  int errors = 0;
+
+  for (uint32_t offset = 0; offset < 4; offset++) {
+    for (uint32_t len = 0; len < 300; len++) {
+      uint32_t ref = reference(bytes + offset, len);
+      if (CRC_Calc(bytes + offset, len) != ref) {
+        errors++;
+      }
+      // continued in two parts (first part of whole words)
+      uint32_t split = len / 8 * 4;
+      if (CRC_Update(CRC_Calc(bytes + offset, split), bytes + offset + split,
+          len - split) != ref) {
+        errors++;
+      }
+    }
+  }
+  if (CRC_Calc(data, DATA_LEN) != reference(bytes, DATA_LEN)) {
+    errors++;
+  }
+  fprintf(stderr, "%-6s %s (%d errors)\n", name, errors ? "FAILED" : "ok",
+      errors);
+  return errors;
+}
+
+int main(void) {
+
+  struct timespec t0, t1;
+  int errors = 0;
+
+  srand(1);
+  for (uint32_t i = 0; i < sizeof(data) / 4; i++) {
+    data[i] = ((uint32_t)rand() << 16) ^ rand();
+  }
+
+  // known value of the STM32 unit: one word 0x12345678
+  uint32_t word = 0x12345678;
+  if (CRC_Calc(&word, 4) != 0xdf8a8a2b) {
+    fprintf(stderr, "Known value wrong: %08x\n", CRC_Calc(&word, 4));
+    errors++;
+  }
+
+  CRC_Init(0);
+  errors += check("table");
+  CRC_Init(unitUpdate);
+  errors += check("unit");
+  CRC_Init(0);
+
+  volatile uint32_t sink = 0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int r = 0; r < RUNS; r++) {
+    sink += CRC_Software(CRC_START, data, DATA_LEN);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  fprintf(stderr, "table  %.1f MB/s\n", (double)RUNS * DATA_LEN / s / 1e6);
+
+  return errors != 0;
+}
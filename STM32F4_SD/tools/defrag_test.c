@@ -0,0 +1,347 @@
+/**
+ * @file    defrag_test.c
+ * @brief   PC test of the defragmenter of fat.c.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Defragments a file split into many fragments on a card in
+ * memory and reads it before and after, then repeats the moving with
+ * power cut after every written sector:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o defrag_test defrag_test.c \
+ *       ramcard.c ../app/src/fat.c ../app/src/bdev.c ../app/src/utils.c \
+ *       ../app/src/crc.c
+ *   ./defrag_test > /dev/null
+ *
+ * The file has one cluster of 512 bytes in every fragment, separated
+ * by free clusters, as left by a file written in turns with another
+ * one that was then deleted. Fragments, commands, sectors and the time
+ * the card would take (ramcard.h model) to read the whole file after a
+ * reset are printed before and after, with the number of steps and the
+ * most commands of one step. After every cut the file must read intact
+ * and the volume must be consistent: every chain as long as its file
+ * needs and no cluster in two chains (lost clusters are allowed). The
+ * test runs on the bare card and through the cache and coalescer of
+ * main.c. On the bare card the moving is also repeated with one failed
+ * write command, for every command of the run, after which the file
+ * must read intact and the volume must be consistent in the same way.
+ * Debug messages of fat.c go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <fat.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CARD_SECTORS  70000 ///< Enough clusters for a FAT32 volume
+#define FILE_BYTES    (256 * 1024) ///< Size of fragmented file
+#define CHUNK         4096  ///< Bytes read by one call
+
+static const char* name = "FRAG    DAT";
+static BDEV_Device* device; ///< Top of block device stack
+static BDEV_Drive failing;  ///< Bare card failing one write
+static uint32_t failAt;     ///< Write commands left before the failed one
+static uint8_t used[CARD_SECTORS]; ///< Clusters found in chains
+
+/**
+ * @brief System time for fat.c (card time is measured instead).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Writes sectors of the card, failing one write command.
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors written
+ * @retval 1 Write failed (nothing written)
+ */
+static uint8_t failWrite(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (failAt-- == 0) {
+    return 1;
+  }
+  return RAMCARD_Write(buf, sector, count);
+}
+/**
+ * @brief Returns a byte of the file.
+ * @param pos Position in file
+ * @return Byte
+ */
+static uint8_t pattern(uint32_t pos) {
+
+  return (uint8_t)(pos * 7 + pos / 509);
+}
+/**
+ * @brief Loads a little endian 32-bit value.
+ */
+static uint32_t get32(const uint8_t* p) {
+
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+/**
+ * @brief Formats the card and writes the fragmented file.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @return 0 if written
+ */
+static int start(uint8_t layers) {
+
+  static const RAMCARD_File card[] = {
+    {"OTHER   DAT", 8192, 0, 0},
+    {"FRAG    DAT", FILE_BYTES, 1, 0},
+  };
+  static uint8_t data[FILE_BYTES];
+
+  RAMCARD_Format(CARD_SECTORS, 1, card, 2);
+  for (uint32_t i = 0; i < FILE_BYTES; i++) {
+    data[i] = pattern(i);
+  }
+  device = RAMCARD_Device(layers);
+  if (FAT_Init(RAMCARD_Init, device)) {
+    return -1;
+  }
+  int file = FAT_OpenFile(name);
+  if (file < 0 || FAT_WriteFile(file, data, FILE_BYTES) != FILE_BYTES) {
+    return -1;
+  }
+  FAT_CloseFile(file);
+  return 0;
+}
+/**
+ * @brief Reads the whole file after a reset.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @param stats Card statistics of reading (function writes this)
+ * @param fragments Fragments of file (function writes this)
+ * @return Number of errors
+ */
+static int readFile(uint8_t layers, RAMCARD_Stats* stats, uint32_t* fragments) {
+
+  uint8_t chunk[CHUNK];
+  FAT_Fragmentation info;
+  int errors = 0;
+
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+    return 1;
+  }
+  int file = FAT_OpenFile(name);
+  if (file < 0 || FAT_GetFileSize(file) != FILE_BYTES) {
+    return 1;
+  }
+  FAT_GetFragmentation(file, &info);
+  *fragments = info.fragments;
+
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  for (uint32_t pos = 0; pos < FILE_BYTES; pos += CHUNK) {
+    if (FAT_ReadFile(file, chunk, CHUNK) != CHUNK) {
+      errors++;
+      break;
+    }
+    for (int i = 0; i < CHUNK; i++) {
+      if (chunk[i] != pattern(pos + i)) {
+        errors++;
+        break;
+      }
+    }
+  }
+  *stats = RAMCARD_stats;
+  FAT_CloseFile(file);
+  return errors;
+}
+/**
+ * @brief Follows a cluster chain in the first FAT.
+ * @param first First cluster (0 - empty file)
+ * @param entries Number of FAT entries
+ * @return Clusters in chain (-1 - broken or cross linked chain)
+ */
+static int chain(uint32_t first, uint32_t entries) {
+
+  const uint8_t* boot = RAMCARD_Image() + RAMCARD_FAT_START * 512;
+  const uint8_t* fat = boot + (boot[14] | boot[15] << 8) * 512;
+  int length = 0;
+
+  for (uint32_t c = first; c;) {
+    if (c < 2 || c >= entries || used[c]) {
+      return -1;
+    }
+    used[c] = 1;
+    length++;
+    c = get32(fat + c * 4) & 0x0fffffff;
+    if (c >= 0x0ffffff8) {
+      break;
+    }
+  }
+  return length;
+}
+/**
+ * @brief Checks that the chains agree with the root directory.
+ * @return Number of errors
+ */
+static int checkVolume(void) {
+
+  const uint8_t* boot = RAMCARD_Image() + RAMCARD_FAT_START * 512;
+  uint32_t fatSize = get32(boot + 36);
+  uint32_t cluster = boot[13] * 512;
+  uint32_t dataStart = RAMCARD_FAT_START + (boot[14] | boot[15] << 8) +
+      2 * fatSize;
+  uint32_t entries = (get32(boot + 32) - (dataStart - RAMCARD_FAT_START)) /
+      boot[13] + 2;
+  int errors = 0;
+
+  memset(used, 0, sizeof(used));
+  if (chain(2, entries) != 1) {
+    return 1;
+  }
+  const uint8_t* entry = RAMCARD_Image() + dataStart * 512;
+  for (uint32_t i = 0; i < cluster / 32 && entry[0]; i++, entry += 32) {
+    if (entry[0] == 0xe5 || entry[11] == 0x0f || (entry[11] & 0x08)) {
+      continue; // deleted, long name or label
+    }
+    uint32_t first = (entry[20] | entry[21] << 8) << 16 |
+        entry[26] | entry[27] << 8;
+    uint32_t size = get32(entry + 28);
+    if (chain(first, entries) != (int)((size + cluster - 1) / cluster)) {
+      errors++;
+    }
+  }
+  return errors;
+}
+/**
+ * @brief Defragments the most fragmented file.
+ * @param maxCmds Most commands of one step (function writes this)
+ * @return Number of steps (-1 - failed)
+ */
+static int defragment(uint32_t* maxCmds) {
+
+  int steps = 0;
+  int8_t ret;
+
+  *maxCmds = 0;
+  if (FAT_DefragFile(0)) {
+    return -1;
+  }
+  do {
+    RAMCARD_Stats before = RAMCARD_stats;
+    ret = FAT_DefragStep();
+    uint32_t cmds = RAMCARD_stats.reads + RAMCARD_stats.writes -
+        before.reads - before.writes;
+    if (cmds > *maxCmds) {
+      *maxCmds = cmds;
+    }
+    steps++;
+  } while (ret == 1);
+  return ret ? -1 : steps;
+}
+
+int main(void) {
+
+  int errors = 0;
+  uint32_t writes = 0;
+
+  BDEV_InitDrive(&failing, RAMCARD_Read, failWrite);
+  fprintf(stderr, "file of %d bytes, one 512-byte cluster per fragment\n",
+      FILE_BYTES);
+  fprintf(stderr, "%-7s %-6s %9s %6s %7s %9s %6s %6s %9s %6s %6s\n", "stack",
+      "file", "fragments", "cmds", "sectors", "read [ms]", "kB/s", "steps",
+      "step cmds", "cuts", "failed");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    RAMCARD_Stats before, after;
+    uint32_t fragBefore, fragAfter, maxCmds;
+    int failed = 0;
+
+    // run without a cut
+    if (start(layers) || readFile(layers, &before, &fragBefore)) {
+      fprintf(stderr, "Cannot write file\n");
+      return 1;
+    }
+    memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+    int steps = defragment(&maxCmds);
+    BDEV_Flush(device);
+    uint32_t sectors = RAMCARD_stats.sectorsWritten;
+    if (!layers) {
+      writes = RAMCARD_stats.writes;
+    }
+    if (steps < 0 || readFile(layers, &after, &fragAfter) || fragAfter != 1 ||
+        checkVolume()) {
+      failed++;
+    }
+
+    for (uint32_t cut = 0; cut <= sectors; cut++) {
+      if (start(layers)) {
+        fprintf(stderr, "Cannot write file\n");
+        return 1;
+      }
+      RAMCARD_CutPower(cut);
+      defragment(&maxCmds);
+      uint32_t fragments;
+      RAMCARD_Stats stats;
+      if (readFile(layers, &stats, &fragments) || checkVolume()) {
+        failed++;
+      }
+    }
+    errors += failed;
+
+    for (int f = 0; f < 2; f++) {
+      RAMCARD_Stats* stats = f ? &after : &before;
+      double time = RAMCARD_Time(stats);
+      fprintf(stderr, "%-7s %-6s %9u %6u %7u %9.1f %6.1f", f ? "" :
+          layers ? "cached" : "card", f ? "after" : "before",
+          (unsigned)(f ? fragAfter : fragBefore), (unsigned)stats->reads,
+          (unsigned)stats->sectorsRead, time / 1000,
+          FILE_BYTES / time * 1e6 / 1024);
+      if (f) {
+        fprintf(stderr, " %6d %9u %6u %6d %s\n", steps, (unsigned)maxCmds,
+            (unsigned)sectors + 1, failed, failed ? "FAILED" : "ok");
+      } else {
+        fprintf(stderr, "\n");
+      }
+    }
+  }
+
+  // one failed write command on the bare card
+  int failed = 0;
+  for (uint32_t w = 0; w < writes; w++) {
+    uint32_t fragments, maxCmds;
+    RAMCARD_Stats stats;
+
+    if (start(0) || FAT_Init(RAMCARD_Init, &failing.dev)) {
+      fprintf(stderr, "Cannot write file\n");
+      return 1;
+    }
+    failAt = w;
+    defragment(&maxCmds);
+    if (readFile(0, &stats, &fragments) || checkVolume()) {
+      failed++;
+    }
+  }
+  errors += failed;
+  fprintf(stderr, "card with one of %u writes failed: %d failed %s\n",
+      (unsigned)writes, failed, failed ? "FAILED" : "ok");
+
+  return errors ? 1 : 0;
+}
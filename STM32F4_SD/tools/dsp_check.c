@@ -0,0 +1,259 @@
+/**
+ * @file    dsp_check.c
+ * @brief   PC check of the signal processing pipeline.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs dsp.c (portable kernels) on the PC and compares every
+ * kind of stage, and a whole chain, with straightforward double
+ * precision reference implementations working on the whole signal:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -I../hal/inc -o dsp_check \
+ *       dsp_check.c ../app/src/dsp.c -lm
+ *   ./dsp_check > /dev/null
+ *
+ * The test signal is a sum of sines and noise in Q15, processed in
+ * many blocks, so the filter state kept between blocks is checked too.
+ * For every pipeline the largest error and the time per block of every
+ * stage (in ns instead of cycles) are printed.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <dsp.h>
+#include <dwt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BLOCK     256   ///< Samples per block
+#define BLOCKS    40    ///< Blocks in test signal
+#define SAMPLES   (BLOCK * BLOCKS)
+#define MAX_ERROR 1e-4  ///< Largest accepted error
+
+static int16_t signal[SAMPLES]; ///< Test signal
+static double x[SAMPLES];       ///< Test signal as read by pipeline
+static double ref[SAMPLES];     ///< Reference output
+static double tmp[SAMPLES];     ///< Reference intermediate output
+
+static float randomTaps[17];    ///< FIR taps without symmetry
+static float lowpassTaps[32];   ///< Anti-aliasing filter for decimation
+static float biquad[10];        ///< Two low pass sections
+
+/**
+ * @brief Cycle counter (ns on the PC).
+ */
+void DWT_Init(void) {
+}
+uint32_t DWT_GetCycles(void) {
+
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+/**
+ * @brief Reference FIR filter with decimation.
+ * @return Output length
+ */
+static int refFir(const double* in, int len, double* out, const float* taps,
+    int count, int factor) {
+
+  int o = 0;
+
+  for (int n = factor - 1; n < len; n += factor) {
+    double acc = 0;
+    for (int k = 0; k < count; k++) {
+      // taps in time reversed order
+      int i = n - k;
+      if (i >= 0) {
+        acc += taps[count - 1 - k] * in[i];
+      }
+    }
+    out[o++] = acc;
+  }
+  return o;
+}
+/**
+ * @brief Reference biquad cascade.
+ * @return Output length
+ */
+static int refBiquad(const double* in, int len, double* out,
+    const float* c, int sections) {
+
+  memmove(out, in, len * sizeof(double));
+  for (int s = 0; s < sections; s++, c += 5) {
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    for (int n = 0; n < len; n++) {
+      double y = c[0] * out[n] + c[1] * x1 + c[2] * x2 + c[3] * y1 + c[4] * y2;
+      x2 = x1;
+      x1 = out[n];
+      y2 = y1;
+      y1 = y;
+      out[n] = y;
+    }
+  }
+  return len;
+}
+/**
+ * @brief Reference RMS of every block.
+ * @return Output length
+ */
+static int refRms(const double* in, int len, double* out, int block) {
+
+  for (int b = 0; b < len / block; b++) {
+    double sum = 0;
+    for (int n = 0; n < block; n++) {
+      sum += in[b * block + n] * in[b * block + n];
+    }
+    out[b] = sqrt(sum / block);
+  }
+  return len / block;
+}
+/**
+ * @brief Reference band energies of every block (direct DFT).
+ * @return Output length
+ */
+static int refBands(const double* in, int len, double* out, int block,
+    int bands) {
+
+  int width = block / 2 / bands;
+  int o = 0;
+
+  for (int b = 0; b < len / block; b++) {
+    const double* blk = in + b * block;
+    for (int band = 0; band < bands; band++) {
+      double sum = 0;
+      for (int k = band * width; k < (band + 1) * width; k++) {
+        double re = 0, im = 0;
+        for (int n = 0; n < block; n++) {
+          re += blk[n] * cos(2 * M_PI * k * n / block);
+          im -= blk[n] * sin(2 * M_PI * k * n / block);
+        }
+        sum += (k ? 2.0 : 1.0) * (re * re + im * im) / ((double)block * block);
+      }
+      out[o++] = sum;
+    }
+  }
+  return o;
+}
+
+/**
+ * @brief Runs a pipeline over the test signal and compares with ref.
+ * @param name Name of pipeline
+ * @param p Pipeline
+ * @param refLen Length of reference output
+ * @return Nonzero if error too large
+ */
+static int check(const char* name, DSP_Pipeline* p, int refLen) {
+
+  static float out[DSP_MAX_BLOCK];
+  double maxError = 0;
+  int o = 0;
+
+  for (int b = 0; b < BLOCKS; b++) {
+    int n = DSP_Process(p, signal + b * BLOCK, out);
+    for (int i = 0; i < n; i++, o++) {
+      double e = fabs(out[i] - ref[o]);
+      if (e > maxError) {
+        maxError = e;
+      }
+    }
+  }
+
+  int failed = (o != refLen || maxError > MAX_ERROR);
+  fprintf(stderr, "%-10s %5d values  error %.2e  %s\n      ns/block:", name, o,
+      maxError, failed ? "FAILED" : "ok");
+  for (int i = 0; i < p->count; i++) {
+    fprintf(stderr, " %u", (unsigned int)DSP_GetCycles(p, i));
+  }
+  fprintf(stderr, "\n");
+  return failed;
+}
+
+int main(void) {
+
+  static DSP_Pipeline p;
+  int failed = 0;
+  int len;
+
+  srand(1);
+  for (int n = 0; n < SAMPLES; n++) {
+    double v = 0.3 * sin(2 * M_PI * n * 0.01) + 0.2 * sin(2 * M_PI * n * 0.23) +
+        0.1 * (rand() / (double)RAND_MAX - 0.5);
+    signal[n] = (int16_t)lrint(v * 32767);
+    x[n] = signal[n] / 32768.0;
+  }
+  for (int k = 0; k < 17; k++) {
+    randomTaps[k] = rand() / (double)RAND_MAX - 0.5;
+  }
+  // windowed sinc, cutoff at 1/8 of sampling frequency
+  for (int k = 0; k < 32; k++) {
+    double t = k - 15.5;
+    lowpassTaps[k] = 0.25 * sin(M_PI * 0.25 * t) / (M_PI * 0.25 * t) *
+        (0.54 - 0.46 * cos(2 * M_PI * k / 31));
+  }
+  // two low pass sections at 0.05 and 0.1 of sampling frequency
+  for (int s = 0; s < 2; s++) {
+    double w = 2 * M_PI * 0.05 * (s + 1);
+    double alpha = sin(w) / (2 * 0.7071);
+    double a0 = 1 + alpha;
+    biquad[5 * s + 0] = (1 - cos(w)) / 2 / a0;
+    biquad[5 * s + 1] = (1 - cos(w)) / a0;
+    biquad[5 * s + 2] = (1 - cos(w)) / 2 / a0;
+    biquad[5 * s + 3] = 2 * cos(w) / a0;    // negated a1
+    biquad[5 * s + 4] = -(1 - alpha) / a0;  // negated a2
+  }
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddFir(&p, randomTaps, 17);
+  failed |= check("fir", &p, refFir(x, SAMPLES, ref, randomTaps, 17, 1));
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddBiquad(&p, biquad, 2);
+  failed |= check("biquad", &p, refBiquad(x, SAMPLES, ref, biquad, 2));
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddDecimate(&p, lowpassTaps, 32, 4);
+  failed |= check("decimate", &p, refFir(x, SAMPLES, ref, lowpassTaps, 32, 4));
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddRms(&p);
+  failed |= check("rms", &p, refRms(x, SAMPLES, ref, BLOCK));
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddBands(&p, 16);
+  failed |= check("bands", &p, refBands(x, SAMPLES, ref, BLOCK, 16));
+
+  DSP_Init(&p, BLOCK);
+  DSP_AddFir(&p, randomTaps, 17);
+  DSP_AddBiquad(&p, biquad, 2);
+  DSP_AddDecimate(&p, lowpassTaps, 32, 4);
+  DSP_AddBands(&p, 8);
+  len = refFir(x, SAMPLES, ref, randomTaps, 17, 1);
+  len = refBiquad(ref, len, tmp, biquad, 2);
+  len = refFir(tmp, len, ref, lowpassTaps, 32, 4);
+  len = refBands(ref, len, tmp, BLOCK / 4, 8);
+  memcpy(ref, tmp, len * sizeof(double));
+  failed |= check("chain", &p, len);
+
+  // wrong configurations must be refused
+  DSP_Init(&p, 100);
+  if (!DSP_AddBands(&p, 4) || !DSP_AddDecimate(&p, lowpassTaps, 32, 3)) {
+    fprintf(stderr, "Wrong configuration accepted\n");
+    failed = 1;
+  }
+
+  return failed;
+}
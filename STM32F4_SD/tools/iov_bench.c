@@ -0,0 +1,345 @@
+/**
+ * @file    iov_bench.c
+ * @brief   PC benchmark of vectored file writes and reads.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Writes records made of a header, a sample block and a
+ * trailer to a file on a card in memory, then reads them back, with
+ * fat.c and with FatFs:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -I../fatfs -o iov_bench iov_bench.c \
+ *       ramcard.c ../app/src/fat.c ../app/src/bdev.c ../app/src/utils.c \
+ *       ../app/src/crc.c ../fatfs/ff.c ../fatfs/diskio.c
+ *   ./iov_bench > /dev/null
+ *
+ * Every record is written in three ways: one call per part, one call
+ * after copying the parts into a staging buffer, and one vectored call
+ * (FAT_WriteFileV). For every way the number of commands and sectors
+ * reaching the card is printed, straight and through the cache and
+ * coalescer of main.c, with the time the card would take (ramcard.h
+ * model) and the time spent on the PC. Read back is checked against
+ * the written data. Debug messages of the modules go to stdout.
+ *
+ * FatFs has no vectored calls. It updates the directory entry only in
+ * f_sync and keeps a partial sector in the file buffer between calls,
+ * so three f_write calls cost the same commands as one f_write of a
+ * staging buffer - the FatFs rows show it.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <fat.h>
+#include <ff.h>
+#include <diskio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CARD_SECTORS  540000 ///< Enough 4 kB clusters for FatFs to see FAT32
+#define HEADER        12    ///< Bytes of record header
+#define SAMPLES       1000  ///< Bytes of sample block
+#define TRAILER       4     ///< Bytes of record trailer
+#define RECORD        (HEADER + SAMPLES + TRAILER)
+#define RECORDS       1000  ///< Records written
+#define FILE_SIZE     (RECORD * RECORDS)
+
+/**
+ * @brief Way of writing a record.
+ */
+typedef enum {
+  WAY_PARTS,    ///< One call per part
+  WAY_STAGING,  ///< Parts copied into one buffer
+  WAY_VECTOR,   ///< One vectored call
+} Way;
+
+static const char* wayNames[] = {"3 calls", "staging buffer", "vectored"};
+static uint8_t written[FILE_SIZE];  ///< Data written to file
+static uint8_t readBack[FILE_SIZE]; ///< Data read from file
+
+/**
+ * @brief System time for fat.c (write-back timing is not measured).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Initializes the card for diskio.c.
+ * @return Always 0
+ */
+uint8_t SD_Init(void) {
+
+  return RAMCARD_Init();
+}
+/**
+ * @brief Time stamp of files for FatFs.
+ * @return 1 January 2014
+ */
+DWORD get_fattime(void) {
+
+  return (DWORD)(2014 - 1980) << 25 | 1 << 21 | 1 << 16;
+}
+/**
+ * @brief Returns monotonic time.
+ * @return Time in us
+ */
+static double now(void) {
+
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+/**
+ * @brief Fills the parts of a record.
+ * @param rec Record number
+ * @param data Record (RECORD bytes)
+ */
+static void makeRecord(int rec, uint8_t* data) {
+
+  for (int i = 0; i < RECORD; i++) {
+    data[i] = (uint8_t)(rec * 7 + i);
+  }
+}
+/**
+ * @brief Prints a result row.
+ */
+static void report(const char* fs, uint8_t layers, const char* what,
+    Way way, const RAMCARD_Stats* stats, double pcTime, int errors) {
+
+  double cardTime = RAMCARD_Time(stats);
+
+  fprintf(stderr, "%-6s %-6s %-5s %-15s %7u %7u %9.0f %7.1f %9.0f %s\n", fs,
+      layers ? "cached" : "card", what, wayNames[way], (unsigned)(stats->reads + stats->writes),
+      (unsigned)(stats->sectorsRead + stats->sectorsWritten), cardTime / 1000,
+      FILE_SIZE / cardTime * 1e6 / 1024, pcTime, errors ? "FAILED" : "ok");
+}
+/**
+ * @brief Formats the card with the files of the benchmark.
+ */
+static void format(void) {
+
+  static const RAMCARD_File files[] = {
+    {"RECORDS DAT", FILE_SIZE, 0, 0},
+  };
+
+  RAMCARD_Format(CARD_SECTORS, 8, files, 1);
+}
+/**
+ * @brief Writes and reads the records with fat.c.
+ * @param way Way of writing
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @return Number of errors
+ */
+static int runFat(Way way, uint8_t layers) {
+
+  static uint8_t staging[RECORD];
+  uint8_t record[RECORD];
+  int errors = 0;
+
+  format();
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+    return 1;
+  }
+  int file = FAT_OpenFile("RECORDS DAT");
+  if (file < 0) {
+    return 1;
+  }
+
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  double start = now();
+
+  for (int rec = 0; rec < RECORDS; rec++) {
+    makeRecord(rec, record);
+    memcpy(written + rec * RECORD, record, RECORD);
+    int len = 0;
+
+    switch (way) {
+    case WAY_PARTS:
+      len += FAT_WriteFile(file, record, HEADER);
+      len += FAT_WriteFile(file, record + HEADER, SAMPLES);
+      len += FAT_WriteFile(file, record + HEADER + SAMPLES, TRAILER);
+      break;
+    case WAY_STAGING:
+      memcpy(staging, record, RECORD);
+      len = FAT_WriteFile(file, staging, RECORD);
+      break;
+    default: {
+      FAT_IoVec iov[3] = {
+        {record, HEADER},
+        {record + HEADER, SAMPLES},
+        {record + HEADER + SAMPLES, TRAILER},
+      };
+      len = FAT_WriteFileV(file, iov, 3);
+      break;
+    }
+    }
+    if (len != RECORD) {
+      errors++;
+    }
+  }
+  FAT_SyncFile(file);
+
+  RAMCARD_Stats stats = RAMCARD_stats;
+  report("fat.c", layers, "write", way, &stats, now() - start, errors);
+
+  // read back with the same split
+  FAT_MoveRdPtr(file, 0);
+  memset(readBack, 0, sizeof(readBack));
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  start = now();
+
+  for (int rec = 0; rec < RECORDS; rec++) {
+    uint8_t* data = readBack + rec * RECORD;
+
+    switch (way) {
+    case WAY_PARTS:
+      FAT_ReadFile(file, data, HEADER);
+      FAT_ReadFile(file, data + HEADER, SAMPLES);
+      FAT_ReadFile(file, data + HEADER + SAMPLES, TRAILER);
+      break;
+    case WAY_STAGING:
+      FAT_ReadFile(file, staging, RECORD);
+      memcpy(data, staging, RECORD);
+      break;
+    default: {
+      FAT_IoVec iov[3] = {
+        {data, HEADER},
+        {data + HEADER, SAMPLES},
+        {data + HEADER + SAMPLES, TRAILER},
+      };
+      FAT_ReadFileV(file, iov, 3);
+      break;
+    }
+    }
+  }
+  if (memcmp(written, readBack, FILE_SIZE)) {
+    errors++;
+  }
+  stats = RAMCARD_stats;
+  report("fat.c", layers, "read", way, &stats, now() - start, errors);
+
+  FAT_CloseFile(file);
+  return errors;
+}
+/**
+ * @brief Writes and reads the records with FatFs.
+ * @param way Way of writing (no vectored calls in FatFs)
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @return Number of errors
+ */
+static int runFatFs(Way way, uint8_t layers) {
+
+  static FATFS fs;
+  static FIL fp;
+  static uint8_t staging[RECORD];
+  uint8_t record[RECORD];
+  UINT n;
+  int errors = 0;
+
+  format();
+  disk_attach(RAMCARD_Device(layers));
+  if (f_mount(&fs, "", 1) != FR_OK ||
+      f_open(&fp, "RECORDS.DAT", FA_READ | FA_WRITE) != FR_OK) {
+    return 1;
+  }
+
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  double start = now();
+
+  for (int rec = 0; rec < RECORDS; rec++) {
+    makeRecord(rec, record);
+    UINT len = 0;
+
+    if (way == WAY_PARTS) {
+      f_write(&fp, record, HEADER, &n);
+      len += n;
+      f_write(&fp, record + HEADER, SAMPLES, &n);
+      len += n;
+      f_write(&fp, record + HEADER + SAMPLES, TRAILER, &n);
+      len += n;
+    } else {
+      memcpy(staging, record, RECORD);
+      f_write(&fp, staging, RECORD, &len);
+    }
+    if (len != RECORD) {
+      errors++;
+    }
+  }
+  f_sync(&fp);
+
+  RAMCARD_Stats stats = RAMCARD_stats;
+  report("FatFs", layers, "write", way, &stats, now() - start, errors);
+
+  f_lseek(&fp, 0);
+  memset(readBack, 0, sizeof(readBack));
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  start = now();
+
+  for (int rec = 0; rec < RECORDS; rec++) {
+    uint8_t* data = readBack + rec * RECORD;
+
+    if (way == WAY_PARTS) {
+      f_read(&fp, data, HEADER, &n);
+      f_read(&fp, data + HEADER, SAMPLES, &n);
+      f_read(&fp, data + HEADER + SAMPLES, TRAILER, &n);
+    } else {
+      f_read(&fp, staging, RECORD, &n);
+      memcpy(data, staging, RECORD);
+    }
+  }
+  if (memcmp(written, readBack, FILE_SIZE)) {
+    errors++;
+  }
+  stats = RAMCARD_stats;
+  report("FatFs", layers, "read", way, &stats, now() - start, errors);
+
+  f_close(&fp);
+  f_mount(0, "", 0);
+  return errors;
+}
+
+int main(void) {
+
+  int errors = 0;
+
+  fprintf(stderr, "%d records of %d+%d+%d bytes\n", RECORDS, HEADER, SAMPLES,
+      TRAILER);
+  fprintf(stderr, "%-6s %-6s %-5s %-15s %7s %7s %9s %7s %9s\n", "fs",
+      "stack", "op", "way", "cmds", "sectors", "card [ms]", "kB/s", "PC [us]");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    for (Way way = WAY_PARTS; way <= WAY_VECTOR; way++) {
+      errors += runFat(way, layers);
+    }
+    for (Way way = WAY_PARTS; way <= WAY_STAGING; way++) {
+      errors += runFatFs(way, layers);
+    }
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+/**
+ * @file    journal_test.c
+ * @brief   PC test of the FatFs metadata journal.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Creates, writes, appends and deletes files with FatFs on a
+ * card in memory, cutting power after every written sector, then
+ * mounts the card again and checks that the FAT and the directory
+ * agree:
+ *
+ *   gcc -std=gnu11 -O2 -D_FS_JOURNAL=1 -I../app/inc -I../fatfs \
+ *       -o journal_test journal_test.c ramcard.c ../app/src/bdev.c \
+ *       ../fatfs/ff.c ../fatfs/diskio.c
+ *   ./journal_test
+ *
+ * A volume is consistent when the chain of every file has as many
+ * clusters as its size needs, no cluster is in two chains and every
+ * cluster marked in the FAT belongs to a chain. A second run creates
+ * so many files without synchronizing that the root directory of
+ * 8-sector clusters grows while the journal fills up, which commits it
+ * in the middle of clearing a new cluster. The tests run on a volume
+ * with a journal (f_mkjournal) and on one without it, on the bare card
+ * and through the cache and coalescer of main.c. Every cut must leave
+ * the journaled volume mountable and consistent. Commands, sectors and
+ * the time the card would take (ramcard.h model) of a run without a
+ * cut show what the journal costs.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <ff.h>
+#include <diskio.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !_FS_JOURNAL
+#error Build the test with -D_FS_JOURNAL=1
+#endif
+
+#define CARD_SECTORS  70000 ///< Enough clusters for FatFs to see FAT32
+#define DIR_SECTORS   540000 ///< The same with 8-sector clusters
+#define FILES         24    ///< Files created
+#define FILE_BYTES    3000  ///< Size of file
+#define LOG_BYTES     1000  ///< Bytes appended to log after every file
+#define KEEP          2     ///< Files kept before deleting the oldest
+#define DIR_FILES     400   ///< Files created in the growing directory
+
+static FATFS fs;
+static uint8_t used[DIR_SECTORS]; ///< Clusters found in chains
+
+/**
+ * @brief Initializes the card for diskio.c.
+ * @return Always 0
+ */
+uint8_t SD_Init(void) {
+
+  return RAMCARD_Init();
+}
+/**
+ * @brief Time stamp of files for FatFs.
+ * @return 1 January 2014
+ */
+DWORD get_fattime(void) {
+
+  return (DWORD)(2014 - 1980) << 25 | 1 << 21 | 1 << 16;
+}
+/**
+ * @brief Loads a little endian 32-bit value.
+ */
+static uint32_t get32(const uint8_t* p) {
+
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+/**
+ * @brief Formats the card and mounts it.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @param journal Nonzero to create a journal
+ * @param cluster Sectors per cluster
+ * @return 0 if mounted
+ */
+static int start(uint8_t layers, int journal, uint8_t cluster) {
+
+  RAMCARD_Format(cluster > 1 ? DIR_SECTORS : CARD_SECTORS, cluster, 0, 0);
+  disk_attach(RAMCARD_Device(layers));
+  if (f_mount(&fs, "", 1) != FR_OK) {
+    return -1;
+  }
+  if (journal && f_mkjournal("") != FR_OK) {
+    return -1;
+  }
+  return 0;
+}
+/**
+ * @brief Runs the file operations.
+ * @return Bytes of file data written
+ */
+static uint32_t session(void) {
+
+  static FIL file, logFile;
+  static uint8_t data[FILE_BYTES];
+  char name[13];
+  uint32_t bytes = 0;
+  UINT n;
+
+  memset(data, 0x55, sizeof(data));
+  f_open(&logFile, "LOG.DAT", FA_CREATE_ALWAYS | FA_WRITE);
+  for (int i = 0; i < FILES; i++) {
+    sprintf(name, "F%02d.DAT", i);
+    if (f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK) {
+      f_write(&file, data, FILE_BYTES, &n);
+      bytes += n;
+      f_close(&file);
+    }
+    f_write(&logFile, data, LOG_BYTES, &n);
+    bytes += n;
+    f_sync(&logFile);
+    if (i >= KEEP) {
+      sprintf(name, "F%02d.DAT", i - KEEP);
+      f_unlink(name);
+    }
+  }
+  f_close(&logFile);
+  return bytes;
+}
+/**
+ * @brief Creates empty files in the root directory, synchronizing once.
+ * @return Bytes of file data written (none)
+ */
+static uint32_t grow(void) {
+
+  static FIL file;
+  char name[13];
+
+  for (int i = 0; i < DIR_FILES; i++) {
+    sprintf(name, "D%03d.DAT", i);
+    f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  }
+  f_close(&file);
+  return 0;
+}
+/**
+ * @brief Follows a cluster chain in the first FAT.
+ * @param first First cluster (0 - empty file)
+ * @param entries Number of FAT entries
+ * @return Clusters in chain (-1 - broken or cross linked chain)
+ */
+static int chain(uint32_t first, uint32_t entries) {
+
+  const uint8_t* boot = RAMCARD_Image() + RAMCARD_FAT_START * 512;
+  const uint8_t* fat = boot + (boot[14] | boot[15] << 8) * 512;
+  int length = 0;
+
+  for (uint32_t c = first; c;) {
+    if (c < 2 || c >= entries || used[c]) {
+      return -1;
+    }
+    used[c] = 1;
+    length++;
+    c = get32(fat + c * 4) & 0x0fffffff;
+    if (c >= 0x0ffffff8) {
+      break;
+    }
+  }
+  return length;
+}
+/**
+ * @brief Checks that the FAT and the root directory agree.
+ * @return Number of errors
+ */
+static int checkVolume(void) {
+
+  const uint8_t* boot = RAMCARD_Image() + RAMCARD_FAT_START * 512;
+  const uint8_t* fat = boot + (boot[14] | boot[15] << 8) * 512;
+  uint32_t fatSize = get32(boot + 36);
+  uint32_t cluster = boot[13] * 512;
+  uint32_t dataStart = RAMCARD_FAT_START + (boot[14] | boot[15] << 8) +
+      2 * fatSize;
+  uint32_t entries = (get32(boot + 32) - (dataStart - RAMCARD_FAT_START)) /
+      boot[13] + 2;
+  uint32_t dir = get32(boot + 44);
+  int errors = 0, end = 0;
+
+  memset(used, 0, sizeof(used));
+
+  // files in the root directory
+  if (chain(dir, entries) < 1) {
+    return 1;
+  }
+  for (; !end && dir < 0x0ffffff8; dir = get32(fat + dir * 4) & 0x0fffffff) {
+    const uint8_t* entry = RAMCARD_Image() +
+        (dataStart + (dir - 2) * boot[13]) * 512;
+    for (uint32_t i = 0; i < cluster / 32; i++, entry += 32) {
+      if (!entry[0]) {
+        end = 1;
+        break;
+      }
+      if (entry[0] == 0xe5 || entry[11] == 0x0f || (entry[11] & 0x08)) {
+        continue; // deleted, long name or label
+      }
+      uint32_t first = (entry[20] | entry[21] << 8) << 16 |
+          entry[26] | entry[27] << 8;
+      uint32_t size = get32(entry + 28);
+      if (chain(first, entries) != (int)((size + cluster - 1) / cluster)) {
+        errors++;
+      }
+    }
+  }
+  // clusters marked in the FAT but lost from all chains
+  for (uint32_t c = 2; c < entries; c++) {
+    if ((get32(fat + c * 4) & 0x0fffffff) && !used[c]) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+/**
+ * @brief Mounts the card again after a reset and checks the volume.
+ * @details Mount copies a committed journal home.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @return 0 if mounted and consistent
+ */
+static int remount(uint8_t layers) {
+
+  f_mount(0, "", 0);
+  RAMCARD_Init();
+  disk_attach(RAMCARD_Device(layers));
+  if (f_mount(&fs, "", 1) != FR_OK) {
+    return 1;
+  }
+  f_mount(0, "", 0);
+  return checkVolume() ? 1 : 0;
+}
+
+int main(void) {
+
+  static const struct {
+    const char* name;     ///< Name printed
+    uint8_t cluster;      ///< Sectors per cluster
+    uint32_t (*run)(void); ///< File operations
+  } tests[] = {
+    {"files", 1, session},
+    {"dir", 8, grow},
+  };
+  int errors = 0;
+
+  fprintf(stderr, "files: %d files of %d bytes, %d bytes appended to log "
+      "after every file\n", FILES, FILE_BYTES, LOG_BYTES);
+  fprintf(stderr, "dir: %d empty files created in root directory of "
+      "%d-byte clusters\n", DIR_FILES, tests[1].cluster * 512);
+  fprintf(stderr, "%-5s %-7s %-7s %6s %12s %6s %7s %9s %6s\n", "test",
+      "stack", "journal", "cuts", "inconsistent", "cmds", "sectors",
+      "card [ms]", "kB/s");
+
+  for (unsigned t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+    for (uint8_t layers = 0; layers < 2; layers++) {
+      for (int journal = 1; journal >= 0; journal--) {
+        int failed = 0;
+
+        // run without a cut to count commands and written sectors
+        if (start(layers, journal, tests[t].cluster)) {
+          fprintf(stderr, "Cannot mount card\n");
+          return 1;
+        }
+        memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+        uint32_t bytes = tests[t].run();
+        RAMCARD_Stats stats = RAMCARD_stats;
+        double cardTime = RAMCARD_Time(&stats);
+        failed += remount(layers);
+
+        for (uint32_t cut = 0; cut <= stats.sectorsWritten; cut++) {
+          start(layers, journal, tests[t].cluster);
+          RAMCARD_CutPower(cut);
+          tests[t].run();
+          failed += remount(layers);
+        }
+        if (journal) {
+          errors += failed;
+        }
+
+        fprintf(stderr, "%-5s %-7s %-7s %6u %12d %6u %7u %9.0f %6.1f %s\n",
+            tests[t].name, layers ? "cached" : "card", journal ? "yes" : "no", (unsigned)stats.sectorsWritten + 1, failed,
+            (unsigned)(stats.reads + stats.writes),
+            (unsigned)(stats.sectorsRead + stats.sectorsWritten),
+            cardTime / 1000, bytes / cardTime * 1e6 / 1024,
+            journal ? (failed ? "FAILED" : "ok") : "");
+      }
+    }
+  }
+
+  return errors ? 1 : 0;
+}
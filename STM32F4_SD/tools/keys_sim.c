@@ -0,0 +1,196 @@
+/**
+ * @file    keys_sim.c
+ * @brief   PC test of keyboard debounce timing.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs keys.c on the PC against bounce traces of a key contact
+ * sampled every 1 ms ('1' - contact closed, '0' - open):
+ *
+ *   gcc -std=gnu11 -DSTM32F40_41xxx -I../app/inc -I../hal/inc \
+ *       -I../include -I../libs/CMSIS/include -o keys_sim keys_sim.c \
+ *       ../app/src/fifo.c
+ *   ./keys_sim [TRACES] > /dev/null
+ *
+ * TRACES is a text file with one trace per line (logic analyser
+ * export), without it some built-in traces are used. Every trace is
+ * replayed with all phases of the scan timer, starting from sleep, so
+ * the EXTI wake-up is included. For each trace the number of press,
+ * repeat and release events and the worst latency of press (from first
+ * closure) and release (from last opening) are printed. A trace fails
+ * if it does not give exactly one press and one release.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <keys_hal.h>
+
+// no NVIC on the PC
+#undef KEYS_HAL_IrqEnable
+#undef KEYS_HAL_IrqDisable
+#define KEYS_HAL_IrqEnable
+#define KEYS_HAL_IrqDisable
+
+#include "../app/src/keys.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACE 4096  ///< Maximum length of trace in ms
+
+static const char* builtinTraces[] = {
+  // clean press
+  "0000011111111111111111111111111111111111111111111111111111111100000000"
+  "0000000000000000000000000000000000000000",
+  // short bounce on press and release
+  "0000010110111111111111111111111111111111111111111111111111111101001000"
+  "0000000000000000000000000000000000000000",
+  // long bounce (worn contact)
+  "0000010101100110111011111111111111111111111111111111111111111111111111"
+  "1111011010100100010000000000000000000000000000000000000000000000000000",
+  // dropout while held
+  "0000011111111111111111111111111111111011111111111111111111111111111111"
+  "1111111111111111000000000000000000000000000000000000000000000000000000",
+  // held long enough to repeat
+  "0000001011111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111111111111111111111111111111111111111111111"
+  "1111111111111111111111111111110100000000000000000000000000000000000000",
+};
+
+static void (*scan)(void);  ///< Scan callback of keys.c
+static uint8_t contact;     ///< Current state of contact
+static uint8_t sleeping;    ///< Scan timer stopped, waiting for EXTI
+
+void KEYS_HAL_Init(uint32_t period, void (*scanCb)(void)) {
+
+  (void)period;
+  scan = scanCb;
+}
+uint16_t KEYS_HAL_ReadMatrix(void) {
+
+  return contact; // key in column 0, row 0
+}
+void KEYS_HAL_Sleep(void) {
+
+  sleeping = 1;
+}
+
+/**
+ * @brief Replays a trace.
+ * @param trace Trace
+ * @param phase Time of first scan in ms
+ * @param counts Number of press, repeat and release events (added to)
+ * @param pressLatency Worst press latency (updated)
+ * @param releaseLatency Worst release latency (updated)
+ */
+static void replay(const char* trace, int phase, int* counts,
+    int* pressLatency, int* releaseLatency) {
+
+  int len = strlen(trace);
+  int firstClosed = strchr(trace, '1') ? strchr(trace, '1') - trace : -1;
+  int lastClosed = strrchr(trace, '1') ? strrchr(trace, '1') - trace : -1;
+  int nextScan = phase;
+  uint8_t id;
+  KEY_Event_Typedef event;
+
+  KEYS_Init();
+  sleeping = 1;
+
+  // run a while after end of trace with contact open
+  for (int t = 0; t < len + 100; t++) {
+
+    contact = (t < len && trace[t] == '1');
+
+    if (sleeping) {
+      if (!contact) {
+        continue;
+      }
+      sleeping = 0; // EXTI restarts timer
+      nextScan = t + KEYS_SCAN_PERIOD;
+    }
+    if (t < nextScan) {
+      continue;
+    }
+    nextScan = t + KEYS_SCAN_PERIOD;
+    scan();
+
+    while (!KEYS_GetEvent(&id, &event)) {
+      counts[event]++;
+      if (event == KEY_EVENT_PRESS && t - firstClosed > *pressLatency) {
+        *pressLatency = t - firstClosed;
+      }
+      if (event == KEY_EVENT_RELEASE && t - lastClosed > *releaseLatency) {
+        *releaseLatency = t - lastClosed;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+
+  static char line[MAX_TRACE + 2];
+  const char* traces[64];
+  int traceCount = 0;
+  int failed = 0;
+
+  if (argc > 1) {
+    FILE* f = fopen(argv[1], "r");
+    if (!f) {
+      perror(argv[1]);
+      return 1;
+    }
+    while (traceCount < 64 && fgets(line, sizeof(line), f)) {
+      line[strcspn(line, "\r\n")] = 0;
+      if (line[0]) {
+        traces[traceCount++] = strdup(line);
+      }
+    }
+    fclose(f);
+  } else {
+    for (; traceCount < (int)(sizeof(builtinTraces) / sizeof(builtinTraces[0]));
+        traceCount++) {
+      traces[traceCount] = builtinTraces[traceCount];
+    }
+  }
+
+  fprintf(stderr, "trace  press repeat release  press[ms] release[ms]\n");
+
+  for (int i = 0; i < traceCount; i++) {
+
+    int pressLatency = 0;
+    int releaseLatency = 0;
+    int result = 1;
+
+    for (int phase = 0; phase < KEYS_SCAN_PERIOD; phase++) {
+      int counts[3] = {0, 0, 0};
+      replay(traces[i], phase, counts, &pressLatency, &releaseLatency);
+      if (counts[KEY_EVENT_PRESS] != 1 || counts[KEY_EVENT_RELEASE] != 1) {
+        result = 0;
+      }
+      if (phase == 0) {
+        fprintf(stderr, "%5d  %5d %6d %7d", i, counts[KEY_EVENT_PRESS],
+            counts[KEY_EVENT_REPEAT], counts[KEY_EVENT_RELEASE]);
+      }
+    }
+    fprintf(stderr, "  %9d %11d  %s\n", pressLatency, releaseLatency,
+        result ? "ok" : "FAILED");
+    failed += !result;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file    kvs_bench.c
+ * @brief   PC benchmark of the key-value store.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs the KVS and FAT modules on the PC, on a card in memory:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o kvs_bench kvs_bench.c ramcard.c \
+ *       ../app/src/kvs.c ../app/src/fat.c ../app/src/bdev.c \
+ *       ../app/src/utils.c ../app/src/crc.c
+ *   ./kvs_bench > /dev/null
+ *
+ * For growing numbers of keys the average commands and time the card
+ * would take (ramcard.h model) of a put, of a put made durable with
+ * KVS_Sync, of a get and of opening the store after a reset are
+ * printed, on the bare card and through the cache and coalescer of
+ * main.c. Debug messages of the modules go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <kvs.h>
+#include <fat.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CARD_SECTORS  20000 ///< Size of card
+#define STORE_BYTES   (KVS_MAX_SEGMENTS * KVS_SEGMENT_SIZE) ///< Size of store file
+#define OVERWRITES    4     ///< Number of times every key is overwritten
+
+static const char* name = "KV      DAT";
+
+/**
+ * @brief System time for fat.c (card time is measured instead).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Overwrites every key.
+ * @param keys Number of keys
+ * @param round Number of round (changes the values)
+ * @param sync Nonzero to make every put durable
+ * @return 0 if written
+ */
+static int overwrite(int keys, int round, int sync) {
+
+  char key[KVS_MAX_KEY + 1];
+  uint8_t value[32];
+
+  for (int i = 0; i < keys; i++) {
+    snprintf(key, sizeof(key), "key/%d", i);
+    memset(value, i + round, sizeof(value));
+    if (KVS_Put(key, value, sizeof(value)) || (sync && KVS_Sync())) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+
+  static const RAMCARD_File card[] = {
+    {"KV      DAT", STORE_BYTES, 0, 0},
+  };
+  char key[KVS_MAX_KEY + 1];
+  uint8_t value[32];
+
+  fprintf(stderr, "%-7s %4s %6s %8s %6s %8s %6s %8s %6s %9s\n", "stack",
+      "keys", "put", "put [ms]", "synced", "put [ms]", "get", "get [ms]",
+      "open", "open [ms]");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    for (int keys = 8; keys <= KVS_MAX_KEYS; keys *= 2) {
+      RAMCARD_Stats put, synced, get;
+      int puts = OVERWRITES * keys;
+
+      RAMCARD_Format(CARD_SECTORS, 8, card, 1);
+      if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers)) || KVS_Open(name) ||
+          overwrite(keys, 0, 0)) {
+        fprintf(stderr, "Cannot fill store\n");
+        return 1;
+      }
+
+      memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+      for (int n = 1; n <= OVERWRITES; n++) {
+        if (overwrite(keys, n, 0)) {
+          fprintf(stderr, "Put failed\n");
+          return 1;
+        }
+      }
+      put = RAMCARD_stats;
+
+      memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+      for (int n = 1; n <= OVERWRITES; n++) {
+        if (overwrite(keys, OVERWRITES + n, 1)) {
+          fprintf(stderr, "Put failed\n");
+          return 1;
+        }
+      }
+      synced = RAMCARD_stats;
+
+      memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+      for (int i = 0; i < keys; i++) {
+        snprintf(key, sizeof(key), "key/%d", i);
+        if (KVS_Get(key, value, sizeof(value)) != sizeof(value) ||
+            value[0] != (uint8_t)(i + 2 * OVERWRITES)) {
+          fprintf(stderr, "Get failed\n");
+          return 1;
+        }
+      }
+      get = RAMCARD_stats;
+
+      // reset, store opened again
+      if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+        fprintf(stderr, "Cannot mount card\n");
+        return 1;
+      }
+      memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+      if (KVS_Open(name)) {
+        fprintf(stderr, "Cannot open store\n");
+        return 1;
+      }
+      RAMCARD_Stats open = RAMCARD_stats;
+      KVS_Close();
+
+      fprintf(stderr, "%-7s %4d %6.2f %8.3f %6.2f %8.3f %6.2f %8.3f %6u "
+          "%9.1f\n", layers ? "cached" : "card", keys,
+          (double)(put.reads + put.writes) / puts,
+          RAMCARD_Time(&put) / puts / 1000,
+          (double)(synced.reads + synced.writes) / puts,
+          RAMCARD_Time(&synced) / puts / 1000,
+          (double)(get.reads + get.writes) / keys,
+          RAMCARD_Time(&get) / keys / 1000, (unsigned)(open.reads + open.writes),
+          RAMCARD_Time(&open) / 1000);
+    }
+  }
+  return 0;
+}
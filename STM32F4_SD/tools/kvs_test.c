@@ -0,0 +1,196 @@
+/**
+ * @file    kvs_test.c
+ * @brief   PC test of the key-value store against a model.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs random puts, deletes, gets and reopens of a store on a
+ * card in memory and compares the store with the same operations on
+ * arrays in RAM:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o kvs_test kvs_test.c ramcard.c \
+ *       ../app/src/kvs.c ../app/src/fat.c ../app/src/bdev.c \
+ *       ../app/src/utils.c ../app/src/crc.c
+ *   ./kvs_test > /dev/null
+ *
+ * Values have random lengths and the store file has few segments, so
+ * compaction runs often, from KVS_Put and from KVS_Update. Half of the
+ * reopens close the store, the other half only call KVS_Sync and then
+ * reset the card, which drops the cache of the block device. After
+ * every reopen all keys must read back as in the model. The test runs
+ * on the bare card and through the cache and coalescer of main.c.
+ * Debug messages of the modules go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <kvs.h>
+#include <fat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CARD_SECTORS  20000 ///< Size of card
+#define STORE_BYTES   (8 * KVS_SEGMENT_SIZE) ///< Size of store file
+#define KEYS          64    ///< Different keys used
+#define MAX_VALUE     64    ///< Longest value
+#define OPS           20000 ///< Random operations
+#define REOPEN        200   ///< One in this many operations reopens the store
+
+static const char* name = "KV      DAT";
+static uint8_t present[KEYS];         ///< Key is in the model
+static uint8_t length[KEYS];          ///< Length of value in the model
+static uint8_t model[KEYS][MAX_VALUE]; ///< Values in the model
+
+/**
+ * @brief System time for fat.c (card time is not measured).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Makes the name of a key.
+ * @param key Buffer for key (function writes this)
+ * @param k Number of key
+ */
+static void keyName(char* key, int k) {
+
+  snprintf(key, KVS_MAX_KEY + 1, "node/%d/value", k);
+}
+/**
+ * @brief Compares one key of the store with the model.
+ * @param k Number of key
+ * @return 0 if equal
+ */
+static int check(int k) {
+
+  char key[KVS_MAX_KEY + 1];
+  uint8_t value[MAX_VALUE];
+
+  keyName(key, k);
+  int len = KVS_Get(key, value, sizeof(value));
+  if (!present[k]) {
+    return len != -1;
+  }
+  return len != length[k] || memcmp(value, model[k], len);
+}
+/**
+ * @brief Resets the card and opens the store again.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @param close Nonzero to close the store, else it is only synchronized
+ * @return Number of keys differing from the model (-1 - not opened)
+ */
+static int reopen(uint8_t layers, int close) {
+
+  int errors = 0;
+
+  if (close ? KVS_Close() : KVS_Sync()) {
+    errors++;
+  }
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers)) || KVS_Open(name)) {
+    return -1;
+  }
+  for (int k = 0; k < KEYS; k++) {
+    errors += check(k);
+  }
+  return errors;
+}
+
+int main(void) {
+
+  static const RAMCARD_File card[] = {
+    {"KV      DAT", STORE_BYTES, 0, 0},
+  };
+  int errors = 0;
+
+  fprintf(stderr, "%d operations on %d keys, store of %d segments\n", OPS,
+      KEYS, STORE_BYTES / KVS_SEGMENT_SIZE);
+  fprintf(stderr, "%-7s %6s %7s %7s %7s %6s\n", "stack", "puts", "deletes",
+      "gets", "reopens", "errors");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    int puts = 0, deletes = 0, gets = 0, reopens = 0, failed = 0;
+    char key[KVS_MAX_KEY + 1];
+    uint8_t value[MAX_VALUE];
+
+    memset(present, 0, sizeof(present));
+    RAMCARD_Format(CARD_SECTORS, 8, card, 1);
+    if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers)) || KVS_Open(name)) {
+      fprintf(stderr, "Cannot open store\n");
+      return 1;
+    }
+    srand(1);
+    for (int op = 0; op < OPS; op++) {
+      int k = rand() % KEYS;
+      int r = rand() % 100;
+
+      keyName(key, k);
+      if (rand() % REOPEN == 0) {
+        int ret = reopen(layers, r & 1);
+        if (ret < 0) {
+          fprintf(stderr, "Cannot open store\n");
+          return 1;
+        }
+        failed += ret;
+        reopens++;
+      } else if (r < 60) {
+        int len = rand() % (MAX_VALUE + 1);
+        for (int i = 0; i < len; i++) {
+          value[i] = rand();
+        }
+        if (KVS_Put(key, value, len)) {
+          failed++;
+          continue;
+        }
+        memcpy(model[k], value, len);
+        length[k] = len;
+        present[k] = 1;
+        puts++;
+      } else if (r < 85) {
+        if (KVS_Delete(key)) {
+          failed++;
+          continue;
+        }
+        present[k] = 0;
+        deletes++;
+      } else if (r < 95) {
+        failed += check(k);
+        gets++;
+      } else {
+        KVS_Update();
+      }
+    }
+    int ret = reopen(layers, 1);
+    failed += ret < 0 ? 1 : ret;
+    KVS_Close();
+    errors += failed;
+
+    fprintf(stderr, "%-7s %6d %7d %7d %7d %6d %s\n", layers ? "cached" : "card",
+        puts, deletes, gets, reopens + 1, failed, failed ? "FAILED" : "ok");
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file    led_sim.c
+ * @brief   PC simulation of LED patterns.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs led.c on the PC with the pattern hardware (step timer,
+ * DMA and PWM timer) simulated, and renders the resulting waveforms:
+ *
+ *   gcc -std=gnu11 -I../app/inc -I../hal/inc -o led_sim led_sim.c
+ *   ./led_sim [WAVES.VCD] > /dev/null
+ *
+ * All patterns and an error code are started on LED0-LED3 in turn. The
+ * brightness (PWM duty averaged over each step) is printed as a strip of
+ * characters, one per step, one line per second. The optional VCD file
+ * gets the PWM outputs of all LEDs with 1 us resolution for the first
+ * two seconds, for viewing in a waveform viewer.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "../app/src/led.c"
+
+#include <stdlib.h>
+
+#define SIM_SECONDS   6     ///< Length of rendered strips
+#define VCD_SECONDS   2     ///< Length of VCD file
+#define PWM_PERIOD_US 1000  ///< PWM period (1MHz timer clock)
+
+static const uint16_t* hwSteps[MAX_LEDS]; ///< Tables read by DMA
+static uint16_t hwCount[MAX_LEDS];        ///< Lengths of tables
+static uint8_t hwPin[MAX_LEDS];           ///< GPIO state when not playing
+
+void LED_HAL_Init(uint8_t led) {
+
+  hwPin[led] = 0;
+}
+void LED_HAL_Toggle(uint8_t led) {
+
+  hwPin[led] ^= 1;
+}
+void LED_HAL_ChangeState(uint8_t led, uint8_t state) {
+
+  hwPin[led] = state;
+}
+void LED_HAL_StartPattern(uint8_t led, const uint16_t* steps, uint16_t count) {
+
+  hwSteps[led] = steps;
+  hwCount[led] = count;
+}
+void LED_HAL_StopPattern(uint8_t led) {
+
+  hwSteps[led] = 0;
+  hwPin[led] = 0;
+}
+
+/**
+ * @brief Gets the duty of a PWM period.
+ * @details The step timer DMA writes the duty register at the start of
+ * every step, the new duty is loaded from the preload register at the
+ * start of the next PWM period.
+ * @param led LED number
+ * @param period Number of PWM period
+ * @return Duty (0 - LED_HAL_PWM_MAX)
+ */
+static uint16_t duty(uint8_t led, uint32_t period) {
+
+  const uint32_t periodsPerStep = LED_HAL_STEP_TIME * 1000 / PWM_PERIOD_US;
+
+  if (!hwSteps[led]) {
+    return hwPin[led] ? LED_HAL_PWM_MAX : 0;
+  }
+  if (period == 0) {
+    return hwSteps[led][0];
+  }
+  return hwSteps[led][((period - 1) / periodsPerStep) % hwCount[led]];
+}
+
+/**
+ * @brief Writes PWM outputs to a VCD file.
+ * @param name File name
+ */
+static void writeVcd(const char* name) {
+
+  FILE* f = fopen(name, "w");
+  uint8_t out[MAX_LEDS];
+
+  if (!f) {
+    perror(name);
+    exit(1);
+  }
+
+  fprintf(f, "$timescale 1us $end\n$scope module leds $end\n");
+  for (int led = 0; led < MAX_LEDS; led++) {
+    fprintf(f, "$var wire 1 %c LED%d $end\n", '!' + led, led);
+    out[led] = 2; // unknown
+  }
+  fprintf(f, "$upscope $end\n$enddefinitions $end\n");
+
+  uint32_t periods = VCD_SECONDS * 1000000 / PWM_PERIOD_US;
+  uint32_t lastTime = 1; // no time written yet
+
+  for (uint32_t p = 0; p < periods; p++) {
+
+    uint32_t start = p * PWM_PERIOD_US;
+    uint16_t d[MAX_LEDS];
+
+    for (int led = 0; led < MAX_LEDS; led++) {
+      d[led] = duty(led, p);
+    }
+    // PWM1 mode: high from start of period until counter reaches duty,
+    // so edges come in order of increasing duty
+    for (uint32_t t = 0; t < PWM_PERIOD_US; t++) {
+      for (int led = 0; led < MAX_LEDS; led++) {
+        uint8_t level = t < d[led];
+        if ((t == 0 || t == d[led]) && level != out[led]) {
+          if (start + t != lastTime) {
+            fprintf(f, "#%u\n", (unsigned int)(start + t));
+            lastTime = start + t;
+          }
+          fprintf(f, "%d%c\n", level, '!' + led);
+          out[led] = level;
+        }
+      }
+    }
+  }
+  fclose(f);
+}
+
+int main(int argc, char** argv) {
+
+  static const char shades[] = " .:-=+*#%@";
+  const uint32_t periodsPerStep = LED_HAL_STEP_TIME * 1000 / PWM_PERIOD_US;
+  const int stepsPerLine = 1000 / LED_HAL_STEP_TIME;
+
+  for (int led = 0; led < MAX_LEDS; led++) {
+    LED_Init(led);
+  }
+  LED_StartPattern(LED0, LED_PATTERN_BLINK);
+  LED_StartPattern(LED1, LED_PATTERN_BREATHE);
+  LED_StartPattern(LED2, LED_PATTERN_HEARTBEAT);
+  LED_ShowError(LED3, 3);
+
+  static const char* names[MAX_LEDS] = {
+    "blink", "breathe", "heartbeat", "error 3"};
+
+  for (int led = 0; led < MAX_LEDS; led++) {
+
+    uint32_t sum = 0;
+
+    fprintf(stderr, "LED%d %s, %u steps:\n", led, names[led],
+        (unsigned int)hwCount[led]);
+
+    for (int step = 0; step < SIM_SECONDS * stepsPerLine; step++) {
+      uint32_t stepSum = 0;
+      for (uint32_t p = 0; p < periodsPerStep; p++) {
+        stepSum += duty(led, step * periodsPerStep + p);
+      }
+      sum += stepSum;
+      uint32_t shade = stepSum * (sizeof(shades) - 2) /
+          (periodsPerStep * LED_HAL_PWM_MAX);
+      fputc(shades[shade], stderr);
+      if ((step + 1) % stepsPerLine == 0) {
+        fputc('\n', stderr);
+      }
+    }
+    fprintf(stderr, "average duty %.1f%%\n\n", 100.0 * sum /
+        (SIM_SECONDS * stepsPerLine * periodsPerStep * LED_HAL_PWM_MAX));
+  }
+
+  if (argc > 1) {
+    writeVcd(argv[1]);
+  }
+  return 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file    mirror_test.c
+ * @brief   PC test of lazy FAT mirroring in FatFs.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs FatFs on a card in memory and checks that both FAT
+ * copies match after every sync, after unmounting, after f_idle and
+ * after a remount following a power cut:
+ *
+ *   gcc -std=gnu11 -O2 -D_FS_LAZYMIRROR=1 -I../app/inc -I../fatfs \
+ *       -o mirror_test mirror_test.c ramcard.c ../app/src/bdev.c \
+ *       ../fatfs/ff.c ../fatfs/diskio.c
+ *   ./mirror_test
+ *
+ * Sector writes to the first and the second FAT are counted for two
+ * sessions. In the first a log is appended while an old file is read,
+ * so a FAT sector is written back for every cluster allocated, and the
+ * log is synchronized every 64 kB. In the second small files are
+ * created and closed one by one, so every file synchronizes the volume
+ * and the clean flag costs more than mirroring saves. Built with
+ * -D_FS_LAZYMIRROR=0 the test shows the writes of immediate mirroring
+ * (the f_idle and power cut checks are then skipped). Power is cut
+ * after every sector written by both sessions.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <ff.h>
+#include <diskio.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CARD_SECTORS  70000 ///< Enough clusters for FatFs to see FAT32
+#define OLD_BYTES     (256 * 1024) ///< Size of file read during logging
+#define CHUNK         1024  ///< Bytes written and read by one call
+#define CHUNKS        512   ///< Chunks appended to log
+#define SYNC_EVERY    64    ///< Chunks between syncs of log
+#define FILES         32    ///< Small files created and closed
+#define FILE_BYTES    2048  ///< Size of small file
+
+static BDEV_Drive drive;    ///< Card with counted writes
+static uint32_t fatBase;    ///< First sector of first FAT
+static uint32_t fatSize;    ///< Sectors of FAT
+static uint32_t fatWrites[2]; ///< Sectors written to first and second FAT
+
+/**
+ * @brief Initializes the card for diskio.c.
+ * @return Always 0
+ */
+uint8_t SD_Init(void) {
+
+  return RAMCARD_Init();
+}
+/**
+ * @brief Time stamp of files for FatFs.
+ * @return 1 January 2014
+ */
+DWORD get_fattime(void) {
+
+  return (DWORD)(2014 - 1980) << 25 | 1 << 21 | 1 << 16;
+}
+/**
+ * @brief Writes sectors of the card counting FAT sectors.
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @return Result of RAMCARD_Write
+ */
+static uint8_t countWrite(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  for (uint32_t s = sector; s < sector + count; s++) {
+    if (s - fatBase < 2 * fatSize) {
+      fatWrites[(s - fatBase) / fatSize]++;
+    }
+  }
+  return RAMCARD_Write(buf, sector, count);
+}
+/**
+ * @brief Formats the card and finds the FATs.
+ */
+static void format(void) {
+
+  static const RAMCARD_File files[] = {
+    {"OLD     DAT", OLD_BYTES, 0, 0},
+  };
+
+  RAMCARD_Format(CARD_SECTORS, 1, files, 1);
+
+  const uint8_t* boot = RAMCARD_Image() + RAMCARD_FAT_START * 512;
+  fatBase = RAMCARD_FAT_START + (boot[14] | boot[15] << 8);
+  fatSize = boot[36] | boot[37] << 8 | boot[38] << 16 | (uint32_t)boot[39] << 24;
+}
+/**
+ * @brief Compares the FAT copies on the card.
+ * @return 0 if they match
+ */
+static int compareFats(void) {
+
+  const uint8_t* fat = RAMCARD_Image() + fatBase * 512;
+
+  return memcmp(fat, fat + fatSize * 512, fatSize * 512) ? 1 : 0;
+}
+/**
+ * @brief Appends to a log while an old file is read.
+ * @details Every cluster of the old file moves the FAT window away from
+ * the sector the log allocates from, so the FAT sector is written back
+ * for every allocation.
+ * @param checkSync Compare the FAT copies after every sync
+ * @return Number of errors
+ */
+static int logSession(int checkSync) {
+
+  static FIL logFile, oldFile;
+  static uint8_t data[CHUNK];
+  UINT n;
+  int errors = 0;
+
+  memset(data, 0x55, sizeof(data));
+  if (f_open(&logFile, "LOG.DAT", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK ||
+      f_open(&oldFile, "OLD.DAT", FA_READ) != FR_OK) {
+    return 1;
+  }
+  for (int i = 0; i < CHUNKS; i++) {
+    f_write(&logFile, data, CHUNK, &n);
+    if (f_eof(&oldFile)) {
+      f_lseek(&oldFile, 0);
+    }
+    f_read(&oldFile, data, CHUNK, &n);
+    if ((i + 1) % SYNC_EVERY == 0) {
+      f_sync(&logFile);
+      if (checkSync && compareFats()) {
+        errors++;
+      }
+    }
+  }
+  f_close(&oldFile);
+  f_close(&logFile);
+  return errors;
+}
+/**
+ * @brief Creates, writes and closes small files.
+ * @details Every file is closed, so every file synchronizes the volume.
+ * @param checkSync Compare the FAT copies after every close
+ * @return Number of errors
+ */
+static int fileSession(int checkSync) {
+
+  static FIL file;
+  static uint8_t data[FILE_BYTES];
+  char name[13];
+  UINT n;
+  int errors = 0;
+
+  for (int i = 0; i < FILES; i++) {
+    sprintf(name, "F%03d.DAT", i);
+    if (f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK ||
+        f_write(&file, data, FILE_BYTES, &n) != FR_OK ||
+        f_close(&file) != FR_OK) {
+      errors++;
+    }
+    if (checkSync && compareFats()) {
+      errors++;
+    }
+  }
+  return errors;
+}
+/**
+ * @brief Runs both sessions.
+ * @param checkSync Compare the FAT copies after every sync
+ * @return Number of errors
+ */
+static int session(int checkSync) {
+
+  return logSession(checkSync) + fileSession(checkSync);
+}
+
+int main(void) {
+
+  static FATFS fs;
+  int errors = 0;
+
+  // sessions, copies checked after every sync and after unmounting
+  format();
+  BDEV_InitDrive(&drive, RAMCARD_Read, countWrite);
+  disk_attach(&drive.dev);
+  if (f_mount(&fs, "", 1) != FR_OK) {
+    fprintf(stderr, "Cannot mount card\n");
+    return 1;
+  }
+  fprintf(stderr, "lazy mirroring %d\n", _FS_LAZYMIRROR);
+  fprintf(stderr, "%-12s %11s %11s %13s %s\n", "session", "FAT1 writes",
+      "FAT2 writes", "all sectors", "copies");
+  for (int s = 0; s < 2; s++) {
+    memset(fatWrites, 0, sizeof(fatWrites));
+    memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+    int sessionErrors = s ? fileSession(1) : logSession(1);
+    f_mount(0, "", 0);
+    sessionErrors += compareFats();
+    f_mount(&fs, "", 1);
+    fprintf(stderr, "%-12s %11u %11u %13u %s\n", s ? "small files" : "log+reader",
+        (unsigned)fatWrites[0], (unsigned)fatWrites[1],
+        (unsigned)RAMCARD_stats.sectorsWritten,
+        sessionErrors ? "DIFFER" : "match");
+    errors += sessionErrors;
+  }
+  f_mount(0, "", 0);
+
+#if _FS_LAZYMIRROR
+  static FIL file;
+  static uint8_t data[4096];
+  UINT n;
+
+  // f_idle mirrors changes not synchronized yet
+  if (f_mount(&fs, "", 1) != FR_OK ||
+      f_open(&file, "IDLE.DAT", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK ||
+      f_write(&file, data, sizeof(data), &n) != FR_OK ||
+      f_lseek(&file, 0) != FR_OK) {
+    errors++;
+  }
+  int before = compareFats();
+  if (f_idle("") != FR_OK || compareFats() || !before) {
+    fprintf(stderr, "f_idle: copies %s before, %s after FAILED\n",
+        before ? "differ" : "match", compareFats() ? "differ" : "match");
+    errors++;
+  } else {
+    fprintf(stderr, "f_idle: copies differ before, match after\n");
+  }
+  f_close(&file);
+  f_mount(0, "", 0);
+
+  // power cut after every written sector, copies repaired on mount
+  format();
+  BDEV_InitDrive(&drive, RAMCARD_Read, countWrite);
+  f_mount(&fs, "", 1);
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  session(0);
+  f_mount(0, "", 0);
+  uint32_t sectors = RAMCARD_stats.sectorsWritten;
+  int failed = 0;
+
+  for (uint32_t cut = 0; cut <= sectors; cut++) {
+    format();
+    f_mount(&fs, "", 1);
+    RAMCARD_CutPower(cut);
+    session(0);
+    f_mount(0, "", 0);
+    RAMCARD_Init(); // reset, mount repairs copies left different
+    if (f_mount(&fs, "", 1) != FR_OK || compareFats()) {
+      failed++;
+    }
+    f_mount(0, "", 0);
+  }
+  fprintf(stderr, "power cut: %u of %u cuts left different copies %s\n",
+      (unsigned)failed, (unsigned)sectors + 1, failed ? "FAILED" : "ok");
+  errors += failed;
+#endif
+
+  return errors ? 1 : 0;
+}
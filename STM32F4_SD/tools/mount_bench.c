@@ -0,0 +1,276 @@
+/**
+ * @file    mount_bench.c
+ * @brief   PC benchmark of mounting with and without a mount snapshot.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Mounts a card in memory after a reset, opens a file and
+ * writes one sector to it, with fat.c and with FatFs:
+ *
+ *   gcc -std=gnu11 -O2 -D_FS_SNAPSHOT=1 -I../app/inc -I../fatfs \
+ *       -o mount_bench mount_bench.c ramcard.c ../app/src/fat.c \
+ *       ../app/src/bdev.c ../app/src/utils.c ../app/src/crc.c \
+ *       ../fatfs/ff.c ../fatfs/diskio.c
+ *   ./mount_bench > /dev/null
+ *
+ * Every reset is run without a snapshot, on the first boot (empty
+ * snapshot memory), after a reset (snapshot kept) and after the card
+ * was swapped (another card ID). The reads of the mount, the time the
+ * card would take to mount (ramcard.h model) and the time to the first
+ * write command are printed. The written file is the last of 40 in the
+ * root directory. fat.c also remembers the directory entries of the
+ * last opened files; FatFs still scans the directory. Debug messages
+ * of fat.c go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <fat.h>
+#include <ff.h>
+#include <diskio.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !_FS_SNAPSHOT
+#error Build the benchmark with -D_FS_SNAPSHOT=1
+#endif
+
+#define CARD_SECTORS  540000 ///< Enough 4 kB clusters for FatFs to see FAT32
+#define FILES         40    ///< Files in root directory, the last one is written
+
+/**
+ * @brief Snapshot state at a reset.
+ */
+typedef enum {
+  SNAP_OFF,       ///< No snapshot memory
+  SNAP_FIRST,     ///< Empty snapshot memory
+  SNAP_RESET,     ///< Snapshot kept from the last mount
+  SNAP_SWAPPED,   ///< Snapshot made for another card
+} Snap;
+
+static const char* snapNames[] = {"off", "first boot", "reset", "card swapped"};
+
+static BDEV_Drive drive;    ///< Card with timed writes
+static double firstWrite;   ///< Card time of first write command in us (-1 - none)
+static uint8_t cardId[16];  ///< ID of card in slot
+static uint8_t fatStore[FAT_SNAPSHOT_SIZE] __attribute__((aligned(4)));
+static uint8_t ffStore[SZ_SNAPSHOT] __attribute__((aligned(4)));
+
+/**
+ * @brief System time for fat.c (card time is measured instead).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Initializes the card for diskio.c.
+ * @return Always 0
+ */
+uint8_t SD_Init(void) {
+
+  return RAMCARD_Init();
+}
+/**
+ * @brief Time stamp of files for FatFs.
+ * @return 1 January 2014
+ */
+DWORD get_fattime(void) {
+
+  return (DWORD)(2014 - 1980) << 25 | 1 << 21 | 1 << 16;
+}
+/**
+ * @brief Reads the ID of the card in the slot.
+ * @param id Card ID (function writes 16 bytes)
+ */
+static void getCardId(uint8_t* id) {
+
+  memcpy(id, cardId, sizeof(cardId));
+}
+/**
+ * @brief Writes sectors of the card noting the first write.
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @return Result of RAMCARD_Write
+ */
+static uint8_t timedWrite(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (firstWrite < 0) {
+    firstWrite = RAMCARD_Time(&RAMCARD_stats);
+  }
+  return RAMCARD_Write(buf, sector, count);
+}
+/**
+ * @brief Formats the card with the files of the benchmark.
+ */
+static void format(void) {
+
+  static char names[FILES][12];
+  static RAMCARD_File files[FILES];
+
+  for (int i = 0; i < FILES; i++) {
+    if (i == FILES - 1) {
+      strcpy(names[i], "LOG     DAT");
+    } else {
+      sprintf(names[i], "FILE%02d  DAT", i);
+    }
+    files[i].name = names[i];
+    files[i].size = 4096;
+  }
+  RAMCARD_Format(CARD_SECTORS, 8, files, FILES);
+}
+/**
+ * @brief Prepares the snapshot memory for a reset.
+ * @param snap Snapshot state
+ */
+static void prepare(Snap snap) {
+
+  memcpy(cardId, "RAMCARD 00000001", sizeof(cardId));
+  switch (snap) {
+  case SNAP_OFF:
+    FAT_SetSnapshot(0, 0);
+    f_setsnapshot(0, 0);
+    return;
+  case SNAP_FIRST:
+    memset(fatStore, 0, sizeof(fatStore));
+    memset(ffStore, 0, sizeof(ffStore));
+    break;
+  case SNAP_SWAPPED:
+    cardId[15] = '2';
+    break;
+  default:
+    break;
+  }
+  FAT_SetSnapshot(fatStore, getCardId);
+  f_setsnapshot(ffStore, getCardId);
+}
+/**
+ * @brief Prints a result row.
+ */
+static void report(const char* fs, Snap snap, const RAMCARD_Stats* mount,
+    const RAMCARD_Stats* beforeWrite, int errors) {
+
+  fprintf(stderr, "%-6s %-13s %11u %10.0f %12u %15.0f %s\n", fs,
+      snapNames[snap], (unsigned)mount->reads, RAMCARD_Time(mount),
+      (unsigned)beforeWrite->reads, firstWrite, errors ? "FAILED" : "ok");
+}
+/**
+ * @brief Resets, mounts with fat.c and writes a sector.
+ * @param snap Snapshot state
+ * @return Number of errors
+ */
+static int runFat(Snap snap) {
+
+  static uint8_t data[512];
+  RAMCARD_Stats mount, beforeWrite;
+  int errors = 0;
+
+  prepare(snap);
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  firstWrite = -1;
+  if (FAT_Init(RAMCARD_Init, &drive.dev)) {
+    return 1;
+  }
+  mount = RAMCARD_stats;
+
+  int file = FAT_OpenFile("LOG     DAT");
+  beforeWrite = RAMCARD_stats;
+  if (file < 0 || FAT_WriteFile(file, data, sizeof(data)) != sizeof(data) ||
+      FAT_CloseFile(file)) {
+    errors++;
+  }
+  if (firstWrite < 0) {
+    errors++;
+  }
+  FAT_Stats stats;
+  FAT_GetStats(&stats);
+  if (stats.snapshotUsed != (snap == SNAP_RESET)) {
+    errors++;
+  }
+  report("fat.c", snap, &mount, &beforeWrite, errors);
+  return errors;
+}
+/**
+ * @brief Resets, mounts with FatFs and writes a sector.
+ * @param snap Snapshot state
+ * @return Number of errors
+ */
+static int runFatFs(Snap snap) {
+
+  static FATFS fs;
+  static FIL fp;
+  static uint8_t data[512];
+  static uint32_t fullReads; // reads of a mount without a snapshot
+  RAMCARD_Stats mount, beforeWrite;
+  UINT n;
+  int errors = 0;
+
+  prepare(snap);
+  disk_attach(&drive.dev);
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+  firstWrite = -1;
+  if (f_mount(&fs, "", 1) != FR_OK) {
+    return 1;
+  }
+  mount = RAMCARD_stats;
+  if (snap == SNAP_OFF) {
+    fullReads = mount.reads;
+  } else if ((snap == SNAP_RESET) != (mount.reads < fullReads)) {
+    errors++; // snapshot used when it should not be or not used
+  }
+
+  FRESULT res = f_open(&fp, "LOG.DAT", FA_WRITE);
+  beforeWrite = RAMCARD_stats;
+  if (res != FR_OK || f_write(&fp, data, sizeof(data), &n) != FR_OK ||
+      f_close(&fp) != FR_OK) {
+    errors++;
+  }
+  if (firstWrite < 0) {
+    errors++;
+  }
+  f_mount(0, "", 0);
+  report("FatFs", snap, &mount, &beforeWrite, errors);
+  return errors;
+}
+
+int main(void) {
+
+  int errors = 0;
+
+  format();
+  BDEV_InitDrive(&drive, RAMCARD_Read, timedWrite);
+
+  fprintf(stderr, "%-6s %-13s %11s %10s %12s %15s\n", "fs", "snapshot",
+      "mount reads", "mount [us]", "reads before", "1st write [us]");
+  for (Snap snap = SNAP_OFF; snap <= SNAP_SWAPPED; snap++) {
+    errors += runFat(snap);
+  }
+  for (Snap snap = SNAP_OFF; snap <= SNAP_SWAPPED; snap++) {
+    errors += runFatFs(snap);
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file    pack_bench.c
+ * @brief   PC benchmark of sample block compression.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Compresses sample traces in blocks of PACK_MAX_SAMPLES,
+ * checks that every block decompresses to the same samples and prints
+ * the compression ratio and the time per input byte:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o pack_bench pack_bench.c \
+ *       ../app/src/pack.c ../app/src/crc.c -lm
+ *   ./pack_bench [TRACE CHANNELS]
+ *
+ * Without arguments synthetic traces resembling typical sensors are
+ * used. A TRACE file holds raw 16-bit little endian samples of
+ * CHANNELS interleaved channels (e.g. an earlier uncompressed log).
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <pack.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define TRACE_SAMPLES (64 * PACK_MAX_SAMPLES) ///< Length of synthetic traces
+#define REPEATS       10  ///< Runs over trace for timing
+
+static int16_t trace[TRACE_SAMPLES];  ///< Trace being compressed
+
+/**
+ * @brief Returns monotonic time.
+ * @return Time in ns
+ */
+static double now(void) {
+
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+/**
+ * @brief Returns gaussian noise.
+ * @param sigma Standard deviation
+ */
+static double noise(double sigma) {
+
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+/**
+ * @brief Compresses a trace and prints results.
+ * @param name Name of trace
+ * @param count Number of samples
+ * @param channels Number of channels
+ * @return Nonzero if a block did not decompress correctly
+ */
+static int bench(const char* name, int count, int channels) {
+
+  static uint8_t packed[PACK_MAX_PACKED(PACK_MAX_SAMPLES)];
+  static int16_t samples[PACK_MAX_SAMPLES];
+  int block = PACK_MAX_SAMPLES / channels * channels;
+  long total = 0;
+  int largest = -2 * PACK_MAX_SAMPLES; // largest growth of block
+  double packTime = 0;
+  double unpackTime = 0;
+
+  for (int r = 0; r < REPEATS; r++) {
+    for (int i = 0; i < count; i += block) {
+
+      int n = (count - i < block) ? count - i : block;
+      double start = now();
+      int len = PACK_Compress(trace + i, n, channels, packed);
+      packTime += now() - start;
+
+      start = now();
+      int m = PACK_Decompress(packed, len, samples, PACK_MAX_SAMPLES);
+      unpackTime += now() - start;
+
+      if (m != n || memcmp(samples, trace + i, 2 * n)) {
+        fprintf(stderr, "%s: block at %d damaged\n", name, i);
+        return 1;
+      }
+      if (r == 0) {
+        total += len;
+        if (len - 2 * n > largest) {
+          largest = len - 2 * n;
+        }
+      }
+    }
+  }
+
+  double bytes = 2.0 * count * REPEATS;
+  fprintf(stderr, "%-14s %2d  %6.2f  %+5d  %8.2f  %8.2f\n", name, channels,
+      2.0 * count / total, largest, packTime / bytes, unpackTime / bytes);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+
+  int failed = 0;
+
+  fprintf(stderr, "trace          ch   ratio  worst  pack[ns/B] unpack[ns/B]\n");
+
+  if (argc == 3) {
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+      perror(argv[1]);
+      return 1;
+    }
+    int count = fread(trace, 2, TRACE_SAMPLES, f);
+    fclose(f);
+    return bench(argv[1], count, atoi(argv[2]));
+  }
+
+  srand(1);
+
+  // temperature: slow drift, little noise
+  for (int i = 0; i < TRACE_SAMPLES; i++) {
+    trace[i] = lrint(2500 + 300 * sin(i * 1e-4) + noise(1.5));
+  }
+  failed |= bench("temperature", TRACE_SAMPLES, 1);
+
+  // 3-axis accelerometer: gravity, vibration and noise
+  for (int i = 0; i + 3 <= TRACE_SAMPLES; i += 3) {
+    double vib = 400 * sin(i * 0.07);
+    trace[i] = lrint(vib + noise(20));
+    trace[i + 1] = lrint(0.5 * vib + noise(20));
+    trace[i + 2] = lrint(16384 + 0.2 * vib + noise(20));
+  }
+  failed |= bench("accelerometer", TRACE_SAMPLES / 3 * 3, 3);
+
+  // 8 channels of 12-bit ADC, slowly changing inputs
+  for (int i = 0; i < TRACE_SAMPLES; i++) {
+    int c = i % 8;
+    trace[i] = lrint(2048 + 1500 * sin(i * 1e-3 * (c + 1) / 8 + c) + noise(2)) & 0xfff;
+  }
+  failed |= bench("adc 12-bit", TRACE_SAMPLES, 8);
+
+  // audio: tones and noise at high level
+  for (int i = 0; i < TRACE_SAMPLES; i++) {
+    trace[i] = lrint(8000 * sin(i * 0.05) + 3000 * sin(i * 0.31) + noise(200));
+  }
+  failed |= bench("audio", TRACE_SAMPLES, 1);
+
+  // worst case: white noise over full range
+  for (int i = 0; i < TRACE_SAMPLES; i++) {
+    trace[i] = rand();
+  }
+  failed |= bench("white noise", TRACE_SAMPLES, 1);
+
+  return failed;
+}
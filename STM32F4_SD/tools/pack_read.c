@@ -0,0 +1,94 @@
+/**
+ * @file    pack_read.c
+ * @brief   PC tool decompressing a file of sample blocks.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Build and run on the PC with the file copied from the card:
+ *
+ *   gcc -I../app/inc -o pack_read pack_read.c ../app/src/pack.c \
+ *       ../app/src/crc.c
+ *   ./pack_read SAMPLES.DAT > samples.csv
+ *
+ * The file holds blocks written one after another as returned by
+ * PACK_Compress. Samples are printed one line per time step, channels
+ * separated by commas. A damaged block is reported and skipped by
+ * searching for the next block header, the rest of the file is still
+ * read. The compression ratio is printed at the end.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <pack.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv) {
+
+  static int16_t samples[PACK_MAX_SAMPLES];
+  long samplesRead = 0;
+  int blocks = 0;
+  int damaged = 0;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s FILE\n", argv[0]);
+    return 1;
+  }
+
+  FILE* f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t* data = malloc(size);
+  if (!data || fread(data, size, 1, f) != 1) {
+    fprintf(stderr, "Cannot read file\n");
+    return 1;
+  }
+  fclose(f);
+
+  long pos = 0;
+  while (pos + (long)sizeof(PACK_Header) <= size) {
+
+    PACK_Header hdr;
+    memcpy(&hdr, data + pos, sizeof(PACK_Header));
+
+    int count = PACK_Decompress(data + pos, size - pos, samples,
+        PACK_MAX_SAMPLES);
+    if (count < 0) {
+      // look for next header
+      if (hdr.magic == PACK_MAGIC) {
+        fprintf(stderr, "Damaged block at offset %ld\n", pos);
+        damaged++;
+      }
+      pos++;
+      continue;
+    }
+
+    for (int i = 0; i < count; i += hdr.channels) {
+      for (int c = 0; c < hdr.channels; c++) {
+        printf(c ? ",%d" : "%d", samples[i + c]);
+      }
+      printf("\n");
+    }
+    samplesRead += count;
+    blocks++;
+    pos += sizeof(PACK_Header) + hdr.length;
+  }
+
+  fprintf(stderr, "%d blocks, %ld samples, %d damaged, ratio %.2f\n",
+      blocks, samplesRead, damaged, size ? 2.0 * samplesRead / size : 0);
+  return damaged ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file    powercut_test.c
+ * @brief   PC test of data lost by fat.c when power is cut.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Appends records to two files in turns on a card in memory,
+ * cutting power after every number of written sectors, then mounts the
+ * card again and checks what the directory entries cover:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o powercut_test powercut_test.c \
+ *       ramcard.c ../app/src/fat.c ../app/src/bdev.c ../app/src/utils.c \
+ *       ../app/src/crc.c
+ *   ./powercut_test > /dev/null
+ *
+ * Data covered by a file size must be the data written, and the bytes
+ * written before the cut but not covered must stay below the byte
+ * threshold of FAT_SetSyncPolicy for both files together. The test
+ * runs on the bare card and through the cache and coalescer of main.c
+ * and prints the worst loss with the directory writes and the write
+ * amplification of a run without a cut. Debug messages of fat.c go to
+ * stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <fat.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CARD_SECTORS  20000 ///< Size of card
+#define FILES         2     ///< Files written in turns
+#define RECORD        100   ///< Bytes written by one call
+#define RECORDS       400   ///< Records written to all files
+#define SYNC_BYTES    4096  ///< Byte threshold of sync policy
+
+static const char* names[FILES] = {"A       DAT", "B       DAT"};
+
+/**
+ * @brief System time for fat.c (time threshold is not used).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Returns a byte written to a file.
+ * @param file File number
+ * @param pos Position in file
+ * @return Byte
+ */
+static uint8_t pattern(int file, uint32_t pos) {
+
+  return (uint8_t)(pos * 7 + pos / 251 + file * 101);
+}
+/**
+ * @brief Formats the card and mounts it.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @param files IDs of opened files (function writes this)
+ * @return 0 if mounted
+ */
+static int start(uint8_t layers, int* files) {
+
+  static const RAMCARD_File card[FILES] = {
+    {"A       DAT", 0, 0, 64 * 1024},
+    {"B       DAT", 0, 0, 64 * 1024},
+  };
+
+  RAMCARD_Format(CARD_SECTORS, 8, card, FILES);
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+    return -1;
+  }
+  FAT_SetSyncPolicy(SYNC_BYTES, 0);
+  for (int f = 0; f < FILES; f++) {
+    files[f] = FAT_OpenFile(names[f]);
+    if (files[f] < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Appends the records.
+ * @param files IDs of opened files
+ * @param acked Bytes written to files before power was cut (function writes this)
+ */
+static void append(const int* files, uint32_t* acked) {
+
+  uint8_t record[RECORD];
+
+  memset(acked, 0, FILES * sizeof(*acked));
+  for (int r = 0; r < RECORDS; r++) {
+    int f = r % FILES;
+    uint32_t pos = r / FILES * RECORD;
+
+    for (int i = 0; i < RECORD; i++) {
+      record[i] = pattern(f, pos + i);
+    }
+    int len = FAT_WriteFile(files[f], record, RECORD);
+    if (!RAMCARD_PowerLost()) {
+      acked[f] += len;
+    }
+  }
+}
+/**
+ * @brief Mounts the card after a reset and checks the files.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @param acked Bytes written to files before power was cut
+ * @param lost Bytes lost from all files (function writes this)
+ * @return Number of errors
+ */
+static int check(uint8_t layers, const uint32_t* acked, uint32_t* lost) {
+
+  static uint8_t data[RECORDS * RECORD];
+  int errors = 0;
+
+  *lost = 0;
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+    return 1;
+  }
+  for (int f = 0; f < FILES; f++) {
+    int file = FAT_OpenFile(names[f]);
+    if (file < 0) {
+      return 1;
+    }
+    uint32_t size = FAT_GetFileSize(file);
+    if (size > 0 && FAT_ReadFile(file, data, size) != (int)size) {
+      errors++;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      if (data[i] != pattern(f, i)) { // size ran ahead of data
+        errors++;
+        break;
+      }
+    }
+    if (size < acked[f]) {
+      *lost += acked[f] - size;
+    }
+    FAT_CloseFile(file);
+  }
+  return errors;
+}
+
+int main(void) {
+
+  int files[FILES];
+  uint32_t acked[FILES];
+  int errors = 0;
+
+  fprintf(stderr, "%d records of %d bytes to %d files, %d bytes threshold\n",
+      RECORDS, RECORD, FILES, SYNC_BYTES);
+  fprintf(stderr, "%-7s %8s %8s %8s %10s %9s\n", "stack", "cuts", "failed",
+      "max lost", "dir writes", "write amp");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    FAT_Stats stats;
+    uint32_t lost, maxLost = 0;
+    int failed = 0;
+
+    // run without a cut to count written sectors
+    if (start(layers, files)) {
+      fprintf(stderr, "Cannot mount card\n");
+      return 1;
+    }
+    FAT_ResetStats();
+    memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+    append(files, acked);
+    for (int f = 0; f < FILES; f++) {
+      FAT_CloseFile(files[f]);
+    }
+    FAT_GetStats(&stats);
+    uint32_t sectors = RAMCARD_stats.sectorsWritten;
+
+    for (uint32_t cut = 0; cut <= sectors; cut++) {
+      int cutErrors = 0;
+
+      if (start(layers, files)) {
+        fprintf(stderr, "Cannot mount card\n");
+        return 1;
+      }
+      RAMCARD_CutPower(cut);
+      append(files, acked);
+      cutErrors = check(layers, acked, &lost);
+      if (lost >= SYNC_BYTES) {
+        cutErrors++;
+      }
+      if (lost > maxLost) {
+        maxLost = lost;
+      }
+      if (cutErrors) {
+        failed++;
+      }
+    }
+    errors += failed;
+
+    fprintf(stderr, "%-7s %8u %8d %8u %10u %9.2f %s\n",
+        layers ? "cached" : "card", (unsigned)sectors + 1, failed,
+        (unsigned)maxLost, (unsigned)stats.dirWrites,
+        (double)sectors * 512 / stats.bytesWritten,
+        failed ? "FAILED" : "ok");
+  }
+
+  return errors ? 1 : 0;
+}
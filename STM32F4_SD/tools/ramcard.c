@@ -0,0 +1,331 @@
+/**
+ * @file    ramcard.c
+ * @brief   Card in PC memory for the PC tools.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Formats a FAT32 volume in memory with preallocated files,
+ * so that fat.c (which does not allocate clusters) and FatFs can be
+ * run on the PC. The volume starts at RAMCARD_FAT_START after an MBR,
+ * the root directory is cluster 2 and files follow it. A file may be
+ * split into fragments separated by free clusters of the same length.
+ * Commands and sectors are counted and the time the card would take
+ * is estimated from them. RAMCARD_Device stacks the block device
+ * layers of main.c over the card. Power may be cut after a number of
+ * written sectors: later writes are lost until the card is initialized
+ * again, like after a reset.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RESERVED_SECTORS 32 ///< Sectors before the first FAT
+
+RAMCARD_Stats RAMCARD_stats;
+
+static uint8_t* image;          ///< Card contents
+static uint32_t imageSectors;   ///< Size of card in sectors
+static uint32_t powerLeft;      ///< Sectors written before power is cut
+static uint8_t powerArmed;      ///< Power will be cut
+static uint8_t powerLost;       ///< Power was cut
+static uint32_t rootSector;     ///< First sector of root directory
+
+static BDEV_Drive drive;                ///< Card as block device
+static BDEV_Coalescer coalescer;        ///< Merges writes of consecutive sectors
+static uint8_t coalescerBuf[RAMCARD_COALESCE * BDEV_SECTOR_SIZE];
+static BDEV_Cache cache;                ///< Keeps FAT and directory sectors
+static BDEV_CacheLine cacheLines[RAMCARD_CACHE_LINES];
+static uint8_t cacheData[RAMCARD_CACHE_LINES * BDEV_SECTOR_SIZE];
+
+static void put16(uint8_t* p, uint16_t v);
+static void put32(uint8_t* p, uint32_t v);
+
+/**
+ * @brief Formats the card.
+ * @param sectors Size of card in sectors (over 66000 clusters
+ * are needed for FatFs to see FAT32)
+ * @param sectorsPerCluster Sectors in cluster
+ * @param files Files to create in the root directory
+ * @param count Number of files (at most 16 per sector of cluster)
+ */
+void RAMCARD_Format(uint32_t sectors, uint8_t sectorsPerCluster,
+    const RAMCARD_File* files, int count) {
+
+  uint32_t partSectors = sectors - RAMCARD_FAT_START;
+  uint32_t fatSectors = 1;
+  uint32_t clusters;
+
+  // FAT size depends on number of clusters which depends on FAT size
+  for (;;) {
+    clusters = (partSectors - RESERVED_SECTORS - 2 * fatSectors) /
+        sectorsPerCluster;
+    uint32_t needed = ((clusters + 2) * 4 + 511) / 512;
+    if (needed <= fatSectors) {
+      break;
+    }
+    fatSectors = needed;
+  }
+
+  free(image);
+  image = calloc(sectors, 512);
+  if (!image) {
+    fprintf(stderr, "No memory for card\n");
+    exit(1);
+  }
+  imageSectors = sectors;
+
+  // MBR with one partition
+  uint8_t* mbr = image;
+  mbr[446 + 4] = 0x0c; // FAT32 LBA
+  put32(mbr + 446 + 8, RAMCARD_FAT_START);
+  put32(mbr + 446 + 12, partSectors);
+  put16(mbr + 510, 0xaa55);
+
+  // boot sector, its backup and FSInfo
+  uint8_t* boot = image + RAMCARD_FAT_START * 512;
+  boot[0] = 0xeb;
+  boot[1] = 0x58;
+  boot[2] = 0x90;
+  memcpy(boot + 3, "RAMCARD ", 8);
+  put16(boot + 11, 512);
+  boot[13] = sectorsPerCluster;
+  put16(boot + 14, RESERVED_SECTORS);
+  boot[16] = 2;
+  boot[21] = 0xf8;
+  put32(boot + 28, RAMCARD_FAT_START);
+  put32(boot + 32, partSectors);
+  put32(boot + 36, fatSectors);
+  put32(boot + 44, 2);
+  put16(boot + 48, 1);
+  put16(boot + 50, 6);
+  boot[64] = 0x80;
+  boot[66] = 0x29;
+  put32(boot + 67, 2014);
+  memcpy(boot + 71, "NO NAME    ", 11);
+  memcpy(boot + 82, "FAT32   ", 8);
+  put16(boot + 510, 0xaa55);
+  memcpy(boot + 6 * 512, boot, 512);
+
+  uint8_t* info = boot + 512;
+  put32(info, 0x41615252);
+  put32(info + 484, 0x61417272);
+  put32(info + 488, 0xffffffff);
+  put32(info + 492, 0xffffffff);
+  put16(info + 510, 0xaa55);
+
+  uint8_t* fat = boot + RESERVED_SECTORS * 512;
+  uint32_t dataStart = RAMCARD_FAT_START + RESERVED_SECTORS + 2 * fatSectors;
+  rootSector = dataStart;
+
+  put32(fat, 0x0ffffff8);
+  put32(fat + 4, 0x0fffffff);
+  put32(fat + 8, 0x0fffffff); // root directory
+
+  // files one after another, fragments separated by free clusters
+  uint32_t next = 3;
+  uint8_t* dir = image + rootSector * 512;
+  for (int i = 0; i < count; i++) {
+    uint32_t bytes = (files[i].allocated > files[i].size) ?
+        files[i].allocated : files[i].size;
+    uint32_t need = (bytes + sectorsPerCluster * 512 - 1) /
+        (sectorsPerCluster * 512);
+    uint32_t first = need ? next : 0;
+    uint32_t prev = 0;
+    uint32_t inFragment = 0;
+
+    for (uint32_t n = 0; n < need; n++) {
+      if (files[i].fragment && inFragment == files[i].fragment) {
+        next += files[i].fragment;
+        inFragment = 0;
+      }
+      if (next >= clusters + 2) {
+        fprintf(stderr, "Card too small for files\n");
+        exit(1);
+      }
+      if (prev) {
+        put32(fat + prev * 4, next);
+      }
+      put32(fat + next * 4, 0x0fffffff);
+      prev = next++;
+      inFragment++;
+    }
+    if (files[i].fragment) { // gap after the last fragment too
+      next += files[i].fragment;
+    }
+
+    uint8_t* entry = dir + i * 32;
+    memcpy(entry, files[i].name, 11);
+    entry[11] = 0x20;
+    put16(entry + 20, first >> 16);
+    put16(entry + 26, first & 0xffff);
+    put32(entry + 28, files[i].size);
+  }
+  memcpy(fat + fatSectors * 512, fat, fatSectors * 512);
+
+  powerArmed = powerLost = 0;
+  memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+}
+/**
+ * @brief Initializes the card (physical layer init), restoring power.
+ * @return Always 0
+ */
+uint8_t RAMCARD_Init(void) {
+
+  powerArmed = powerLost = 0;
+  return 0;
+}
+/**
+ * @brief Builds a block device stack over the card.
+ * @details Layers keep nothing from an earlier stack, like after a reset.
+ * @param layers Nonzero for the cache and coalescer of main.c,
+ * zero for the bare card
+ * @return Top of stack
+ */
+BDEV_Device* RAMCARD_Device(uint8_t layers) {
+
+  BDEV_InitDrive(&drive, RAMCARD_Read, RAMCARD_Write);
+  if (!layers) {
+    return &drive.dev;
+  }
+  BDEV_InitCoalescer(&coalescer, &drive.dev, coalescerBuf, RAMCARD_COALESCE);
+  BDEV_InitCache(&cache, &coalescer.dev, cacheLines, cacheData,
+      RAMCARD_CACHE_LINES);
+  return &cache.dev;
+}
+/**
+ * @brief Reads sectors of the card.
+ * @param buf Buffer
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors read
+ * @retval 1 Sectors out of card
+ */
+uint8_t RAMCARD_Read(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (sector + count > imageSectors) {
+    return 1;
+  }
+  RAMCARD_stats.reads++;
+  RAMCARD_stats.sectorsRead += count;
+  memcpy(buf, image + sector * 512L, count * 512);
+  return 0;
+}
+/**
+ * @brief Writes sectors of the card.
+ * @details After power is cut the command seems to succeed,
+ * but nothing is stored.
+ * @param buf Data
+ * @param sector First sector
+ * @param count Number of sectors
+ * @retval 0 Sectors written
+ * @retval 1 Sectors out of card
+ */
+uint8_t RAMCARD_Write(uint8_t* buf, uint32_t sector, uint32_t count) {
+
+  if (sector + count > imageSectors) {
+    return 1;
+  }
+  RAMCARD_stats.writes++;
+  RAMCARD_stats.sectorsWritten += count;
+  for (uint32_t i = 0; i < count; i++) {
+    if (powerArmed) {
+      if (powerLeft == 0) {
+        powerLost = 1;
+        return 0;
+      }
+      powerLeft--;
+    }
+    memcpy(image + (sector + i) * 512L, buf + i * 512, 512);
+  }
+  return 0;
+}
+/**
+ * @brief Cuts power after a number of written sectors.
+ * @param sectors Sectors still written
+ */
+void RAMCARD_CutPower(uint32_t sectors) {
+
+  powerArmed = 1;
+  powerLeft = sectors;
+  powerLost = 0;
+}
+/**
+ * @brief Checks if power was cut.
+ * @return Nonzero if writes were lost
+ */
+uint8_t RAMCARD_PowerLost(void) {
+
+  return powerLost;
+}
+/**
+ * @brief Returns contents of the card.
+ * @return Card image
+ */
+uint8_t* RAMCARD_Image(void) {
+
+  return image;
+}
+/**
+ * @brief Returns size of the card.
+ * @return Size in sectors
+ */
+uint32_t RAMCARD_Size(void) {
+
+  return imageSectors;
+}
+/**
+ * @brief Finds the first cluster of a file in the root directory.
+ * @param name 8.3 name padded to 11 characters
+ * @return First cluster (0 - not found)
+ */
+uint32_t RAMCARD_Cluster(const char* name) {
+
+  const uint8_t* entry = image + rootSector * 512;
+
+  for (; entry[0]; entry += 32) {
+    if (memcmp(entry, name, 11) == 0) {
+      return (entry[20] | entry[21] << 8) << 16 | entry[26] | entry[27] << 8;
+    }
+  }
+  return 0;
+}
+/**
+ * @brief Estimates the time the card takes.
+ * @param stats Commands and sectors
+ * @return Time in us
+ */
+double RAMCARD_Time(const RAMCARD_Stats* stats) {
+
+  return (double)(stats->reads + stats->writes) * RAMCARD_CMD_US +
+      (double)(stats->sectorsRead + stats->sectorsWritten) * RAMCARD_SECTOR_US;
+}
+/**
+ * @brief Stores a little endian 16-bit value.
+ */
+static void put16(uint8_t* p, uint16_t v) {
+
+  p[0] = v;
+  p[1] = v >> 8;
+}
+/**
+ * @brief Stores a little endian 32-bit value.
+ */
+static void put32(uint8_t* p, uint32_t v) {
+
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
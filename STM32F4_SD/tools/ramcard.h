@@ -0,0 +1,65 @@
+/**
+ * @file    ramcard.h
+ * @brief   Card in PC memory for the PC tools.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#ifndef RAMCARD_H_
+#define RAMCARD_H_
+
+#include <inttypes.h>
+#include <bdev.h>
+
+#define RAMCARD_FAT_START   64  ///< First sector of the FAT32 volume
+#define RAMCARD_CMD_US      300 ///< Modelled latency of a card command [us]
+#define RAMCARD_SECTOR_US   195 ///< Modelled transfer of a sector [us] (SPI at 21 MHz)
+#define RAMCARD_CACHE_LINES 8   ///< Sectors in block device cache (as in main.c)
+#define RAMCARD_COALESCE    8   ///< Largest write merged by coalescer (as in main.c)
+
+/**
+ * @brief File created when formatting.
+ */
+typedef struct {
+  const char* name;     ///< 8.3 name padded to 11 characters ("NAME    EXT")
+  uint32_t size;        ///< Size in bytes, clusters are allocated for all of it
+  uint32_t fragment;    ///< Clusters in each fragment, followed by as many free ones (0 - contiguous)
+  uint32_t allocated;   ///< Bytes of clusters allocated if more than size (for appending)
+} RAMCARD_File;
+
+/**
+ * @brief Access statistics.
+ */
+typedef struct {
+  uint32_t reads;           ///< Read commands
+  uint32_t writes;          ///< Write commands
+  uint32_t sectorsRead;     ///< Sectors read
+  uint32_t sectorsWritten;  ///< Sectors written
+} RAMCARD_Stats;
+
+extern RAMCARD_Stats RAMCARD_stats; ///< Statistics since format or last clear
+
+void      RAMCARD_Format(uint32_t sectors, uint8_t sectorsPerCluster,
+    const RAMCARD_File* files, int count);
+uint8_t   RAMCARD_Init(void);
+BDEV_Device* RAMCARD_Device(uint8_t layers);
+uint8_t   RAMCARD_Read(uint8_t* buf, uint32_t sector, uint32_t count);
+uint8_t   RAMCARD_Write(uint8_t* buf, uint32_t sector, uint32_t count);
+void      RAMCARD_CutPower(uint32_t sectors);
+uint8_t   RAMCARD_PowerLost(void);
+uint8_t*  RAMCARD_Image(void);
+uint32_t  RAMCARD_Size(void);
+uint32_t  RAMCARD_Cluster(const char* name);
+double    RAMCARD_Time(const RAMCARD_Stats* stats);
+
+#endif /* RAMCARD_H_ */
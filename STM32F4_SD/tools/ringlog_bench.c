@@ -0,0 +1,276 @@
+/**
+ * @file    ringlog_bench.c
+ * @brief   PC benchmark of appending to and recovering the circular log.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Appends records to a log in a preallocated file on a card in
+ * memory until it wraps several times, cutting power after every
+ * written sector, then opens the log again:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o ringlog_bench ringlog_bench.c \
+ *       ramcard.c ../app/src/ringlog.c ../app/src/fat.c ../app/src/bdev.c \
+ *       ../app/src/utils.c ../app/src/crc.c
+ *   ./ringlog_bench > /dev/null
+ *
+ * After every cut the header on the card is checked as ringlog_read.c
+ * sees it before any recovery: every block from its oldestSeq to its
+ * nextSeq must still be in the file, not overwritten by a newer one.
+ * Then RINGLOG_Open recovers the log and every block it counts as
+ * valid must be readable, the records must follow one another and at
+ * most the blocks in RAM may be lost. Commands, sectors and the time
+ * the card would take (ramcard.h model) of appending without a cut and
+ * the worst recovery are printed, on the bare card and through the
+ * cache and coalescer of main.c. Debug messages go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <ringlog.h>
+#include <fat.h>
+#include <crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#define CARD_SECTORS  20000 ///< Size of card
+#define LOG_BYTES     (128 * 1024) ///< Size of log file
+#define RECORD        40    ///< Bytes of record
+#define WRAPS         3     ///< Times the log is filled
+#define PER_BLOCK     (RINGLOG_PAYLOAD / (RECORD + 2)) ///< Records in block
+
+static const char* name = "LOG     DAT";
+static RINGLOG_TypeDef ringLog;
+
+/**
+ * @brief System time for fat.c (card time is measured instead).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Returns the number of records appended in a run.
+ */
+static uint32_t records(void) {
+
+  return (LOG_BYTES / RINGLOG_BLOCK_SIZE - RINGLOG_HEADER_BLOCKS) * WRAPS *
+      PER_BLOCK;
+}
+/**
+ * @brief Formats the card and opens the log.
+ * @param layers Nonzero for the cache and coalescer of main.c
+ * @return 0 if opened
+ */
+static int start(uint8_t layers) {
+
+  static const RAMCARD_File card[] = {
+    {"LOG     DAT", LOG_BYTES, 0, 0},
+  };
+
+  RAMCARD_Format(CARD_SECTORS, 8, card, 1);
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+    return -1;
+  }
+  return RINGLOG_Open(&ringLog, name);
+}
+/**
+ * @brief Appends the records.
+ * @return Records appended before power was cut
+ */
+static uint32_t append(void) {
+
+  uint8_t record[RECORD];
+  uint32_t acked = 0;
+
+  memset(record, 0x55, sizeof(record));
+  for (uint32_t r = 0; r < records(); r++) {
+    memcpy(record, &r, sizeof(r));
+    if (RINGLOG_Append(&ringLog, record, RECORD) == 0 && !RAMCARD_PowerLost()) {
+      acked = r + 1;
+    }
+  }
+  return acked;
+}
+/**
+ * @brief Checks a data block read from the file.
+ * @param block Block
+ * @param seq Expected sequence number
+ * @return 0 if valid
+ */
+static int checkBlock(uint8_t* block, uint32_t seq) {
+
+  RINGLOG_BlockHeader* hdr = (RINGLOG_BlockHeader*)block;
+
+  return hdr->seq != seq || hdr->used > RINGLOG_PAYLOAD || hdr->checksum !=
+      CRC_Update(CRC_Calc(block, offsetof(RINGLOG_BlockHeader, checksum)),
+      block + sizeof(RINGLOG_BlockHeader), hdr->used);
+}
+/**
+ * @brief Checks the blocks covered by the newest header on the card.
+ * @details Nothing is written, like in ringlog_read.c.
+ * @return Number of blocks counted as valid but not in the file
+ */
+static int checkHeader(void) {
+
+  uint8_t block[RINGLOG_BLOCK_SIZE];
+  RINGLOG_Header hdr = {0}, *h = (RINGLOG_Header*)block;
+  uint32_t blockCount = LOG_BYTES / RINGLOG_BLOCK_SIZE - RINGLOG_HEADER_BLOCKS;
+  int valid = 0, missing = 0;
+
+  int file = FAT_OpenFile(name);
+  if (file < 0) {
+    return 1;
+  }
+  for (int i = 0; i < RINGLOG_HEADER_BLOCKS; i++) {
+    FAT_MoveRdPtr(file, i * RINGLOG_BLOCK_SIZE);
+    if (FAT_ReadFile(file, block, RINGLOG_BLOCK_SIZE) != RINGLOG_BLOCK_SIZE ||
+        h->magic != RINGLOG_MAGIC || h->checksum !=
+        CRC_Calc(block, offsetof(RINGLOG_Header, checksum))) {
+      continue;
+    }
+    if (!valid || (int32_t)(h->commit - hdr.commit) > 0) {
+      hdr = *h;
+      valid = 1;
+    }
+  }
+  for (uint32_t seq = hdr.oldestSeq; valid && seq != hdr.nextSeq; seq++) {
+    FAT_MoveRdPtr(file, (RINGLOG_HEADER_BLOCKS + seq % blockCount) *
+        RINGLOG_BLOCK_SIZE);
+    if (FAT_ReadFile(file, block, RINGLOG_BLOCK_SIZE) != RINGLOG_BLOCK_SIZE ||
+        checkBlock(block, seq)) {
+      missing++;
+    }
+  }
+  FAT_CloseFile(file);
+  return valid ? missing : 1;
+}
+/**
+ * @brief Checks the records of the recovered log.
+ * @param acked Records appended before power was cut
+ * @param lost Records lost (function writes this)
+ * @return Number of errors
+ */
+static int checkLog(uint32_t acked, uint32_t* lost) {
+
+  uint8_t block[RINGLOG_BLOCK_SIZE];
+  uint32_t expected = 0, last = 0;
+  int first = 1, errors = 0;
+
+  for (uint32_t seq = ringLog.oldestSeq; seq != ringLog.nextSeq; seq++) {
+    int used = RINGLOG_ReadBlock(&ringLog, seq, block);
+    if (used == -1) {
+      errors++; // gap in the log
+      continue;
+    }
+    for (int pos = 0; pos + 2 + RECORD <= used; pos += 2 + RECORD) {
+      uint32_t r;
+      memcpy(&r, block + sizeof(RINGLOG_BlockHeader) + pos + 2, sizeof(r));
+      if (!first && r != expected) {
+        errors++;
+      }
+      first = 0;
+      expected = r + 1;
+      last = expected;
+    }
+  }
+  *lost = acked > last ? acked - last : 0;
+  if (*lost > (RINGLOG_BUFFER_BLOCKS + 1) * PER_BLOCK) {
+    errors++;
+  }
+  return errors;
+}
+
+int main(void) {
+
+  int errors = 0;
+
+  fprintf(stderr, "%u records of %d bytes to log of %d blocks\n",
+      (unsigned)records(), RECORD,
+      LOG_BYTES / RINGLOG_BLOCK_SIZE - RINGLOG_HEADER_BLOCKS);
+  fprintf(stderr, "%-7s %6s %7s %9s %10s %6s %7s %8s %8s %9s\n", "stack",
+      "cmds", "sectors", "card [ms]", "records/s", "cuts", "headers",
+      "recovery", "max lost", "open [ms]");
+
+  for (uint8_t layers = 0; layers < 2; layers++) {
+    uint32_t maxLost = 0, lost;
+    double maxOpen = 0;
+    int badHeaders = 0, failed = 0;
+
+    // run without a cut to count commands and written sectors
+    if (start(layers)) {
+      fprintf(stderr, "Cannot open log\n");
+      return 1;
+    }
+    memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+    append();
+    RAMCARD_Stats stats = RAMCARD_stats;
+    double cardTime = RAMCARD_Time(&stats);
+    RINGLOG_Close(&ringLog);
+
+    for (uint32_t cut = 0; cut <= stats.sectorsWritten; cut++) {
+      if (start(layers)) {
+        fprintf(stderr, "Cannot open log\n");
+        return 1;
+      }
+      RAMCARD_CutPower(cut);
+      uint32_t acked = append();
+
+      // reset, header checked before recovery writes a new one
+      if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers))) {
+        failed++;
+        continue;
+      }
+      if (checkHeader()) {
+        badHeaders++;
+      }
+      memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+      if (RINGLOG_Open(&ringLog, name)) {
+        failed++;
+        continue;
+      }
+      if (RAMCARD_Time(&RAMCARD_stats) > maxOpen) {
+        maxOpen = RAMCARD_Time(&RAMCARD_stats);
+      }
+      if (checkLog(acked, &lost)) {
+        failed++;
+      }
+      if (lost > maxLost) {
+        maxLost = lost;
+      }
+      RINGLOG_Close(&ringLog);
+    }
+    errors += badHeaders + failed;
+
+    fprintf(stderr, "%-7s %6u %7u %9.0f %10.0f %6u %7d %8d %8u %9.1f %s\n",
+        layers ? "cached" : "card", (unsigned)(stats.reads + stats.writes),
+        (unsigned)(stats.sectorsRead + stats.sectorsWritten), cardTime / 1000,
+        records() / cardTime * 1e6, (unsigned)stats.sectorsWritten + 1,
+        badHeaders, failed, (unsigned)maxLost, maxOpen / 1000,
+        badHeaders + failed ? "FAILED" : "ok");
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file    ringlog_read.c
+ * @brief   PC tool printing records of a circular log file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Build and run on the PC with the file copied from the card:
+ *
+ *   gcc -I../app/inc -o ringlog_read ringlog_read.c ../app/src/crc.c
+ *   ./ringlog_read LOG.DAT
+ *
+ * Every record is printed in a line starting with the sequence number
+ * of its block, oldest first. Blocks written after the last header
+ * update are found in the same way as RINGLOG_Open does on the device.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <ringlog.h>
+#include <crc.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <ctype.h>
+
+static FILE* logFile; ///< Opened log file
+static uint32_t blockCount; ///< Number of data blocks in file
+
+/**
+ * @brief Reads a block of the file.
+ * @param index Number of block in file
+ * @param block Buffer for RINGLOG_BLOCK_SIZE bytes
+ * @retval 0 Block read
+ * @retval 1 Read error
+ */
+static int readBlock(uint32_t index, uint8_t* block) {
+
+  if (fseek(logFile, (long)index * RINGLOG_BLOCK_SIZE, SEEK_SET)) {
+    return 1;
+  }
+  return fread(block, RINGLOG_BLOCK_SIZE, 1, logFile) != 1;
+}
+/**
+ * @brief Reads a data block with a given sequence number.
+ * @param seq Sequence number of block
+ * @param block Buffer for RINGLOG_BLOCK_SIZE bytes
+ * @return Number of payload bytes or -1 if block is not valid
+ */
+static int readDataBlock(uint32_t seq, uint8_t* block) {
+
+  RINGLOG_BlockHeader* hdr = (RINGLOG_BlockHeader*)block;
+
+  if (readBlock(RINGLOG_HEADER_BLOCKS + seq % blockCount, block)) {
+    return -1;
+  }
+  if (hdr->seq != seq || hdr->used > RINGLOG_PAYLOAD || hdr->checksum !=
+      CRC_Update(CRC_Calc(block, offsetof(RINGLOG_BlockHeader, checksum)),
+      block + sizeof(RINGLOG_BlockHeader), hdr->used)) {
+    return -1;
+  }
+  return hdr->used;
+}
+
+int main(int argc, char** argv) {
+
+  uint8_t block[RINGLOG_BLOCK_SIZE];
+  RINGLOG_Header hdr;
+  int valid = 0;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s LOGFILE\n", argv[0]);
+    return 1;
+  }
+  logFile = fopen(argv[1], "rb");
+  if (!logFile) {
+    perror(argv[1]);
+    return 1;
+  }
+  fseek(logFile, 0, SEEK_END);
+  long size = ftell(logFile);
+  if (size < (RINGLOG_HEADER_BLOCKS + 1) * RINGLOG_BLOCK_SIZE) {
+    fprintf(stderr, "File too small\n");
+    return 1;
+  }
+  blockCount = size / RINGLOG_BLOCK_SIZE - RINGLOG_HEADER_BLOCKS;
+
+  // choose the newest valid header
+  for (int i = 0; i < RINGLOG_HEADER_BLOCKS; i++) {
+    RINGLOG_Header* h = (RINGLOG_Header*)block;
+    if (readBlock(i, block) || h->magic != RINGLOG_MAGIC ||
+        h->blockCount != blockCount || h->checksum !=
+        CRC_Calc(block, offsetof(RINGLOG_Header, checksum))) {
+      continue;
+    }
+    if (!valid || (int32_t)(h->commit - hdr.commit) > 0) {
+      hdr = *h;
+      valid = 1;
+    }
+  }
+  if (!valid) {
+    fprintf(stderr, "No valid header\n");
+    return 1;
+  }
+
+  // find blocks written after last header update
+  uint32_t nextSeq = hdr.nextSeq;
+  while (nextSeq - hdr.nextSeq < blockCount &&
+      readDataBlock(nextSeq, block) != -1) {
+    nextSeq++;
+  }
+  uint32_t oldestSeq = hdr.oldestSeq;
+  if (nextSeq - oldestSeq > blockCount) {
+    oldestSeq = nextSeq - blockCount;
+  }
+
+  fprintf(stderr, "Blocks %u to %u (%u after last header update)\n",
+      (unsigned int)oldestSeq, (unsigned int)nextSeq - 1,
+      (unsigned int)(nextSeq - hdr.nextSeq));
+
+  for (uint32_t seq = oldestSeq; seq != nextSeq; seq++) {
+    int used = readDataBlock(seq, block);
+    if (used == -1) {
+      printf("%u: damaged block\n", (unsigned int)seq);
+      continue;
+    }
+    uint8_t* ptr = block + sizeof(RINGLOG_BlockHeader);
+    uint8_t* end = ptr + used;
+    while (ptr + 2 <= end) {
+      int len = ptr[0] | (ptr[1] << 8);
+      ptr += 2;
+      if (ptr + len > end) {
+        printf("%u: damaged record\n", (unsigned int)seq);
+        break;
+      }
+      printf("%u: ", (unsigned int)seq);
+      for (int i = 0; i < len; i++) {
+        if (isprint(ptr[i])) {
+          putchar(ptr[i]);
+        } else {
+          printf("\\x%02x", ptr[i]);
+        }
+      }
+      putchar('\n');
+      ptr += len;
+    }
+  }
+
+  fclose(logFile);
+  return 0;
+}
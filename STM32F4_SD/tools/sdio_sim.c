@@ -0,0 +1,627 @@
+/**
+ * @file    sdio_sim.c
+ * @brief   PC test of the SDIO card driver with a model of the card.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs sdio_card.c on the PC. The SDIO_HAL functions are
+ * replaced by a model of an SD card in SD bus mode, which follows the
+ * card states (idle, ready, ident, stby, tran, data, rcv, prg), checks
+ * that every command is allowed in the current state and is sent with
+ * the right kind of response, that data transfers are set up in the
+ * right order (before the command for reading, after it for writing)
+ * that ACMD23 (pre-erase) comes right before CMD25 and that the bus is
+ * switched to 4 bits and high speed only after the card was told to:
+ *
+ *   gcc -std=gnu11 -DSD_USE_SDIO -I../app/inc -I../hal/inc -o sdio_sim \
+ *       sdio_sim.c ../app/src/sdio_card.c
+ *   ./sdio_sim > /dev/null
+ *
+ * The commands sent during initialization are compared with the
+ * expected sequence, then sectors are written and read back in several
+ * ways, for an SDHC card with high speed, an SDSC card without CMD8 and
+ * CMD6, a card initialized with SD_StartInit and SD_PollInit between
+ * other work, a card returning a data CRC error and a card that never
+ * answers. Cards powering up for 700 ms and for ever check that ACMD41
+ * is sent less often the longer the card is busy, that a ready card is
+ * found soon and that a card never ready fails after SD_INIT_TIMEOUT.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <sdcard.h>
+#include <sdio_hal.h>
+#include <timers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CARD_SECTORS  2048  ///< Size of modelled card (1 MB)
+#define CARD_RCA      0x1234
+
+/**
+ * @brief States of the card.
+ */
+typedef enum {
+  IDLE, READY, IDENT, STBY, TRAN, DATA, RCV, PRG
+} State;
+
+/**
+ * @brief Model of card.
+ */
+static struct {
+  // kind of card
+  int version2;       ///< Answers CMD8
+  int sdhc;           ///< Block addressing
+  int highSpeed;      ///< Supports CMD6 high speed
+  int powerUpPolls;   ///< ACMD41 answered busy this many times
+  uint32_t readyAt;   ///< and until this time [ms]
+  int dead;           ///< Never answers
+  int crcErrorRead;   ///< Read with CRC error (counted from 1, 0 - none)
+  // state
+  State state;
+  int appCmd;         ///< Last command was CMD55
+  int wide;           ///< Card uses 4-bit bus
+  int hsOn;           ///< Card switched to high speed
+  int busyPolls;      ///< CMD13 polls until programming ends
+  int reads;          ///< Number of read commands
+  uint32_t address;   ///< Next sector of multiple block transfer
+  int writeCmd;       ///< Write command waiting for data
+  uint32_t preErase;  ///< Blocks to pre-erase set by ACMD23
+  // host
+  int hostWide;       ///< Bus width set by host
+  int hostClock;      ///< Clock set by host
+  uint8_t* dataBuf;   ///< Started data transfer
+  int dataLog2;
+  int dataBlocks;
+  int dataRead;
+  int dataResult;     ///< Result of transfer for SDIO_HAL_WaitData
+  int dataDone;       ///< Data of transfer were moved
+  // results
+  char trace[2048];   ///< Commands sent
+  int errors;
+} card;
+
+static uint8_t memory[CARD_SECTORS * 512]; ///< Card contents
+static uint32_t now; ///< Time in ms
+
+/**
+ * @brief Reports an error of the driver.
+ */
+static void fail(const char* what) {
+
+  fprintf(stderr, "  error: %s (after %s)\n", what, card.trace);
+  card.errors++;
+}
+/**
+ * @brief Appends to the trace.
+ */
+static void trace(const char* fmt, int value) {
+
+  char s[32];
+
+  snprintf(s, sizeof(s), fmt, value);
+  if (strlen(card.trace) + strlen(s) + 2 > sizeof(card.trace)) {
+    return;
+  }
+  if (card.trace[0]) {
+    strcat(card.trace, " ");
+  }
+  strcat(card.trace, s);
+}
+/**
+ * @brief Card status (R1).
+ */
+static uint32_t status(void) {
+
+  State s = card.state == DATA ? TRAN : card.state; // busy is on D0 only
+  return (s << 9) | ((card.state == TRAN) << 8) | (card.appCmd << 5);
+}
+/**
+ * @brief Converts sector address of command.
+ * @return Sector or -1 if wrong
+ */
+static int sectorOf(uint32_t arg) {
+
+  if (!card.sdhc) {
+    if (arg % 512) {
+      fail("SDSC address not multiple of 512");
+      return -1;
+    }
+    arg /= 512;
+  }
+  if (arg >= CARD_SECTORS) {
+    fail("address out of range");
+    return -1;
+  }
+  return arg;
+}
+/**
+ * @brief Moves sectors between card and host buffer.
+ */
+static void moveData(int read) {
+
+  if (card.hostWide != card.wide) {
+    fail("bus width differs from card");
+  }
+  if (card.hostClock == SDIO_HAL_CLOCK_48MHZ && !card.hsOn) {
+    fail("high speed clock without CMD6");
+  }
+  for (int i = 0; i < card.dataBlocks; i++) {
+    if (card.address + i >= CARD_SECTORS) {
+      fail("transfer beyond end of card");
+      return;
+    }
+    uint8_t* sector = memory + (card.address + i) * 512;
+    if (read) {
+      memcpy(card.dataBuf + i * 512, sector, 512);
+    } else {
+      memcpy(sector, card.dataBuf + i * 512, 512);
+    }
+  }
+  card.dataDone = 1;
+}
+
+/**
+ * @brief Model of SDIO_HAL functions.
+ */
+void SDIO_HAL_Init(void) {
+
+  card.hostWide = 0;
+  card.hostClock = SDIO_HAL_CLOCK_INIT;
+  card.dataBuf = 0;
+}
+void SDIO_HAL_SetBus(uint8_t wide, SDIO_HAL_Clock clock) {
+
+  if (wide && !card.wide) {
+    fail("4-bit bus before ACMD6");
+  }
+  if (clock == SDIO_HAL_CLOCK_48MHZ && !card.hsOn) {
+    fail("high speed before CMD6");
+  }
+  card.hostWide = wide;
+  card.hostClock = clock;
+  trace(clock == SDIO_HAL_CLOCK_48MHZ ? "BUS%d/48" : clock == SDIO_HAL_CLOCK_24MHZ ?
+      "BUS%d/24" : "BUS%d/0.4", wide ? 4 : 1);
+}
+uint8_t SDIO_HAL_Command(uint8_t cmd, uint32_t arg, SDIO_HAL_Response resp,
+    uint8_t checkCrc, uint32_t* response) {
+
+  int app = card.appCmd;
+  SDIO_HAL_Response expected = SDIO_HAL_RESP_SHORT;
+  uint32_t r = 0;
+
+  now++;
+  trace(app ? "ACMD%d" : "CMD%d", cmd);
+  if (card.dead) {
+    return SDIO_HAL_TIMEOUT;
+  }
+  if (card.hostClock != SDIO_HAL_CLOCK_INIT && card.state < STBY) {
+    fail("identification faster than 400 kHz");
+  }
+  card.appCmd = 0;
+
+  if (app && cmd == 41) {
+    if (card.state != IDLE || checkCrc) {
+      fail("ACMD41 in wrong state or with CRC check");
+    }
+    if (card.sdhc && !(arg & (1 << 30))) {
+      fail("ACMD41 without HCS for SDHC card");
+    }
+    r = 0x00ff8000;
+    if (--card.powerUpPolls < 0 && now >= card.readyAt) {
+      r |= (1u << 31) | (card.sdhc ? 1 << 30 : 0);
+      card.state = READY;
+    }
+  } else if (app && cmd == 23) {
+    if (card.state != TRAN || arg == 0) {
+      fail("ACMD23 wrong");
+    }
+    r = status();
+    card.preErase = arg;
+  } else if (app && cmd == 6) {
+    if (card.state != TRAN || arg != 2) {
+      fail("ACMD6 wrong");
+    }
+    r = status();
+    card.wide = 1;
+  } else {
+    switch (cmd) {
+    case 0:
+      expected = SDIO_HAL_RESP_NONE;
+      card.state = IDLE;
+      card.wide = 0;
+      card.hsOn = 0;
+      break;
+    case 8:
+      if (!card.version2) {
+        return SDIO_HAL_TIMEOUT;
+      }
+      r = arg & 0xfff;
+      break;
+    case 55:
+      card.appCmd = 1;
+      r = status();
+      break;
+    case 2:
+      expected = SDIO_HAL_RESP_LONG;
+      if (card.state != READY) {
+        fail("CMD2 not in ready state");
+      }
+      card.state = IDENT;
+      if (resp == SDIO_HAL_RESP_LONG) {
+        // CID, end bit dropped by interface
+        response[0] = 0x03534453; // 'SD'
+        response[1] = 0x53443130; // "SD10"
+        response[2] = 0x47801234;
+        response[3] = 0x5678014a & ~1u;
+      }
+      break;
+    case 3:
+      if (card.state != IDENT && card.state != STBY) {
+        fail("CMD3 in wrong state");
+      }
+      card.state = STBY;
+      r = ((uint32_t)CARD_RCA << 16) | 0x0500;
+      break;
+    case 9:
+      expected = SDIO_HAL_RESP_LONG;
+      if (card.state != STBY || arg != (uint32_t)CARD_RCA << 16) {
+        fail("CMD9 in wrong state or to wrong RCA");
+      }
+      if (resp == SDIO_HAL_RESP_LONG) {
+        uint32_t ccc = card.highSpeed ? 0x5b5 : 0x1b5;
+        if (card.sdhc) {
+          // version 2.0, C_SIZE = 1 (1 MB)
+          response[0] = 0x400e0032;
+          response[1] = (ccc << 20) | (9 << 16) | 0;
+          response[2] = (1 << 16) | 0x7f80;
+          response[3] = 0x0a400000;
+        } else {
+          // version 1.0, READ_BL_LEN = 9, C_SIZE = 3, C_SIZE_MULT = 7 (1 MB)
+          response[0] = 0x002e0032;
+          response[1] = (ccc << 20) | (9 << 16) | 0;
+          response[2] = (3u << 30) | (7 << 15);
+          response[3] = 0x0a400000;
+        }
+      }
+      break;
+    case 7:
+      if (card.state != STBY || arg != (uint32_t)CARD_RCA << 16) {
+        fail("CMD7 in wrong state or to wrong RCA");
+      }
+      r = status();
+      card.state = TRAN;
+      break;
+    case 13:
+      if (arg != (uint32_t)CARD_RCA << 16) {
+        fail("CMD13 to wrong RCA");
+      }
+      if (card.state == PRG && --card.busyPolls <= 0) {
+        card.state = TRAN;
+      }
+      r = status();
+      break;
+    case 16:
+      if (card.state != TRAN || card.sdhc || arg != 512) {
+        fail("CMD16 wrong");
+      }
+      r = status();
+      break;
+    case 6:
+      if (card.state != TRAN || !card.highSpeed) {
+        fail("CMD6 to card without class 10");
+      }
+      if (!card.dataBuf || !card.dataRead || card.dataLog2 != 6 ||
+          card.dataBlocks != 1) {
+        fail("CMD6 without 64 byte read started");
+        break;
+      }
+      r = status();
+      memset(card.dataBuf, 0, 64);
+      card.dataBuf[13] = 0x03;  // group 1 supports default and high speed
+      card.dataBuf[16] = (arg & 0x80000000) ? 0x01 : 0x00;
+      card.hsOn = (arg & 0x80000000) ? 1 : 0;
+      card.dataDone = 1;
+      break;
+    case 17:
+    case 18: {
+      if (card.state != TRAN) {
+        fail("read not in transfer state");
+      }
+      int sector = sectorOf(arg);
+      if (!card.dataBuf || !card.dataRead || card.dataLog2 != 9 ||
+          (cmd == 17 && card.dataBlocks != 1)) {
+        fail("read command without read started");
+        break;
+      }
+      r = status();
+      if (sector < 0) {
+        r |= 1u << 31;
+        break;
+      }
+      card.address = sector;
+      moveData(1);
+      card.dataResult = (++card.reads == card.crcErrorRead) ?
+          SDIO_HAL_CRC : SDIO_HAL_OK;
+      card.state = (cmd == 18) ? DATA : TRAN;
+      break;
+    }
+    case 24:
+    case 25: {
+      if (card.state != TRAN) {
+        fail("write not in transfer state");
+      }
+      if (card.dataBuf) {
+        fail("write started before write command");
+      }
+      int sector = sectorOf(arg);
+      r = status();
+      if (sector < 0) {
+        r |= 1u << 31;
+        break;
+      }
+      if (card.preErase && cmd != 25) {
+        fail("ACMD23 not before CMD25");
+      }
+      card.preErase = 0;
+      card.address = sector;
+      card.writeCmd = cmd;
+      card.state = RCV;
+      break;
+    }
+    case 12:
+      if (card.state == DATA) {
+        card.state = TRAN;
+      } else if (card.state == RCV) {
+        card.state = PRG;
+        card.busyPolls = 3;
+      } else {
+        fail("CMD12 without transfer");
+      }
+      r = status();
+      break;
+    default:
+      fail("unexpected command");
+      break;
+    }
+  }
+
+  if (app && cmd != 41 && cmd != 6 && cmd != 23) {
+    fail("unexpected application command");
+  }
+  if (app && cmd == 41) {
+    expected = SDIO_HAL_RESP_SHORT;
+  }
+  if (resp != expected) {
+    fail("wrong response type");
+  }
+  if (resp == SDIO_HAL_RESP_SHORT && response) {
+    response[0] = r;
+  }
+  return SDIO_HAL_OK;
+}
+void SDIO_HAL_StartData(uint8_t* buf, uint8_t blockSizeLog2, uint32_t blocks,
+    uint8_t read) {
+
+  if (((uintptr_t)buf & 3) != 0) {
+    fail("DMA buffer not word aligned");
+  }
+  card.dataBuf = buf;
+  card.dataLog2 = blockSizeLog2;
+  card.dataBlocks = blocks;
+  card.dataRead = read;
+  card.dataDone = 0;
+  card.dataResult = SDIO_HAL_OK;
+
+  if (!read) {
+    if (card.state != RCV || blockSizeLog2 != 9 ||
+        (card.writeCmd == 24 && blocks != 1)) {
+      fail("write data without write command");
+      return;
+    }
+    moveData(0);
+    if (card.writeCmd == 24) {
+      card.state = PRG;
+      card.busyPolls = 2;
+    }
+  }
+}
+uint8_t SDIO_HAL_WaitData(void) {
+
+  if (!card.dataBuf) {
+    fail("wait without transfer");
+    return SDIO_HAL_ERROR;
+  }
+  card.dataBuf = 0;
+  if (!card.dataDone) {
+    fail("transfer never ends (data timeout)");
+    return SDIO_HAL_TIMEOUT;
+  }
+  return card.dataResult;
+}
+void SDIO_HAL_StopData(void) {
+
+  card.dataBuf = 0;
+}
+
+/**
+ * @brief Time functions used by the driver.
+ * @details Every reading of the time takes 1 ms, so waiting loops end.
+ */
+uint32_t TIMER_GetTime(void) {
+  return now++;
+}
+void TIMER_Delay(uint32_t ms) {
+  now += ms;
+}
+
+/**
+ * @brief Writes and reads sectors in several ways.
+ * @return Nonzero if data differs or a transfer failed
+ */
+static int checkData(void) {
+
+  static uint32_t out[8 * 128];
+  static uint32_t in[8 * 128 + 1];
+  uint8_t* src = (uint8_t*)out;
+  int failed = 0;
+
+  for (unsigned int i = 0; i < sizeof(out); i++) {
+    src[i] = rand();
+  }
+
+  // multiple block write and read
+  failed |= SD_WriteSectors(src, 100, 8);
+  failed |= SD_ReadSectors((uint8_t*)in, 100, 8);
+  failed |= memcmp(in, out, 8 * 512) != 0;
+
+  // single blocks
+  failed |= SD_WriteSectors(src + 512, CARD_SECTORS - 1, 1);
+  memset(in, 0, sizeof(in));
+  failed |= SD_ReadSectors((uint8_t*)in, CARD_SECTORS - 1, 1);
+  failed |= memcmp(in, src + 512, 512) != 0;
+
+  // buffers not word aligned
+  failed |= SD_WriteSectors(src + 1, 200, 3);
+  memset(in, 0, sizeof(in));
+  failed |= SD_ReadSectors((uint8_t*)in + 3, 200, 3);
+  failed |= memcmp((uint8_t*)in + 3, src + 1, 3 * 512) != 0;
+
+  // data really on card at the right place
+  failed |= memcmp(memory + 100 * 512, src, 8 * 512) != 0;
+  failed |= memcmp(memory + 200 * 512, src + 1, 3 * 512) != 0;
+
+  if (card.state != TRAN) {
+    fail("card not in transfer state after transfers");
+  }
+  return failed;
+}
+/**
+ * @brief Test case.
+ */
+typedef struct {
+  const char* name;
+  int version2;       ///< Card answers CMD8
+  int sdhc;           ///< Block addressing
+  int highSpeed;      ///< Supports CMD6 high speed
+  uint32_t readyAt;   ///< Time of end of power up [ms]
+  int crcErrorRead;   ///< Read with CRC error
+  int dead;           ///< Card never answers
+  int overlap;        ///< Other work during initialization
+  int maxPolls;       ///< Most ACMD41 allowed
+  const char* expected; ///< Commands of initialization (0 - not checked)
+} Scenario;
+
+/**
+ * @brief Runs a test case.
+ * @return Nonzero if failed
+ */
+static int run(const Scenario* t) {
+
+  SD_InitStats stats;
+  uint8_t result;
+
+  memset(&card, 0, sizeof(card));
+  card.version2 = t->version2;
+  card.sdhc = t->sdhc;
+  card.highSpeed = t->highSpeed;
+  card.powerUpPolls = 2;
+  card.readyAt = t->readyAt;
+  card.crcErrorRead = t->crcErrorRead;
+  card.dead = t->dead;
+  now = 0;
+
+  if (t->overlap) {
+    // other initialization runs while the card powers up
+    SD_StartInit();
+    for (int i = 0; i < 20; i++) {
+      TIMER_Delay(3);
+      SD_PollInit();
+    }
+    result = SD_WaitInit();
+  } else {
+    result = SD_Init();
+  }
+  SD_GetInitStats(&stats);
+  printf("%s: %s\n", t->name, card.trace);
+  printf("  power up %u ms, init %u ms, %u ACMD41\n",
+      (unsigned int)stats.powerUpTime, (unsigned int)stats.initTime,
+      (unsigned int)stats.polls);
+
+  int failed = 0;
+  if (t->expected && strcmp(card.trace, t->expected)) {
+    fprintf(stderr, "  expected: %s\n  got:      %s\n", t->expected, card.trace);
+    failed = 1;
+  }
+  if (stats.polls > t->maxPolls) {
+    fprintf(stderr, "  %u ACMD41, expected at most %d\n",
+        (unsigned int)stats.polls, t->maxPolls);
+    failed = 1;
+  }
+
+  if (t->dead || t->readyAt > SD_INIT_TIMEOUT) {
+    // fails after the timeout, without waiting much longer
+    failed |= result != 1 || !stats.error || SD_ReadCapacity() != 0;
+    failed |= stats.initTime < SD_INIT_TIMEOUT ||
+        stats.initTime > SD_INIT_TIMEOUT + 2 * SD_INIT_INTERVAL_MAX;
+  } else if (t->crcErrorRead) {
+    static uint32_t buf[2 * 128];
+    // first read fails, card must be usable after it
+    failed |= result != 0;
+    failed |= SD_ReadSectors((uint8_t*)buf, 5, 2) != 1;
+    failed |= SD_ReadSectors((uint8_t*)buf, 5, 2) != 0;
+    failed |= card.state != TRAN;
+  } else {
+    uint8_t cid[16];
+    SD_GetCID(cid);
+    failed |= result != 0 || stats.error;
+    failed |= memcmp(cid, stats.cid, 16) != 0;
+    // busy card is not asked much later than it is ready
+    failed |= stats.powerUpTime < t->readyAt ||
+        stats.powerUpTime > t->readyAt + 2 * SD_INIT_INTERVAL_MAX;
+    failed |= SD_ReadCapacity() != CARD_SECTORS * 512;
+    failed |= cid[0] != 0x03 || cid[15] != 0x4b;
+    failed |= checkData();
+  }
+
+  failed |= card.errors != 0;
+  fprintf(stderr, "%-24s %s\n", t->name, failed ? "FAILED" : "ok");
+  return failed;
+}
+
+int main(void) {
+
+  const char* sdhcInit =
+      "CMD0 CMD8 CMD55 ACMD41 CMD55 ACMD41 CMD55 ACMD41 CMD2 CMD3 CMD9 "
+      "CMD7 CMD13 CMD55 ACMD6 BUS4/24 CMD6 BUS4/48";
+  const char* sdscInit =
+      "CMD0 CMD8 CMD55 ACMD41 CMD55 ACMD41 CMD55 ACMD41 CMD2 CMD3 CMD9 "
+      "CMD7 CMD13 CMD55 ACMD6 BUS4/24 CMD16";
+
+  const Scenario scenarios[] = {
+    // name                   v2 hc hs ready crc dead ovl polls
+    {"SDHC, high speed",       1, 1, 1,    0, 0, 0, 0,   3, sdhcInit},
+    {"SDSC version 1",         0, 0, 0,    0, 0, 0, 0,   3, sdscInit},
+    {"init during other work", 1, 1, 1,    0, 0, 0, 1,   3, sdhcInit},
+    {"slow power up (700 ms)", 1, 1, 1,  700, 0, 0, 0,  30, 0},
+    {"never ready",            1, 1, 1, 5000, 0, 0, 0,  45, 0},
+    {"data CRC error",         1, 1, 0,    0, 1, 0, 0,   3, 0},
+    {"no card",                1, 1, 1,    0, 0, 1, 0,  45, 0},
+  };
+  int failed = 0;
+
+  for (unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    failed |= run(&scenarios[i]);
+  }
+
+  return failed;
+}
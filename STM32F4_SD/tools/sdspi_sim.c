@@ -0,0 +1,916 @@
+/**
+ * @file    sdspi_sim.c
+ * @brief   PC benchmark of the SPI SD card driver with a model of the card.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs sdcard.c on the PC. The SPI1 functions are replaced by
+ * a model of an SD card in SPI mode, which gets every byte clocked on
+ * the bus, parses commands, answers with R1 (and R3/R7, register
+ * blocks and data blocks), takes write data with start and stop
+ * tokens, and holds MISO low while it is busy. It checks that data
+ * commands come in an allowed order (CMD23 only on cards listing it in
+ * SCR and only before CMD18/CMD25, ACMD23 only before a write, CMD12
+ * only during an open ended read, no command while busy):
+ *
+ *   gcc -std=gnu11 -I../app/inc -I../hal/inc -o sdspi_sim sdspi_sim.c \
+ *       ../app/src/sdcard.c ../app/src/utils.c
+ *   ./sdspi_sim > /dev/null
+ *
+ * The workload is metadata-heavy, like appending to files on FAT: read
+ * a directory and a FAT sector, write a cluster, update both FAT copies
+ * and the directory entry, then read the cluster back. It is run with
+ * each command policy of SD_SetCommandPolicy and on a card without
+ * CMD23. The time is counted in bytes clocked on the bus. Programming a
+ * block costs PROGRAM_BYTES of busy and erasing ERASE_BYTES, once per
+ * write if ACMD23 told the card how many blocks follow, otherwise once
+ * per block. The commands are counted by the driver (SD_GetCommandStats).
+ *
+ * After CMD59 the card checks CRC7 of commands (CMD0 and CMD8 always)
+ * and CRC16 of written blocks, and sends CRC16 with read blocks. The
+ * CRC functions of the SPI are modelled in software. Scenarios with bit
+ * errors flip random bits of data blocks on MOSI and MISO, and with CRC
+ * on also of command arguments (not of CMD12, which is sent while data
+ * is still coming). Responses have no CRC in SPI mode and are not
+ * damaged. With CRC on all data has to arrive intact and the bus time
+ * without errors has to be the same as with CRC off; with CRC off the
+ * errors are expected to get through.
+ *
+ * Time is counted from bytes on the bus at the SPI clock set by the
+ * driver (84 MHz divided), and by 1 ms for each call of TIMER_GetTime
+ * while the bus is idle. Fault scenarios script one fault of the card
+ * during a transfer and check that it is recovered by the expected tier
+ * of SD_Recover, or reported with the failed sector, and print the time
+ * of the recovery:
+ *
+ * - a read block with wrong CRC (repeat)
+ * - a read without data token (repeat after timeout)
+ * - card losing command framing until clocked while deselected (resync)
+ * - error answered to data commands until status is read (status)
+ * - data damaged at the current clock (slower clock)
+ * - card answering nothing but CMD0 (initialization)
+ * - sector which can't be written (failed, sector reported)
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <sdcard.h>
+#include <spi1.h>
+#include <timers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CARD_SECTORS    2048  ///< Size of modelled card (1 MB)
+#define ACCESS_BYTES    4     ///< Bytes before data token of read
+#define PROGRAM_BYTES   200   ///< Busy bytes to program a block
+#define ERASE_BYTES     600   ///< Busy bytes to erase before writing
+#define STOP_BYTES      8     ///< Busy bytes after CMD12
+#define OPS             100   ///< File appends in workload
+#define CLUSTER         4     ///< Sectors of cluster
+#define BUS_CLOCK_KHZ   84000 ///< Clock of SPI1 before divider
+#define RESYNC_CLOCKS   74    ///< Clocks with card deselected to resynchronize
+
+/**
+ * @brief Scripted faults of the card.
+ */
+typedef enum {
+  FAULT_NONE,
+  FAULT_CRC,        ///< Next read block damaged
+  FAULT_NO_TOKEN,   ///< Next read sends no data
+  FAULT_DESYNC,     ///< Next data command lost, card deaf until resynchronized
+  FAULT_ERROR,      ///< Data commands rejected until CMD13
+  FAULT_FAST_CLOCK, ///< Data damaged until clock is halved
+  FAULT_HANG,       ///< Card answers only CMD0
+  FAULT_BAD_SECTOR  ///< Sector can't be written
+} Fault;
+
+/**
+ * @brief What the card expects on MOSI.
+ */
+typedef enum {
+  IN_COMMAND,     ///< Command frame
+  IN_TOKEN,       ///< Start (or stop) token of write
+  IN_DATA         ///< Data block and CRC
+} Input;
+
+/**
+ * @brief Model of card.
+ */
+static struct {
+  // kind of card
+  int cmd23;            ///< SCR lists CMD23
+  uint32_t errorRate;   ///< One in errorRate bits is flipped (0 - none)
+  // state
+  int idle;             ///< In idle state
+  int powerUpPolls;     ///< ACMD41 answered busy this many times
+  int appCmd;           ///< Last command was CMD55
+  int lastCmd;          ///< Last command
+  int crcOn;            ///< CRC checking turned on by CMD59
+  int selected;         ///< Chip select is low
+  uint32_t idleClocks;  ///< Clocks while deselected
+  Fault fault;          ///< Fault waiting for its data command
+  int desync;           ///< Ignores bus until resynchronized
+  int errorLatched;     ///< Rejects data commands until CMD13
+  int hang;             ///< Answers only CMD0
+  uint16_t slowDivider; ///< Data damaged while clock divider is lower
+  uint32_t badSector;   ///< Sector which can't be written (+1, 0 - none)
+  uint8_t frame[6];     ///< Command being received
+  int frameLen;
+  Input in;
+  uint32_t address;     ///< Next sector of transfer
+  int32_t readLeft;     ///< Blocks still to be sent (-1 until CMD12)
+  int32_t writeLeft;    ///< Blocks still to be received (-1 until stop token)
+  int writeMulti;       ///< Write started by CMD25
+  uint32_t blockCount;  ///< Set by CMD23
+  uint32_t preErase;    ///< Set by ACMD23
+  uint32_t erased;      ///< Blocks of this write already erased
+  int rejected;         ///< Block of multiple block write was rejected
+  uint8_t block[514];   ///< Received data block with CRC
+  int blockLen;
+  uint8_t out[600];     ///< Bytes to send on MISO
+  int outHead;
+  int outLen;
+  uint32_t busy;        ///< Busy bytes left
+  // results
+  uint64_t bytes;       ///< Bytes clocked
+  uint64_t busyBytes;   ///< Bytes clocked while busy
+  uint32_t stopTokens;  ///< Stop tokens received
+  uint32_t damaged;     ///< Bytes damaged on the bus
+  uint32_t crcErrors;   ///< Commands and blocks with wrong CRC received
+  int errors;
+} card;
+
+static uint8_t memory[CARD_SECTORS * 512]; ///< Card contents
+static uint32_t idleTime; ///< Time while bus was idle [ms]
+static uint64_t ticks; ///< Clocks of SPI1 before divider
+static uint64_t lastBytes; ///< Bytes at last TIMER_GetTime
+static uint16_t divider = 256; ///< SPI clock divider
+static uint32_t seed; ///< State of random numbers
+
+/**
+ * @brief Reports an error of the driver.
+ */
+static void fail(const char* what) {
+
+  fprintf(stderr, "  error: %s (after CMD%d)\n", what, card.lastCmd);
+  card.errors++;
+}
+/**
+ * @brief Random numbers (xorshift).
+ */
+static uint32_t random32(void) {
+
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+/**
+ * @brief Flips random bits of a byte on the bus.
+ */
+static uint8_t damage(uint8_t b) {
+
+  uint8_t d = b;
+
+  if (card.errorRate == 0) {
+    return b;
+  }
+  for (int i = 0; i < 8; i++) {
+    if (random32() % card.errorRate == 0) {
+      d ^= 1 << i;
+    }
+  }
+  if (d != b) {
+    card.damaged++;
+  }
+  return d;
+}
+/**
+ * @brief CRC7 of command (x^7 + x^3 + 1) in the upper seven bits.
+ */
+static uint8_t crc7(const uint8_t* buf, int len) {
+
+  uint8_t crc = 0;
+
+  for (int i = 0; i < len; i++) {
+    for (int j = 7; j >= 0; j--) {
+      uint8_t bit = ((buf[i] >> j) ^ (crc >> 7)) & 1;
+      crc <<= 1;
+      if (bit) {
+        crc ^= 0x12;
+      }
+    }
+  }
+  return crc;
+}
+/**
+ * @brief CRC16 of data (x^16 + x^12 + x^5 + 1).
+ */
+static uint16_t crc16(const uint8_t* buf, int len, uint16_t crc) {
+
+  for (int i = 0; i < len; i++) {
+    crc ^= buf[i] << 8;
+    for (int j = 0; j < 8; j++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+/**
+ * @brief Queues bytes to send.
+ */
+static void send(const uint8_t* buf, int len) {
+
+  if (card.outLen + len > (int)sizeof(card.out)) {
+    fail("output queue overflow");
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    card.out[(card.outHead + card.outLen++) % sizeof(card.out)] = buf[i];
+  }
+}
+/**
+ * @brief Queues a byte to send.
+ */
+static void sendByte(uint8_t b) {
+
+  send(&b, 1);
+}
+/**
+ * @brief Queues a data block with start token.
+ * @details Sectors may be damaged on the way, registers are not.
+ */
+static void sendBlock(const uint8_t* buf, int len) {
+
+  uint16_t crc = crc16(buf, len, 0);
+  int flip = (len == 512) && (card.fault == FAULT_CRC ||
+      divider < card.slowDivider);
+
+  if (len == 512 && card.fault == FAULT_CRC) {
+    card.fault = FAULT_NONE;
+  }
+  for (int i = 0; i < ACCESS_BYTES; i++) {
+    sendByte(0xff);
+  }
+  sendByte(0xfe);
+  for (int i = 0; i < len; i++) {
+    sendByte((len == 512 ? damage(buf[i]) : buf[i]) ^ (flip && i == 100));
+  }
+  sendByte(crc >> 8);
+  sendByte(crc);
+}
+/**
+ * @brief Checks sector address of command.
+ * @return 0 if right
+ */
+static int checkAddress(uint32_t arg) {
+
+  if (arg >= CARD_SECTORS) {
+    fail("address out of range");
+    return 1;
+  }
+  return 0;
+}
+/**
+ * @brief Executes a received command.
+ */
+static void command(void) {
+
+  int cmd = card.frame[0] & 0x3f;
+  int app = card.appCmd;
+  uint32_t arg = ((uint32_t)card.frame[1] << 24) | (card.frame[2] << 16) |
+      (card.frame[3] << 8) | card.frame[4];
+  uint8_t r1 = card.idle ? 0x01 : 0x00;
+  uint8_t buf[16];
+  int data = !app && (cmd == 17 || cmd == 18 || cmd == 24 || cmd == 25);
+
+  if (card.busy) {
+    fail("command while busy");
+  }
+  if (card.blockCount && cmd != 18 && cmd != 25) {
+    fail("CMD23 not before CMD18/CMD25");
+  }
+  card.appCmd = 0;
+
+  // stuff byte, then response
+  sendByte(0xff);
+
+  // damaged command is not executed
+  if ((card.crcOn || cmd == 0 || cmd == 8) &&
+      (crc7(card.frame, 5) | 0x01) != card.frame[5]) {
+    card.crcErrors++;
+    sendByte(r1 | 0x08);
+    return;
+  }
+  if (card.hang && cmd != 0) {
+    return;
+  }
+  if (data && card.fault == FAULT_DESYNC) {
+    card.fault = FAULT_NONE;
+    card.desync = 1;
+    card.outLen = 0;
+    card.blockCount = 0;
+    card.preErase = 0;
+    return;
+  }
+  if (data && card.fault == FAULT_HANG) {
+    card.fault = FAULT_NONE;
+    card.hang = 1;
+    card.outLen = 0;
+    card.blockCount = 0;
+    card.preErase = 0;
+    return;
+  }
+  if (data && card.fault == FAULT_ERROR) {
+    card.fault = FAULT_NONE;
+    card.errorLatched = 1;
+  }
+  if ((data || cmd == 23) && card.errorLatched) {
+    card.blockCount = 0;
+    card.preErase = 0;
+    sendByte(r1 | 0x40); // parameter error
+    return;
+  }
+  if (card.preErase && cmd != 25 && cmd != 23) {
+    fail("ACMD23 not before CMD25");
+  }
+  if (cmd == 12 && card.lastCmd != 18) {
+    sendByte(r1 | 0x04); // illegal outside of read
+    return;
+  }
+  card.lastCmd = cmd;
+
+  if (app) {
+    switch (cmd) {
+    case 41:
+      if (--card.powerUpPolls < 0) {
+        card.idle = 0;
+      }
+      sendByte(card.idle ? 0x01 : 0x00);
+      return;
+    case 51: // SCR: SD 3.0, 1 and 4-bit bus, CMD_SUPPORT
+      sendByte(r1);
+      memset(buf, 0, 8);
+      buf[0] = 0x02;
+      buf[1] = 0x35;
+      buf[2] = 0x80;
+      buf[3] = card.cmd23 ? 0x02 : 0x00;
+      sendBlock(buf, 8);
+      return;
+    case 23:
+      if (card.idle || arg == 0) {
+        fail("ACMD23 wrong");
+      }
+      card.preErase = arg;
+      sendByte(r1);
+      return;
+    default:
+      fail("unexpected application command");
+      sendByte(r1 | 0x04);
+      return;
+    }
+  }
+
+  switch (cmd) {
+  case 0:
+    card.idle = 1;
+    card.crcOn = 0;
+    card.hang = 0;
+    card.blockCount = 0;
+    card.preErase = 0;
+    card.readLeft = 0;
+    card.in = IN_COMMAND;
+    sendByte(0x01);
+    break;
+  case 8:
+    sendByte(r1);
+    buf[0] = 0x00;
+    buf[1] = 0x00;
+    buf[2] = (arg >> 8) & 0x0f;
+    buf[3] = arg & 0xff;
+    send(buf, 4);
+    break;
+  case 58: // OCR: powered up, SDHC
+    sendByte(r1);
+    buf[0] = card.idle ? 0x00 : 0xc0;
+    buf[1] = 0xff;
+    buf[2] = 0x80;
+    buf[3] = 0x00;
+    send(buf, 4);
+    break;
+  case 55:
+    card.appCmd = 1;
+    sendByte(r1);
+    break;
+  case 59:
+    card.crcOn = arg & 1;
+    sendByte(r1);
+    break;
+  case 10: // CID
+    sendByte(r1);
+    memcpy(buf, "\x03SDSD10G\x80\x12\x34\x56\x78\x01\x4a\x01", 16);
+    sendBlock(buf, 16);
+    break;
+  case 9: // CSD version 2.0, C_SIZE = 1
+    sendByte(r1);
+    memset(buf, 0, 16);
+    buf[0] = 0x40;
+    buf[9] = 0x01;
+    sendBlock(buf, 16);
+    break;
+  case 13:
+    sendByte(r1);
+    sendByte(card.errorLatched ? 0x04 : 0x00); // error bit cleared by reading
+    card.errorLatched = 0;
+    break;
+  case 23:
+    if (!card.cmd23) {
+      fail("CMD23 to card without CMD23 in SCR");
+      sendByte(r1 | 0x04);
+      break;
+    }
+    card.blockCount = arg;
+    sendByte(r1);
+    break;
+  case 17:
+  case 18:
+    if (card.idle || checkAddress(arg)) {
+      sendByte(r1 | 0x40);
+      break;
+    }
+    sendByte(r1);
+    card.address = arg;
+    card.readLeft = (cmd == 17) ? 1 : card.blockCount ? (int32_t)card.blockCount : -1;
+    card.blockCount = 0;
+    if (card.fault == FAULT_NO_TOKEN) {
+      card.fault = FAULT_NONE;
+      card.readLeft = 0; // data never comes
+    }
+    break;
+  case 24:
+  case 25:
+    if (card.idle || checkAddress(arg)) {
+      sendByte(r1 | 0x40);
+      break;
+    }
+    sendByte(r1);
+    card.address = arg;
+    card.writeMulti = (cmd == 25);
+    card.writeLeft = (cmd == 24) ? 1 : card.blockCount ? (int32_t)card.blockCount : -1;
+    card.erased = (cmd == 25) ? card.preErase : 0;
+    card.rejected = 0;
+    card.blockCount = 0;
+    card.preErase = 0;
+    card.in = IN_TOKEN;
+    break;
+  case 12:
+    card.outLen = 0; // stops data at once
+    card.readLeft = 0;
+    sendByte(0xff);
+    sendByte(r1);
+    card.busy = STOP_BYTES;
+    break;
+  default:
+    fail("unexpected command");
+    sendByte(r1 | 0x04);
+    break;
+  }
+}
+/**
+ * @brief Takes a byte from MOSI.
+ */
+static void receive(uint8_t b) {
+
+  switch (card.in) {
+  case IN_COMMAND:
+    if (card.frameLen == 0 && (b & 0xc0) != 0x40) {
+      return; // not a start of command
+    }
+    if (card.frameLen > 0 && card.crcOn && (card.frame[0] & 0x3f) != 12) {
+      b = damage(b);
+    }
+    card.frame[card.frameLen++] = b;
+    if (card.frameLen == 6) {
+      card.frameLen = 0;
+      command();
+    }
+    break;
+  case IN_TOKEN:
+    if (b == 0xff) {
+      break;
+    }
+    if (card.writeMulti && b == 0xfd) {
+      if (card.writeLeft >= 0 && !card.rejected) {
+        fail("stop token after CMD23");
+      }
+      card.stopTokens++;
+      card.in = IN_COMMAND;
+      sendByte(0xff);
+      card.busy = PROGRAM_BYTES / 4; // finishing
+    } else if (b == (card.writeMulti ? 0xfc : 0xfe)) {
+      card.in = IN_DATA;
+      card.blockLen = 0;
+    } else {
+      fail("wrong start token");
+    }
+    break;
+  case IN_DATA:
+    card.block[card.blockLen] = damage(b) ^
+        (card.blockLen == 100 && divider < card.slowDivider);
+    card.blockLen++;
+    if (card.blockLen < 514) {
+      break;
+    }
+    if (card.crcOn && crc16(card.block, 514, 0) != 0) {
+      card.crcErrors++;
+      card.rejected = 1;
+      sendByte(0xeb); // CRC error, nothing written
+      card.in = card.writeMulti ? IN_TOKEN : IN_COMMAND;
+      break;
+    }
+    if (card.address >= CARD_SECTORS) {
+      fail("write beyond end of card");
+      sendByte(0xed);
+    } else if (card.address + 1 == card.badSector) {
+      sendByte(0xed); // write error
+      card.rejected = 1;
+    } else {
+      memcpy(memory + card.address * 512, card.block, 512);
+      sendByte(0xe5); // data accepted
+    }
+    card.busy = PROGRAM_BYTES;
+    if (card.erased == 0) {
+      card.busy += ERASE_BYTES; // erase is not known ahead
+    } else {
+      card.erased--;
+    }
+    card.address++;
+    if (card.writeLeft > 0 && --card.writeLeft == 0) {
+      card.in = IN_COMMAND;
+    } else {
+      card.in = IN_TOKEN;
+    }
+    break;
+  }
+}
+
+/**
+ * @brief Model of SPI1 functions.
+ */
+void SPI1_Init(void) {
+
+  divider = 256;
+}
+void SPI1_Select(void) {
+
+  card.selected = 1;
+}
+void SPI1_Deselect(void) {
+
+  card.selected = 0;
+  card.idleClocks = 0;
+}
+uint16_t SPI1_SetClockDivider(uint16_t div) {
+
+  uint16_t old = divider;
+
+  divider = 2;
+  while (divider < div && divider < 256) {
+    divider *= 2;
+  }
+  return old;
+}
+uint8_t SPI1_Transmit(uint8_t data) {
+
+  uint8_t b = 0xff;
+
+  card.bytes++;
+  ticks += 8 * divider;
+  if (!card.selected) {
+    // card ignores the bus, but counts clocks to find start of commands
+    card.idleClocks += 8;
+    if (card.idleClocks >= RESYNC_CLOCKS) {
+      card.desync = 0;
+      card.frameLen = 0;
+    }
+    return 0xff;
+  }
+  if (card.desync) {
+    return 0xff;
+  }
+  if (!card.outLen && card.readLeft != 0) {
+    if (card.address >= CARD_SECTORS) {
+      fail("read beyond end of card");
+      card.readLeft = 0;
+    } else {
+      sendBlock(memory + card.address++ * 512, 512);
+      if (card.readLeft > 0) {
+        card.readLeft--;
+      }
+    }
+  }
+  if (card.outLen) {
+    b = card.out[card.outHead];
+    card.outHead = (card.outHead + 1) % sizeof(card.out);
+    card.outLen--;
+  } else if (card.busy) {
+    card.busy--;
+    card.busyBytes++;
+    b = 0x00;
+  }
+  receive(data);
+  return b;
+}
+void SPI1_Transfer(const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  for (uint32_t i = 0; i < len; i++) {
+    uint8_t b = SPI1_Transmit(tx ? tx[i] : 0xff);
+    if (rx) {
+      rx[i] = b;
+    }
+  }
+}
+void SPI1_ReadBuffer(uint8_t* buf, uint32_t len) {
+
+  SPI1_Transfer(0, buf, len);
+}
+void SPI1_WriteBuffer(uint8_t* buf, uint32_t len) {
+
+  SPI1_Transfer(buf, 0, len);
+}
+uint16_t SPI1_ReadBlockCrc(uint8_t* buf, uint32_t len) {
+
+  uint8_t crc[2];
+
+  SPI1_Transfer(0, buf, len);
+  SPI1_Transfer(0, crc, 2);
+  return crc16(crc, 2, crc16(buf, len, 0));
+}
+uint16_t SPI1_WriteBlockCrc(const uint8_t* buf, uint32_t len) {
+
+  uint16_t crc = crc16(buf, len, 0);
+  uint8_t frame[2] = {crc >> 8, crc};
+
+  SPI1_Transfer(buf, 0, len);
+  SPI1_Transfer(frame, 0, 2);
+  return crc;
+}
+uint32_t TIMER_GetTime(void) {
+
+  // time passes with the bus, or by 1 ms for each call while it is idle
+  if (card.bytes == lastBytes) {
+    idleTime++;
+  }
+  lastBytes = card.bytes;
+  return idleTime + ticks / BUS_CLOCK_KHZ;
+}
+
+/**
+ * @brief Test scenario.
+ */
+typedef struct {
+  const char* name;
+  int cmd23;          ///< Card supports CMD23
+  uint8_t policy;     ///< SD_POLICY_ flags
+  uint8_t crc;        ///< CRC mode
+  uint32_t errorRate; ///< One in errorRate bits is flipped (0 - none)
+} Scenario;
+
+/**
+ * @brief Runs the workload.
+ * @return 0 if passed
+ */
+static int run(const Scenario* t) {
+
+  static uint8_t src[CLUSTER * 512], dst[CLUSTER * 512];
+  SD_CommandStats stats;
+  int failed = 0;
+  int corrupted = 0;
+
+  memset(&card, 0, sizeof(card));
+  seed = 2014;
+  card.cmd23 = t->cmd23;
+  card.powerUpPolls = 2;
+
+  if (SD_Init()) {
+    fprintf(stderr, "%s: init failed\n", t->name);
+    return 1;
+  }
+  if (!card.crcOn) {
+    fprintf(stderr, "%s: CRC not turned on by init\n", t->name);
+    return 1;
+  }
+  if (SD_SetCrcMode(t->crc)) {
+    fprintf(stderr, "%s: CRC mode not set\n", t->name);
+    return 1;
+  }
+  SD_SetCommandPolicy(t->policy);
+  SD_ClearCommandStats();
+  card.bytes = 0;
+  card.busyBytes = 0;
+  card.errorRate = t->errorRate;
+
+  for (int op = 0; op < OPS; op++) {
+    uint32_t cluster = 64 + op * CLUSTER;
+    uint32_t dir = 32 + op / 16;
+    uint32_t fat = 1 + cluster / 128;
+
+    for (unsigned int i = 0; i < sizeof(src); i++) {
+      src[i] = op * 7 + i;
+    }
+    failed |= SD_ReadSectors(dst, dir, 1);
+    failed |= SD_ReadSectors(dst, fat, 1);
+    failed |= SD_WriteSectors(src, cluster, CLUSTER);
+    failed |= SD_WriteSectors(src, fat, 1);
+    failed |= SD_WriteSectors(src, fat + 16, 1);
+    failed |= SD_WriteSectors(src + 512, dir, 1);
+    failed |= SD_ReadSectors(dst, cluster, CLUSTER);
+    if (memcmp(src, dst, sizeof(src))) {
+      corrupted++;
+    }
+  }
+  card.errorRate = 0;
+
+  SD_GetCommandStats(&stats);
+  fprintf(stderr, "%-26s %7u bytes (%6u busy), CMD17 %3u CMD18 %3u CMD12 %3u "
+      "CMD24 %3u CMD25 %3u CMD23 %3u ACMD23 %3u stop %3u\n", t->name,
+      (unsigned int)card.bytes, (unsigned int)card.busyBytes,
+      (unsigned int)stats.cmd[17], (unsigned int)stats.cmd[18],
+      (unsigned int)stats.cmd[12], (unsigned int)stats.cmd[24],
+      (unsigned int)stats.cmd[25], (unsigned int)stats.cmd[23],
+      (unsigned int)stats.acmd[23], (unsigned int)card.stopTokens);
+  fprintf(stderr, "%-26s %7u bytes damaged, CRC errors %3u (card %3u), "
+      "%3u clusters corrupted\n", "", (unsigned int)card.damaged,
+      (unsigned int)stats.crcErrors, (unsigned int)card.crcErrors, corrupted);
+
+  if (t->crc || !t->errorRate) {
+    // everything has to arrive intact
+    if (corrupted) {
+      fprintf(stderr, "  read back differs\n");
+      failed = 1;
+    }
+  } else if (!corrupted) {
+    fprintf(stderr, "  errors without CRC did not corrupt data\n");
+    failed = 1;
+  }
+  if (t->errorRate == 0 && (stats.crcErrors || card.crcErrors)) {
+    fprintf(stderr, "  CRC errors without bit errors\n");
+    failed = 1;
+  }
+
+  if (stats.busyBytes != card.busyBytes) {
+    fprintf(stderr, "  driver counted %u busy bytes, card %u\n",
+        (unsigned int)stats.busyBytes, (unsigned int)card.busyBytes);
+    failed = 1;
+  }
+  return failed || card.errors;
+}
+
+/**
+ * @brief Fault scenario.
+ */
+typedef struct {
+  const char* name;
+  Fault fault;
+  int read;           ///< 1 - read, 0 - write
+  int tier;           ///< Tier expected to recover (-1 - transfer fails)
+} FaultScenario;
+
+/**
+ * @brief Runs a transfer with a scripted fault.
+ * @return 0 if passed
+ */
+static int runFault(const FaultScenario* t) {
+
+  static uint8_t src[CLUSTER * 512], dst[CLUSTER * 512];
+  const uint32_t sector = 100;
+  SD_RecoveryStats stats;
+  uint32_t start, time;
+  int failed = 0;
+  uint8_t result;
+
+  memset(&card, 0, sizeof(card));
+  card.cmd23 = 1;
+  if (SD_Init()) {
+    fprintf(stderr, "%s: init failed\n", t->name);
+    return 1;
+  }
+  SD_SetCommandPolicy(SD_POLICY_DEFAULT);
+  SD_ClearRecoveryStats();
+
+  for (unsigned int i = 0; i < sizeof(src); i++) {
+    src[i] = i * 13 + t->fault;
+  }
+  memcpy(memory + sector * 512, t->read ? src : dst, sizeof(src));
+
+  card.fault = t->fault;
+  if (t->fault == FAULT_FAST_CLOCK) {
+    card.slowDivider = divider * 2;
+  } else if (t->fault == FAULT_BAD_SECTOR) {
+    card.badSector = sector + 2 + 1;
+  }
+  start = TIMER_GetTime();
+  if (t->read) {
+    result = SD_ReadSectors(dst, sector, CLUSTER);
+  } else {
+    result = SD_WriteSectors(src, sector, CLUSTER);
+  }
+  time = TIMER_GetTime() - start;
+  SD_GetRecoveryStats(&stats);
+
+  fprintf(stderr, "%-26s %s, %4u ms, tiers tried", t->name,
+      result ? "failed   " : "recovered", (unsigned int)time);
+  for (int i = 0; i < SD_TIERS; i++) {
+    fprintf(stderr, " %u", (unsigned int)stats.attempts[i]);
+  }
+  fprintf(stderr, ", time of tiers");
+  for (int i = 0; i < SD_TIERS; i++) {
+    fprintf(stderr, " %u", (unsigned int)stats.time[i]);
+  }
+  fprintf(stderr, " ms\n");
+
+  if (stats.errors != 1) {
+    fprintf(stderr, "  %u errors\n", (unsigned int)stats.errors);
+    failed = 1;
+  }
+  if (t->tier < 0) {
+    if (!result || stats.failed != 1 || stats.errorSector != sector + 2) {
+      fprintf(stderr, "  failure not reported at sector %u\n",
+          (unsigned int)(sector + 2));
+      failed = 1;
+    }
+  } else {
+    if (result || stats.recovered[t->tier] != 1) {
+      fprintf(stderr, "  not recovered by tier %d\n", t->tier);
+      failed = 1;
+    }
+    if (memcmp(t->read ? dst : memory + sector * 512, src, sizeof(src))) {
+      fprintf(stderr, "  data differs\n");
+      failed = 1;
+    }
+  }
+
+  // card works again
+  card.badSector = 0;
+  card.slowDivider = 0;
+  if (SD_WriteSectors(src, sector, CLUSTER) ||
+      SD_ReadSectors(dst, sector, CLUSTER) || memcmp(src, dst, sizeof(src))) {
+    fprintf(stderr, "  card not working after fault\n");
+    failed = 1;
+  }
+  return failed || card.errors;
+}
+
+int main(void) {
+
+  const Scenario scenarios[] = {
+    // name                     CMD23 policy                              CRC errors
+    {"multiple block only",       1, 0,                                     1, 0},
+    {"single block",              1, SD_POLICY_SINGLE,                      1, 0},
+    {"single block, CMD23",       1, SD_POLICY_SINGLE | SD_POLICY_CMD23,    1, 0},
+    {"all (default)",             1, SD_POLICY_DEFAULT,                     1, 0},
+    {"all, card without CMD23",   0, SD_POLICY_DEFAULT,                     1, 0},
+    {"all, CRC off",              1, SD_POLICY_DEFAULT,                     0, 0},
+    {"all, bit errors",           1, SD_POLICY_DEFAULT,                     1, 200000},
+    {"single, bit errors",        1, SD_POLICY_SINGLE,                      1, 200000},
+    {"no CMD23, bit errors",      0, SD_POLICY_DEFAULT,                     1, 200000},
+    {"all, CRC off, bit errors",  1, SD_POLICY_DEFAULT,                     0, 200000},
+  };
+  const FaultScenario faults[] = {
+    // name                     fault             read tier
+    {"damaged read block",        FAULT_CRC,          1, SD_TIER_RETRY},
+    {"no data token",             FAULT_NO_TOKEN,     1, SD_TIER_RETRY},
+    {"lost command framing",      FAULT_DESYNC,       0, SD_TIER_RESYNC},
+    {"error until status",        FAULT_ERROR,        1, SD_TIER_STATUS},
+    {"clock too fast",            FAULT_FAST_CLOCK,   1, SD_TIER_SLOW},
+    {"card hangs",                FAULT_HANG,         0, SD_TIER_REINIT},
+    {"bad sector",                FAULT_BAD_SECTOR,   0, -1},
+  };
+  int failed = 0;
+
+  for (unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    int f = run(&scenarios[i]);
+    if (f) {
+      fprintf(stderr, "%s: FAILED\n", scenarios[i].name);
+    }
+    failed |= f;
+  }
+  for (unsigned int i = 0; i < sizeof(faults) / sizeof(faults[0]); i++) {
+    int f = runFault(&faults[i]);
+    if (f) {
+      fprintf(stderr, "%s: FAILED\n", faults[i].name);
+    }
+    failed |= f;
+  }
+
+  return failed;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file    spi_sim.c
+ * @brief   PC model of the SPI bus for the pipelined transfer loop.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Runs the loops of spi_pipe.h on the PC against a model of
+ * the STM32 SPI in master mode (transmit buffer, shift register, receive
+ * buffer, TXE, RXNE and overrun) with MOSI looped back to MISO. Time
+ * is counted in core cycles: every register access takes REG_CYCLES,
+ * a clock period of SCK takes 2 cycles times the divider (APB2 runs at
+ * half the core clock):
+ *
+ *   gcc -std=gnu11 -O2 -I../hal/inc -o spi_sim spi_sim.c
+ *   ./spi_sim
+ *
+ * Like a logic analyser it records when every frame is clocked and
+ * prints the bus utilisation (clocked time over time from the first to
+ * the last clock) and the longest gap between frames, for the loop
+ * waiting for every byte (as SPI1_Transmit does) and for the pipelined
+ * loop with 8 and 16-bit frames. It checks that the pipelined loops
+ * clock without gaps, that the bytes are sent in buffer order and
+ * received back unchanged, and that with interrupts arriving during
+ * the transfer there is no overrun. Without the lock an interrupt
+ * longer than a frame loses a received frame and the loop then waits
+ * for ever for the last one.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define REG_CYCLES  4     ///< Core cycles of register access (with loop overhead)
+#define DATA_LEN    512   ///< Bytes of test transfer
+#define STALL_POLLS 1000  ///< Polls of idle bus after which the loop hangs
+#define SR_TXE      0x02
+#define SR_RXNE     0x01
+
+/**
+ * @brief Model of SPI and of the CPU time.
+ */
+static struct {
+  uint64_t now;         ///< Core cycles
+  uint32_t bitCycles;   ///< Core cycles of SCK period
+  uint8_t frameBits;    ///< 8 or 16
+  uint8_t shifting;     ///< Shift register busy
+  uint64_t shiftEnd;    ///< End of frame in shift register
+  uint16_t shiftData;   ///< Frame in shift register
+  uint8_t txFull;       ///< Transmit buffer full
+  uint16_t txData;      ///< Transmit buffer
+  uint8_t rxFull;       ///< Receive buffer full (RXNE)
+  uint16_t rxData;      ///< Receive buffer
+  uint32_t overruns;    ///< Frames received with RXNE set
+  uint32_t txLost;      ///< Frames written with TXE clear
+  uint32_t stallPolls;  ///< Polls while nothing can change
+  uint8_t hung;         ///< Loop waits for a frame that never comes
+  uint32_t masked;      ///< Interrupts locked
+  uint8_t lock;         ///< SPI_PIPE_LOCK locks interrupts
+  uint32_t irqPeriod;   ///< Cycles between interrupts (0 - none)
+  uint32_t irqLength;   ///< Cycles of interrupt handler
+  uint64_t nextIrq;     ///< Time of next interrupt
+  uint32_t irqs;        ///< Interrupts taken
+  // logic analyser
+  uint32_t frames;      ///< Frames clocked
+  uint64_t firstStart;  ///< Start of first frame
+  uint64_t lastEnd;     ///< End of last frame
+  uint64_t clocked;     ///< Time with clock running
+  uint64_t maxGap;      ///< Longest gap between frames
+  uint32_t gaps;        ///< Number of gaps between frames
+  uint8_t wire[DATA_LEN]; ///< Bytes on MOSI
+  uint32_t wireLen;     ///< Number of bytes on MOSI
+} bus;
+
+/**
+ * @brief Starts clocking a frame.
+ */
+static void busStart(uint64_t t, uint16_t data) {
+
+  if (bus.frames == 0) {
+    bus.firstStart = t;
+  } else if (t > bus.lastEnd) {
+    bus.gaps++;
+    if (t - bus.lastEnd > bus.maxGap) {
+      bus.maxGap = t - bus.lastEnd;
+    }
+  }
+  bus.frames++;
+  bus.shifting = 1;
+  bus.shiftData = data;
+  bus.shiftEnd = t + bus.frameBits * bus.bitCycles;
+  bus.clocked += bus.frameBits * bus.bitCycles;
+
+  if (bus.frameBits == 16 && bus.wireLen < DATA_LEN) {
+    bus.wire[bus.wireLen++] = data >> 8; // MSB first
+  }
+  if (bus.wireLen < DATA_LEN) {
+    bus.wire[bus.wireLen++] = data;
+  }
+}
+/**
+ * @brief Finishes frames clocked until now.
+ */
+static void busAdvance(void) {
+
+  while (bus.shifting && bus.now >= bus.shiftEnd) {
+    bus.shifting = 0;
+    bus.lastEnd = bus.shiftEnd;
+    if (bus.rxFull) {
+      bus.overruns++; // received frame lost
+    } else {
+      bus.rxFull = 1;
+      bus.rxData = bus.shiftData; // loop back
+    }
+    if (bus.txFull) { // next frame follows without gap
+      bus.txFull = 0;
+      busStart(bus.lastEnd, bus.txData);
+    }
+  }
+}
+/**
+ * @brief Lets the CPU run, with interrupts if they are not locked.
+ */
+static void cpu(uint32_t cycles) {
+
+  bus.now += cycles;
+  if (!bus.masked && bus.irqPeriod && bus.now >= bus.nextIrq) {
+    bus.now += bus.irqLength;
+    bus.nextIrq = bus.now + bus.irqPeriod;
+    bus.irqs++;
+  }
+  busAdvance();
+}
+/**
+ * @brief Reads status register (TXE and RXNE).
+ */
+static uint8_t readSR(void) {
+
+  cpu(REG_CYCLES);
+  if (!bus.shifting && !bus.rxFull && ++bus.stallPolls > STALL_POLLS) {
+    bus.hung = 1; // let the loop finish
+    return SR_TXE | SR_RXNE;
+  }
+  return (bus.txFull ? 0 : SR_TXE) | (bus.rxFull ? SR_RXNE : 0);
+}
+/**
+ * @brief Writes data register.
+ */
+static void writeDR(uint16_t data) {
+
+  cpu(REG_CYCLES);
+  if (!bus.shifting) {
+    busStart(bus.now, data);
+  } else if (bus.txFull) {
+    bus.txLost++;
+  } else {
+    bus.txFull = 1;
+    bus.txData = data;
+  }
+}
+/**
+ * @brief Reads data register.
+ */
+static uint16_t readDR(void) {
+
+  cpu(REG_CYCLES);
+  bus.rxFull = 0;
+  return bus.rxData;
+}
+
+#define SPI_PIPE_TXE()          (readSR() & SR_TXE)
+#define SPI_PIPE_RXNE()         (readSR() & SR_RXNE)
+#define SPI_PIPE_WRITE(x)       writeDR(x)
+#define SPI_PIPE_READ()         readDR()
+#define SPI_PIPE_LOCK(state)    ((state) = bus.masked, \
+                                  bus.masked = bus.lock ? 1 : bus.masked)
+#define SPI_PIPE_UNLOCK(state)  (bus.masked = (state))
+
+#include <spi_pipe.h>
+
+/**
+ * @brief Transfers bytes waiting for each one (like SPI1_Transmit).
+ */
+static void transferBlocking(const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  while (len--) {
+    while (!SPI_PIPE_TXE());
+    SPI_PIPE_WRITE(*tx++);
+    while (!SPI_PIPE_RXNE());
+    *rx++ = SPI_PIPE_READ();
+  }
+}
+/**
+ * @brief Transfers bytes with the pipelined loop and 8-bit frames.
+ */
+static void transfer8(const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  SPI_PIPE_Transfer8(tx, rx, len);
+}
+/**
+ * @brief Transfers bytes with 16-bit frames and the odd byte in an
+ * 8-bit frame (like SPI1_Transfer with SPI1_USE_16BIT).
+ */
+static void transfer16(const uint8_t* tx, uint8_t* rx, uint32_t len) {
+
+  bus.frameBits = 16;
+  SPI_PIPE_Transfer16(tx, rx, len / 2);
+  while (bus.shifting) { // BSY
+    cpu(REG_CYCLES);
+  }
+  bus.frameBits = 8;
+  SPI_PIPE_Transfer8(tx + (len & ~1), rx + (len & ~1), len & 1);
+}
+
+/**
+ * @brief Test scenario.
+ */
+typedef struct {
+  const char* name;
+  void (*transfer)(const uint8_t*, uint8_t*, uint32_t);
+  uint16_t div;         ///< SPI clock divider
+  uint32_t len;         ///< Bytes transferred
+  uint8_t lock;         ///< Interrupts locked by the loop
+  uint32_t irqPeriod;   ///< Cycles between interrupts
+  uint32_t irqLength;   ///< Cycles of interrupt handler
+  uint8_t gapFree;      ///< Gaps not allowed (without interrupts)
+  uint8_t overrun;      ///< Overrun expected
+} Scenario;
+
+/**
+ * @brief Runs a scenario.
+ * @return 0 if passed
+ */
+static int run(const Scenario* t) {
+
+  uint8_t tx[DATA_LEN], rx[DATA_LEN];
+  int failed = 0;
+
+  memset(&bus, 0, sizeof(bus));
+  bus.bitCycles = 2 * t->div;
+  bus.frameBits = 8;
+  bus.lock = t->lock;
+  bus.irqPeriod = t->irqPeriod;
+  bus.irqLength = t->irqLength;
+  bus.nextIrq = t->irqPeriod;
+  for (uint32_t i = 0; i < t->len; i++) {
+    tx[i] = i * 37 + 11;
+  }
+  memset(rx, 0, sizeof(rx));
+
+  t->transfer(tx, rx, t->len);
+
+  uint64_t span = bus.lastEnd - bus.firstStart;
+  printf("%-28s div %3u: %4u cycles/byte, utilisation %5.1f%%, "
+      "%3u gaps (max %4u cycles), %u irqs, %u overruns%s\n",
+      t->name, t->div, (unsigned int)(bus.now / t->len),
+      100.0 * bus.clocked / span, (unsigned int)bus.gaps,
+      (unsigned int)bus.maxGap, (unsigned int)bus.irqs,
+      (unsigned int)bus.overruns, bus.hung ? ", hung" : "");
+
+  if (t->overrun) {
+    if (!bus.overruns) {
+      fprintf(stderr, "  FAIL: overrun expected\n");
+      failed = 1;
+    }
+    return failed;
+  }
+  if (bus.overruns || bus.txLost || bus.hung) {
+    fprintf(stderr, "  FAIL: %u overruns, %u frames lost\n",
+        (unsigned int)bus.overruns, (unsigned int)bus.txLost);
+    failed = 1;
+  }
+  if (t->gapFree && bus.gaps) {
+    fprintf(stderr, "  FAIL: gaps between frames\n");
+    failed = 1;
+  }
+  if (bus.wireLen != t->len || memcmp(bus.wire, tx, t->len)) {
+    fprintf(stderr, "  FAIL: bytes sent out of order\n");
+    failed = 1;
+  }
+  if (memcmp(rx, tx, t->len)) {
+    fprintf(stderr, "  FAIL: received bytes differ\n");
+    failed = 1;
+  }
+  return failed;
+}
+
+int main(void) {
+
+  const Scenario scenarios[] = {
+    // name                      transfer          div  len lock  irq  len gap ovr
+    {"waiting for each byte",    transferBlocking,   2, 512, 1,     0,   0, 0, 0},
+    {"waiting for each byte",    transferBlocking,   8, 512, 1,     0,   0, 0, 0},
+    {"pipelined, 8-bit",         transfer8,          2, 512, 1,     0,   0, 1, 0},
+    {"pipelined, 8-bit",         transfer8,          8, 512, 1,     0,   0, 1, 0},
+    {"pipelined, 8-bit, command",transfer8,          2,   8, 1,     0,   0, 1, 0},
+    {"pipelined, 16-bit",        transfer16,         2, 512, 1,     0,   0, 1, 0},
+    {"pipelined, 16-bit, odd",   transfer16,         2, 511, 1,     0,   0, 0, 0},
+    {"pipelined, 8-bit, irqs",   transfer8,          2, 512, 1,  1000, 300, 0, 0},
+    {"pipelined, 16-bit, irqs",  transfer16,         2, 512, 1,  1000, 300, 0, 0},
+    {"pipelined, no lock, irqs", transfer8,          2, 512, 0,  1000, 300, 0, 1},
+  };
+  int failed = 0;
+
+  for (unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    failed |= run(&scenarios[i]);
+  }
+
+  return failed;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file    tlog_bench.c
+ * @brief   PC benchmark of queries of the time-indexed record file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Appends records to a data and an index file on a card in
+ * memory, opens the files again and runs queries of time ranges, for
+ * logs of several sizes:
+ *
+ *   gcc -std=gnu11 -O2 -I../app/inc -o tlog_bench tlog_bench.c \
+ *       ramcard.c ../app/src/tlog.c ../app/src/fat.c ../app/src/bdev.c \
+ *       ../app/src/utils.c ../app/src/crc.c
+ *   ./tlog_bench > /dev/null
+ *
+ * Ranges of several widths start at random timestamps. For every log
+ * size and width the average commands, sectors and time the card would take
+ * (ramcard.h model) of a query are printed, on the bare card and
+ * through the cache and coalescer of main.c, next to a scan of the
+ * block headers from the first block, which is what a query costs
+ * without the index. Every query must return the records in its range.
+ * Debug messages go to stdout.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include "ramcard.h"
+#include <tlog.h>
+#include <fat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CARD_SECTORS  20000 ///< Size of card
+#define DATA_BYTES    (4 * 1024 * 1024) ///< Size of data file
+#define INDEX_BYTES   4096  ///< Size of index file
+#define RECORD        24    ///< Bytes of record data
+#define PERIOD        2     ///< Seconds between records
+#define QUERIES       200   ///< Queries of every width
+
+static const uint32_t sizes[] = {1000, 10000, 100000}; ///< Records appended
+static const uint32_t widths[] = {0, 60, 3600, 6 * 3600};
+static TLOG_TypeDef tlog;
+static uint32_t matched;  ///< Records returned by query
+static uint32_t bad;      ///< Records returned out of range
+
+static uint32_t from, to; ///< Range of current query
+
+/**
+ * @brief System time for fat.c (card time is measured instead).
+ * @return Time in ms
+ */
+uint32_t TIMER_GetTime(void) {
+
+  return 0;
+}
+/**
+ * @brief Checks delay for fat.c.
+ * @param delay Delay in ms
+ * @param startTime Start of delay
+ * @return Always 0
+ */
+uint8_t TIMER_DelayTimer(uint32_t delay, uint32_t startTime) {
+
+  (void)delay;
+  (void)startTime;
+  return 0;
+}
+/**
+ * @brief Counts a record returned by a query.
+ * @param time Timestamp of record
+ * @param data Record data
+ * @param len Length of data
+ */
+static void count(uint32_t time, const uint8_t* data, uint16_t len) {
+
+  uint32_t stamp;
+
+  memcpy(&stamp, data, sizeof(stamp));
+  if (time < from || time > to || stamp != time || len != RECORD) {
+    bad++;
+  }
+  matched++;
+}
+/**
+ * @brief Formats the card and appends the records.
+ * @param records Number of records
+ * @return 0 if appended
+ */
+static int fill(uint32_t records) {
+
+  static const RAMCARD_File card[] = {
+    {"DATA    DAT", DATA_BYTES, 0, 0},
+    {"INDEX   DAT", INDEX_BYTES, 0, 0},
+  };
+  uint8_t record[RECORD];
+
+  RAMCARD_Format(CARD_SECTORS, 8, card, 2);
+  if (FAT_Init(RAMCARD_Init, RAMCARD_Device(0)) ||
+      TLOG_Open(&tlog, "DATA    DAT", "INDEX   DAT")) {
+    return -1;
+  }
+  memset(record, 0x55, sizeof(record));
+  for (uint32_t r = 0; r < records; r++) {
+    uint32_t time = r * PERIOD;
+    memcpy(record, &time, sizeof(time));
+    if (TLOG_Append(&tlog, time, record, RECORD)) {
+      return -1;
+    }
+  }
+  return TLOG_Close(&tlog);
+}
+/**
+ * @brief Finds the first block of a range by reading every block header.
+ * @param time First timestamp
+ */
+static void scan(uint32_t time) {
+
+  static uint8_t block[TLOG_BLOCK_SIZE];
+
+  for (uint32_t b = 0; b <= tlog.blockCount; b++) {
+    if (TLOG_ReadBlock(&tlog, b, block) > 0 &&
+        ((TLOG_BlockHeader*)block)->lastTime >= time) {
+      return;
+    }
+  }
+}
+
+int main(void) {
+
+  int errors = 0;
+
+  fprintf(stderr, "records every %d s, %d records per block\n", PERIOD,
+      (int)(TLOG_PAYLOAD / (RECORD + 6)));
+  fprintf(stderr, "%-7s %7s %9s %8s %6s %7s %10s %12s\n", "stack", "log",
+      "width [s]", "records", "cmds", "sectors", "query [ms]",
+      "no index [ms]");
+
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    uint32_t span = sizes[s] * PERIOD;
+
+    if (fill(sizes[s])) {
+      fprintf(stderr, "Cannot fill files\n");
+      return 1;
+    }
+    for (uint8_t layers = 0; layers < 2; layers++) {
+      // reset, files opened again
+      if (FAT_Init(RAMCARD_Init, RAMCARD_Device(layers)) ||
+          TLOG_Open(&tlog, "DATA    DAT", "INDEX   DAT")) {
+        fprintf(stderr, "Cannot open files\n");
+        return 1;
+      }
+      for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        RAMCARD_Stats query = {0, 0, 0, 0};
+        double scanTime = 0;
+        uint32_t records = 0;
+
+        srand(1);
+        bad = 0;
+        for (int q = 0; q < QUERIES; q++) {
+          from = rand() % span;
+          to = from + widths[w];
+          uint32_t expected = (to >= span ? span - 1 : to) / PERIOD -
+              (from + PERIOD - 1) / PERIOD + 1;
+
+          matched = 0;
+          memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+          TLOG_Query(&tlog, from, to, count);
+          query.reads += RAMCARD_stats.reads;
+          query.sectorsRead += RAMCARD_stats.sectorsRead;
+          if (matched != expected) {
+            bad++;
+          }
+          records += matched;
+
+          memset(&RAMCARD_stats, 0, sizeof(RAMCARD_stats));
+          scan(from);
+          scanTime += RAMCARD_Time(&RAMCARD_stats);
+        }
+        errors += bad;
+
+        fprintf(stderr, "%-7s %7u %9u %8.1f %6.1f %7.1f %10.2f %12.2f %s\n",
+            layers ? "cached" : "card", (unsigned)sizes[s],
+            (unsigned)widths[w], (double)records / QUERIES,
+            (double)query.reads / QUERIES, (double)query.sectorsRead / QUERIES,
+            RAMCARD_Time(&query) / QUERIES / 1000, scanTime / QUERIES / 1000,
+            bad ? "FAILED" : "ok");
+      }
+      TLOG_Close(&tlog);
+    }
+  }
+
+  return errors ? 1 : 0;
+}
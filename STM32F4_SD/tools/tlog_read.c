@@ -0,0 +1,173 @@
+/**
+ * @file    tlog_read.c
+ * @brief   PC tool printing records of a time-indexed record file.
+ * @date    17 paź 2026
+ * @author  Michal Ksiezopolski
+ *
+ * @details Build and run on the PC with the files copied from the card:
+ *
+ *   gcc -I../app/inc -o tlog_read tlog_read.c ../app/src/crc.c
+ *   ./tlog_read DATA.DAT INDEX.DAT [FROM TO]
+ *
+ * Records with timestamps from FROM to TO (all records if not given)
+ * are printed, one per line, after the timestamp. The range is found
+ * in the same way as TLOG_Query does on the device. The number of
+ * sectors read is printed at the end.
+ *
+ * @verbatim
+ * Copyright (c) 2014 Michal Ksiezopolski.
+ * All rights reserved. This program and the
+ * accompanying materials are made available
+ * under the terms of the GNU Public License
+ * v3.0 which accompanies this distribution,
+ * and is available at
+ * http://www.gnu.org/licenses/gpl.html
+ * @endverbatim
+ */
+
+#include <tlog.h>
+#include <crc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+
+static FILE* dataFile;    ///< Opened data file
+static FILE* indexFile;   ///< Opened index file
+static uint32_t generation; ///< Generation from index header
+static uint32_t dataReads;  ///< Number of data sectors read
+static uint32_t indexReads; ///< Number of index reads
+
+/**
+ * @brief Reads a data block.
+ * @param block Number of block
+ * @param buf Buffer for TLOG_BLOCK_SIZE bytes
+ * @return Number of records or -1 if block is not valid
+ */
+static int readBlock(uint32_t block, uint8_t* buf) {
+
+  TLOG_BlockHeader* hdr = (TLOG_BlockHeader*)buf;
+
+  dataReads++;
+  if (fseek(dataFile, (long)block * TLOG_BLOCK_SIZE, SEEK_SET) ||
+      fread(buf, TLOG_BLOCK_SIZE, 1, dataFile) != 1) {
+    return -1;
+  }
+  if (hdr->magic != TLOG_BLOCK_MAGIC || hdr->generation != generation ||
+      hdr->block != block || hdr->used > TLOG_PAYLOAD ||
+      hdr->checksum != CRC_Update(CRC_Calc(buf,
+      offsetof(TLOG_BlockHeader, checksum)),
+      buf + sizeof(TLOG_BlockHeader), hdr->used)) {
+    return -1;
+  }
+  return hdr->count;
+}
+/**
+ * @brief Reads an index entry.
+ * @param entry Number of entry
+ * @param data Entry (function writes this)
+ * @retval 0 Entry read
+ * @retval 1 Read error
+ */
+static int readEntry(uint32_t entry, TLOG_IndexEntry* data) {
+
+  indexReads++;
+  if (fseek(indexFile, TLOG_BLOCK_SIZE + (long)entry * sizeof(TLOG_IndexEntry),
+      SEEK_SET)) {
+    return 1;
+  }
+  return fread(data, sizeof(TLOG_IndexEntry), 1, indexFile) != 1;
+}
+
+int main(int argc, char** argv) {
+
+  uint8_t buf[TLOG_BLOCK_SIZE];
+  TLOG_IndexHeader hdr;
+  TLOG_IndexEntry entry;
+  uint32_t from = 0, to = UINT32_MAX;
+
+  if (argc != 3 && argc != 5) {
+    fprintf(stderr, "Usage: %s DATAFILE INDEXFILE [FROM TO]\n", argv[0]);
+    return 1;
+  }
+  if (argc == 5) {
+    from = strtoul(argv[3], 0, 0);
+    to = strtoul(argv[4], 0, 0);
+  }
+  dataFile = fopen(argv[1], "rb");
+  indexFile = fopen(argv[2], "rb");
+  if (!dataFile || !indexFile) {
+    perror("fopen");
+    return 1;
+  }
+  if (fread(&hdr, sizeof(hdr), 1, indexFile) != 1 ||
+      hdr.magic != TLOG_INDEX_MAGIC || hdr.checksum !=
+      CRC_Calc(&hdr, offsetof(TLOG_IndexHeader, checksum))) {
+    fprintf(stderr, "No valid index\n");
+    return 1;
+  }
+  generation = hdr.generation;
+
+  // count blocks written after header update
+  uint32_t blockCount = hdr.blockCount;
+  while (readBlock(blockCount, buf) != -1) {
+    blockCount++;
+  }
+
+  // find last entry older than first timestamp
+  uint32_t start = 0;
+  int lo = 0;
+  int hi = (hdr.blockCount + hdr.blocksPerEntry - 1) / hdr.blocksPerEntry - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (readEntry(mid, &entry)) {
+      break;
+    }
+    if (entry.firstTime < from) {
+      start = entry.block;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  uint32_t found = 0;
+  for (uint32_t block = start; block < blockCount; block++) {
+    int count = readBlock(block, buf);
+    if (count == -1) {
+      break;
+    }
+    uint8_t* ptr = buf + sizeof(TLOG_BlockHeader);
+    for (int i = 0; i < count; i++) {
+      uint32_t time;
+      memcpy(&time, ptr, 4);
+      int len = ptr[4] | (ptr[5] << 8);
+      if (time > to) {
+        block = blockCount;
+        break;
+      }
+      if (time >= from) {
+        printf("%u: ", (unsigned int)time);
+        for (int k = 0; k < len; k++) {
+          if (isprint(ptr[6 + k])) {
+            putchar(ptr[6 + k]);
+          } else {
+            printf("\\x%02x", ptr[6 + k]);
+          }
+        }
+        putchar('\n');
+        found++;
+      }
+      ptr += 6 + len;
+    }
+  }
+
+  fprintf(stderr, "%u records, %u blocks in file, %u index reads, %u data reads\n",
+      (unsigned int)found, (unsigned int)blockCount,
+      (unsigned int)indexReads, (unsigned int)dataReads);
+
+  fclose(dataFile);
+  fclose(indexFile);
+  return 0;
+}